@@ -69,6 +69,7 @@ static const pa_daemon_conf default_conf = {
     .disallow_module_loading = false,
     .disallow_exit = false,
     .flat_volumes = true,
+    .float_processing = false,
     .exit_idle_time = 20,
     .scache_idle_time = 20,
     .script_commands = NULL,
@@ -84,6 +85,8 @@ static const pa_daemon_conf default_conf = {
     .disable_remixing = false,
     .disable_lfe_remixing = false,
     .lfe_crossover_freq = 120,
+    .render_threads = 0,
+    .rtpoll_backend = PA_RTPOLL_BACKEND_POLL,
     .config_file = NULL,
     .use_pid_file = true,
     .system_instance = false,
@@ -293,6 +296,24 @@ static int parse_resample_method(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_rtpoll_backend(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+    int b;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if ((b = pa_parse_rtpoll_backend(state->rvalue)) < 0 || !pa_rtpoll_backend_supported(b)) {
+        pa_log(_("[%s:%u] Invalid rtpoll backend '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    c->rtpoll_backend = b;
+
+    return 0;
+}
+
 #ifdef HAVE_SYS_RESOURCE_H
 static int parse_rlimit(pa_config_parser_state *state) {
     struct pa_rlimit *r;
@@ -527,6 +548,7 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-shm",                pa_config_parse_bool,     &c->disable_shm, NULL },
         { "enable-shm",                 pa_config_parse_not_bool, &c->disable_shm, NULL },
         { "flat-volumes",               pa_config_parse_bool,     &c->flat_volumes, NULL },
+        { "float-processing",           pa_config_parse_bool,     &c->float_processing, NULL },
         { "lock-memory",                pa_config_parse_bool,     &c->lock_memory, NULL },
         { "enable-deferred-volume",     pa_config_parse_bool,     &c->deferred_volume, NULL },
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
@@ -555,6 +577,8 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "disable-lfe-remixing",       pa_config_parse_bool,     &c->disable_lfe_remixing, NULL },
         { "enable-lfe-remixing",        pa_config_parse_not_bool, &c->disable_lfe_remixing, NULL },
         { "lfe-crossover-freq",         pa_config_parse_unsigned, &c->lfe_crossover_freq, NULL },
+        { "render-threads",             pa_config_parse_unsigned, &c->render_threads, NULL },
+        { "rtpoll-backend",             parse_rtpoll_backend,     c, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
@@ -736,6 +760,7 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "cpu-limit = %s\n", pa_yes_no(!c->no_cpu_limit));
     pa_strbuf_printf(s, "enable-shm = %s\n", pa_yes_no(!c->disable_shm));
     pa_strbuf_printf(s, "flat-volumes = %s\n", pa_yes_no(c->flat_volumes));
+    pa_strbuf_printf(s, "float-processing = %s\n", pa_yes_no(c->float_processing));
     pa_strbuf_printf(s, "lock-memory = %s\n", pa_yes_no(c->lock_memory));
     pa_strbuf_printf(s, "exit-idle-time = %i\n", c->exit_idle_time);
     pa_strbuf_printf(s, "scache-idle-time = %i\n", c->scache_idle_time);
@@ -748,6 +773,8 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "enable-remixing = %s\n", pa_yes_no(!c->disable_remixing));
     pa_strbuf_printf(s, "enable-lfe-remixing = %s\n", pa_yes_no(!c->disable_lfe_remixing));
     pa_strbuf_printf(s, "lfe-crossover-freq = %u\n", c->lfe_crossover_freq);
+    pa_strbuf_printf(s, "render-threads = %u\n", c->render_threads);
+    pa_strbuf_printf(s, "rtpoll-backend = %s\n", pa_rtpoll_backend_to_string(c->rtpoll_backend));
     pa_strbuf_printf(s, "default-sample-format = %s\n", pa_sample_format_to_string(c->default_sample_spec.format));
     pa_strbuf_printf(s, "default-sample-rate = %u\n", c->default_sample_spec.rate);
     pa_strbuf_printf(s, "alternate-sample-rate = %u\n", c->alternate_sample_rate);
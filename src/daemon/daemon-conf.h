@@ -28,6 +28,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/core.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/rtpoll.h>
 
 #ifdef HAVE_SYS_RESOURCE_H
 #include <sys/resource.h>
@@ -73,6 +74,7 @@ typedef struct pa_daemon_conf {
         log_meta,
         log_time,
         flat_volumes,
+        float_processing,
         lock_memory,
         deferred_volume;
     pa_server_type_t local_server_type;
@@ -128,6 +130,8 @@ typedef struct pa_daemon_conf {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_threads;
+    pa_rtpoll_backend_t rtpoll_backend;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
@@ -85,6 +85,7 @@
 #include <pulsecore/shm.h>
 #include <pulsecore/memtrap.h>
 #include <pulsecore/strlist.h>
+#include <pulsecore/rtpoll.h>
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-shared.h>
 #endif
@@ -1015,6 +1016,8 @@ int main(int argc, char *argv[]) {
 
     pa_memtrap_install();
 
+    pa_rtpoll_set_default_backend(conf->rtpoll_backend);
+
     pa_assert_se(mainloop = pa_mainloop_new());
 
     if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm, conf->shm_size))) {
@@ -1030,6 +1033,7 @@ int main(int argc, char *argv[]) {
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
     c->lfe_crossover_freq = conf->lfe_crossover_freq;
+    c->render_threads = conf->render_threads;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
     c->resample_method = conf->resample_method;
@@ -1041,6 +1045,10 @@ int main(int argc, char *argv[]) {
     c->running_as_daemon = conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
     c->flat_volumes = conf->flat_volumes;
+    c->float_processing = conf->float_processing;
+
+    if (c->float_processing)
+        c->default_sample_spec.format = PA_SAMPLE_FLOAT32NE;
 #ifdef HAVE_DBUS
     c->server_type = conf->local_server_type;
 #endif
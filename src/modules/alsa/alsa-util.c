@@ -48,7 +48,7 @@
 #include "udev-util.h"
 #endif
 
-static int set_format(snd_pcm_t *pcm_handle, snd_pcm_hw_params_t *hwparams, pa_sample_format_t *f) {
+static int set_format(snd_pcm_t *pcm_handle, snd_pcm_hw_params_t *hwparams, pa_sample_format_t *f, bool exact) {
 
     static const snd_pcm_format_t format_trans[] = {
         [PA_SAMPLE_U8] = SND_PCM_FORMAT_U8,
@@ -96,6 +96,9 @@ static int set_format(snd_pcm_t *pcm_handle, snd_pcm_hw_params_t *hwparams, pa_s
                  snd_pcm_format_description(format_trans[*f]),
                  pa_alsa_strerror(ret));
 
+    if (exact)
+        return ret;
+
     if (*f == PA_SAMPLE_FLOAT32BE)
         *f = PA_SAMPLE_FLOAT32LE;
     else if (*f == PA_SAMPLE_FLOAT32LE)
@@ -205,7 +208,8 @@ int pa_alsa_set_hw_params(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,
         bool *use_tsched,
-        bool require_exact_channel_number) {
+        bool require_exact_channel_number,
+        bool require_exact_format) {
 
     int ret = -1;
     snd_pcm_hw_params_t *hwparams, *hwparams_copy;
@@ -298,7 +302,7 @@ int pa_alsa_set_hw_params(
     }
 #endif
 
-    if ((ret = set_format(pcm_handle, hwparams, &_ss.format)) < 0)
+    if ((ret = set_format(pcm_handle, hwparams, &_ss.format, require_exact_format)) < 0)
         goto finish;
 
     if ((ret = snd_pcm_hw_params_set_rate_near(pcm_handle, hwparams, &_ss.rate, NULL)) < 0) {
@@ -528,7 +532,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_auto(
         bool *use_mmap,
         bool *use_tsched,
         pa_alsa_profile_set *ps,
-        pa_alsa_mapping **mapping) {
+        pa_alsa_mapping **mapping,
+        bool require_exact_format) {
 
     char *d;
     snd_pcm_t *pcm_handle;
@@ -565,7 +570,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_auto(
                 tsched_size,
                 use_mmap,
                 use_tsched,
-                m);
+                m,
+                require_exact_format);
 
         if (pcm_handle) {
             if (mapping)
@@ -592,7 +598,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_auto(
                 tsched_size,
                 use_mmap,
                 use_tsched,
-                m);
+                m,
+                require_exact_format);
 
         if (pcm_handle) {
             if (mapping)
@@ -616,7 +623,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_auto(
             tsched_size,
             use_mmap,
             use_tsched,
-            false);
+            false,
+            require_exact_format);
     pa_xfree(d);
 
     if (pcm_handle && mapping)
@@ -636,7 +644,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_mapping(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,
         bool *use_tsched,
-        pa_alsa_mapping *m) {
+        pa_alsa_mapping *m,
+        bool require_exact_format) {
 
     snd_pcm_t *pcm_handle;
     pa_sample_spec try_ss;
@@ -665,7 +674,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_mapping(
             tsched_size,
             use_mmap,
             use_tsched,
-            pa_channel_map_valid(&m->channel_map) /* Query the channel count if we don't know what we want */);
+            pa_channel_map_valid(&m->channel_map) /* Query the channel count if we don't know what we want */,
+            require_exact_format);
 
     if (!pcm_handle)
         return NULL;
@@ -688,7 +698,8 @@ snd_pcm_t *pa_alsa_open_by_device_string(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,
         bool *use_tsched,
-        bool require_exact_channel_number) {
+        bool require_exact_channel_number,
+        bool require_exact_format) {
 
     int err;
     char *d;
@@ -723,7 +734,8 @@ snd_pcm_t *pa_alsa_open_by_device_string(
                      tsched_size,
                      use_mmap,
                      use_tsched,
-                     require_exact_channel_number)) < 0) {
+                     require_exact_channel_number,
+                     require_exact_format)) < 0) {
 
             if (!reformat) {
                 reformat = true;
@@ -781,7 +793,8 @@ snd_pcm_t *pa_alsa_open_by_template(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,
         bool *use_tsched,
-        bool require_exact_channel_number) {
+        bool require_exact_channel_number,
+        bool require_exact_format) {
 
     snd_pcm_t *pcm_handle;
     char **i;
@@ -802,7 +815,8 @@ snd_pcm_t *pa_alsa_open_by_template(
                 tsched_size,
                 use_mmap,
                 use_tsched,
-                require_exact_channel_number);
+                require_exact_channel_number,
+                require_exact_format);
 
         pa_xfree(d);
 
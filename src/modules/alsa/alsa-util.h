@@ -33,6 +33,10 @@
 
 #include "alsa-mixer.h"
 
+/* If require_exact_format is set, the sample format in ss is not
+ * replaced by one the device supports, the call fails instead. The
+ * pa_alsa_open_*() functions then retry with ALSA's plug plugin,
+ * which converts to the device format. */
 int pa_alsa_set_hw_params(
         snd_pcm_t *pcm_handle,
         pa_sample_spec *ss,                /* modified at return */
@@ -41,7 +45,8 @@ int pa_alsa_set_hw_params(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,                    /* modified at return */
         bool *use_tsched,                  /* modified at return */
-        bool require_exact_channel_number);
+        bool require_exact_channel_number,
+        bool require_exact_format);
 
 int pa_alsa_set_sw_params(
         snd_pcm_t *pcm,
@@ -61,7 +66,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_auto(
         bool *use_mmap,                   /* modified at return */
         bool *use_tsched,                 /* modified at return */
         pa_alsa_profile_set *ps,
-        pa_alsa_mapping **mapping);       /* modified at return */
+        pa_alsa_mapping **mapping,        /* modified at return */
+        bool require_exact_format);
 
 /* Uses the specified mapping */
 snd_pcm_t *pa_alsa_open_by_device_id_mapping(
@@ -75,7 +81,8 @@ snd_pcm_t *pa_alsa_open_by_device_id_mapping(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,                   /* modified at return */
         bool *use_tsched,                 /* modified at return */
-        pa_alsa_mapping *mapping);
+        pa_alsa_mapping *mapping,
+        bool require_exact_format);
 
 /* Opens the explicit ALSA device */
 snd_pcm_t *pa_alsa_open_by_device_string(
@@ -89,7 +96,8 @@ snd_pcm_t *pa_alsa_open_by_device_string(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,                   /* modified at return */
         bool *use_tsched,                 /* modified at return */
-        bool require_exact_channel_number);
+        bool require_exact_channel_number,
+        bool require_exact_format);
 
 /* Opens the explicit ALSA device with a fallback list */
 snd_pcm_t *pa_alsa_open_by_template(
@@ -104,7 +112,8 @@ snd_pcm_t *pa_alsa_open_by_template(
         snd_pcm_uframes_t tsched_size,
         bool *use_mmap,                   /* modified at return */
         bool *use_tsched,                 /* modified at return */
-        bool require_exact_channel_number);
+        bool require_exact_channel_number,
+        bool require_exact_format);
 
 void pa_alsa_dump(pa_log_level_t level, snd_pcm_t *pcm);
 void pa_alsa_dump_status(snd_pcm_t *pcm);
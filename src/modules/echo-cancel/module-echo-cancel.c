@@ -38,7 +38,9 @@
 #include <pulse/rtclock.h>
 
 #include <pulsecore/i18n.h>
+#include <pulsecore/asyncq.h>
 #include <pulsecore/atomic.h>
+#include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sink.h>
@@ -50,6 +52,8 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
 
 #include "module-echo-cancel-symdef.h"
 
@@ -75,6 +79,7 @@ PA_MODULE_USAGE(
           "save_aec=<save AEC data in /tmp> "
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
+          "pipelined=<run the canceller on its own thread, yes or no> "
         ));
 
 /* NOTE: Make sure the enum and ec_table are maintained in the correct order */
@@ -140,6 +145,7 @@ static const pa_echo_canceller ec_table[] = {
 #define DEFAULT_ADJUST_TOLERANCE (5*PA_USEC_PER_MSEC)
 #define DEFAULT_SAVE_AEC false
 #define DEFAULT_AUTOLOADED false
+#define DEFAULT_PIPELINED false
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
@@ -174,6 +180,17 @@ static const pa_echo_canceller ec_table[] = {
  *    be before capture and the difference should not be bigger than one frame
  *    size. We would ideally like to resample the sink_input but most driver
  *    don't give enough accuracy to be able to do that right now.
+ *
+ * With pipelined=yes the canceller itself does not run in the source IO
+ * thread. The IO thread still aligns capture and playback, but hands the
+ * blocks to a dedicated canceller thread through a lock-free queue. The
+ * canceller thread posts the canceled blocks back to the source IO thread
+ * through our asyncmsgq, and the blocks still in flight are added to the
+ * latency of our source. This keeps an expensive canceller from stalling
+ * the capture device, at the cost of some extra latency. If the canceller
+ * thread falls so far behind that its queue is full, the IO thread does not
+ * wait for it: the capture data is passed through uncanceled and whatever
+ * the canceller still has in flight is dropped when it comes back.
  */
 
 struct userdata;
@@ -200,6 +217,29 @@ struct snapshot {
     size_t plen;
 };
 
+/* Work for the canceller thread, in the order the source IO thread would
+ * have done it itself */
+struct ec_job {
+    enum {
+        EC_JOB_RUN,
+        EC_JOB_PLAY,
+        EC_JOB_RECORD,
+        EC_JOB_SET_DRIFT,
+        EC_JOB_PASS,
+        EC_JOB_FLUSH,
+        EC_JOB_QUIT
+    } type;
+
+    pa_memchunk rchunk, pchunk;
+    float drift;
+
+    /* What the canceller sees of the source IO thread */
+    pa_cvolume current_volume;
+    pa_thread_mq *thread_mq;
+};
+
+PA_STATIC_FLIST_DECLARE(ec_jobs, 0, pa_xfree);
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -253,6 +293,18 @@ struct userdata {
     struct {
         pa_cvolume current_volume;
     } thread_info;
+
+    /* Only set up with pipelined=yes */
+    pa_thread *ec_thread;
+    pa_asyncq *ec_queue;
+    size_t ec_pending;             /* bytes in flight, source I/O thread */
+    size_t ec_dropping;            /* of those, what is dropped on return */
+    unsigned ec_overruns;
+
+    struct {
+        pa_cvolume current_volume;
+        pa_thread_mq *thread_mq;
+    } ec_thread_info;
 };
 
 static void source_output_snapshot_within_thread(struct userdata *u, struct snapshot *snapshot);
@@ -275,6 +327,7 @@ static const char* const valid_modargs[] = {
     "save_aec",
     "autoloaded",
     "use_volume_sharing",
+    "pipelined",
     NULL
 };
 
@@ -282,7 +335,9 @@ enum {
     SOURCE_OUTPUT_MESSAGE_POST = PA_SOURCE_OUTPUT_MESSAGE_MAX,
     SOURCE_OUTPUT_MESSAGE_REWIND,
     SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT,
-    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME
+    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
+    SOURCE_OUTPUT_MESSAGE_CANCELED,
+    SOURCE_OUTPUT_MESSAGE_FLUSHED
 };
 
 enum {
@@ -417,7 +472,9 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
                 /* Add the latency internal to our source output on top */
                 pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec) +
                 /* and the buffering we do on the source */
-                pa_bytes_to_usec(u->source_output_blocksize, &u->source_output->source->sample_spec);
+                pa_bytes_to_usec(u->source_output_blocksize, &u->source_output->source->sample_spec) +
+                /* and what is still with the canceller thread */
+                pa_bytes_to_usec(u->ec_pending - u->ec_dropping, &u->source->sample_spec);
 
             return 0;
 
@@ -691,6 +748,248 @@ static void do_resync(struct userdata *u) {
     apply_diff_time(u, diff_time);
 }
 
+/* The canceller calls proper. These run in the source I/O thread, or in the
+ * canceller thread when pipelined, which then also owns the save_aec files.
+ * The caller keeps its references to the chunks passed in. */
+static void canceller_set_drift(struct userdata *u, float drift) {
+    u->ec->set_drift(u->ec, drift);
+
+    if (u->save_aec) {
+        if (u->drift_file)
+            fprintf(u->drift_file, "d %a\n", drift);
+    }
+}
+
+static void canceller_play(struct userdata *u, pa_memchunk *pchunk) {
+    uint8_t *pdata;
+    int unused PA_GCC_UNUSED;
+
+    pdata = pa_memblock_acquire(pchunk->memblock);
+    pdata += pchunk->index;
+
+    u->ec->play(u->ec, pdata);
+
+    if (u->save_aec) {
+        if (u->drift_file)
+            fprintf(u->drift_file, "p %d\n", u->sink_blocksize);
+        if (u->played_file)
+            unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
+    }
+
+    pa_memblock_release(pchunk->memblock);
+}
+
+static void canceller_record(struct userdata *u, pa_memchunk *rchunk, pa_memchunk *cchunk) {
+    uint8_t *rdata, *cdata;
+    int unused PA_GCC_UNUSED;
+
+    rdata = pa_memblock_acquire(rchunk->memblock);
+    rdata += rchunk->index;
+
+    cchunk->index = 0;
+    cchunk->length = u->source_output_blocksize;
+    cchunk->memblock = pa_memblock_new(u->core->mempool, cchunk->length);
+    cdata = pa_memblock_acquire(cchunk->memblock);
+
+    u->ec->record(u->ec, rdata, cdata);
+
+    if (u->save_aec) {
+        if (u->drift_file)
+            fprintf(u->drift_file, "c %d\n", u->source_output_blocksize);
+        if (u->captured_file)
+            unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
+        if (u->canceled_file)
+            unused = fwrite(cdata, 1, u->source_output_blocksize, u->canceled_file);
+    }
+
+    pa_memblock_release(cchunk->memblock);
+    pa_memblock_release(rchunk->memblock);
+}
+
+static void canceller_run(struct userdata *u, pa_memchunk *rchunk, pa_memchunk *pchunk, pa_memchunk *cchunk) {
+    uint8_t *rdata, *pdata, *cdata;
+    int unused PA_GCC_UNUSED;
+
+    rdata = pa_memblock_acquire(rchunk->memblock);
+    rdata += rchunk->index;
+    pdata = pa_memblock_acquire(pchunk->memblock);
+    pdata += pchunk->index;
+
+    cchunk->index = 0;
+    cchunk->length = u->source_blocksize;
+    cchunk->memblock = pa_memblock_new(u->core->mempool, cchunk->length);
+    cdata = pa_memblock_acquire(cchunk->memblock);
+
+    if (u->save_aec) {
+        if (u->captured_file)
+            unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
+        if (u->played_file)
+            unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
+    }
+
+    /* perform echo cancellation */
+    u->ec->run(u->ec, rdata, pdata, cdata);
+
+    if (u->save_aec) {
+        if (u->canceled_file)
+            unused = fwrite(cdata, 1, u->source_blocksize, u->canceled_file);
+    }
+
+    pa_memblock_release(cchunk->memblock);
+    pa_memblock_release(pchunk->memblock);
+    pa_memblock_release(rchunk->memblock);
+}
+
+/* Hands a job to the canceller thread, which takes over the references to
+ * the chunks. Unless asked to wait, this fails if the canceller thread's
+ * queue is full, and the caller keeps its references.
+ *
+ * Called from source I/O thread context. */
+static int queue_job(struct userdata *u, int type, const pa_memchunk *rchunk, const pa_memchunk *pchunk, float drift, bool wait) {
+    struct ec_job *j;
+    size_t pending = 0;
+
+    pa_assert(u->ec_thread);
+
+    if (!(j = pa_flist_pop(PA_STATIC_FLIST_GET(ec_jobs))))
+        j = pa_xnew(struct ec_job, 1);
+
+    j->type = type;
+    j->drift = drift;
+
+    if (rchunk)
+        j->rchunk = *rchunk;
+    else
+        pa_memchunk_reset(&j->rchunk);
+
+    if (pchunk)
+        j->pchunk = *pchunk;
+    else
+        pa_memchunk_reset(&j->pchunk);
+
+    j->current_volume = u->thread_info.current_volume;
+    j->thread_mq = pa_thread_mq_get();
+
+    /* Whatever will come back for our source */
+    if (type == EC_JOB_RUN)
+        pending = u->source_blocksize;
+    else if (type == EC_JOB_RECORD)
+        pending = u->source_output_blocksize;
+    else if (type == EC_JOB_PASS)
+        pending = rchunk->length;
+
+    if (pa_asyncq_push(u->ec_queue, j, wait) < 0) {
+        if (pa_flist_push(PA_STATIC_FLIST_GET(ec_jobs), j) < 0)
+            pa_xfree(j);
+
+        return -1;
+    }
+
+    u->ec_pending += pending;
+
+    return 0;
+}
+
+/* The canceller thread could not take rchunk, so post it without
+ * cancellation. What the canceller thread still has is older than that
+ * now, and is dropped when it comes back.
+ *
+ * Called from source I/O thread context. */
+static void canceller_overrun(struct userdata *u, pa_memchunk *rchunk) {
+    pa_memchunk chunk;
+
+    u->ec_overruns++;
+    u->ec_dropping = u->ec_pending;
+
+    if (pa_log_ratelimit(PA_LOG_WARN))
+        pa_log_warn("Canceller thread overrun (%u so far), passing capture data through", u->ec_overruns);
+
+    if (pa_sample_spec_equal(&u->source_output->sample_spec, &u->source->sample_spec)) {
+        pa_source_post(u->source, rchunk);
+        return;
+    }
+
+    /* The capture data is not in our source's format, so keep the timing
+     * with silence instead */
+    pa_silence_memchunk_get(&u->core->silence_cache, u->core->mempool, &chunk, &u->source->sample_spec,
+                            rchunk->length / pa_frame_size(&u->source_output->sample_spec) * pa_frame_size(&u->source->sample_spec));
+    pa_source_post(u->source, &chunk);
+    pa_memblock_unref(chunk.memblock);
+}
+
+/* Called from canceller thread context. */
+static void post_canceled(struct userdata *u, pa_memchunk *cchunk) {
+#ifdef ECHO_CANCEL_TEST
+    int unused PA_GCC_UNUSED;
+
+    unused = fwrite(pa_memblock_acquire_chunk(cchunk), cchunk->length, 1, u->canceled_file);
+    pa_memblock_release(cchunk->memblock);
+#else
+    pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_CANCELED, NULL, 0, cchunk, NULL);
+#endif
+    pa_memblock_unref(cchunk->memblock);
+}
+
+static void canceller_thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    struct ec_job *j;
+    pa_memchunk cchunk;
+    bool quit = false;
+
+    pa_log_debug("Canceller thread starting up");
+
+    if (u->core->realtime_scheduling)
+        pa_make_realtime(u->core->realtime_priority);
+
+    while (!quit) {
+        pa_assert_se(j = pa_asyncq_pop(u->ec_queue, true));
+
+        u->ec_thread_info.current_volume = j->current_volume;
+        u->ec_thread_info.thread_mq = j->thread_mq;
+
+        switch (j->type) {
+            case EC_JOB_RUN:
+                canceller_run(u, &j->rchunk, &j->pchunk, &cchunk);
+                pa_memblock_unref(j->rchunk.memblock);
+                pa_memblock_unref(j->pchunk.memblock);
+                post_canceled(u, &cchunk);
+                break;
+
+            case EC_JOB_PLAY:
+                canceller_play(u, &j->pchunk);
+                pa_memblock_unref(j->pchunk.memblock);
+                break;
+
+            case EC_JOB_RECORD:
+                canceller_record(u, &j->rchunk, &cchunk);
+                pa_memblock_unref(j->rchunk.memblock);
+                post_canceled(u, &cchunk);
+                break;
+
+            case EC_JOB_SET_DRIFT:
+                canceller_set_drift(u, j->drift);
+                break;
+
+            case EC_JOB_PASS:
+                post_canceled(u, &j->rchunk);
+                break;
+
+            case EC_JOB_FLUSH:
+                pa_asyncmsgq_post(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_FLUSHED, NULL, 0, NULL, NULL);
+                break;
+
+            case EC_JOB_QUIT:
+                quit = true;
+                break;
+        }
+
+        if (pa_flist_push(PA_STATIC_FLIST_GET(ec_jobs), j) < 0)
+            pa_xfree(j);
+    }
+
+    pa_log_debug("Canceller thread shutting down");
+}
+
 /* 1. Calculate drift at this point, pass to canceller
  * 2. Push out playback samples in blocksize chunks
  * 3. Push out capture samples in blocksize chunks
@@ -702,9 +1001,7 @@ static void do_resync(struct userdata *u) {
 static void do_push_drift_comp(struct userdata *u) {
     size_t rlen, plen;
     pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
     float drift;
-    int unused PA_GCC_UNUSED;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
@@ -724,68 +1021,46 @@ static void do_push_drift_comp(struct userdata *u) {
     u->source_rem = rlen % u->source_output_blocksize;
 
     /* Now let the canceller work its drift compensation magic */
-    u->ec->set_drift(u->ec, drift);
-
-    if (u->save_aec) {
-        if (u->drift_file)
-            fprintf(u->drift_file, "d %a\n", drift);
-    }
+    if (u->ec_thread)
+        queue_job(u, EC_JOB_SET_DRIFT, NULL, NULL, drift, false);
+    else
+        canceller_set_drift(u, drift);
 
     /* Send in the playback samples first */
     while (plen >= u->sink_blocksize) {
         pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &pchunk);
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
-
-        u->ec->play(u->ec, pdata);
-
-        if (u->save_aec) {
-            if (u->drift_file)
-                fprintf(u->drift_file, "p %d\n", u->sink_blocksize);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
-        }
-
-        pa_memblock_release(pchunk.memblock);
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
-
         plen -= u->sink_blocksize;
+
+        if (u->ec_thread) {
+            /* Missed playback just makes the canceller adapt again */
+            if (queue_job(u, EC_JOB_PLAY, NULL, &pchunk, 0.0f, false) < 0)
+                pa_memblock_unref(pchunk.memblock);
+        } else {
+            canceller_play(u, &pchunk);
+            pa_memblock_unref(pchunk.memblock);
+        }
     }
 
     /* And now the capture samples */
     while (rlen >= u->source_output_blocksize) {
         pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &rchunk);
+        pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
+        rlen -= u->source_output_blocksize;
 
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
-
-        cchunk.index = 0;
-        cchunk.length = u->source_output_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
-
-        u->ec->record(u->ec, rdata, cdata);
-
-        if (u->save_aec) {
-            if (u->drift_file)
-                fprintf(u->drift_file, "c %d\n", u->source_output_blocksize);
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_output_blocksize, u->canceled_file);
+        if (u->ec_thread) {
+            if (queue_job(u, EC_JOB_RECORD, &rchunk, NULL, 0.0f, false) < 0) {
+                canceller_overrun(u, &rchunk);
+                pa_memblock_unref(rchunk.memblock);
+            }
+            continue;
         }
 
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
-
+        canceller_record(u, &rchunk, &cchunk);
         pa_memblock_unref(rchunk.memblock);
 
         pa_source_post(u->source, &cchunk);
         pa_memblock_unref(cchunk.memblock);
-
-        pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
-        rlen -= u->source_output_blocksize;
     }
 }
 
@@ -797,8 +1072,6 @@ static void do_push_drift_comp(struct userdata *u) {
 static void do_push(struct userdata *u) {
     size_t rlen, plen;
     pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
-    int unused PA_GCC_UNUSED;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
@@ -813,49 +1086,31 @@ static void do_push(struct userdata *u) {
         if (plen < u->sink_blocksize)
             pa_memblockq_seek(u->sink_memblockq, u->sink_blocksize - plen, PA_SEEK_RELATIVE, true);
 
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
-
-        cchunk.index = 0;
-        cchunk.length = u->source_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
-
-        if (u->save_aec) {
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
-        }
-
-        /* perform echo cancellation */
-        u->ec->run(u->ec, rdata, pdata, cdata);
-
-        if (u->save_aec) {
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_blocksize, u->canceled_file);
-        }
-
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(pchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
-
         /* drop consumed source samples */
         pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
-        pa_memblock_unref(rchunk.memblock);
         rlen -= u->source_output_blocksize;
 
         /* drop consumed sink samples */
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
 
         if (plen >= u->sink_blocksize)
             plen -= u->sink_blocksize;
         else
             plen = 0;
 
+        if (u->ec_thread) {
+            if (queue_job(u, EC_JOB_RUN, &rchunk, &pchunk, 0.0f, false) < 0) {
+                canceller_overrun(u, &rchunk);
+                pa_memblock_unref(rchunk.memblock);
+                pa_memblock_unref(pchunk.memblock);
+            }
+            continue;
+        }
+
+        canceller_run(u, &rchunk, &pchunk, &cchunk);
+        pa_memblock_unref(rchunk.memblock);
+        pa_memblock_unref(pchunk.memblock);
+
         /* forward the (echo-canceled) data to the virtual source */
         pa_source_post(u->source, &cchunk);
         pa_memblock_unref(cchunk.memblock);
@@ -907,9 +1162,18 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
 
         if (to_skip) {
             pa_memblockq_peek_fixed_size(u->source_memblockq, to_skip, &rchunk);
-            pa_source_post(u->source, &rchunk);
 
-            pa_memblock_unref(rchunk.memblock);
+            /* Keep these in order with what the canceller still has */
+            if (u->ec_thread) {
+                if (queue_job(u, EC_JOB_PASS, &rchunk, NULL, 0.0f, false) < 0) {
+                    canceller_overrun(u, &rchunk);
+                    pa_memblock_unref(rchunk.memblock);
+                }
+            } else {
+                pa_source_post(u->source, &rchunk);
+                pa_memblock_unref(rchunk.memblock);
+            }
+
             pa_memblockq_drop(u->source_memblockq, to_skip);
 
             rlen -= to_skip;
@@ -1068,6 +1332,27 @@ static int source_output_process_msg_cb(pa_msgobject *obj, int code, void *data,
             apply_diff_time(u, offset);
             return 0;
 
+        case SOURCE_OUTPUT_MESSAGE_CANCELED:
+            pa_source_output_assert_io_context(u->source_output);
+
+            pa_assert(u->ec_pending >= chunk->length);
+            u->ec_pending -= chunk->length;
+
+            /* Overtaken by capture data that was passed through */
+            if (u->ec_dropping > 0) {
+                pa_assert(u->ec_dropping >= chunk->length);
+                u->ec_dropping -= chunk->length;
+                return 0;
+            }
+
+            if (PA_SOURCE_IS_LINKED(u->source->thread_info.state))
+                pa_source_post(u->source, chunk);
+
+            return 0;
+
+        case SOURCE_OUTPUT_MESSAGE_FLUSHED:
+            return 0;
+
     }
 
     return pa_source_output_process_msg(obj, code, data, offset, chunk);
@@ -1286,6 +1571,15 @@ static void source_output_detach_cb(pa_source_output *o) {
     pa_source_output_assert_io_context(o);
     pa_assert_se(u = o->userdata);
 
+    /* Collect everything the canceller thread still has for us, so that
+     * none of it ends up in another thread */
+    if (u->ec_thread) {
+        pa_assert_se(queue_job(u, EC_JOB_FLUSH, NULL, NULL, 0.0f, true) == 0);
+        pa_asyncmsgq_wait_for(u->asyncmsgq, SOURCE_OUTPUT_MESSAGE_FLUSHED);
+        pa_assert(u->ec_pending == 0);
+        pa_assert(u->ec_dropping == 0);
+    }
+
     pa_source_detach_within_thread(u->source);
     pa_source_set_rtpoll(u->source, NULL);
 
@@ -1550,22 +1844,41 @@ static int canceller_process_msg_cb(pa_msgobject *o, int code, void *userdata, i
     return 0;
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread context, or canceller thread
+ * context when pipelined. */
 void pa_echo_canceller_get_capture_volume(pa_echo_canceller *ec, pa_cvolume *v) {
 #ifndef ECHO_CANCEL_TEST
-    *v = ec->msg->userdata->thread_info.current_volume;
+    struct userdata *u = ec->msg->userdata;
+
+    if (u->ec_thread)
+        *v = u->ec_thread_info.current_volume;
+    else
+        *v = u->thread_info.current_volume;
 #else
     pa_cvolume_set(v, 1, PA_VOLUME_NORM);
 #endif
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread context, or canceller thread
+ * context when pipelined. */
 void pa_echo_canceller_set_capture_volume(pa_echo_canceller *ec, pa_cvolume *v) {
 #ifndef ECHO_CANCEL_TEST
-    if (!pa_cvolume_equal(&ec->msg->userdata->thread_info.current_volume, v)) {
+    struct userdata *u = ec->msg->userdata;
+    pa_cvolume *current;
+    pa_thread_mq *thread_mq;
+
+    if (u->ec_thread) {
+        current = &u->ec_thread_info.current_volume;
+        thread_mq = u->ec_thread_info.thread_mq;
+    } else {
+        current = &u->thread_info.current_volume;
+        thread_mq = pa_thread_mq_get();
+    }
+
+    if (!pa_cvolume_equal(current, v)) {
         pa_cvolume *vol = pa_xnewdup(pa_cvolume, v, 1);
 
-        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, vol, 0, NULL,
+        pa_asyncmsgq_post(thread_mq->outq, PA_MSGOBJECT(ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, vol, 0, NULL,
                 pa_xfree);
     }
 #endif
@@ -1650,6 +1963,7 @@ int pa__init(pa_module*m) {
     pa_sample_spec source_output_ss, source_ss, sink_ss;
     pa_channel_map source_output_map, source_map, sink_map;
     pa_modargs *ma;
+    bool pipelined = DEFAULT_PIPELINED;
     pa_source *source_master=NULL;
     pa_sink *sink_master=NULL;
     pa_source_output_new_data source_output_data;
@@ -1742,6 +2056,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "pipelined", &pipelined) < 0) {
+        pa_log("Failed to parse pipelined value");
+        goto fail;
+    }
+
     if (init_common(ma, u, &source_ss, &source_map) < 0)
         goto fail;
 
@@ -1772,6 +2091,15 @@ int pa__init(pa_module*m) {
     if (u->ec->params.drift_compensation)
         pa_assert(u->ec->set_drift);
 
+    if (pipelined) {
+        u->ec_queue = pa_asyncq_new(0);
+
+        if (!(u->ec_thread = pa_thread_new("echo-cancel", canceller_thread_func, u))) {
+            pa_log("Failed to create canceller thread.");
+            goto fail;
+        }
+    }
+
     /* Create source */
     pa_source_new_data_init(&source_data);
     source_data.driver = __FILE__;
@@ -2048,6 +2376,18 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unlink(u->sink);
 
+    /* The source output is detached now, so the canceller thread is idle */
+    if (u->ec_thread) {
+        struct ec_job *j = pa_xnew0(struct ec_job, 1);
+
+        j->type = EC_JOB_QUIT;
+        pa_assert_se(pa_asyncq_push(u->ec_queue, j, true) == 0);
+        pa_thread_free(u->ec_thread);
+    }
+
+    if (u->ec_queue)
+        pa_asyncq_free(u->ec_queue, NULL);
+
     if (u->source_output)
         pa_source_output_unref(u->source_output);
     if (u->sink_input)
@@ -2088,6 +2428,25 @@ void pa__done(pa_module*m) {
 }
 
 #ifdef ECHO_CANCEL_TEST
+/* With pipelined=yes the blocks go through the canceller thread as they
+ * would in the module, which writes out what comes back */
+static void test_chunk_new(struct userdata *u, pa_memchunk *chunk, const uint8_t *data, size_t length) {
+    chunk->index = 0;
+    chunk->length = length;
+    chunk->memblock = pa_memblock_new(u->core->mempool, length);
+    memcpy(pa_memblock_acquire(chunk->memblock), data, length);
+    pa_memblock_release(chunk->memblock);
+}
+
+static void test_thread_stop(struct userdata *u) {
+    if (!u->ec_thread)
+        return;
+
+    pa_assert_se(queue_job(u, EC_JOB_QUIT, NULL, NULL, 0.0f, true) == 0);
+    pa_thread_free(u->ec_thread);
+    u->ec_thread = NULL;
+}
+
 /*
  * Stand-alone test program for running in the canceller on pre-recorded files.
  */
@@ -2097,11 +2456,13 @@ int main(int argc, char* argv[]) {
     pa_channel_map source_output_map, source_map, sink_map;
     pa_modargs *ma = NULL;
     uint8_t *rdata = NULL, *pdata = NULL, *cdata = NULL;
+    pa_memchunk rchunk, pchunk;
     int unused PA_GCC_UNUSED;
     int ret = 0, i;
     char c;
     float drift;
     uint32_t nframes;
+    bool pipelined = DEFAULT_PIPELINED;
 
     if (!getenv("MAKE_CHECK"))
         pa_log_set_level(PA_LOG_DEBUG);
@@ -2162,6 +2523,21 @@ int main(int argc, char* argv[]) {
     u.source_blocksize = nframes * pa_frame_size(&source_ss);
     u.sink_blocksize = nframes * pa_frame_size(&sink_ss);
 
+    if (pa_modargs_get_value_boolean(ma, "pipelined", &pipelined) < 0) {
+        pa_log("Failed to parse pipelined value");
+        goto fail;
+    }
+
+    if (pipelined) {
+        u.core->mempool = pa_mempool_new(false, 0);
+        u.ec_queue = pa_asyncq_new(0);
+
+        if (!(u.ec_thread = pa_thread_new("echo-cancel", canceller_thread_func, &u))) {
+            pa_log("Failed to create canceller thread.");
+            goto fail;
+        }
+    }
+
     if (u.ec->params.drift_compensation) {
         if (argc < 6) {
             pa_log("Drift compensation enabled but drift file not specified");
@@ -2187,6 +2563,13 @@ int main(int argc, char* argv[]) {
                 goto fail;
             }
 
+            if (u.ec_thread) {
+                test_chunk_new(&u, &rchunk, rdata, u.source_output_blocksize);
+                test_chunk_new(&u, &pchunk, pdata, u.sink_blocksize);
+                pa_assert_se(queue_job(&u, EC_JOB_RUN, &rchunk, &pchunk, 0.0f, true) == 0);
+                continue;
+            }
+
             u.ec->run(u.ec, rdata, pdata, cdata);
 
             unused = fwrite(cdata, u.source_blocksize, 1, u.canceled_file);
@@ -2200,7 +2583,10 @@ int main(int argc, char* argv[]) {
                         goto fail;
                     }
 
-                    u.ec->set_drift(u.ec, drift);
+                    if (u.ec_thread)
+                        pa_assert_se(queue_job(&u, EC_JOB_SET_DRIFT, NULL, NULL, drift, true) == 0);
+                    else
+                        u.ec->set_drift(u.ec, drift);
 
                     break;
 
@@ -2215,6 +2601,12 @@ int main(int argc, char* argv[]) {
                         goto fail;
                     }
 
+                    if (u.ec_thread) {
+                        test_chunk_new(&u, &rchunk, rdata, i);
+                        pa_assert_se(queue_job(&u, EC_JOB_RECORD, &rchunk, NULL, 0.0f, true) == 0);
+                        break;
+                    }
+
                     u.ec->record(u.ec, rdata, cdata);
 
                     unused = fwrite(cdata, i, 1, u.canceled_file);
@@ -2232,7 +2624,11 @@ int main(int argc, char* argv[]) {
                         goto fail;
                     }
 
-                    u.ec->play(u.ec, pdata);
+                    if (u.ec_thread) {
+                        test_chunk_new(&u, &pchunk, pdata, i);
+                        pa_assert_se(queue_job(&u, EC_JOB_PLAY, NULL, &pchunk, 0.0f, true) == 0);
+                    } else
+                        u.ec->play(u.ec, pdata);
 
                     break;
             }
@@ -2244,9 +2640,17 @@ int main(int argc, char* argv[]) {
             pa_log("All playback data was not consumed");
     }
 
+    test_thread_stop(&u);
     u.ec->done(u.ec);
 
 out:
+    test_thread_stop(&u);
+
+    if (u.ec_queue)
+        pa_asyncq_free(u.ec_queue, NULL);
+    if (u.core && u.core->mempool)
+        pa_mempool_free(u.core->mempool);
+
     if (u.captured_file)
         fclose(u.captured_file);
     if (u.played_file)
@@ -48,21 +48,27 @@
 
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/i18n.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/aupdate.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sink.h>
 #include <pulsecore/module.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
+#include <pulsecore/planar.h>
 #include <pulsecore/log.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/semaphore.h>
 #include <pulsecore/shared.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/strlist.h>
 #include <pulsecore/database.h>
 #include <pulsecore/protocol-dbus.h>
 #include <pulsecore/dbus-util.h>
+#include <pulsecore/filter/convolver.h>
+#include <pulsecore/filter/fir-design.h>
 
 #include "module-equalizer-sink-symdef.h"
 
@@ -80,10 +86,32 @@ PA_MODULE_USAGE(
           "channel_map=<channel map> "
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
+          "filter_mode=<stft or partitioned> "
+          "block_size=<partition size in frames for partitioned mode> "
+          "filter_length=<number of FIR coefficients for partitioned mode> "
          ));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED false
+#define DEFAULT_BLOCK_SIZE 256
+#define DEFAULT_FILTER_LENGTH 4095
+#define MIN_BLOCK_SIZE 16
+#define MAX_BLOCK_SIZE 8192
+#define CROSSFADE_USEC (20 * PA_USEC_PER_MSEC)
+
+enum {
+    SINK_MESSAGE_SET_FIR = PA_SINK_MESSAGE_MAX
+};
+
+struct userdata;
+
+/* Helper thread for running the convolvers of several channels at
+ * once in partitioned mode */
+struct fir_worker {
+    struct userdata *u;
+    pa_thread *thread;
+    pa_semaphore *sem;
+};
 
 struct userdata {
     pa_module *module;
@@ -116,12 +144,35 @@ struct userdata {
     float ***Hs;//thread updatable copies of the freq response filters (magnitude based)
     pa_aupdate **a_H;
     pa_memblockq *input_q;
+    pa_planar *planar;
     char *output_buffer;
     size_t output_buffer_length;
     size_t output_buffer_max_length;
     pa_memblockq *output_q;
     bool first_iteration;
 
+    /* Partitioned mode: one convolver per channel running a linear
+     * phase FIR designed from the current filter, NULL in STFT mode.
+     * Latency doesn't depend on the filter length here, only the
+     * group delay of fir_length / 2 frames remains. */
+    pa_convolver **convolvers;
+    size_t fir_length;
+    unsigned crossfade_frames;
+    pa_fir_design *fir_design;
+    pa_planar *fir_out;
+
+    /* The batch being processed by the workers, only written by the
+     * IO thread while they are idle */
+    struct fir_worker *workers;
+    unsigned n_workers;
+    const float *fir_src[PA_CHANNELS_MAX];
+    uint8_t *fir_dst;
+    unsigned fir_frames;
+    pa_atomic_t fir_next;
+    pa_atomic_t fir_running;
+    pa_semaphore *fir_done;
+    bool fir_quit;
+
     pa_dbus_protocol *dbus_protocol;
     char *dbus_path;
 
@@ -139,6 +190,9 @@ static const char* const valid_modargs[] = {
     "channel_map",
     "autoloaded",
     "use_volume_sharing",
+    "filter_mode",
+    "block_size",
+    "filter_length",
     NULL
 };
 
@@ -237,12 +291,165 @@ static void alloc_input_buffers(struct userdata *u, size_t min_buffer_length) {
     u->input_buffer_max = min_buffer_length;
 }
 
+/* Called from main context */
+static void design_fir(struct userdata *u, size_t c, float *taps) {
+    unsigned a_i;
+
+    a_i = pa_aupdate_read_begin(u->a_H[c]);
+    pa_fir_design_run(u->fir_design, u->Hs[c][a_i], u->Xs[c][a_i], taps);
+    pa_aupdate_read_end(u->a_H[c]);
+}
+
+/* Called from I/O thread context, or from main context while the
+ * sink input isn't running */
+static void set_fir(struct userdata *u, const float *taps, unsigned crossfade_frames) {
+    for (size_t c = 0; c < u->channels; ++c) {
+        pa_convolver_crossfade(u->convolvers[c], crossfade_frames);
+        pa_convolver_set_ir(u->convolvers[c], 0, 0, taps + c * u->fir_length, 1);
+    }
+}
+
+/* Called from main context, after the filters have been written */
+static void filter_changed(struct userdata *u) {
+    float *taps;
+
+    if (!u->convolvers)
+        return;
+
+    taps = pa_xnew(float, u->channels * u->fir_length);
+    for (size_t c = 0; c < u->channels; ++c)
+        design_fir(u, c, taps + c * u->fir_length);
+
+    /* Let the IO thread fade over to the new filter. The FIR design
+     * is done here, so it only has to transform the partitions. */
+    if (PA_SINK_IS_LINKED(pa_sink_get_state(u->sink)) && u->sink->asyncmsgq)
+        pa_asyncmsgq_post(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_SET_FIR, taps, 0, NULL, pa_xfree);
+    else {
+        set_fir(u, taps, 0);
+        pa_xfree(taps);
+    }
+}
+
+/* Called from I/O thread context or from a worker */
+static void run_fir_batch(struct userdata *u) {
+    size_t fs = pa_frame_size(&u->sink->sample_spec);
+    int c;
+
+    while ((c = pa_atomic_inc(&u->fir_next)) < (int) u->channels) {
+        pa_convolver_process(u->convolvers[c], u->fir_src[c], u->fir_out->data[c], u->fir_frames);
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->fir_dst + c * sizeof(float), fs, u->fir_out->data[c], sizeof(float), u->fir_frames);
+    }
+
+    /* The last one to leave the batch wakes up the IO thread */
+    if (pa_atomic_dec(&u->fir_running) == 1)
+        pa_semaphore_post(u->fir_done);
+}
+
+static void fir_thread_func(void *userdata) {
+    struct fir_worker *w = userdata;
+    struct userdata *u = w->u;
+
+    if (u->module->core->realtime_scheduling)
+        pa_make_realtime(u->module->core->realtime_priority);
+
+    for (;;) {
+        pa_semaphore_wait(w->sem);
+
+        if (u->fir_quit)
+            break;
+
+        run_fir_batch(u);
+    }
+}
+
+/* Called from I/O thread context. Filters n frames of the given
+ * planes into the interleaved dst, one channel per participant. */
+static void process_fir(struct userdata *u, const float *planes[], uint8_t *dst, unsigned n) {
+    unsigned n_wake;
+
+    pa_planar_ensure(u->fir_out, n);
+
+    for (size_t c = 0; c < u->channels; ++c)
+        u->fir_src[c] = planes[c];
+    u->fir_dst = dst;
+    u->fir_frames = n;
+
+    /* The IO thread takes a channel itself */
+    n_wake = PA_MIN((unsigned) u->channels - 1, u->n_workers);
+
+    pa_atomic_store(&u->fir_next, 0);
+    pa_atomic_store(&u->fir_running, (int) n_wake + 1);
+
+    for (unsigned i = 0; i < n_wake; ++i)
+        pa_semaphore_post(u->workers[i].sem);
+
+    run_fir_batch(u);
+
+    pa_semaphore_wait(u->fir_done);
+}
+
+/* Called from main context. Only worth it with more than two
+ * channels, below that the thread handoff costs about as much as it
+ * saves. */
+static void start_fir_workers(struct userdata *u) {
+    unsigned n;
+
+    n = PA_MIN((unsigned) u->channels, pa_ncpus());
+    if (u->channels <= 2 || n < 2)
+        return;
+
+    u->workers = pa_xnew0(struct fir_worker, n - 1);
+
+    for (unsigned i = 0; i < n - 1; ++i) {
+        struct fir_worker *w = &u->workers[i];
+        char *t;
+
+        w->u = u;
+        w->sem = pa_semaphore_new(0);
+
+        t = pa_sprintf_malloc("equalizer-%u", i);
+        w->thread = pa_thread_new(t, fir_thread_func, w);
+        pa_xfree(t);
+
+        if (!w->thread) {
+            pa_log("Failed to create filter thread.");
+            pa_semaphore_free(w->sem);
+            break;
+        }
+
+        u->n_workers++;
+    }
+
+    pa_log_debug("Filtering %zu channels with %u helper threads.", u->channels, u->n_workers);
+}
+
+/* Called from main context, once the sink input is gone */
+static void stop_fir_workers(struct userdata *u) {
+    u->fir_quit = true;
+
+    for (unsigned i = 0; i < u->n_workers; ++i)
+        pa_semaphore_post(u->workers[i].sem);
+
+    for (unsigned i = 0; i < u->n_workers; ++i) {
+        pa_thread_free(u->workers[i].thread);
+        pa_semaphore_free(u->workers[i].sem);
+    }
+
+    pa_xfree(u->workers);
+    u->workers = NULL;
+    u->n_workers = 0;
+}
+
 /* Called from I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
 
     switch (code) {
 
+        case SINK_MESSAGE_SET_FIR:
+            set_fir(u, data, u->crossfade_frames);
+            return 0;
+
         case PA_SINK_MESSAGE_GET_LATENCY: {
             //size_t fs=pa_frame_size(&u->sink->sample_spec);
 
@@ -263,6 +470,11 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
                 pa_bytes_to_usec(pa_memblockq_get_length(u->output_q) +
                                  pa_memblockq_get_length(u->input_q), &u->sink_input->sink->sample_spec) +
                 pa_bytes_to_usec(pa_memblockq_get_length(u->sink_input->thread_info.render_memblockq), &u->sink_input->sink->sample_spec);
+
+            /* The FIR is linear phase, so everything comes out half
+             * the filter length late */
+            if (u->convolvers)
+                *((pa_usec_t*) data) += pa_bytes_to_usec((u->fir_length / 2) * pa_frame_size(&u->sink->sample_spec), &u->sink->sample_spec);
             //    pa_bytes_to_usec(u->samples_gathered * fs, &u->sink->sample_spec);
             //+ pa_bytes_to_usec(u->latency * fs, ss)
             return 0;
@@ -572,18 +784,62 @@ static void process_samples(struct userdata *u) {
 static void input_buffer(struct userdata *u, pa_memchunk *in) {
     size_t fs = pa_frame_size(&(u->sink->sample_spec));
     size_t samples = in->length/fs;
-    float *src = pa_memblock_acquire_chunk(in);
+    const float *planes[PA_CHANNELS_MAX];
     pa_assert(u->samples_gathered + samples <= u->input_buffer_max);
+    /* this doesn't copy anything if the data comes from a filter that
+     * already has it in planes */
+    pa_planar_from_memchunk(u->planar, in, planes);
     for(size_t c = 0; c < u->channels; c++) {
         //buffer with an offset after the overlap from previous
         //iterations
         pa_assert_se(
             u->input[c] + u->samples_gathered + samples <= u->input[c] + u->input_buffer_max
         );
-        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c] + u->samples_gathered, sizeof(float), src + c, fs, samples);
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c] + u->samples_gathered, sizeof(float), planes[c], sizeof(float), samples);
     }
     u->samples_gathered += samples;
-    pa_memblock_release(in->memblock);
+}
+
+/* Called from I/O thread context. In partitioned mode there is no
+ * window to fill: whatever the master asks for is rendered and
+ * filtered right away. */
+static void partitioned_pop(struct userdata *u, size_t nbytes, pa_memchunk *chunk) {
+    size_t fs = pa_frame_size(&u->sink->sample_spec);
+    const float *planes[PA_CHANNELS_MAX];
+    pa_memchunk tchunk;
+    uint8_t *dst;
+    unsigned n;
+
+    /* Hmm, process any rewind request that might be queued up */
+    pa_sink_process_rewind(u->sink, 0);
+
+    while (pa_memblockq_peek(u->input_q, &tchunk) < 0) {
+        pa_memchunk nchunk;
+
+        pa_sink_render(u->sink, nbytes, &nchunk);
+        pa_memblockq_push(u->input_q, &nchunk);
+        pa_memblock_unref(nchunk.memblock);
+    }
+
+    tchunk.length = PA_MIN(nbytes, tchunk.length);
+    pa_assert(tchunk.length > 0);
+
+    n = (unsigned) (tchunk.length / fs);
+    pa_assert(n > 0);
+
+    chunk->index = 0;
+    chunk->length = n * fs;
+    chunk->memblock = pa_memblock_new(u->sink->core->mempool, chunk->length);
+
+    pa_memblockq_drop(u->input_q, chunk->length);
+
+    pa_planar_from_memchunk(u->planar, &tchunk, planes);
+
+    dst = pa_memblock_acquire(chunk->memblock);
+    process_fir(u, planes, dst, n);
+    pa_memblock_release(chunk->memblock);
+
+    pa_memblock_unref(tchunk.memblock);
 }
 
 /* Called from I/O thread context */
@@ -599,6 +855,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     pa_assert(chunk);
     pa_assert(u->sink);
 
+    if (u->convolvers) {
+        partitioned_pop(u, nbytes, chunk);
+        return 0;
+    }
+
     /* FIXME: Please clean this up. I see more commented code lines
      * than uncommented code lines. I am sorry, but I am too dumb to
      * understand this. */
@@ -736,13 +997,23 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         if (amount > 0) {
             //invalidate the output q
             pa_memblockq_seek(u->input_q, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-            pa_log("Resetting filter");
+            if (!u->convolvers)
+                pa_log("Resetting filter");
             //reset_filter(u); //this is the "proper" thing to do...
         }
     }
 
     pa_sink_process_rewind(u->sink, amount);
     pa_memblockq_rewind(u->input_q, nbytes);
+
+    /* The convolvers keep their input history, so the rewound input
+     * can simply be filtered again when it is popped */
+    if (u->convolvers) {
+        size_t fs = pa_frame_size(&u->sink->sample_spec);
+
+        for (size_t c = 0; c < u->channels; ++c)
+            pa_convolver_rewind(u->convolvers[c], nbytes / fs);
+    }
 }
 
 /* Called from I/O thread context */
@@ -756,6 +1027,13 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_memblockq_set_maxrewind(u->input_q, nbytes);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes);
+
+    if (u->convolvers) {
+        size_t fs = pa_frame_size(&u->sink->sample_spec);
+
+        for (size_t c = 0; c < u->channels; ++c)
+            pa_convolver_set_max_rewind(u->convolvers[c], nbytes / fs);
+    }
 }
 
 /* Called from I/O thread context */
@@ -766,6 +1044,11 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
     pa_sink_input_assert_ref(i);
     pa_assert_se(u = i->userdata);
 
+    if (u->convolvers) {
+        pa_sink_set_max_request_within_thread(u->sink, nbytes);
+        return;
+    }
+
     fs = pa_frame_size(&u->sink_input->sample_spec);
     pa_sink_set_max_request_within_thread(u->sink, PA_ROUND_UP(nbytes / fs, u->R) * fs);
 }
@@ -815,11 +1098,15 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
 
     fs = pa_frame_size(&u->sink_input->sample_spec);
-    /* set buffer size to max request, no overlap copy */
-    max_request = PA_ROUND_UP(pa_sink_input_get_max_request(u->sink_input) / fs, u->R);
-    max_request = PA_MAX(max_request, u->window_size);
+    if (u->convolvers)
+        pa_sink_set_max_request_within_thread(u->sink, pa_sink_input_get_max_request(u->sink_input));
+    else {
+        /* set buffer size to max request, no overlap copy */
+        max_request = PA_ROUND_UP(pa_sink_input_get_max_request(u->sink_input) / fs, u->R);
+        max_request = PA_MAX(max_request, u->window_size);
 
-    pa_sink_set_max_request_within_thread(u->sink, max_request * fs);
+        pa_sink_set_max_request_within_thread(u->sink, max_request * fs);
+    }
 
     /* FIXME: Too small max_rewind:
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
@@ -1092,6 +1379,10 @@ int pa__init(pa_module*m) {
     float *H;
     unsigned a_i;
     bool use_volume_sharing = true;
+    const char *filter_mode;
+    bool partitioned;
+    uint32_t block_size = DEFAULT_BLOCK_SIZE;
+    uint32_t filter_length = DEFAULT_FILTER_LENGTH;
 
     pa_assert(m);
 
@@ -1124,6 +1415,30 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    filter_mode = pa_modargs_get_value(ma, "filter_mode", "stft");
+    if (pa_streq(filter_mode, "partitioned"))
+        partitioned = true;
+    else if (pa_streq(filter_mode, "stft"))
+        partitioned = false;
+    else {
+        pa_log("filter_mode= expects stft or partitioned");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "block_size", &block_size) < 0 ||
+        block_size < MIN_BLOCK_SIZE || block_size > MAX_BLOCK_SIZE || (block_size & (block_size - 1)) != 0) {
+        pa_log("block_size= expects a power of two between %u and %u", MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+        goto fail;
+    }
+
+    /* The FIR is taken from the inverse transform of the filter, which
+     * has at least as many points as the sample rate */
+    if (pa_modargs_get_value_u32(ma, "filter_length", &filter_length) < 0 ||
+        filter_length < 1 || filter_length > ss.rate) {
+        pa_log("filter_length= expects a number between 1 and the sample rate");
+        goto fail;
+    }
+
     u = pa_xnew0(struct userdata, 1);
     u->module = m;
     m->userdata = u;
@@ -1166,6 +1481,26 @@ int pa__init(pa_module*m) {
     hanning_window(u->W, u->window_size);
     u->first_iteration = true;
 
+    if (partitioned) {
+        u->fir_length = filter_length;
+        if (u->fir_length % 2 == 0)
+            u->fir_length--;
+
+        u->fir_design = pa_fir_design_new(u->fft_size, u->fir_length);
+
+        u->crossfade_frames = pa_usec_to_bytes(CROSSFADE_USEC, &ss) / pa_frame_size(&ss);
+        u->fir_out = pa_planar_new(ss.channels, 0);
+        u->fir_done = pa_semaphore_new(0);
+
+        u->convolvers = pa_xnew0(pa_convolver *, u->channels);
+        for (c = 0; c < u->channels; ++c)
+            u->convolvers[c] = pa_convolver_new(block_size, 1, 1, u->fir_length);
+
+        start_fir_workers(u);
+
+        pa_log_debug("Partitioned convolution with %zu coefficients in blocks of %u frames.", u->fir_length, block_size);
+    }
+
     u->base_profiles = pa_xnew0(char *, u->channels);
     for (c = 0; c < u->channels; ++c)
         u->base_profiles[c] = pa_xstrdup("default");
@@ -1218,6 +1553,7 @@ int pa__init(pa_module*m) {
     u->sink->userdata = u;
 
     u->input_q = pa_memblockq_new("module-equalizer-sink input_q", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, &u->sink->silence);
+    u->planar = pa_planar_new(ss.channels, 0);
     u->output_q = pa_memblockq_new("module-equalizer-sink output_q", 0, MEMBLOCKQ_MAXLENGTH, 0, &ss, 1, 1, 0, NULL);
     u->output_buffer = NULL;
     u->output_buffer_length = 0;
@@ -1279,6 +1615,7 @@ int pa__init(pa_module*m) {
 
     /* load old parameters */
     load_state(u);
+    filter_changed(u);
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
@@ -1337,9 +1674,27 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unref(u->sink);
 
+    if (u->workers)
+        stop_fir_workers(u);
+
+    if (u->convolvers) {
+        for (c = 0; c < u->channels; ++c)
+            if (u->convolvers[c])
+                pa_convolver_free(u->convolvers[c]);
+        pa_xfree(u->convolvers);
+    }
+    if (u->fir_done)
+        pa_semaphore_free(u->fir_done);
+    if (u->fir_out)
+        pa_planar_free(u->fir_out);
+    if (u->fir_design)
+        pa_fir_design_free(u->fir_design);
+
     pa_xfree(u->output_buffer);
     pa_memblockq_free(u->output_q);
     pa_memblockq_free(u->input_q);
+    if (u->planar)
+        pa_planar_free(u->planar);
 
     fftwf_destroy_plan(u->inverse_plan);
     fftwf_destroy_plan(u->forward_plan);
@@ -1857,6 +2212,7 @@ void equalizer_handle_seed_filter(DBusConnection *conn, DBusMessage *msg, void *
     }
     pa_aupdate_write_end(u->a_H[r_channel]);
     pa_xfree(ys);
+    filter_changed(u);
 
     pa_dbus_send_empty_reply(conn, msg);
 
@@ -2039,6 +2395,7 @@ void equalizer_handle_set_filter(DBusConnection *conn, DBusMessage *msg, void *_
         return;
     }
     set_filter(u, channel, H, preamp);
+    filter_changed(u);
 
     pa_dbus_send_empty_reply(conn, msg);
 
@@ -2119,6 +2476,7 @@ void equalizer_handle_load_profile(DBusConnection *conn, DBusMessage *msg, void
             load_profile(u, c, name);
         }
     }
+    filter_changed(u);
     pa_dbus_send_empty_reply(conn, msg);
 
     pa_assert_se((message = dbus_message_new_signal(u->dbus_path, EQUALIZER_IFACE, equalizer_signals[EQUALIZER_SIGNAL_FILTER_CHANGED].name)));
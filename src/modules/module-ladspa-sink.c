@@ -34,6 +34,7 @@
 #include <pulsecore/module.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
+#include <pulsecore/planar.h>
 #include <pulsecore/log.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
@@ -89,6 +90,8 @@ struct userdata {
     LADSPA_Data control_out;
 
     pa_memblockq *memblockq;
+    pa_planar *planar;
+    pa_planar *planar_out;
 
     bool *use_default;
     pa_sample_spec ss;
@@ -435,13 +438,55 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
+/* Called from I/O thread context */
+static void process_chunk(struct userdata *u, pa_memchunk *chunk, const float *planes[]) {
+    size_t fs;
+    unsigned n, m, h, c, k, offset;
+    pa_memchunk ochunk;
+    pa_planar *out = u->planar_out;
+    void *dst;
+
+    fs = pa_frame_size(&u->sink->sample_spec);
+    n = (unsigned) (chunk->length / fs);
+
+    pa_assert(n > 0);
+
+    /* The plugin works on its own port buffers. Its output is collected
+     * in planes and interleaved into the result. */
+    pa_planar_ensure(out, n);
+
+    for (offset = 0; offset < n; offset += m) {
+        m = PA_MIN(n - offset, (unsigned) (u->block_size / fs));
+
+        for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
+            k = h * u->max_ladspaport_count;
+
+            for (c = 0; c < u->input_count; c++)
+                pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), planes[k + c] + offset, sizeof(float), m);
+            u->descriptor->run(u->handle[h], m);
+            for (c = 0; c < u->output_count; c++)
+                pa_sample_clamp(PA_SAMPLE_FLOAT32NE, out->data[k + c] + offset, sizeof(float), u->output[c], sizeof(float), m);
+
+            /* Channels without an output port are passed through */
+            for (; c < u->max_ladspaport_count; c++)
+                memcpy(out->data[k + c] + offset, planes[k + c] + offset, m * sizeof(float));
+        }
+    }
+
+    /* We are done with the input, so we can write the result back into
+     * the rendered block if nobody else uses it */
+    pa_memchunk_make_output(&ochunk, chunk);
+    dst = pa_memblock_acquire_chunk(&ochunk);
+    pa_interleave((const void **) out->data, out->channels, dst, sizeof(float), n);
+    pa_memblock_release(ochunk.memblock);
+
+    pa_memblock_unref(chunk->memblock);
+    *chunk = ochunk;
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
-    float *src, *dst;
-    size_t fs;
-    unsigned n, h, c;
-    pa_memchunk tchunk;
 
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
@@ -450,44 +495,25 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* Hmm, process any rewind request that might be queued up */
     pa_sink_process_rewind(u->sink, 0);
 
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
+    /* The queue holds the output of the plugin, which we hand on as it
+     * is. Rewinding our sink input hence doesn't feed the same data
+     * into the plugin twice. */
+    while (pa_memblockq_peek(u->memblockq, chunk) < 0) {
         pa_memchunk nchunk;
 
-        pa_sink_render(u->sink, nbytes, &nchunk);
+        const float *planes[PA_CHANNELS_MAX];
+
+        pa_sink_render_planar(u->sink, nbytes, &nchunk, u->planar, planes);
+        process_chunk(u, &nchunk, planes);
         pa_memblockq_push(u->memblockq, &nchunk);
         pa_memblock_unref(nchunk.memblock);
     }
 
-    tchunk.length = PA_MIN(nbytes, tchunk.length);
-    pa_assert(tchunk.length > 0);
-
-    fs = pa_frame_size(&i->sample_spec);
-    n = (unsigned) (PA_MIN(tchunk.length, u->block_size) / fs);
-
-    pa_assert(n > 0);
-
-    chunk->index = 0;
-    chunk->length = n*fs;
-    chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
+    chunk->length = PA_MIN(nbytes, chunk->length);
+    pa_assert(chunk->length > 0);
 
     pa_memblockq_drop(u->memblockq, chunk->length);
 
-    src = pa_memblock_acquire_chunk(&tchunk);
-    dst = pa_memblock_acquire(chunk->memblock);
-
-    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
-        for (c = 0; c < u->input_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), src+ h*u->max_ladspaport_count + c, u->channels*sizeof(float), n);
-        u->descriptor->run(u->handle[h], n);
-        for (c = 0; c < u->output_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + h*u->max_ladspaport_count + c, u->channels*sizeof(float), u->output[c], sizeof(float), n);
-    }
-
-    pa_memblock_release(tchunk.memblock);
-    pa_memblock_release(chunk->memblock);
-
-    pa_memblock_unref(tchunk.memblock);
-
     return 0;
 }
 
@@ -1143,6 +1169,10 @@ int pa__init(pa_module*m) {
     }
 
     u->block_size = pa_frame_align(pa_mempool_block_size_max(m->core->mempool), &ss);
+    u->planar = pa_planar_new((unsigned) u->channels, 0);
+    /* Rendering gives us at most a block at a time, so this doesn't
+     * need to grow in the IO thread */
+    u->planar_out = pa_planar_new((unsigned) u->channels, u->block_size / pa_frame_size(&ss));
 
     /* Create buffers */
     if (LADSPA_IS_INPLACE_BROKEN(d->Properties)) {
@@ -1375,6 +1405,12 @@ void pa__done(pa_module*m) {
     if (u->memblockq)
         pa_memblockq_free(u->memblockq);
 
+    if (u->planar)
+        pa_planar_free(u->planar);
+
+    if (u->planar_out)
+        pa_planar_free(u->planar_out);
+
     pa_xfree(u->control);
     pa_xfree(u->use_default);
     pa_xfree(u);
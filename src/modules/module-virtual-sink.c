@@ -191,51 +191,31 @@ static void sink_set_mute_cb(pa_sink *s) {
 }
 
 /* Called from I/O thread context */
-static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
-    struct userdata *u;
+static void reset_filter(struct userdata *u) {
+    /* (5) PUT YOUR CODE HERE TO RESET YOUR FILTER. THE EXAMPLE FILTER
+     * BELOW KEEPS NO STATE, SO THERE IS NOTHING TO DO. */
+}
+
+/* Called from I/O thread context */
+static void process_chunk(struct userdata *u, pa_memchunk *chunk) {
     float *src, *dst;
     size_t fs;
     unsigned n, c;
-    pa_memchunk tchunk;
-    pa_usec_t current_latency PA_GCC_UNUSED;
+    pa_memchunk ochunk;
 
-    pa_sink_input_assert_ref(i);
-    pa_assert(chunk);
-    pa_assert_se(u = i->userdata);
-
-    /* Hmm, process any rewind request that might be queued up */
-    pa_sink_process_rewind(u->sink, 0);
-
-    /* (1) IF YOU NEED A FIXED BLOCK SIZE USE
-     * pa_memblockq_peek_fixed_size() HERE INSTEAD. NOTE THAT FILTERS
-     * WHICH CAN DEAL WITH DYNAMIC BLOCK SIZES ARE HIGHLY
-     * PREFERRED. */
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
-        pa_memchunk nchunk;
-
-        pa_sink_render(u->sink, nbytes, &nchunk);
-        pa_memblockq_push(u->memblockq, &nchunk);
-        pa_memblock_unref(nchunk.memblock);
-    }
-
-    /* (2) IF YOU NEED A FIXED BLOCK SIZE, THIS NEXT LINE IS NOT
-     * NECESSARY */
-    tchunk.length = PA_MIN(nbytes, tchunk.length);
-    pa_assert(tchunk.length > 0);
-
-    fs = pa_frame_size(&i->sample_spec);
-    n = (unsigned) (tchunk.length / fs);
+    fs = pa_frame_size(&u->sink->sample_spec);
+    n = (unsigned) (chunk->length / fs);
 
     pa_assert(n > 0);
 
-    chunk->index = 0;
-    chunk->length = n*fs;
-    chunk->memblock = pa_memblock_new(i->sink->core->mempool, chunk->length);
-
-    pa_memblockq_drop(u->memblockq, chunk->length);
+    /* This processes the data in place if the rendered memblock isn't
+     * used by anyone else, saving the allocation and a pass over the
+     * data. Filters that can't work in place need to allocate their
+     * output block themselves. */
+    pa_memchunk_make_output(&ochunk, chunk);
 
-    src = pa_memblock_acquire_chunk(&tchunk);
-    dst = pa_memblock_acquire(chunk->memblock);
+    src = pa_memblock_acquire_chunk(chunk);
+    dst = pa_memblock_acquire_chunk(&ochunk);
 
     /* (3) PUT YOUR CODE HERE TO DO SOMETHING WITH THE DATA */
 
@@ -247,10 +227,47 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
                         n);
     }
 
-    pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
+    pa_memblock_release(ochunk.memblock);
 
-    pa_memblock_unref(tchunk.memblock);
+    pa_memblock_unref(chunk->memblock);
+    *chunk = ochunk;
+}
+
+/* Called from I/O thread context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct userdata *u;
+    pa_usec_t current_latency PA_GCC_UNUSED;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert(chunk);
+    pa_assert_se(u = i->userdata);
+
+    /* Hmm, process any rewind request that might be queued up */
+    pa_sink_process_rewind(u->sink, 0);
+
+    /* The queue holds processed data, so that rewinding our sink input
+     * replays it and doesn't run the filter over the same data twice.
+     * If our sink rewrites data, the filter is reset before it sees the
+     * new data, see sink_input_process_rewind_cb().
+     *
+     * (1) IF YOU NEED A FIXED BLOCK SIZE USE pa_sink_render_full()
+     * HERE INSTEAD. NOTE THAT FILTERS WHICH CAN DEAL WITH DYNAMIC
+     * BLOCK SIZES ARE HIGHLY PREFERRED. */
+    while (pa_memblockq_peek(u->memblockq, chunk) < 0) {
+        pa_memchunk nchunk;
+
+        pa_sink_render(u->sink, nbytes, &nchunk);
+        process_chunk(u, &nchunk);
+        pa_memblockq_push(u->memblockq, &nchunk);
+        pa_memblock_unref(nchunk.memblock);
+    }
+
+    /* (2) The processed data is handed on as it is, without copying */
+    chunk->length = PA_MIN(nbytes, chunk->length);
+    pa_assert(chunk->length > 0);
+
+    pa_memblockq_drop(u->memblockq, chunk->length);
 
     /* (4) IF YOU NEED THE LATENCY FOR SOMETHING ACQUIRE IT LIKE THIS: */
     current_latency =
@@ -281,7 +298,11 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         if (amount > 0) {
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
 
-            /* (5) PUT YOUR CODE HERE TO RESET YOUR FILTER  */
+            /* The processed data in the queue is overwritten with the
+             * rewritten data, filtered again. The filter's state is
+             * that after the newest data, not the data before the
+             * rewritten part, so start over. */
+            reset_filter(u);
         }
     }
 
@@ -38,6 +38,7 @@
 #include <pulsecore/ltdl-helper.h>
 #include <pulsecore/sound-file.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/filter/convolver.h>
 
 #include <math.h>
 
@@ -62,6 +63,9 @@ PA_MODULE_USAGE(
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+/* Partition size of the convolution, for long hrirs */
+#define MAX_BLOCK_SIZE 256
+
 struct userdata {
     pa_module *module;
 
@@ -85,8 +89,7 @@ struct userdata {
     unsigned hrir_samples;
     float *hrir_data;
 
-    float *input_buffer;
-    int input_buffer_offset;
+    pa_convolver *convolver;
 };
 
 static const char* const valid_modargs[] = {
@@ -215,13 +218,9 @@ static void sink_set_mute_cb(pa_sink *s) {
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
     float *src, *dst;
-    unsigned n;
+    unsigned n, l;
     pa_memchunk tchunk;
 
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
-
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
     pa_assert_se(u = i->userdata);
@@ -253,29 +252,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (l = 0; l < n; l++) {
-        memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
-
-        sum_right = 0;
-        sum_left = 0;
-
-        /* fold the input buffer with the impulse response */
-        for (j = 0; j < u->hrir_samples; j++) {
-            for (k = 0; k < u->channels; k++) {
-                current_sample = u->input_buffer[((u->input_buffer_offset + j) % u->hrir_samples) * u->channels + k];
+    /* fold the input with the impulse response */
+    pa_convolver_process(u->convolver, src, dst, n);
 
-                sum_left += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_left[k]];
-                sum_right += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_right[k]];
-            }
-        }
-
-        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
-        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
-
-        u->input_buffer_offset--;
-        if (u->input_buffer_offset < 0)
-            u->input_buffer_offset += u->hrir_samples;
-    }
+    for (l = 0; l < 2 * n; l++)
+        dst[l] = PA_CLAMP_UNLIKELY(dst[l], -1.0f, 1.0f);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -300,17 +281,15 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         amount = PA_MIN(u->sink->thread_info.rewind_nbytes * u->sink_fs / u->fs, max_rewrite);
         u->sink->thread_info.rewind_nbytes = 0;
 
-        if (amount > 0) {
+        if (amount > 0)
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-
-            /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
-        }
     }
 
     pa_sink_process_rewind(u->sink, amount);
     pa_memblockq_rewind(u->memblockq, nbytes * u->sink_fs / u->fs);
+
+    /* The rewound input will be popped again */
+    pa_convolver_rewind(u->convolver, nbytes / u->fs);
 }
 
 /* Called from I/O thread context */
@@ -324,6 +303,7 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes * u->sink_fs / u->fs);
+    pa_convolver_set_max_rewind(u->convolver, nbytes / u->fs);
 }
 
 /* Called from I/O thread context */
@@ -569,7 +549,7 @@ int pa__init(pa_module*m) {
     pa_memchunk silence;
 
     const char *hrir_file;
-    unsigned i, j, found_channel_left, found_channel_right;
+    unsigned i, j, found_channel_left, found_channel_right, block_size;
     float *hrir_data;
 
     pa_sample_spec hrir_ss;
@@ -747,10 +727,6 @@ int pa__init(pa_module*m) {
                                  PA_RESAMPLER_SRC_SINC_BEST_QUALITY, PA_RESAMPLER_NO_REMAP);
 
     u->hrir_samples = hrir_temp_chunk.length / pa_frame_size(&hrir_temp_ss) * hrir_ss.rate / hrir_temp_ss.rate;
-    if (u->hrir_samples > 64) {
-        u->hrir_samples = 64;
-        pa_log("The (resampled) hrir contains more than 64 samples. Only the first 64 samples will be used to limit processor usage.");
-    }
 
     hrir_total_length = u->hrir_samples * pa_frame_size(&hrir_ss);
     u->hrir_channels = hrir_ss.channels;
@@ -771,10 +747,10 @@ int pa__init(pa_module*m) {
             hrir_data = (float *) pa_memblock_acquire(hrir_temp_chunk_resampled.memblock);
 
             if (hrir_total_length - hrir_copied_length >= hrir_temp_chunk_resampled.length) {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
+                memcpy((uint8_t *) u->hrir_data + hrir_copied_length, hrir_data, hrir_temp_chunk_resampled.length);
                 hrir_copied_length += hrir_temp_chunk_resampled.length;
             } else {
-                memcpy(u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
+                memcpy((uint8_t *) u->hrir_data + hrir_copied_length, hrir_data, hrir_total_length - hrir_copied_length);
                 hrir_copied_length = hrir_total_length;
             }
 
@@ -825,8 +801,15 @@ int pa__init(pa_module*m) {
         }
     }
 
-    u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
-    u->input_buffer_offset = 0;
+    block_size = 16;
+    while (block_size < u->hrir_samples && block_size < MAX_BLOCK_SIZE)
+        block_size *= 2;
+
+    u->convolver = pa_convolver_new(block_size, u->channels, 2, u->hrir_samples);
+    for (i = 0; i < u->channels; i++) {
+        pa_convolver_set_ir(u->convolver, i, 0, u->hrir_data + u->mapping_left[i], u->hrir_channels);
+        pa_convolver_set_ir(u->convolver, i, 1, u->hrir_data + u->mapping_right[i], u->hrir_channels);
+    }
 
     pa_sink_put(u->sink);
     pa_sink_input_put(u->sink_input);
@@ -887,8 +870,8 @@ void pa__done(pa_module*m) {
     if (u->hrir_data)
         pa_xfree(u->hrir_data);
 
-    if (u->input_buffer)
-        pa_xfree(u->input_buffer);
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
 
     if (u->mapping_left)
         pa_xfree(u->mapping_left);
@@ -30,6 +30,10 @@
 #include <unistd.h>
 #include <math.h>
 
+#ifdef HAVE_OPUS
+#include <opus.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -40,6 +44,7 @@
 #include <pulsecore/sink.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/memblockq.h>
+#include <pulsecore/mix.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
@@ -67,20 +72,36 @@ PA_MODULE_USAGE(
         "sink=<name of the sink> "
         "sap_address=<multicast address to listen on> "
         "latency_msec=<latency in ms> "
+        "adaptive_latency=<adapt the latency to the network jitter?> "
+        "min_latency_msec=<minimum latency in ms when adapting> "
 );
 
 #define SAP_PORT 9875
 #define DEFAULT_SAP_ADDRESS "224.0.0.56"
 #define DEFAULT_LATENCY_MSEC 500
+#define DEFAULT_MIN_LATENCY_MSEC 20U
 #define MEMBLOCKQ_MAXLENGTH (1024*1024*40)
 #define MAX_SESSIONS 16
 #define DEATH_TIMEOUT 20
 #define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
+/* How many times the interarrival jitter we keep buffered when adapting */
+#define JITTER_MULTIPLIER 4
+/* Gaps up to this long are filled with attenuated copies of the last packet */
+#define MAX_CONCEAL_USEC (20*PA_USEC_PER_MSEC)
+/* The Opus decoder conceals longer gaps well, and can recover the last
+ * packet before a gap from FEC data */
+#define MAX_OPUS_CONCEAL_USEC (120*PA_USEC_PER_MSEC)
+/* Opus packets vary in size, leave room for whatever fits an Ethernet frame */
+#define MAX_OPUS_PACKET_SIZE 1500
+/* Smallest change of the latency we bother to make when adapting */
+#define LATENCY_HYSTERESIS_USEC (10*PA_USEC_PER_MSEC)
 
 static const char* const valid_modargs[] = {
     "sink",
     "sap_address",
     "latency_msec",
+    "adaptive_latency",
+    "min_latency_msec",
     NULL
 };
 
@@ -99,6 +120,10 @@ struct session {
 
     pa_rtp_context rtp_context;
 
+#ifdef HAVE_OPUS
+    OpusDecoder *opus_decoder;
+#endif
+
     pa_rtpoll_item *rtpoll_item;
 
     pa_atomic_t timestamp;
@@ -110,6 +135,21 @@ struct session {
     pa_usec_t last_latency;
     double estimated_rate;
     double avg_estimated_rate;
+
+    /* RFC 3550 interarrival jitter estimate in usec */
+    bool have_transit;
+    pa_usec_t last_arrival;
+    uint32_t last_arrival_timestamp;
+    double jitter;
+
+    pa_usec_t packet_usec;
+    pa_memchunk last_chunk;
+
+    /* Jitter buffer statistics, read from the main thread */
+    pa_atomic_t jitter_usec;
+    pa_atomic_t late;
+    pa_atomic_t concealed;
+    pa_atomic_t target_latency_usec;
 };
 
 struct userdata {
@@ -128,6 +168,8 @@ struct userdata {
     int n_sessions;
 
     pa_usec_t latency;
+    pa_usec_t min_latency;
+    bool adaptive_latency;
 };
 
 static void session_free(struct session *s);
@@ -199,39 +241,199 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, bool b) {
 
     if (b)
         pa_memblockq_flush_read(s->memblockq);
-    else
+    else {
         s->first_packet = false;
+        s->have_transit = false;
+    }
 }
 
 /* Called from I/O thread context */
-static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
-    int64_t k, j, delta;
-    struct timeval now = { 0, 0 };
-    struct session *s;
-    struct pollfd *p;
+static void update_jitter(struct session *s, pa_usec_t arrival) {
+    int64_t d;
 
-    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+    /* RFC 3550 A.8: the difference of the relative transit times of two
+     * successive packets, smoothed with a gain of 1/16 */
+    if (s->have_transit) {
+        d = (int64_t) (arrival - s->last_arrival) -
+            (int64_t) (int32_t) (s->rtp_context.timestamp - s->last_arrival_timestamp) * (int64_t) PA_USEC_PER_SEC / (int64_t) s->sdp_info.sample_spec.rate;
 
-    p = pa_rtpoll_item_get_pollfd(i, NULL);
+        s->jitter += ((double) (d < 0 ? -d : d) - s->jitter) / 16.0;
+        pa_atomic_store(&s->jitter_usec, (int) s->jitter);
+    }
 
-    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
-        pa_log("poll() signalled bad revents.");
+    s->have_transit = true;
+    s->last_arrival = arrival;
+    s->last_arrival_timestamp = s->rtp_context.timestamp;
+}
+
+/* Called from I/O thread context */
+static pa_usec_t jitter_target_latency(struct session *s) {
+    pa_usec_t target;
+
+    target = s->sink_latency + s->packet_usec + (pa_usec_t) (JITTER_MULTIPLIER * s->jitter);
+    target = PA_CLAMP(target, s->userdata->min_latency, s->userdata->latency);
+
+    return PA_MAX(target, s->sink_latency*2);
+}
+
+/* Called from I/O thread context */
+static void set_intended_latency(struct session *s, pa_usec_t latency) {
+    s->intended_latency = latency;
+    pa_memblockq_set_prebuf(s->memblockq, pa_usec_to_bytes(s->intended_latency - s->sink_latency, &s->sink_input->sample_spec));
+    pa_atomic_store(&s->target_latency_usec, (int) s->intended_latency);
+}
+
+/* Called from I/O thread context. Growing the latency has to happen at once
+ * to avoid further underruns, so the write index is moved forward which
+ * leaves a short hole. Shrinking it is left to the rate adjustment in
+ * handle_packet(), which is inaudible. */
+static void grow_latency(struct session *s, bool late) {
+    pa_usec_t target, step;
+
+    step = PA_MAX(s->packet_usec, LATENCY_HYSTERESIS_USEC);
+    target = jitter_target_latency(s);
+
+    if (late) {
+        target = PA_MAX(target, s->intended_latency + step);
+        target = PA_MIN(target, s->userdata->latency);
+    }
+
+    if (target < s->intended_latency + step)
+        return;
+
+    pa_log_debug("Jitter is %0.2f ms, increasing latency from %0.2f ms to %0.2f ms",
+                 s->jitter/PA_USEC_PER_MSEC, (double) s->intended_latency/PA_USEC_PER_MSEC, (double) target/PA_USEC_PER_MSEC);
+
+    pa_memblockq_seek(s->memblockq, (int64_t) pa_usec_to_bytes(target - s->intended_latency, &s->sink_input->sample_spec), PA_SEEK_RELATIVE, true);
+    set_intended_latency(s, target);
+}
+
+/* Called from I/O thread context */
+static void conceal_gap(struct session *s, size_t length) {
+    pa_volume_t volume = PA_VOLUME_NORM;
+    pa_cvolume v;
+
+    /* Repeat the last packet, 6 dB quieter each time */
+    while (length > 0) {
+        pa_memchunk c = s->last_chunk;
+
+        c.length = PA_MIN(c.length, length);
+        pa_memblock_ref(c.memblock);
+        pa_memchunk_make_writable(&c, 0);
+
+        volume = pa_sw_volume_multiply(volume, pa_sw_volume_from_linear(0.5));
+        pa_volume_memchunk(&c, &s->sdp_info.sample_spec, pa_cvolume_set(&v, s->sdp_info.sample_spec.channels, volume));
+
+        if (pa_memblockq_push(s->memblockq, &c) < 0)
+            pa_memblockq_seek(s->memblockq, (int64_t) c.length, PA_SEEK_RELATIVE, true);
+
+        pa_memblock_unref(c.memblock);
+        length -= c.length;
+    }
+
+    pa_atomic_inc(&s->concealed);
+}
+
+#ifdef HAVE_OPUS
+/* Called from I/O thread context. Decodes frames frames into out. With data
+ * NULL the decoder conceals a loss, with fec set it recovers the frames
+ * before data from the redundancy in it where the sender included some. */
+static int decode_opus(struct session *s, const pa_memchunk *data, int64_t frames, bool fec, pa_memchunk *out) {
+    void *d;
+    int r;
+
+    out->memblock = pa_memblock_new(s->userdata->module->core->mempool, (size_t) frames * pa_frame_size(&s->sdp_info.sample_spec));
+    out->index = 0;
+
+    d = pa_memblock_acquire(out->memblock);
+    r = opus_decode(s->opus_decoder,
+                    data ? pa_memblock_acquire_chunk(data) : NULL, data ? (opus_int32) data->length : 0,
+                    d, (int) frames, fec ? 1 : 0);
+    pa_memblock_release(out->memblock);
+
+    if (data)
+        pa_memblock_release(data->memblock);
+
+    if (r <= 0) {
+        pa_log_debug("Failed to decode Opus packet: %s", opus_strerror(r));
+        pa_memblock_unref(out->memblock);
+        pa_memchunk_reset(out);
         return -1;
     }
 
-    if ((p->revents & POLLIN) == 0)
-        return 0;
+    out->length = (size_t) r * pa_frame_size(&s->sdp_info.sample_spec);
 
-    p->revents = 0;
+    return 0;
+}
 
-    if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
-        return 0;
+/* Called from I/O thread context */
+static void recover_opus(struct session *s, const pa_memchunk *chunk, int64_t frames) {
+    pa_memchunk pcm;
+    size_t length = (size_t) frames * pa_frame_size(&s->sdp_info.sample_spec);
+
+    if (decode_opus(s, chunk, frames, true, &pcm) < 0) {
+        pa_memblockq_seek(s->memblockq, (int64_t) length, PA_SEEK_RELATIVE, true);
+        return;
+    }
+
+    if (pa_memblockq_push(s->memblockq, &pcm) < 0)
+        pa_memblockq_seek(s->memblockq, (int64_t) pcm.length, PA_SEEK_RELATIVE, true);
+
+    if (pcm.length < length)
+        pa_memblockq_seek(s->memblockq, (int64_t) (length - pcm.length), PA_SEEK_RELATIVE, true);
+
+    pa_memblock_unref(pcm.memblock);
+    pa_atomic_inc(&s->concealed);
+}
+#endif
+
+/* Called from I/O thread context. Returns the number of frames in the
+ * packet, or a negative value if it is unusable. */
+static int64_t packet_frames(struct session *s, const pa_memchunk *chunk) {
+#ifdef HAVE_OPUS
+    if (s->opus_decoder) {
+        int r;
+
+        r = opus_packet_get_nb_samples(pa_memblock_acquire_chunk(chunk), (opus_int32) chunk->length, (opus_int32) s->sdp_info.sample_spec.rate);
+        pa_memblock_release(chunk->memblock);
+
+        return r;
+    }
+#endif
+
+    return (int64_t) (chunk->length / pa_frame_size(&s->sdp_info.sample_spec));
+}
+
+/* Called from I/O thread context. Returns true if the packet came too late to
+ * be played completely. */
+static bool push_packet(struct session *s, pa_memchunk *chunk) {
+    bool late;
+
+    late = pa_memblockq_get_write_index(s->memblockq) < pa_memblockq_get_read_index(s->memblockq);
+
+    if (late)
+        pa_atomic_inc(&s->late);
+
+    if (pa_memblockq_push(s->memblockq, chunk) < 0) {
+        pa_log_warn("Queue overrun");
+        pa_memblockq_seek(s->memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
+    }
+
+    return late;
+}
+
+/* Called from I/O thread context */
+static bool handle_packet(struct session *s, pa_memchunk *chunk, struct timeval *now) {
+    int64_t delta, frames;
+    size_t frame_size = pa_frame_size(&s->sdp_info.sample_spec);
+    pa_usec_t max_conceal = MAX_CONCEAL_USEC;
+    bool late;
 
     if (s->sdp_info.payload != s->rtp_context.payload ||
         !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state)) {
-        pa_memblock_unref(chunk.memblock);
-        return 0;
+        pa_memblock_unref(chunk->memblock);
+        pa_atomic_inc(&s->rtp_context.stats.dropped);
+        return false;
     }
 
     if (!s->first_packet) {
@@ -244,45 +446,119 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
             pa_log_warn("Detected RTP packet loop!");
     } else {
         if (s->ssrc != s->rtp_context.ssrc) {
-            pa_memblock_unref(chunk.memblock);
-            return 0;
+            pa_memblock_unref(chunk->memblock);
+            pa_atomic_inc(&s->rtp_context.stats.dropped);
+            return false;
         }
     }
 
-    /* Check whether there was a timestamp overflow */
-    k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
-    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) s->rtp_context.timestamp;
-
-    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
-        delta = k;
-    else
-        delta = j;
+    delta = pa_rtp_timestamp_delta(s->offset, s->rtp_context.timestamp);
 
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, true);
-
-    if (now.tv_sec == 0) {
+    if (now->tv_sec == 0) {
         PA_ONCE_BEGIN {
             pa_log_warn("Using artificial time instead of timestamp");
         } PA_ONCE_END;
-        pa_rtclock_get(&now);
+        pa_rtclock_get(now);
     } else
-        pa_rtclock_from_wallclock(&now);
+        pa_rtclock_from_wallclock(now);
 
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, true);
+    if ((frames = packet_frames(s, chunk)) <= 0) {
+        pa_memblock_unref(chunk->memblock);
+        pa_atomic_inc(&s->rtp_context.stats.dropped);
+        return false;
+    }
+
+    /* Without resynchronizing, all packets after the restart would be
+     * put in the past */
+    if (pa_rtp_timestamp_restarted(delta, frames)) {
+        pa_log_debug("RTP timestamp went back by %lli frames, resynchronizing", (long long) -delta);
+
+        s->offset = s->rtp_context.timestamp;
+        s->have_transit = false;
+        delta = 0;
+    }
+
+    update_jitter(s, pa_timeval_load(now));
+
+#ifdef HAVE_OPUS
+    if (s->opus_decoder) {
+        /* The decoder has moved on, and concealed the gap already */
+        if (delta + frames <= 0) {
+            pa_memblock_unref(chunk->memblock);
+            pa_atomic_inc(&s->late);
+            return false;
+        }
+
+        max_conceal = MAX_OPUS_CONCEAL_USEC;
+    }
+#endif
+
+    if (delta + frames <= 0) {
+        /* This packet was overtaken by later ones. Put it in its place and
+         * return to where the newest packet ended. */
+        pa_memblockq_seek(s->memblockq, delta * (int64_t) frame_size, PA_SEEK_RELATIVE, true);
+        late = push_packet(s, chunk);
+        pa_memblockq_seek(s->memblockq, -delta * (int64_t) frame_size - (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
+    } else {
+        /* Fill short gaps rather than leaving silence. Should the missing
+         * packets turn up after all they simply overwrite this. */
+        if (delta > 0 && pa_bytes_to_usec((uint64_t) delta * frame_size, &s->sdp_info.sample_spec) <= max_conceal) {
+#ifdef HAVE_OPUS
+            if (s->opus_decoder) {
+                recover_opus(s, chunk, delta);
+                delta = 0;
+            }
+#endif
+
+            if (delta > 0 && s->last_chunk.memblock) {
+                conceal_gap(s, (size_t) delta * frame_size);
+                delta = 0;
+            }
+        }
+
+#ifdef HAVE_OPUS
+        if (s->opus_decoder) {
+            pa_memchunk pcm;
+
+            if (decode_opus(s, chunk, frames, false, &pcm) < 0) {
+                /* Expect what follows where this one started */
+                pa_memblockq_seek(s->memblockq, delta * (int64_t) frame_size, PA_SEEK_RELATIVE, true);
+                s->offset = s->rtp_context.timestamp;
+
+                pa_memblock_unref(chunk->memblock);
+                pa_atomic_inc(&s->rtp_context.stats.dropped);
+                return false;
+            }
+
+            pa_memblock_unref(chunk->memblock);
+            *chunk = pcm;
+        }
+#endif
+
+        pa_memblockq_seek(s->memblockq, delta * (int64_t) frame_size, PA_SEEK_RELATIVE, true);
+        late = push_packet(s, chunk);
+
+        if (s->last_chunk.memblock)
+            pa_memblock_unref(s->last_chunk.memblock);
+        s->last_chunk = *chunk;
+        pa_memblock_ref(s->last_chunk.memblock);
+
+        s->packet_usec = pa_bytes_to_usec(chunk->length, &s->sdp_info.sample_spec);
+
+        /* The next timestamp we expect */
+        s->offset = s->rtp_context.timestamp + (uint32_t) (chunk->length / frame_size);
     }
 
 /*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
 
-    pa_memblock_unref(chunk.memblock);
+    pa_memblock_unref(chunk->memblock);
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+    if (s->userdata->adaptive_latency)
+        grow_latency(s, late);
 
-    pa_atomic_store(&s->timestamp, (int) now.tv_sec);
+    pa_atomic_store(&s->timestamp, (int) now->tv_sec);
 
-    if (s->last_rate_update + RATE_UPDATE_INTERVAL < pa_timeval_load(&now)) {
+    if (s->last_rate_update + RATE_UPDATE_INTERVAL < pa_timeval_load(now)) {
         pa_usec_t wi, ri, render_delay, sink_delay = 0, latency;
         uint32_t base_rate = s->sink_input->sink->sample_spec.rate;
         uint32_t current_rate = s->sink_input->sample_spec.rate;
@@ -291,6 +567,15 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
         pa_log_debug("Updating sample rate");
 
+        if (s->userdata->adaptive_latency) {
+            pa_usec_t target = jitter_target_latency(s);
+
+            if (target + PA_MAX(s->packet_usec, LATENCY_HYSTERESIS_USEC) <= s->intended_latency) {
+                pa_log_debug("Jitter is %0.2f ms, decreasing latency to %0.2f ms", s->jitter/PA_USEC_PER_MSEC, (double) target/PA_USEC_PER_MSEC);
+                set_intended_latency(s, target);
+            }
+        }
+
         wi = pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec);
         ri = pa_bytes_to_usec((uint64_t) pa_memblockq_get_read_index(s->memblockq), &s->sink_input->sample_spec);
 
@@ -371,7 +656,7 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
         pa_log_debug("Updated sampling rate to %lu Hz.", (unsigned long) s->sink_input->sample_spec.rate);
 
-        s->last_rate_update = pa_timeval_load(&now);
+        s->last_rate_update = pa_timeval_load(now);
     }
 
     if (pa_memblockq_is_readable(s->memblockq) &&
@@ -382,7 +667,43 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
                                      false, true, false);
     }
 
-    return 1;
+    return true;
+}
+
+/* Called from I/O thread context */
+static int rtpoll_work_cb(pa_rtpoll_item *i) {
+    struct session *s;
+    struct pollfd *p;
+    int ret = 0;
+
+    pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
+
+    p = pa_rtpoll_item_get_pollfd(i, NULL);
+
+    if (p->revents & (POLLERR|POLLNVAL|POLLHUP|POLLOUT)) {
+        pa_log("poll() signalled bad revents.");
+        return -1;
+    }
+
+    if ((p->revents & POLLIN) == 0)
+        return 0;
+
+    p->revents = 0;
+
+    /* All packets waiting on the socket are read at once, and then
+     * handed out one by one */
+    do {
+        pa_memchunk chunk;
+        struct timeval now = { 0, 0 };
+
+        if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
+            continue;
+
+        if (handle_packet(s, &chunk, &now))
+            ret = 1;
+    } while (pa_rtp_recv_pending(&s->rtp_context) > 0);
+
+    return ret;
 }
 
 /* Called from I/O thread context */
@@ -518,13 +839,27 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     s->first_packet = false;
     s->sdp_info = *sdp_info;
     s->rtpoll_item = NULL;
-    s->intended_latency = u->latency;
+    s->intended_latency = u->adaptive_latency ? u->min_latency : u->latency;
     s->last_rate_update = pa_timeval_load(&now);
-    s->last_latency = u->latency;
+    s->last_latency = s->intended_latency;
     s->estimated_rate = (double) sink->sample_spec.rate;
     s->avg_estimated_rate = (double) sink->sample_spec.rate;
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
+    if (sdp_info->encoding == PA_RTP_ENCODING_OPUS) {
+#ifdef HAVE_OPUS
+        int error;
+
+        if (!(s->opus_decoder = opus_decoder_create((opus_int32) sdp_info->sample_spec.rate, sdp_info->sample_spec.channels, &error))) {
+            pa_log("Failed to create Opus decoder: %s", opus_strerror(error));
+            goto fail;
+        }
+#else
+        pa_log("Session '%s' uses Opus, which is not supported.", pa_strnull(sdp_info->session_name));
+        goto fail;
+#endif
+    }
+
     if ((fd = mcast_socket((const struct sockaddr*) &sdp_info->sa, sdp_info->salen)) < 0)
         goto fail;
 
@@ -542,6 +877,7 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
         pa_proplist_sets(data.proplist, "rtp.session", sdp_info->session_name);
     pa_proplist_sets(data.proplist, "rtp.origin", sdp_info->origin);
     pa_proplist_setf(data.proplist, "rtp.payload", "%u", (unsigned) sdp_info->payload);
+    pa_proplist_sets(data.proplist, "rtp.encoding", sdp_info->encoding == PA_RTP_ENCODING_OPUS ? "opus" : "pcm");
     data.module = u->module;
     pa_sink_input_new_data_set_sample_spec(&data, &sdp_info->sample_spec);
     data.flags = PA_SINK_INPUT_VARIABLE_RATE;
@@ -585,7 +921,14 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
 
     pa_memblock_unref(silence.memblock);
 
-    pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
+    pa_atomic_store(&s->target_latency_usec, (int) s->intended_latency);
+
+    /* Opus packets may have any length */
+    if (s->sdp_info.encoding == PA_RTP_ENCODING_OPUS) {
+        pa_rtp_context_init_recv(&s->rtp_context, fd, 1);
+        pa_rtp_context_set_max_packet_size(&s->rtp_context, MAX_OPUS_PACKET_SIZE);
+    } else
+        pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
 
     pa_hashmap_put(s->userdata->by_origin, s->sdp_info.origin, s);
     u->n_sessions++;
@@ -598,6 +941,11 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     return s;
 
 fail:
+#ifdef HAVE_OPUS
+    if (s && s->opus_decoder)
+        opus_decoder_destroy(s->opus_decoder);
+#endif
+
     pa_xfree(s);
 
     if (fd >= 0)
@@ -618,10 +966,18 @@ static void session_free(struct session *s) {
     pa_assert(s->userdata->n_sessions >= 1);
     s->userdata->n_sessions--;
 
+    if (s->last_chunk.memblock)
+        pa_memblock_unref(s->last_chunk.memblock);
+
     pa_memblockq_free(s->memblockq);
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
 
+#ifdef HAVE_OPUS
+    if (s->opus_decoder)
+        opus_decoder_destroy(s->opus_decoder);
+#endif
+
     pa_xfree(s);
 }
 
@@ -662,6 +1018,19 @@ static void sap_event_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event
     }
 }
 
+static void session_update_stats(struct session *s) {
+    pa_proplist *p;
+
+    p = pa_proplist_new();
+    pa_rtp_stats_update_proplist(&s->rtp_context, p);
+    pa_proplist_setf(p, "rtp.jitter_usec", "%u", (unsigned) pa_atomic_load(&s->jitter_usec));
+    pa_proplist_setf(p, "rtp.target_latency_usec", "%u", (unsigned) pa_atomic_load(&s->target_latency_usec));
+    pa_proplist_setf(p, "rtp.late", "%u", (unsigned) pa_atomic_load(&s->late));
+    pa_proplist_setf(p, "rtp.concealed", "%u", (unsigned) pa_atomic_load(&s->concealed));
+    pa_sink_input_update_proplist(s->sink_input, PA_UPDATE_REPLACE, p);
+    pa_proplist_free(p);
+}
+
 static void check_death_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct timeval *tv, void *userdata) {
     struct session *s, *n;
     struct userdata *u = userdata;
@@ -683,6 +1052,8 @@ static void check_death_event_cb(pa_mainloop_api *m, pa_time_event *t, const str
 
         if (k + DEATH_TIMEOUT < now.tv_sec)
             pa_hashmap_remove_and_free(u->by_origin, s->sdp_info.origin);
+        else
+            session_update_stats(s);
     }
 
     /* Restart timer */
@@ -699,7 +1070,8 @@ int pa__init(pa_module*m) {
     struct sockaddr *sa;
     socklen_t salen;
     const char *sap_address;
-    uint32_t latency_msec;
+    uint32_t latency_msec, min_latency_msec;
+    bool adaptive_latency = false;
     int fd = -1;
 
     pa_assert(m);
@@ -734,6 +1106,17 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "adaptive_latency", &adaptive_latency) < 0) {
+        pa_log("Failed to parse adaptive_latency argument");
+        goto fail;
+    }
+
+    min_latency_msec = PA_MIN(DEFAULT_MIN_LATENCY_MSEC, latency_msec);
+    if (pa_modargs_get_value_u32(ma, "min_latency_msec", &min_latency_msec) < 0 || min_latency_msec < 1 || min_latency_msec > latency_msec) {
+        pa_log("Invalid minimum latency specification");
+        goto fail;
+    }
+
     if ((fd = mcast_socket(sa, salen)) < 0)
         goto fail;
 
@@ -742,6 +1125,8 @@ int pa__init(pa_module*m) {
     u->core = m->core;
     u->sink_name = pa_xstrdup(pa_modargs_get_value(ma, "sink", NULL));
     u->latency = (pa_usec_t) latency_msec * PA_USEC_PER_MSEC;
+    u->min_latency = (pa_usec_t) min_latency_msec * PA_USEC_PER_MSEC;
+    u->adaptive_latency = adaptive_latency;
 
     u->sap_event = m->core->mainloop->io_new(m->core->mainloop, fd, PA_IO_EVENT_INPUT, sap_event_cb, u);
     pa_sap_context_init_recv(&u->sap_context, fd);
@@ -22,11 +22,16 @@
 #endif
 
 #include <stdio.h>
+#include <math.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <errno.h>
 #include <unistd.h>
 
+#ifdef HAVE_OPUS
+#include <opus.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/util.h>
@@ -45,6 +50,8 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/socket-util.h>
 #include <pulsecore/arpa-inet.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/mutex.h>
 
 #include "module-rtp-send-symdef.h"
 
@@ -67,7 +74,12 @@ PA_MODULE_USAGE(
         "mtu=<maximum transfer unit> "
         "loop=<loopback to local host?> "
         "ttl=<ttl value> "
-        "inhibit_auto_suspend=<always|never|only_with_non_monitor_sources>"
+        "inhibit_auto_suspend=<always|never|only_with_non_monitor_sources> "
+        "encoding=<pcm|opus> "
+        "opus_frame_msec=<2.5, 5, 10, 20, 40 or 60> "
+        "opus_bitrate=<bits per second> "
+        "opus_fec=<send in-band forward error correction data?> "
+        "opus_packet_loss=<expected packet loss in percent>"
 );
 
 #define DEFAULT_PORT 46000
@@ -78,6 +90,12 @@ PA_MODULE_USAGE(
 #define MEMBLOCKQ_MAXLENGTH (1024*170)
 #define DEFAULT_MTU 1280
 #define SAP_INTERVAL (5*PA_USEC_PER_SEC)
+#define DEFAULT_OPUS_FRAME_MSEC 10
+#define DEFAULT_OPUS_PACKET_LOSS 10
+/* The largest Opus packet with a single frame */
+#define MAX_OPUS_PACKET 1275
+/* Frames the encoder thread takes from the queue at once */
+#define OPUS_BATCH 16
 
 static const char* const valid_modargs[] = {
     "source",
@@ -92,6 +110,11 @@ static const char* const valid_modargs[] = {
     "loop",
     "ttl",
     "inhibit_auto_suspend",
+    "encoding",
+    "opus_frame_msec",
+    "opus_bitrate",
+    "opus_fec",
+    "opus_packet_loss",
     NULL
 };
 
@@ -114,8 +137,40 @@ struct userdata {
     pa_time_event *sap_event;
 
     enum inhibit_auto_suspend inhibit_auto_suspend;
+
+#ifdef HAVE_OPUS
+    /* With Opus the source output only queues the audio, it is encoded
+     * and sent by the encoder thread. The mutex protects memblockq and
+     * encoder_quit. */
+    OpusEncoder *opus_encoder;
+    uint32_t opus_frame_samples;
+    size_t opus_frame_bytes;
+    size_t opus_max_packet;
+
+    pa_thread *encoder_thread;
+    pa_mutex *encoder_mutex;
+    pa_cond *encoder_cond;
+    bool encoder_quit;
+#endif
 };
 
+/* Called from I/O thread context */
+static size_t queue_length(struct userdata *u) {
+#ifdef HAVE_OPUS
+    if (u->opus_encoder) {
+        size_t l;
+
+        pa_mutex_lock(u->encoder_mutex);
+        l = pa_memblockq_get_length(u->memblockq);
+        pa_mutex_unlock(u->encoder_mutex);
+
+        return l;
+    }
+#endif
+
+    return pa_memblockq_get_length(u->memblockq);
+}
+
 /* Called from I/O thread context */
 static int source_output_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u;
@@ -123,7 +178,7 @@ static int source_output_process_msg(pa_msgobject *o, int code, void *data, int6
 
     switch (code) {
         case PA_SOURCE_OUTPUT_MESSAGE_GET_LATENCY:
-            *((pa_usec_t*) data) = pa_bytes_to_usec(pa_memblockq_get_length(u->memblockq), &u->source_output->sample_spec);
+            *((pa_usec_t*) data) = pa_bytes_to_usec(queue_length(u), &u->source_output->sample_spec);
 
             /* Fall through, the default handler will add in the extra
              * latency added by the resampler */
@@ -139,6 +194,22 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
     pa_source_output_assert_ref(o);
     pa_assert_se(u = o->userdata);
 
+#ifdef HAVE_OPUS
+    if (u->opus_encoder) {
+        int r;
+
+        pa_mutex_lock(u->encoder_mutex);
+        r = pa_memblockq_push(u->memblockq, chunk);
+        pa_cond_signal(u->encoder_cond, 0);
+        pa_mutex_unlock(u->encoder_mutex);
+
+        if (r < 0)
+            pa_log_warn("Failed to push chunk into memblockq.");
+
+        return;
+    }
+#endif
+
     if (pa_memblockq_push(u->memblockq, chunk) < 0) {
         pa_log_warn("Failed to push chunk into memblockq.");
         return;
@@ -147,6 +218,161 @@ static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk)
     pa_rtp_send(&u->rtp_context, u->mtu, u->memblockq);
 }
 
+#ifdef HAVE_OPUS
+/* Encodes n frames from pcm into packets, which share one memblock */
+static void encode_opus(struct userdata *u, pa_memchunk *pcm, pa_memchunk *packets, unsigned n) {
+    pa_memblock *block;
+    uint8_t *d;
+    unsigned i;
+
+    block = pa_memblock_new(u->module->core->mempool, n * u->opus_max_packet);
+    d = pa_memblock_acquire(block);
+
+    for (i = 0; i < n; i++) {
+        opus_int32 r;
+
+        r = opus_encode(u->opus_encoder, pa_memblock_acquire_chunk(&pcm[i]), (int) u->opus_frame_samples,
+                        d + i * u->opus_max_packet, (opus_int32) u->opus_max_packet);
+        pa_memblock_release(pcm[i].memblock);
+
+        if (r < 0) {
+            pa_log_warn("Failed to encode Opus frame: %s", opus_strerror(r));
+            r = 0;
+        }
+
+        packets[i].memblock = block;
+        packets[i].index = i * u->opus_max_packet;
+        packets[i].length = (size_t) r;
+    }
+
+    pa_memblock_release(block);
+}
+
+static void encoder_thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    pa_memchunk pcm[OPUS_BATCH], packets[OPUS_BATCH];
+
+    pa_assert(u);
+
+    pa_log_debug("Opus encoder thread starting up");
+
+    if (u->module->core->realtime_scheduling)
+        pa_make_realtime(u->module->core->realtime_priority);
+
+    pa_mutex_lock(u->encoder_mutex);
+
+    for (;;) {
+        unsigned i, n = 0;
+
+        while (!u->encoder_quit && pa_memblockq_get_length(u->memblockq) < u->opus_frame_bytes)
+            pa_cond_wait(u->encoder_cond, u->encoder_mutex);
+
+        if (u->encoder_quit)
+            break;
+
+        while (n < OPUS_BATCH && pa_memblockq_get_length(u->memblockq) >= u->opus_frame_bytes) {
+            pa_assert_se(pa_memblockq_peek_fixed_size(u->memblockq, u->opus_frame_bytes, &pcm[n]) >= 0);
+            pa_memblockq_drop(u->memblockq, u->opus_frame_bytes);
+            n++;
+        }
+
+        /* Encoding happens without the lock, so the source I/O thread
+         * never waits for it */
+        pa_mutex_unlock(u->encoder_mutex);
+
+        encode_opus(u, pcm, packets, n);
+        pa_rtp_send_packets(&u->rtp_context, packets, n, u->opus_frame_samples);
+
+        for (i = 0; i < n; i++)
+            pa_memblock_unref(pcm[i].memblock);
+        pa_memblock_unref(packets[0].memblock);
+
+        pa_mutex_lock(u->encoder_mutex);
+    }
+
+    pa_mutex_unlock(u->encoder_mutex);
+
+    pa_log_debug("Opus encoder thread shutting down");
+}
+
+/* Creates the encoder for ss as configured in ma */
+static OpusEncoder *create_opus_encoder(pa_modargs *ma, const pa_sample_spec *ss, uint32_t *frame_samples) {
+    OpusEncoder *e;
+    double frame_msec = DEFAULT_OPUS_FRAME_MSEC;
+    long frame_tenths;
+    uint32_t bitrate = 0, packet_loss = DEFAULT_OPUS_PACKET_LOSS;
+    bool fec = true;
+    int error;
+
+    if (pa_modargs_get_value_double(ma, "opus_frame_msec", &frame_msec) < 0) {
+        pa_log("opus_frame_msec= expects one of 2.5, 5, 10, 20, 40 or 60.");
+        return NULL;
+    }
+
+    /* Opus frames are multiples of 2.5 ms, so compare in units of
+     * 0.1 ms */
+    frame_tenths = lround(frame_msec * 10);
+    if (fabs(frame_msec * 10 - (double) frame_tenths) > 1e-6 ||
+        (frame_tenths != 25 && frame_tenths != 50 && frame_tenths != 100 &&
+         frame_tenths != 200 && frame_tenths != 400 && frame_tenths != 600)) {
+        pa_log("opus_frame_msec= expects one of 2.5, 5, 10, 20, 40 or 60.");
+        return NULL;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "opus_bitrate", &bitrate) < 0 || (bitrate != 0 && (bitrate < 6000 || bitrate > 510000))) {
+        pa_log("opus_bitrate= expects a bit rate between 6000 and 510000.");
+        return NULL;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "opus_fec", &fec) < 0) {
+        pa_log("Failed to parse \"opus_fec\" parameter.");
+        return NULL;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "opus_packet_loss", &packet_loss) < 0 || packet_loss > 100) {
+        pa_log("opus_packet_loss= expects a percentage.");
+        return NULL;
+    }
+
+    if (!(e = opus_encoder_create((opus_int32) ss->rate, ss->channels, OPUS_APPLICATION_AUDIO, &error))) {
+        pa_log("Failed to create Opus encoder: %s", opus_strerror(error));
+        return NULL;
+    }
+
+    if (bitrate > 0)
+        opus_encoder_ctl(e, OPUS_SET_BITRATE((opus_int32) bitrate));
+
+    /* Frames shorter than 10 ms are always coded with CELT, which has no
+     * in-band FEC */
+    opus_encoder_ctl(e, OPUS_SET_INBAND_FEC(fec ? 1 : 0));
+    opus_encoder_ctl(e, OPUS_SET_PACKET_LOSS_PERC(fec ? (int) packet_loss : 0));
+
+    *frame_samples = (uint32_t) frame_tenths * PA_RTP_OPUS_RATE / 10000;
+
+    return e;
+}
+
+static void free_opus(struct userdata *u) {
+    if (u->encoder_thread) {
+        pa_mutex_lock(u->encoder_mutex);
+        u->encoder_quit = true;
+        pa_cond_signal(u->encoder_cond, 0);
+        pa_mutex_unlock(u->encoder_mutex);
+
+        pa_thread_free(u->encoder_thread);
+    }
+
+    if (u->encoder_cond)
+        pa_cond_free(u->encoder_cond);
+
+    if (u->encoder_mutex)
+        pa_mutex_free(u->encoder_mutex);
+
+    if (u->opus_encoder)
+        opus_encoder_destroy(u->opus_encoder);
+}
+#endif
+
 static pa_source_output_flags_t get_dont_inhibit_auto_suspend_flag(pa_source *source,
                                                                    enum inhibit_auto_suspend inhibit_auto_suspend) {
     pa_assert(source);
@@ -202,11 +428,20 @@ static void sap_event_cb(pa_mainloop_api *m, pa_time_event *t, const struct time
 
     pa_sap_send(&u->sap_context, 0);
 
+    if (u->source_output) {
+        pa_proplist *p;
+
+        p = pa_proplist_new();
+        pa_rtp_stats_update_proplist(&u->rtp_context, p);
+        pa_source_output_update_proplist(u->source_output, PA_UPDATE_REPLACE, p);
+        pa_proplist_free(p);
+    }
+
     pa_core_rttime_restart(u->module->core, t, pa_rtclock_now() + SAP_INTERVAL);
 }
 
 int pa__init(pa_module*m) {
-    struct userdata *u;
+    struct userdata *u = NULL;
     pa_modargs *ma = NULL;
     const char *dst_addr;
     const char *src_addr;
@@ -232,6 +467,14 @@ int pa__init(pa_module*m) {
     enum inhibit_auto_suspend inhibit_auto_suspend = INHIBIT_AUTO_SUSPEND_ONLY_WITH_NON_MONITOR_SOURCES;
     const char *inhibit_auto_suspend_str;
     pa_source_output_new_data data;
+    pa_rtp_encoding_t encoding = PA_RTP_ENCODING_PCM;
+    const char *encoding_str;
+    pa_usec_t latency;
+    char *fmtp = NULL;
+#ifdef HAVE_OPUS
+    OpusEncoder *opus_encoder = NULL;
+    uint32_t opus_frame_samples = 0;
+#endif
 
     pa_assert(m);
 
@@ -263,6 +506,19 @@ int pa__init(pa_module*m) {
         }
     }
 
+    encoding_str = pa_modargs_get_value(ma, "encoding", "pcm");
+    if (pa_streq(encoding_str, "opus")) {
+#ifdef HAVE_OPUS
+        encoding = PA_RTP_ENCODING_OPUS;
+#else
+        pa_log("Opus support not available.");
+        goto fail;
+#endif
+    } else if (!pa_streq(encoding_str, "pcm")) {
+        pa_log("Failed to parse the \"encoding\" parameter.");
+        goto fail;
+    }
+
     ss = s->sample_spec;
     pa_rtp_sample_spec_fixup(&ss);
     cm = s->channel_map;
@@ -271,7 +527,13 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
-    if (!pa_rtp_sample_spec_valid(&ss)) {
+    if (encoding == PA_RTP_ENCODING_OPUS) {
+        /* The encoder is fed at the RTP clock rate, the sample format
+         * argument doesn't matter */
+        ss.format = PA_SAMPLE_S16NE;
+        ss.rate = PA_RTP_OPUS_RATE;
+        ss.channels = PA_MIN(ss.channels, 2);
+    } else if (!pa_rtp_sample_spec_valid(&ss)) {
         pa_log("Specified sample type not compatible with RTP");
         goto fail;
     }
@@ -279,15 +541,31 @@ int pa__init(pa_module*m) {
     if (ss.channels != cm.channels)
         pa_channel_map_init_auto(&cm, ss.channels, PA_CHANNEL_MAP_AIFF);
 
-    payload = pa_rtp_payload_from_sample_spec(&ss);
+    if (encoding == PA_RTP_ENCODING_OPUS)
+        payload = PA_RTP_PAYLOAD_OPUS;
+    else
+        payload = pa_rtp_payload_from_sample_spec(&ss);
 
     mtu = (uint32_t) pa_frame_align(DEFAULT_MTU, &ss);
 
-    if (pa_modargs_get_value_u32(ma, "mtu", &mtu) < 0 || mtu < 1 || mtu % pa_frame_size(&ss) != 0) {
+    if (pa_modargs_get_value_u32(ma, "mtu", &mtu) < 0 || mtu < 1 ||
+        (encoding == PA_RTP_ENCODING_PCM && mtu % pa_frame_size(&ss) != 0)) {
         pa_log("Invalid MTU.");
         goto fail;
     }
 
+    latency = pa_bytes_to_usec(mtu, &ss);
+
+#ifdef HAVE_OPUS
+    if (encoding == PA_RTP_ENCODING_OPUS) {
+        if (!(opus_encoder = create_opus_encoder(ma, &ss, &opus_frame_samples)))
+            goto fail;
+
+        latency = pa_bytes_to_usec(opus_frame_samples * pa_frame_size(&ss), &ss);
+        fmtp = pa_sprintf_malloc("sprop-stereo=%i", ss.channels == 2);
+    }
+#endif
+
     port = DEFAULT_PORT + ((uint32_t) (rand() % 512) << 1);
     if (pa_modargs_get_value_u32(ma, "port", &port) < 0 || port < 1 || port > 0xFFFF) {
         pa_log("port= expects a numerical argument between 1 and 65535.");
@@ -449,9 +727,9 @@ int pa__init(pa_module*m) {
     o->kill = source_output_kill_cb;
 
     pa_log_info("Configured source latency of %llu ms.",
-                (unsigned long long) pa_source_output_set_requested_latency(o, pa_bytes_to_usec(mtu, &o->sample_spec)) / PA_USEC_PER_MSEC);
+                (unsigned long long) pa_source_output_set_requested_latency(o, latency) / PA_USEC_PER_MSEC);
 
-    m->userdata = o->userdata = u = pa_xnew(struct userdata, 1);
+    m->userdata = o->userdata = u = pa_xnew0(struct userdata, 1);
     u->module = m;
     u->source_output = o;
 
@@ -468,6 +746,20 @@ int pa__init(pa_module*m) {
 
     u->mtu = mtu;
 
+#ifdef HAVE_OPUS
+    if (opus_encoder) {
+        u->opus_encoder = opus_encoder;
+        opus_encoder = NULL;
+
+        u->opus_frame_samples = opus_frame_samples;
+        u->opus_frame_bytes = opus_frame_samples * pa_frame_size(&ss);
+        u->opus_max_packet = PA_MIN(u->mtu, (size_t) MAX_OPUS_PACKET);
+
+        u->encoder_mutex = pa_mutex_new(false, true);
+        u->encoder_cond = pa_cond_new();
+    }
+#endif
+
     k = sizeof(sa_dst);
     pa_assert_se((r = getsockname(fd, (struct sockaddr*) &sa_dst, &k)) >= 0);
 
@@ -477,17 +769,19 @@ int pa__init(pa_module*m) {
         p = pa_sdp_build(af,
                      (void*) &((struct sockaddr_in*) &sa_dst)->sin_addr,
                      (void*) &dst_sa4.sin_addr,
-                     n, (uint16_t) port, payload, &ss);
+                     n, (uint16_t) port, payload, &ss, encoding, fmtp);
 #ifdef HAVE_IPV6
     } else {
         p = pa_sdp_build(af,
                      (void*) &((struct sockaddr_in6*) &sa_dst)->sin6_addr,
                      (void*) &dst_sa6.sin6_addr,
-                     n, (uint16_t) port, payload, &ss);
+                     n, (uint16_t) port, payload, &ss, encoding, fmtp);
 #endif
     }
 
     pa_xfree(n);
+    pa_xfree(fmtp);
+    fmtp = NULL;
 
     pa_rtp_context_init_send(&u->rtp_context, fd, m->core->cookie, payload, pa_frame_size(&ss));
     pa_sap_context_init_send(&u->sap_context, sap_fd, p);
@@ -495,6 +789,13 @@ int pa__init(pa_module*m) {
     pa_log_info("RTP stream initialized with mtu %u on %s:%u from %s ttl=%u, SSRC=0x%08x, payload=%u, initial sequence #%u", mtu, dst_addr, port, src_addr, ttl, u->rtp_context.ssrc, payload, u->rtp_context.sequence);
     pa_log_info("SDP-Data:\n%s\nEOF", p);
 
+#ifdef HAVE_OPUS
+    if (u->opus_encoder && !(u->encoder_thread = pa_thread_new("rtp-opus", encoder_thread_func, u))) {
+        pa_log("Failed to create encoder thread.");
+        goto fail;
+    }
+#endif
+
     pa_sap_send(&u->sap_context, 0);
 
     u->sap_event = pa_core_rttime_new(m->core, pa_rtclock_now() + SAP_INTERVAL, sap_event_cb, u);
@@ -510,6 +811,19 @@ fail:
     if (ma)
         pa_modargs_free(ma);
 
+    pa_xfree(fmtp);
+
+    if (u) {
+        /* Everything else is owned by u by now */
+        pa__done(m);
+        return -1;
+    }
+
+#ifdef HAVE_OPUS
+    if (opus_encoder)
+        opus_encoder_destroy(opus_encoder);
+#endif
+
     if (fd >= 0)
         pa_close(fd);
 
@@ -539,6 +853,11 @@ void pa__done(pa_module*m) {
         pa_source_output_unref(u->source_output);
     }
 
+#ifdef HAVE_OPUS
+    /* Stop the encoder thread before the context it sends with goes */
+    free_opus(u);
+#endif
+
     pa_rtp_context_destroy(&u->rtp_context);
 
     pa_sap_send(&u->sap_context, 1);
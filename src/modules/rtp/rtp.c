@@ -25,16 +25,15 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-
-#ifdef HAVE_SYS_FILIO_H
-#include <sys/filio.h>
-#endif
 
 #ifdef HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
 #include <pulsecore/core-error.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -43,10 +42,58 @@
 
 #include "rtp.h"
 
+#define MAX_IOVECS 16
+
+/* Packets are sent and received in batches of up to this many, with one
+ * sendmmsg() or recvmmsg() call where the system has them */
+#define MAX_BATCH 16
+
+/* Receive buffer size per packet until we have seen some packets */
+#define DEFAULT_PACKET_SIZE 2048
+#define MAX_PACKET_SIZE 65536
+
+/* In packets, see RFC 3550 */
+#define MAX_DROPOUT 3000
+#define MAX_MISORDER 100
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define USE_MMSG
+typedef struct mmsghdr packet_hdr;
+#else
+typedef struct packet_hdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} packet_hdr;
+#endif
+
+struct pa_rtp_batch {
+    packet_hdr msgs[MAX_BATCH];
+    struct iovec iov[MAX_BATCH][MAX_IOVECS];
+
+    /* Sending: the memblocks in iov[][1...] and the RTP headers in
+     * iov[][0] */
+    pa_memblock *mb[MAX_BATCH][MAX_IOVECS];
+    uint32_t header[MAX_BATCH][3];
+
+    /* Receiving: the packets are stored packet_size bytes apart from
+     * index on in memblock, with their ancillary data in aux */
+    union {
+        struct cmsghdr cm;
+        uint8_t data[128];
+    } aux[MAX_BATCH];
+    pa_memblock *memblock;
+    size_t index;
+    size_t packet_size;
+    size_t max_packet_size;
+    unsigned n, next;
+};
+
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size) {
     pa_assert(c);
     pa_assert(fd >= 0);
 
+    pa_zero(*c);
+
     c->fd = fd;
     c->sequence = (uint16_t) (rand()*rand());
     c->timestamp = 0;
@@ -55,202 +102,325 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
     c->frame_size = frame_size;
 
     pa_memchunk_reset(&c->memchunk);
+    c->batch = pa_xnew0(pa_rtp_batch, 1);
 
     return c;
 }
 
-#define MAX_IOVECS 16
+static int send_packets(pa_rtp_context *c, unsigned n) {
+    pa_rtp_batch *b = c->batch;
+    unsigned i;
+    int j, r;
+
+#ifdef USE_MMSG
+    r = sendmmsg(c->fd, b->msgs, n, MSG_DONTWAIT);
+    pa_atomic_inc(&c->stats.syscalls);
+#else
+    for (r = 0; r < (int) n; r++) {
+        pa_atomic_inc(&c->stats.syscalls);
+
+        if (sendmsg(c->fd, &b->msgs[r].msg_hdr, MSG_DONTWAIT) < 0) {
+            if (r == 0)
+                r = -1;
+            break;
+        }
+    }
+#endif
 
-int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
-    struct iovec iov[MAX_IOVECS];
-    pa_memblock* mb[MAX_IOVECS];
-    int iov_idx = 1;
-    size_t n = 0;
+    if (r < 0) {
+        if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
+            pa_log("sendmmsg() failed: %s", pa_cstrerror(errno));
+        r = 0;
+    }
 
-    pa_assert(c);
-    pa_assert(size > 0);
-    pa_assert(q);
+    for (i = 0; i < n; i++)
+        for (j = 1; j < (int) b->msgs[i].msg_hdr.msg_iovlen; j++) {
+            pa_memblock_release(b->mb[i][j]);
+            pa_memblock_unref(b->mb[i][j]);
+        }
 
-    if (pa_memblockq_get_length(q) < size)
-        return 0;
+    pa_atomic_add(&c->stats.packets, r);
+    pa_atomic_add(&c->stats.dropped, (int) n - r);
+
+    return r < (int) n ? -1 : 0;
+}
+
+/* Completes packet p of the batch, whose payload is in iov[p][1...] */
+static void fill_header(pa_rtp_context *c, unsigned p, int iov_idx) {
+    pa_rtp_batch *b = c->batch;
+    struct msghdr *m = &b->msgs[p].msg_hdr;
+
+    b->header[p][0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+    b->header[p][1] = htonl(c->timestamp);
+    b->header[p][2] = htonl(c->ssrc);
+
+    b->iov[p][0].iov_base = (void*) b->header[p];
+    b->iov[p][0].iov_len = sizeof(b->header[p]);
+
+    pa_zero(*m);
+    m->msg_iov = b->iov[p];
+    m->msg_iovlen = (size_t) iov_idx;
+
+    c->sequence++;
+}
+
+/* Fills packet p of the batch with at most size bytes from q. Returns
+ * the number of bytes. *hole is set if q has a hole at the read index. */
+static size_t fill_packet(pa_rtp_context *c, unsigned p, size_t size, pa_memblockq *q, bool *hole) {
+    pa_rtp_batch *b = c->batch;
+    struct iovec *iov = b->iov[p];
+    int iov_idx = 1;
+    size_t n = 0;
 
-    for (;;) {
-        int r;
+    while (n < size && iov_idx < MAX_IOVECS) {
         pa_memchunk chunk;
+        size_t k;
 
         pa_memchunk_reset(&chunk);
 
-        if ((r = pa_memblockq_peek(q, &chunk)) >= 0) {
+        if (pa_memblockq_peek(q, &chunk) < 0) {
+            *hole = true;
+            break;
+        }
 
-            size_t k = n + chunk.length > size ? size - n : chunk.length;
+        pa_assert(chunk.memblock);
 
-            pa_assert(chunk.memblock);
+        k = n + chunk.length > size ? size - n : chunk.length;
 
-            iov[iov_idx].iov_base = pa_memblock_acquire_chunk(&chunk);
-            iov[iov_idx].iov_len = k;
-            mb[iov_idx] = chunk.memblock;
-            iov_idx ++;
+        iov[iov_idx].iov_base = pa_memblock_acquire_chunk(&chunk);
+        iov[iov_idx].iov_len = k;
+        b->mb[p][iov_idx] = chunk.memblock;
+        iov_idx++;
 
-            n += k;
-            pa_memblockq_drop(q, k);
-        }
+        n += k;
+        pa_memblockq_drop(q, k);
+    }
 
-        pa_assert(n % c->frame_size == 0);
+    pa_assert(n % c->frame_size == 0);
 
-        if (r < 0 || n >= size || iov_idx >= MAX_IOVECS) {
-            uint32_t header[3];
-            struct msghdr m;
-            ssize_t k;
-            int i;
+    if (n > 0)
+        fill_header(c, p, iov_idx);
 
-            if (n > 0) {
-                header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
-                header[1] = htonl(c->timestamp);
-                header[2] = htonl(c->ssrc);
+    c->timestamp += (unsigned) (n/c->frame_size);
 
-                iov[0].iov_base = (void*)header;
-                iov[0].iov_len = sizeof(header);
+    return n;
+}
 
-                m.msg_name = NULL;
-                m.msg_namelen = 0;
-                m.msg_iov = iov;
-                m.msg_iovlen = (size_t) iov_idx;
-                m.msg_control = NULL;
-                m.msg_controllen = 0;
-                m.msg_flags = 0;
+int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
+    bool hole = false;
 
-                k = sendmsg(c->fd, &m, MSG_DONTWAIT);
+    pa_assert(c);
+    pa_assert(size > 0);
+    pa_assert(q);
 
-                for (i = 1; i < iov_idx; i++) {
-                    pa_memblock_release(mb[i]);
-                    pa_memblock_unref(mb[i]);
-                }
+    while (!hole && pa_memblockq_get_length(q) >= size) {
+        unsigned n = 0;
 
-                c->sequence++;
-            } else
-                k = 0;
+        while (n < MAX_BATCH && !hole && pa_memblockq_get_length(q) >= size)
+            if (fill_packet(c, n, size, q, &hole) > 0)
+                n++;
 
-            c->timestamp += (unsigned) (n/c->frame_size);
+        if (n > 0 && send_packets(c, n) < 0)
+            return -1;
+    }
 
-            if (k < 0) {
-                if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
-                    pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
-                return -1;
-            }
+    return 0;
+}
+
+int pa_rtp_send_packets(pa_rtp_context *c, const pa_memchunk *packets, unsigned n, uint32_t duration) {
+    pa_rtp_batch *b;
+    unsigned i = 0;
+    int r = 0;
+
+    pa_assert(c);
+    pa_assert(packets || n == 0);
+
+    b = c->batch;
 
-            if (r < 0 || pa_memblockq_get_length(q) < size)
-                break;
+    while (i < n) {
+        unsigned k = 0;
 
-            n = 0;
-            iov_idx = 1;
+        for (; k < MAX_BATCH && i < n; i++) {
+            if (packets[i].length > 0) {
+                b->iov[k][1].iov_base = pa_memblock_acquire_chunk(&packets[i]);
+                b->iov[k][1].iov_len = packets[i].length;
+                b->mb[k][1] = pa_memblock_ref(packets[i].memblock);
+
+                fill_header(c, k, 2);
+                k++;
+            }
+
+            c->timestamp += duration;
         }
+
+        if (k > 0 && send_packets(c, k) < 0)
+            r = -1;
     }
 
-    return 0;
+    return r;
 }
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size) {
     pa_assert(c);
 
+    pa_zero(*c);
+
     c->fd = fd;
     c->frame_size = frame_size;
 
     pa_memchunk_reset(&c->memchunk);
+    c->batch = pa_xnew0(pa_rtp_batch, 1);
+    c->batch->packet_size = DEFAULT_PACKET_SIZE;
+
     return c;
 }
 
-int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
-    int size;
-    struct msghdr m;
-    struct cmsghdr *cm;
-    struct iovec iov;
-    uint32_t header;
-    unsigned cc;
-    ssize_t r;
-    uint8_t aux[1024];
-    bool found_tstamp = false;
-
+void pa_rtp_context_set_max_packet_size(pa_rtp_context *c, size_t size) {
     pa_assert(c);
-    pa_assert(chunk);
+    pa_assert(size > 0);
 
-    pa_memchunk_reset(chunk);
+    size = PA_MAX(c->batch->max_packet_size, size);
+    c->batch->max_packet_size = PA_MIN(size, (size_t) MAX_PACKET_SIZE);
+}
 
-    if (ioctl(c->fd, FIONREAD, &size) < 0) {
-        pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
-        goto fail;
-    }
+/* Reads all queued packets into the free part of c->memchunk */
+static int recv_packets(pa_rtp_context *c, pa_mempool *pool) {
+    pa_rtp_batch *b = c->batch;
+    uint8_t *d;
+    unsigned i, n;
+    int r;
 
-    if (size <= 0) {
-        /* size can be 0 due to any of the following reasons:
-         *
-         * 1. Somebody sent us a perfectly valid zero-length UDP packet.
-         * 2. Somebody sent us a UDP packet with a bad CRC.
-         *
-         * It is unknown whether size can actually be less than zero.
-         *
-         * In the first case, the packet has to be read out, otherwise the
-         * kernel will tell us again and again about it, thus preventing
-         * reception of any further packets. So let's just read it out
-         * now and discard it later, when comparing the number of bytes
-         * received (0) with the number of bytes wanted (1, see below).
-         *
-         * In the second case, recvmsg() will fail, thus allowing us to
-         * return the error.
-         *
-         * Just to avoid passing zero-sized memchunks and NULL pointers to
-         * recvmsg(), let's force allocation of at least one byte by setting
-         * size to 1.
-         */
-        size = 1;
+    if (b->memblock) {
+        pa_memblock_unref(b->memblock);
+        b->memblock = NULL;
     }
 
-    if (c->memchunk.length < (unsigned) size) {
-        size_t l;
+    b->n = b->next = 0;
 
-        if (c->memchunk.memblock)
-            pa_memblock_unref(c->memchunk.memblock);
+    /* Only as much space as the largest packet so far is reserved for
+     * each one, so that the blocks stay densely packed */
+    if (b->max_packet_size > 0)
+        b->packet_size = PA_ALIGN(b->max_packet_size);
 
-        l = PA_MAX((size_t) size, pa_mempool_block_size_max(pool));
+    if (c->memchunk.memblock && c->memchunk.length < b->packet_size) {
+        pa_memblock_unref(c->memchunk.memblock);
+        pa_memchunk_reset(&c->memchunk);
+    }
 
-        c->memchunk.memblock = pa_memblock_new(pool, l);
+    if (!c->memchunk.memblock) {
+        c->memchunk.memblock = pa_memblock_new(pool, PA_MAX(b->packet_size, pa_mempool_block_size_max(pool)));
         c->memchunk.index = 0;
         c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock);
     }
 
-    pa_assert(c->memchunk.length >= (size_t) size);
+    n = (unsigned) PA_MIN((size_t) MAX_BATCH, c->memchunk.length / b->packet_size);
+    pa_assert(n > 0);
 
-    chunk->memblock = pa_memblock_ref(c->memchunk.memblock);
-    chunk->index = c->memchunk.index;
+    d = pa_memblock_acquire_chunk(&c->memchunk);
 
-    iov.iov_base = pa_memblock_acquire_chunk(chunk);
-    iov.iov_len = (size_t) size;
+    for (i = 0; i < n; i++) {
+        struct msghdr *m = &b->msgs[i].msg_hdr;
 
-    m.msg_name = NULL;
-    m.msg_namelen = 0;
-    m.msg_iov = &iov;
-    m.msg_iovlen = 1;
-    m.msg_control = aux;
-    m.msg_controllen = sizeof(aux);
-    m.msg_flags = 0;
+        b->iov[i][0].iov_base = d + i * b->packet_size;
+        b->iov[i][0].iov_len = b->packet_size;
 
-    r = recvmsg(c->fd, &m, 0);
-    pa_memblock_release(chunk->memblock);
+        pa_zero(*m);
+        m->msg_iov = b->iov[i];
+        m->msg_iovlen = 1;
+        m->msg_control = b->aux[i].data;
+        m->msg_controllen = sizeof(b->aux[i].data);
+    }
 
-    if (r != size) {
+    /* With MSG_TRUNC we learn the real size of packets that didn't fit */
+#ifdef USE_MMSG
+    r = recvmmsg(c->fd, b->msgs, n, MSG_DONTWAIT|MSG_TRUNC, NULL);
+#else
+    if ((r = (int) recvmsg(c->fd, &b->msgs[0].msg_hdr, MSG_DONTWAIT|MSG_TRUNC)) >= 0) {
+        b->msgs[0].msg_len = (unsigned) r;
+        r = 1;
+    }
+#endif
+
+    pa_memblock_release(c->memchunk.memblock);
+    pa_atomic_inc(&c->stats.syscalls);
+
+    if (r <= 0) {
         if (r < 0 && errno != EAGAIN && errno != EINTR)
-            pa_log_warn("recvmsg() failed: %s", r < 0 ? pa_cstrerror(errno) : "size mismatch");
+            pa_log_warn("recvmmsg() failed: %s", pa_cstrerror(errno));
+
+        return -1;
+    }
+
+    b->memblock = pa_memblock_ref(c->memchunk.memblock);
+    b->index = c->memchunk.index;
+    b->n = (unsigned) r;
+
+    c->memchunk.index += b->n * b->packet_size;
+    c->memchunk.length -= b->n * b->packet_size;
+
+    if (c->memchunk.length <= 0) {
+        pa_memblock_unref(c->memchunk.memblock);
+        pa_memchunk_reset(&c->memchunk);
+    }
+
+    return 0;
+}
+
+unsigned pa_rtp_recv_pending(pa_rtp_context *c) {
+    pa_assert(c);
+
+    return c->batch->n - c->batch->next;
+}
+
+int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
+    pa_rtp_batch *b;
+    struct msghdr *m;
+    struct cmsghdr *cm;
+    uint8_t *d;
+    size_t size;
+    uint32_t header;
+    uint16_t delta;
+    unsigned cc, i;
+    bool found_tstamp = false;
+
+    pa_assert(c);
+    pa_assert(chunk);
+
+    pa_memchunk_reset(chunk);
+
+    b = c->batch;
 
+    if (b->next >= b->n && recv_packets(c, pool) < 0)
+        return -1;
+
+    i = b->next++;
+    m = &b->msgs[i].msg_hdr;
+    size = b->msgs[i].msg_len;
+
+    if (size > b->packet_size || (m->msg_flags & MSG_TRUNC)) {
+        pa_log_warn("RTP packet larger than %lu bytes, dropped.", (unsigned long) b->packet_size);
+
+        /* Not all systems tell the real size */
+        size = PA_MAX(size, 2 * b->packet_size);
+        b->max_packet_size = PA_MIN(size, (size_t) MAX_PACKET_SIZE);
         goto fail;
     }
 
+    b->max_packet_size = PA_MAX(b->max_packet_size, size);
+
     if (size < 12) {
         pa_log_warn("RTP packet too short.");
         goto fail;
     }
 
-    memcpy(&header, iov.iov_base, sizeof(uint32_t));
-    memcpy(&c->timestamp, (uint8_t*) iov.iov_base + 4, sizeof(uint32_t));
-    memcpy(&c->ssrc, (uint8_t*) iov.iov_base + 8, sizeof(uint32_t));
+    chunk->memblock = pa_memblock_ref(b->memblock);
+    chunk->index = b->index + i * b->packet_size;
+
+    d = pa_memblock_acquire_chunk(chunk);
+    memcpy(&header, d, sizeof(uint32_t));
+    memcpy(&c->timestamp, d + 4, sizeof(uint32_t));
+    memcpy(&c->ssrc, d + 8, sizeof(uint32_t));
+    pa_memblock_release(chunk->memblock);
 
     header = ntohl(header);
     c->timestamp = ntohl(c->timestamp);
@@ -275,28 +445,33 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
     c->payload = (uint8_t) ((header >> 16) & 127U);
     c->sequence = (uint16_t) (header & 0xFFFFU);
 
-    if (12 + cc*4 > (unsigned) size) {
+    if (12 + cc*4 > size) {
         pa_log_warn("RTP packet too short. (CSRC)");
         goto fail;
     }
 
     chunk->index += 12 + cc*4;
-    chunk->length = (size_t) size - 12 + cc*4;
+    chunk->length = size - (12 + cc*4);
 
     if (chunk->length % c->frame_size != 0) {
         pa_log_warn("Bad RTP packet size.");
         goto fail;
     }
 
-    c->memchunk.index = chunk->index + chunk->length;
-    c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock) - c->memchunk.index;
+    /* Like in appendix A.1 of RFC 3550: small gaps are lost packets,
+     * packets a little behind arrived late or twice, and anything else
+     * means the sender started over */
+    delta = (uint16_t) (c->sequence - c->next_sequence);
 
-    if (c->memchunk.length <= 0) {
-        pa_memblock_unref(c->memchunk.memblock);
-        pa_memchunk_reset(&c->memchunk);
+    if (!c->have_sequence || delta < 0x10000U - MAX_MISORDER) {
+        if (c->have_sequence && delta < MAX_DROPOUT)
+            pa_atomic_add(&c->stats.lost, (int) delta);
+
+        c->next_sequence = (uint16_t) (c->sequence + 1);
+        c->have_sequence = true;
     }
 
-    for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
+    for (cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm))
         if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMP) {
             memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
             found_tstamp = true;
@@ -308,15 +483,56 @@ int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct
         pa_zero(*tstamp);
     }
 
+    pa_atomic_inc(&c->stats.packets);
+
     return 0;
 
 fail:
     if (chunk->memblock)
         pa_memblock_unref(chunk->memblock);
 
+    pa_memchunk_reset(chunk);
+    pa_atomic_inc(&c->stats.dropped);
+
     return -1;
 }
 
+int64_t pa_rtp_timestamp_delta(uint32_t expected, uint32_t timestamp) {
+    return (int64_t) (int32_t) (timestamp - expected);
+}
+
+bool pa_rtp_timestamp_restarted(int64_t delta, int64_t frames) {
+    pa_assert(frames > 0);
+
+    /* A packet overtaken by later ones lags behind by a few packets at
+     * most, just like in pa_rtp_recv() */
+    return delta + frames <= 0 && -delta > MAX_MISORDER * frames;
+}
+
+void pa_rtp_stats_update_proplist(pa_rtp_context *c, pa_proplist *p) {
+    unsigned packets;
+    pa_usec_t now;
+    double rate = 0;
+
+    pa_assert(c);
+    pa_assert(p);
+
+    now = pa_rtclock_now();
+    packets = (unsigned) pa_atomic_load(&c->stats.packets);
+
+    if (c->stats.last_update > 0 && now > c->stats.last_update)
+        rate = (double) (packets - c->stats.last_packets) * PA_USEC_PER_SEC / (double) (now - c->stats.last_update);
+
+    c->stats.last_packets = packets;
+    c->stats.last_update = now;
+
+    pa_proplist_setf(p, "rtp.packets", "%u", packets);
+    pa_proplist_setf(p, "rtp.packet_rate", "%0.1f", rate);
+    pa_proplist_setf(p, "rtp.dropped", "%u", (unsigned) pa_atomic_load(&c->stats.dropped));
+    pa_proplist_setf(p, "rtp.lost", "%u", (unsigned) pa_atomic_load(&c->stats.lost));
+    pa_proplist_setf(p, "rtp.syscalls", "%u", (unsigned) pa_atomic_load(&c->stats.syscalls));
+}
+
 uint8_t pa_rtp_payload_from_sample_spec(const pa_sample_spec *ss) {
     pa_assert(ss);
 
@@ -397,6 +613,11 @@ void pa_rtp_context_destroy(pa_rtp_context *c) {
 
     if (c->memchunk.memblock)
         pa_memblock_unref(c->memchunk.memblock);
+
+    if (c->batch->memblock)
+        pa_memblock_unref(c->batch->memblock);
+
+    pa_xfree(c->batch);
 }
 
 const char* pa_rtp_format_to_string(pa_sample_format_t f) {
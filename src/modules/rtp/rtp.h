@@ -23,9 +23,36 @@
 #include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <pulse/proplist.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
 
+/* Counted by the thread that sends or receives, read by the main
+ * thread */
+typedef struct pa_rtp_stats {
+    pa_atomic_t packets;    /* Sent, or received and usable */
+    pa_atomic_t dropped;    /* Failed to send, or received but unusable */
+    pa_atomic_t lost;       /* Missing from the received sequence */
+    pa_atomic_t syscalls;
+
+    /* Only used by pa_rtp_stats_update_proplist() */
+    unsigned last_packets;
+    pa_usec_t last_update;
+} pa_rtp_stats;
+
+typedef struct pa_rtp_batch pa_rtp_batch;
+
+typedef enum pa_rtp_encoding {
+    PA_RTP_ENCODING_PCM,
+    PA_RTP_ENCODING_OPUS    /* RFC 7587 */
+} pa_rtp_encoding_t;
+
+/* Opus has no static payload type, and its RTP clock always runs at
+ * 48 kHz whatever the rate actually coded */
+#define PA_RTP_PAYLOAD_OPUS 96
+#define PA_RTP_OPUS_RATE 48000
+
 typedef struct pa_rtp_context {
     int fd;
     uint16_t sequence;
@@ -35,6 +62,12 @@ typedef struct pa_rtp_context {
     size_t frame_size;
 
     pa_memchunk memchunk;
+    pa_rtp_batch *batch;
+
+    bool have_sequence;
+    uint16_t next_sequence;
+
+    pa_rtp_stats stats;
 } pa_rtp_context;
 
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
@@ -43,8 +76,37 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
  * guarantee that the current read index doesn't point to a hole. */
 int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 
+/* Sends each of the n chunks as a packet of its own, for payloads that
+ * are already framed like Opus. Every packet advances the timestamp by
+ * duration. Empty chunks are not sent, but their time passes. */
+int pa_rtp_send_packets(pa_rtp_context *c, const pa_memchunk *packets, unsigned n, uint32_t duration);
+
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
+
+/* Returns the next received packet. All packets the kernel has queued
+ * are read at once, call this again while pa_rtp_recv_pending() is
+ * non-zero. */
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
+unsigned pa_rtp_recv_pending(pa_rtp_context *c);
+
+/* Returns the distance in frames from the expected timestamp to the
+ * received one, taking wraparound into account */
+int64_t pa_rtp_timestamp_delta(uint32_t expected, uint32_t timestamp);
+
+/* Returns true if a packet of the given number of frames that starts
+ * delta frames after the expected timestamp is too far behind to have
+ * been reordered, so that the sender must have restarted its
+ * timestamps */
+bool pa_rtp_timestamp_restarted(int64_t delta, int64_t frames);
+
+/* Reserves room for packets of up to size bytes from the start. Without
+ * this packets larger than all before them are dropped while the room is
+ * adapted, which is fine for constant sized payloads only. */
+void pa_rtp_context_set_max_packet_size(pa_rtp_context *c, size_t size);
+
+/* Sets rtp.packets, rtp.packet_rate, rtp.dropped, rtp.lost and
+ * rtp.syscalls in p. The rate is the one since the last call. */
+void pa_rtp_stats_update_proplist(pa_rtp_context *c, pa_proplist *p);
 
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
@@ -27,6 +27,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <string.h>
+#include <strings.h>
 
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
@@ -39,10 +40,10 @@
 #include "sdp.h"
 #include "rtp.h"
 
-char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss) {
+char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss, pa_rtp_encoding_t encoding, const char *fmtp) {
     uint32_t ntp;
-    char buf_src[64], buf_dst[64], un[64];
-    const char *u, *f;
+    char buf_src[64], buf_dst[64], un[64], rtpmap[64], *a, *r;
+    const char *u;
 
     pa_assert(src);
     pa_assert(dst);
@@ -53,7 +54,16 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
     pa_assert(af == AF_INET);
 #endif
 
-    pa_assert_se(f = pa_rtp_format_to_string(ss->format));
+    if (encoding == PA_RTP_ENCODING_OPUS)
+        /* RFC 7587 always announces two channels, the actual number
+         * goes into the sprop-stereo parameter */
+        pa_snprintf(rtpmap, sizeof(rtpmap), "opus/%u/2", PA_RTP_OPUS_RATE);
+    else {
+        const char *f;
+
+        pa_assert_se(f = pa_rtp_format_to_string(ss->format));
+        pa_snprintf(rtpmap, sizeof(rtpmap), "%s/%u/%u", f, ss->rate, ss->channels);
+    }
 
     if (!(u = pa_get_user_name(un, sizeof(un))))
         u = "-";
@@ -63,7 +73,9 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
     pa_assert_se(inet_ntop(af, src, buf_src, sizeof(buf_src)));
     pa_assert_se(inet_ntop(af, dst, buf_dst, sizeof(buf_dst)));
 
-    return pa_sprintf_malloc(
+    a = fmtp ? pa_sprintf_malloc("a=fmtp:%i %s\n", payload, fmtp) : NULL;
+
+    r = pa_sprintf_malloc(
             PA_SDP_HEADER
             "o=%s %lu 0 IN %s %s\n"
             "s=%s\n"
@@ -71,22 +83,37 @@ char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, u
             "t=%lu 0\n"
             "a=recvonly\n"
             "m=audio %u RTP/AVP %i\n"
-            "a=rtpmap:%i %s/%u/%u\n"
+            "a=rtpmap:%i %s\n"
+            "%s"
             "a=type:broadcast\n",
             u, (unsigned long) ntp, af == AF_INET ? "IP4" : "IP6", buf_src,
             name,
             af == AF_INET ? "IP4" : "IP6", buf_dst,
             (unsigned long) ntp,
             port, payload,
-            payload, f, ss->rate, ss->channels);
+            payload, rtpmap,
+            a ? a : "");
+
+    pa_xfree(a);
+
+    return r;
 }
 
-static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, char *c) {
+static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, pa_rtp_encoding_t *encoding, char *c) {
     unsigned rate, channels;
     pa_assert(ss);
+    pa_assert(encoding);
     pa_assert(c);
 
-    if (pa_startswith(c, "L16/")) {
+    *encoding = PA_RTP_ENCODING_PCM;
+
+    if (strncasecmp(c, "opus/", 5) == 0) {
+        /* We decode to whatever the sender announced with sprop-stereo,
+         * see pa_sdp_parse() */
+        ss->format = PA_SAMPLE_S16NE;
+        *encoding = PA_RTP_ENCODING_OPUS;
+        c += 5;
+    } else if (pa_startswith(c, "L16/")) {
         ss->format = PA_SAMPLE_S16BE;
         c += 4;
     } else if (pa_startswith(c, "L8/")) {
@@ -118,7 +145,7 @@ static pa_sample_spec *parse_sdp_sample_spec(pa_sample_spec *ss, char *c) {
 
 pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
     uint16_t port = 0;
-    bool ss_valid = false;
+    bool ss_valid = false, mono = false;
 
     pa_assert(t);
     pa_assert(i);
@@ -126,6 +153,7 @@ pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
     i->origin = i->session_name = NULL;
     i->salen = 0;
     i->payload = 255;
+    i->encoding = PA_RTP_ENCODING_PCM;
 
     if (!pa_startswith(t, PA_SDP_HEADER)) {
         pa_log("Failed to parse SDP data: invalid header.");
@@ -225,11 +253,28 @@ pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
                         c[63] = 0;
                         c[strcspn(c, "\n")] = 0;
 
-                        if (parse_sdp_sample_spec(&i->sample_spec, c))
+                        if (parse_sdp_sample_spec(&i->sample_spec, &i->encoding, c))
                             ss_valid = true;
                     }
                 }
             }
+        } else if (pa_startswith(t, "a=fmtp:")) {
+
+            if (i->payload <= 127) {
+                int _payload;
+                int len;
+
+                if (sscanf(t + 7, "%i %n", &_payload, &len) == 1 && _payload == i->payload) {
+                    char *c = pa_xstrndup(t + 7 + len, l - 7 - (size_t) len);
+
+                    /* Only the Opus parameter that changes how we decode
+                     * is of interest */
+                    if (strstr(c, "sprop-stereo=0"))
+                        mono = true;
+
+                    pa_xfree(c);
+                }
+            }
         }
 
         t += l;
@@ -243,6 +288,9 @@ pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *i, int is_goodbye) {
         goto fail;
     }
 
+    if (i->encoding == PA_RTP_ENCODING_OPUS && mono)
+        i->sample_spec.channels = 1;
+
     if (((struct sockaddr*) &i->sa)->sa_family == AF_INET)
         ((struct sockaddr_in*) &i->sa)->sin_port = htons(port);
     else
@@ -26,6 +26,8 @@
 
 #include <pulse/sample.h>
 
+#include "rtp.h"
+
 #define PA_SDP_HEADER "v=0\n"
 
 typedef struct pa_sdp_info {
@@ -35,11 +37,14 @@ typedef struct pa_sdp_info {
     struct sockaddr_storage sa;
     socklen_t salen;
 
+    /* For Opus this is the decoded format */
     pa_sample_spec sample_spec;
+    pa_rtp_encoding_t encoding;
     uint8_t payload;
 } pa_sdp_info;
 
-char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss);
+/* fmtp is the format specific parameter string, or NULL */
+char *pa_sdp_build(int af, const void *src, const void *dst, const char *name, uint16_t port, uint8_t payload, const pa_sample_spec *ss, pa_rtp_encoding_t encoding, const char *fmtp);
 
 pa_sdp_info *pa_sdp_parse(const char *t, pa_sdp_info *info, int is_goodbye);
 
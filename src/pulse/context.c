@@ -372,6 +372,8 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
         return;
     }
 
+    pa_log_debug("Using srbchannel with a capacity of 2 * %lu bytes.", (unsigned long) pa_srbchannel_get_capacity(sr));
+
     /* Ack the enable command */
     t = pa_tagstruct_new();
     pa_tagstruct_putu32(t, PA_COMMAND_ENABLE_SRBCHANNEL);
@@ -78,6 +78,133 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
     return pa_context_send_simple_command(c, PA_COMMAND_STAT, context_stat_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Timing Statistics ***/
+
+static void timing_stats_info_free(pa_timing_stats_info *i) {
+    uint32_t j;
+
+    if (i->histograms) {
+        for (j = 0; j < i->n_histograms; j++)
+            pa_xfree(i->histograms[j].buckets);
+
+        pa_xfree(i->histograms);
+    }
+}
+
+static int fill_timing_histogram(pa_tagstruct *t, pa_timing_histogram *h) {
+    uint32_t j;
+
+    if (pa_tagstruct_gets(t, &h->name) < 0 ||
+        pa_tagstruct_getu64(t, &h->count) < 0 ||
+        pa_tagstruct_get_usec(t, &h->total) < 0 ||
+        pa_tagstruct_get_usec(t, &h->max) < 0 ||
+        pa_tagstruct_getu32(t, &h->n_buckets) < 0 ||
+        !h->name ||
+        h->n_buckets > 64)
+        return -1;
+
+    h->buckets = pa_xnew(uint32_t, h->n_buckets);
+
+    for (j = 0; j < h->n_buckets; j++)
+        if (pa_tagstruct_getu32(t, &h->buckets[j]) < 0)
+            return -1;
+
+    return 0;
+}
+
+static void context_get_timing_stats_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    pa_timing_stats_info i, *p = &i;
+    uint32_t j;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    pa_zero(i);
+
+    if (!o->context)
+        goto finish;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, false) < 0)
+            goto finish;
+
+        p = NULL;
+    } else {
+        if (pa_tagstruct_getu32(t, &i.index) < 0 ||
+            pa_tagstruct_getu32(t, &i.n_histograms) < 0 ||
+            i.n_histograms > 16) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        i.histograms = pa_xnew0(pa_timing_histogram, i.n_histograms);
+
+        for (j = 0; j < i.n_histograms; j++)
+            if (fill_timing_histogram(t, &i.histograms[j]) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+        if (!pa_tagstruct_eof(t)) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+    }
+
+    if (o->callback) {
+        pa_timing_stats_info_cb_t cb = (pa_timing_stats_info_cb_t) o->callback;
+        cb(o->context, p, o->userdata);
+    }
+
+finish:
+    timing_stats_info_free(&i);
+
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+static pa_operation* get_timing_stats(pa_context *c, uint32_t command, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, idx != PA_INVALID_INDEX, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 31, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, command, &tag);
+    pa_tagstruct_putu32(t, idx);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_timing_stats_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
+pa_operation* pa_context_get_sink_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata) {
+    return get_timing_stats(c, PA_COMMAND_GET_SINK_TIMING_INFO, idx, cb, userdata);
+}
+
+pa_operation* pa_context_get_source_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata) {
+    return get_timing_stats(c, PA_COMMAND_GET_SOURCE_TIMING_INFO, idx, cb, userdata);
+}
+
+pa_operation* pa_context_get_sink_input_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata) {
+    return get_timing_stats(c, PA_COMMAND_GET_SINK_INPUT_TIMING_INFO, idx, cb, userdata);
+}
+
+pa_operation* pa_context_get_source_output_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata) {
+    return get_timing_stats(c, PA_COMMAND_GET_SOURCE_OUTPUT_TIMING_INFO, idx, cb, userdata);
+}
+
 /*** Server Info ***/
 
 static void context_get_server_info_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
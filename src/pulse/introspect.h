@@ -683,6 +683,58 @@ pa_operation* pa_context_stat(pa_context *c, pa_stat_info_cb_t cb, void *userdat
 
 /** @} */
 
+/** @{ \name Timing Statistics */
+
+/** A histogram of the time spent in one code path of the daemon's IO
+ * threads. Bucket 0 counts calls that took less than 1 usec, bucket
+ * k > 0 those that took at least 2^(k-1) and less than 2^k usec. The
+ * last bucket also counts everything that took longer. \since 10.0 */
+typedef struct pa_timing_histogram {
+    const char *name;                  /**< Name of the measured code path, e.g. "render" */
+    uint64_t count;                    /**< Number of measurements */
+    pa_usec_t total;                   /**< Sum of all measurements */
+    pa_usec_t max;                     /**< Longest measurement */
+    uint32_t n_buckets;                /**< Number of entries in the buckets array */
+    uint32_t *buckets;                 /**< Number of measurements per bucket */
+} pa_timing_histogram;
+
+/** Timing statistics of a sink, source, sink input or source output,
+ * collected since it was created. Please note that this structure can
+ * be extended as part of evolutionary API updates at any time in any
+ * new release. \since 10.0 */
+typedef struct pa_timing_stats_info {
+    uint32_t index;                    /**< Index of the object */
+    uint32_t n_histograms;             /**< Number of entries in the histograms array */
+    pa_timing_histogram *histograms;   /**< Array of histograms */
+} pa_timing_stats_info;
+
+/** Callback prototype for pa_context_get_sink_timing_stats() and
+ * friends. i is NULL on failure. \since 10.0 */
+typedef void (*pa_timing_stats_info_cb_t) (pa_context *c, const pa_timing_stats_info *i, void *userdata);
+
+/** Get the timing statistics of a sink: "render" is the time spent
+ * rendering, "sleep" the time spent waiting in the IO thread's poll
+ * loop and "late" how late the IO thread woke up for its
+ * timer. \since 10.0 */
+pa_operation* pa_context_get_sink_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata);
+
+/** Get the timing statistics of a source: "post" is the time spent
+ * passing captured data on to the source outputs, "sleep" and "late"
+ * are as for sinks. \since 10.0 */
+pa_operation* pa_context_get_source_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata);
+
+/** Get the timing statistics of a sink input: "peek" is the time
+ * spent producing data for the sink, "resample" the part of it spent
+ * in the resampler. \since 10.0 */
+pa_operation* pa_context_get_sink_input_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata);
+
+/** Get the timing statistics of a source output: "push" is the time
+ * spent handling captured data, "resample" the part of it spent in
+ * the resampler. \since 10.0 */
+pa_operation* pa_context_get_source_output_timing_stats(pa_context *c, uint32_t idx, pa_timing_stats_info_cb_t cb, void *userdata);
+
+/** @} */
+
 /** @{ \name Cached Samples */
 
 /** Stores information about sample cache entries. Please note that this structure
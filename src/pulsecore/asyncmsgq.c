@@ -30,11 +30,15 @@
 #include <pulsecore/log.h>
 #include <pulsecore/semaphore.h>
 #include <pulsecore/macro.h>
-#include <pulsecore/mutex.h>
 #include <pulsecore/flist.h>
 
 #include "asyncmsgq.h"
 
+/* Number of items allocated together with each queue for posted
+ * messages. Only when more messages are in flight, items come from
+ * the global free list or the heap. */
+#define N_ITEMS 64
+
 PA_STATIC_FLIST_DECLARE(asyncmsgq, 0, pa_xfree);
 PA_STATIC_FLIST_DECLARE(semaphores, 0, (void(*)(void*)) pa_semaphore_free);
 
@@ -49,27 +53,61 @@ struct asyncmsgq_item {
     int ret;
 };
 
+/* pa_asyncq is multiple-writer safe by itself, so neither _post nor
+ * _send take a lock, unless the queue overflows. */
 struct pa_asyncmsgq {
     PA_REFCNT_DECLARE;
     pa_asyncq *asyncq;
-    pa_mutex *mutex; /* only for the writer side */
+
+    /* Preallocated items, and the ones of them that are unused */
+    struct asyncmsgq_item *items;
+    pa_flist *free_items;
 
     struct asyncmsgq_item *current;
 };
 
 pa_asyncmsgq *pa_asyncmsgq_new(unsigned size) {
     pa_asyncmsgq *a;
+    unsigned i;
 
     a = pa_xnew(pa_asyncmsgq, 1);
 
     PA_REFCNT_INIT(a);
     pa_assert_se(a->asyncq = pa_asyncq_new(size));
-    pa_assert_se(a->mutex = pa_mutex_new(false, true));
     a->current = NULL;
 
+    a->items = pa_xnew(struct asyncmsgq_item, N_ITEMS);
+    a->free_items = pa_flist_new_with_name(N_ITEMS, "asyncmsgq items");
+
+    for (i = 0; i < N_ITEMS; i++)
+        pa_assert_se(pa_flist_push(a->free_items, &a->items[i]) == 0);
+
     return a;
 }
 
+static struct asyncmsgq_item *item_new(pa_asyncmsgq *a) {
+    struct asyncmsgq_item *i;
+
+    if ((i = pa_flist_pop(a->free_items)))
+        return i;
+
+    if ((i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
+        return i;
+
+    return pa_xnew(struct asyncmsgq_item, 1);
+}
+
+static void item_free(pa_asyncmsgq *a, struct asyncmsgq_item *i) {
+
+    if (i >= a->items && i < a->items + N_ITEMS) {
+        pa_assert_se(pa_flist_push(a->free_items, i) == 0);
+        return;
+    }
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
+        pa_xfree(i);
+}
+
 static void asyncmsgq_free(pa_asyncmsgq *a) {
     struct asyncmsgq_item *i;
     pa_assert(a);
@@ -87,12 +125,12 @@ static void asyncmsgq_free(pa_asyncmsgq *a) {
         if (i->free_cb)
             i->free_cb(i->userdata);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
-            pa_xfree(i);
+        item_free(a, i);
     }
 
     pa_asyncq_free(a->asyncq, NULL);
-    pa_mutex_free(a->mutex);
+    pa_flist_free(a->free_items, NULL);
+    pa_xfree(a->items);
     pa_xfree(a);
 }
 
@@ -114,8 +152,7 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
     struct asyncmsgq_item *i;
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(asyncmsgq))))
-        i = pa_xnew(struct asyncmsgq_item, 1);
+    i = item_new(a);
 
     i->code = code;
     i->object = object ? pa_msgobject_ref(object) : NULL;
@@ -130,10 +167,7 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
         pa_memchunk_reset(&i->memchunk);
     i->semaphore = NULL;
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
     pa_asyncq_post(a->asyncq, i);
-    pa_mutex_unlock(a->mutex);
 }
 
 int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk) {
@@ -155,10 +189,7 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
     if (!(i.semaphore = pa_flist_pop(PA_STATIC_FLIST_GET(semaphores))))
         i.semaphore = pa_semaphore_new(0);
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
     pa_assert_se(pa_asyncq_push(a->asyncq, &i, true) == 0);
-    pa_mutex_unlock(a->mutex);
 
     pa_semaphore_wait(i.semaphore);
 
@@ -222,8 +253,7 @@ void pa_asyncmsgq_done(pa_asyncmsgq *a, int ret) {
         if (a->current->memchunk.memblock)
             pa_memblock_unref(a->current->memchunk.memblock);
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), a->current) < 0)
-            pa_xfree(a->current);
+        item_free(a, a->current);
     }
 
     a->current = NULL;
@@ -26,13 +26,11 @@
 #include <pulsecore/memchunk.h>
 #include <pulsecore/msgobject.h>
 
-/* A simple asynchronous message queue, based on pa_asyncq. In
- * contrast to pa_asyncq this one is multiple-writer safe, though
- * still not multiple-reader safe. This queue is intended to be used
- * for controlling real-time threads from normal-priority
- * threads. Multiple-writer-safety is accomplished by using a mutex on
- * the writer side. This queue is thus not useful for communication
- * between several real-time threads.
+/* A simple asynchronous message queue, based on pa_asyncq. Like
+ * pa_asyncq this one is multiple-writer safe, though still not
+ * multiple-reader safe. This queue is intended to be used for
+ * controlling real-time threads from normal-priority threads. Writers
+ * don't take any locks, unless the queue overflows.
  *
  * The queue takes messages consisting of:
  *    "Object" for which this messages is intended (may be NULL)
@@ -34,6 +34,7 @@
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/mutex.h>
 
 #include "asyncq.h"
 
@@ -55,12 +56,27 @@ struct localq {
     PA_LLIST_FIELDS(struct localq);
 };
 
+/* Every cell carries a sequence number that tells which of the
+ * writers and the reader may use it next: the writer that claimed
+ * index i may fill it when seq == i, the reader may take its data
+ * when seq == i + 1. After reading, seq is set to i + size, handing
+ * the cell to the writer of the next round. */
+struct cell {
+    pa_atomic_t seq;
+    pa_atomic_ptr_t data;
+};
+
 struct pa_asyncq {
     unsigned size;
     unsigned read_idx;
-    unsigned write_idx;
+    pa_atomic_t write_idx;
     pa_fdsem *read_fdsem, *write_fdsem;
 
+    /* Items that didn't fit in the queue when posted. Only touched
+     * with the mutex held, which writers only take when n_localq is
+     * non-zero or the queue is full. */
+    pa_mutex *mutex;
+    pa_atomic_t n_localq;
     PA_LLIST_HEAD(struct localq, localq);
     struct localq *last_localq;
     bool waiting_for_post;
@@ -68,7 +84,7 @@ struct pa_asyncq {
 
 PA_STATIC_FLIST_DECLARE(localq, 0, pa_xfree);
 
-#define PA_ASYNCQ_CELLS(x) ((pa_atomic_ptr_t*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_asyncq))))
+#define PA_ASYNCQ_CELLS(x) ((struct cell*) ((uint8_t*) (x) + PA_ALIGN(sizeof(struct pa_asyncq))))
 
 static unsigned reduce(pa_asyncq *l, unsigned value) {
     return value & (unsigned) (l->size - 1);
@@ -76,16 +92,22 @@ static unsigned reduce(pa_asyncq *l, unsigned value) {
 
 pa_asyncq *pa_asyncq_new(unsigned size) {
     pa_asyncq *l;
+    struct cell *cells;
+    unsigned i;
 
     if (!size)
         size = ASYNCQ_SIZE;
 
     pa_assert(pa_is_power_of_two(size));
 
-    l = pa_xmalloc0(PA_ALIGN(sizeof(pa_asyncq)) + (sizeof(pa_atomic_ptr_t) * size));
+    l = pa_xmalloc0(PA_ALIGN(sizeof(pa_asyncq)) + (sizeof(struct cell) * size));
 
     l->size = size;
 
+    cells = PA_ASYNCQ_CELLS(l);
+    for (i = 0; i < size; i++)
+        pa_atomic_store(&cells[i].seq, (int) i);
+
     PA_LLIST_HEAD_INIT(struct localq, l->localq);
     l->last_localq = NULL;
     l->waiting_for_post = false;
@@ -101,6 +123,8 @@ pa_asyncq *pa_asyncq_new(unsigned size) {
         return NULL;
     }
 
+    l->mutex = pa_mutex_new(false, true);
+
     return l;
 }
 
@@ -125,6 +149,7 @@ void pa_asyncq_free(pa_asyncq *l, pa_free_cb_t free_cb) {
             pa_xfree(q);
     }
 
+    pa_mutex_free(l->mutex);
     pa_fdsem_free(l->read_fdsem);
     pa_fdsem_free(l->write_fdsem);
     pa_xfree(l);
@@ -132,36 +157,57 @@ void pa_asyncq_free(pa_asyncq *l, pa_free_cb_t free_cb) {
 
 static int push(pa_asyncq*l, void *p, bool wait_op) {
     unsigned idx;
-    pa_atomic_ptr_t *cells;
+    struct cell *cells, *c;
+    bool waited = false;
 
     pa_assert(l);
     pa_assert(p);
 
     cells = PA_ASYNCQ_CELLS(l);
 
-    _Y;
-    idx = reduce(l, l->write_idx);
+    for (;;) {
+        int d;
 
-    if (!pa_atomic_ptr_cmpxchg(&cells[idx], NULL, p)) {
+        _Y;
+        idx = (unsigned) pa_atomic_load(&l->write_idx);
+        c = &cells[reduce(l, idx)];
+        d = (int) ((unsigned) pa_atomic_load(&c->seq) - idx);
 
-        if (!wait_op)
-            return -1;
+        if (d == 0) {
+            /* The cell is free, try to claim it */
+            if (pa_atomic_cmpxchg(&l->write_idx, (int) idx, (int) (idx + 1)))
+                break;
 
-/*         pa_log("sleeping on push"); */
+        } else if (d < 0) {
+            /* The reader hasn't taken the item of the last round yet,
+             * so the queue is full */
+            if (!wait_op)
+                return -1;
+
+/*             pa_log("sleeping on push"); */
 
-        do {
             pa_fdsem_wait(l->read_fdsem);
-        } while (!pa_atomic_ptr_cmpxchg(&cells[idx], NULL, p));
+            waited = true;
+        }
+
+        /* Otherwise another writer claimed this cell in the meantime */
     }
 
     _Y;
-    l->write_idx++;
+    pa_atomic_ptr_store(&c->data, p);
+    pa_atomic_store(&c->seq, (int) (idx + 1));
 
     pa_fdsem_post(l->write_fdsem);
 
+    /* The reader wakes up only one of the writers that wait for space
+     * in the queue, so pass the wakeup on to the next one */
+    if (waited)
+        pa_fdsem_post(l->read_fdsem);
+
     return 0;
 }
 
+/* Called with the mutex held */
 static bool flush_postq(pa_asyncq *l, bool wait_op) {
     struct localq *q;
 
@@ -175,6 +221,7 @@ static bool flush_postq(pa_asyncq *l, bool wait_op) {
         l->last_localq = q->prev;
 
         PA_LLIST_REMOVE(struct localq, l->localq, q);
+        pa_atomic_dec(&l->n_localq);
 
         if (pa_flist_push(PA_STATIC_FLIST_GET(localq), q) < 0)
             pa_xfree(q);
@@ -184,12 +231,24 @@ static bool flush_postq(pa_asyncq *l, bool wait_op) {
 }
 
 int pa_asyncq_push(pa_asyncq*l, void *p, bool wait_op) {
+    int r;
+
     pa_assert(l);
 
-    if (!flush_postq(l, wait_op))
-        return -1;
+    /* Items queued locally earlier have to go first */
+    if (PA_LIKELY(pa_atomic_load(&l->n_localq) == 0))
+        return push(l, p, wait_op);
+
+    pa_mutex_lock(l->mutex);
 
-    return push(l, p, wait_op);
+    if (flush_postq(l, wait_op))
+        r = push(l, p, wait_op);
+    else
+        r = -1;
+
+    pa_mutex_unlock(l->mutex);
+
+    return r;
 }
 
 void pa_asyncq_post(pa_asyncq*l, void *p) {
@@ -198,9 +257,17 @@ void pa_asyncq_post(pa_asyncq*l, void *p) {
     pa_assert(l);
     pa_assert(p);
 
+    if (PA_LIKELY(pa_atomic_load(&l->n_localq) == 0))
+        if (push(l, p, false) >= 0)
+            return;
+
+    pa_mutex_lock(l->mutex);
+
     if (flush_postq(l, false))
-        if (pa_asyncq_push(l, p, false) >= 0)
+        if (push(l, p, false) >= 0) {
+            pa_mutex_unlock(l->mutex);
             return;
+        }
 
     /* OK, we couldn't push anything in the queue. So let's queue it
      * locally and push it later */
@@ -213,26 +280,26 @@ void pa_asyncq_post(pa_asyncq*l, void *p) {
 
     q->data = p;
     PA_LLIST_PREPEND(struct localq, l->localq, q);
+    pa_atomic_inc(&l->n_localq);
 
     if (!l->last_localq)
         l->last_localq = q;
 
-    return;
+    pa_mutex_unlock(l->mutex);
 }
 
 void* pa_asyncq_pop(pa_asyncq*l, bool wait_op) {
-    unsigned idx;
     void *ret;
-    pa_atomic_ptr_t *cells;
+    struct cell *c;
 
     pa_assert(l);
 
-    cells = PA_ASYNCQ_CELLS(l);
-
     _Y;
-    idx = reduce(l, l->read_idx);
+    c = &PA_ASYNCQ_CELLS(l)[reduce(l, l->read_idx)];
 
-    if (!(ret = pa_atomic_ptr_load(&cells[idx]))) {
+    /* The writer that claimed this cell might not have filled it yet,
+     * even if later cells are already filled. */
+    if ((unsigned) pa_atomic_load(&c->seq) != l->read_idx + 1) {
 
         if (!wait_op)
             return NULL;
@@ -241,13 +308,14 @@ void* pa_asyncq_pop(pa_asyncq*l, bool wait_op) {
 
         do {
             pa_fdsem_wait(l->write_fdsem);
-        } while (!(ret = pa_atomic_ptr_load(&cells[idx])));
+        } while ((unsigned) pa_atomic_load(&c->seq) != l->read_idx + 1);
     }
 
+    ret = pa_atomic_ptr_load(&c->data);
     pa_assert(ret);
 
-    /* Guaranteed to succeed if we only have a single reader */
-    pa_assert_se(pa_atomic_ptr_cmpxchg(&cells[idx], ret, NULL));
+    /* Hand the cell over to the writer of the next round */
+    pa_atomic_store(&c->seq, (int) (l->read_idx + l->size));
 
     _Y;
     l->read_idx++;
@@ -264,18 +332,15 @@ int pa_asyncq_read_fd(pa_asyncq *q) {
 }
 
 int pa_asyncq_read_before_poll(pa_asyncq *l) {
-    unsigned idx;
-    pa_atomic_ptr_t *cells;
+    struct cell *c;
 
     pa_assert(l);
 
-    cells = PA_ASYNCQ_CELLS(l);
-
     _Y;
-    idx = reduce(l, l->read_idx);
+    c = &PA_ASYNCQ_CELLS(l)[reduce(l, l->read_idx)];
 
     for (;;) {
-        if (pa_atomic_ptr_load(&cells[idx]))
+        if ((unsigned) pa_atomic_load(&c->seq) == l->read_idx + 1)
             return -1;
 
         if (pa_fdsem_before_poll(l->write_fdsem) >= 0)
@@ -299,8 +364,16 @@ void pa_asyncq_write_before_poll(pa_asyncq *l) {
     pa_assert(l);
 
     for (;;) {
+        bool flushed;
+
+        if (pa_atomic_load(&l->n_localq) == 0)
+            break;
+
+        pa_mutex_lock(l->mutex);
+        flushed = flush_postq(l, false);
+        pa_mutex_unlock(l->mutex);
 
-        if (flush_postq(l, false))
+        if (flushed)
             break;
 
         if (pa_fdsem_before_poll(l->read_fdsem) >= 0) {
@@ -25,11 +25,12 @@
 #include <pulsecore/macro.h>
 
 /* A simple, asynchronous, lock-free (if requested also wait-free)
- * queue. Not multiple-reader/multiple-writer safe. If that is
- * required both sides can be protected by a mutex each. --- Which is
- * not a bad thing in most cases, since this queue is intended for
- * communication between a normal thread and a single real-time
- * thread. Only the real-time side needs to be lock-free/wait-free.
+ * queue. Multiple writers may push and post concurrently, but there
+ * may be only one reader at a time. If multiple readers are required
+ * the reading side can be protected by a mutex. --- This queue is
+ * intended for communication between normal threads and a single
+ * real-time thread. Only the real-time side needs to be
+ * lock-free/wait-free.
  *
  * If the queue is full and another entry shall be pushed, or when the
  * queue is empty and another entry shall be popped and the "wait"
@@ -48,7 +49,8 @@ int pa_asyncq_push(pa_asyncq *q, void *p, bool wait);
 
 /* Similar to pa_asyncq_push(), but if the queue is full, postpone the
  * appending of the item locally and delay until
- * pa_asyncq_before_poll_post() is called. */
+ * pa_asyncq_write_before_poll() is called or the next item is pushed
+ * or posted. Only this overflow path takes a lock. */
 void pa_asyncq_post(pa_asyncq*l, void *p);
 
 /* For the reading side */
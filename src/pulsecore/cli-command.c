@@ -90,6 +90,7 @@ static int pa_cli_command_sources(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, b
 static int pa_cli_command_sink_inputs(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_source_outputs(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
+static int pa_cli_command_timing(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_info(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_load(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
 static int pa_cli_command_unload(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail);
@@ -150,6 +151,7 @@ static const struct command commands[] = {
     { "list-sink-inputs",        pa_cli_command_sink_inputs,        "List sink inputs",             1 },
     { "list-source-outputs",     pa_cli_command_source_outputs,     "List source outputs",          1 },
     { "stat",                    pa_cli_command_stat,               "Show memory block statistics", 1 },
+    { "list-timing",             pa_cli_command_timing,             "Show timing statistics of the IO threads", 1 },
     { "info",                    pa_cli_command_info,               "Show comprehensive status",    1 },
     { "ls",                      pa_cli_command_info,               NULL,                           1 },
     { "list",                    pa_cli_command_info,               NULL,                           1 },
@@ -342,10 +344,24 @@ static int pa_cli_command_source_outputs(pa_core *c, pa_tokenizer *t, pa_strbuf
     return 0;
 }
 
+static int pa_cli_command_timing(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail) {
+    char *s;
+
+    pa_core_assert_ref(c);
+    pa_assert(t);
+    pa_assert(buf);
+    pa_assert(fail);
+
+    pa_assert_se(s = pa_timing_list_to_string(c));
+    pa_strbuf_puts(buf, s);
+    pa_xfree(s);
+    return 0;
+}
+
 static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool *fail) {
     char ss[PA_SAMPLE_SPEC_SNPRINT_MAX];
     char cm[PA_CHANNEL_MAP_SNPRINT_MAX];
-    char bytes[PA_BYTES_SNPRINT_MAX];
+    char bytes[PA_BYTES_SNPRINT_MAX], bytes2[PA_BYTES_SNPRINT_MAX];
     const pa_mempool_stat *mstat;
     unsigned k;
     pa_sink *def_sink;
@@ -383,6 +399,17 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, bool
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Memory pool segments: %u, size: %s, slots in use: %u, size: %s.\n",
+                     (unsigned) pa_atomic_load(&mstat->n_segments),
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->pool_size)),
+                     (unsigned) pa_atomic_load(&mstat->n_used_slots),
+                     pa_bytes_snprint(bytes2, sizeof(bytes2), (unsigned) pa_atomic_load(&mstat->used_slots_size)));
+
+    pa_strbuf_printf(buf, "Memory blocks allocated outside of the pool: %u (pool full: %u, too large: %u).\n",
+                     (unsigned) pa_atomic_load(&mstat->n_fallback),
+                     (unsigned) pa_atomic_load(&mstat->n_pool_full),
+                     (unsigned) pa_atomic_load(&mstat->n_too_large_for_pool));
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
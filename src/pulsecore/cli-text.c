@@ -715,6 +715,87 @@ char *pa_scache_list_to_string(pa_core *c) {
     return pa_strbuf_to_string_free(s);
 }
 
+static void append_histogram(pa_strbuf *s, const char *name, const pa_histogram *h) {
+    char *t;
+
+    t = pa_histogram_to_string(h);
+    pa_strbuf_printf(s, "\t%s: %s\n", name, t);
+    pa_xfree(t);
+}
+
+char *pa_timing_list_to_string(pa_core *c) {
+    pa_strbuf *s;
+    pa_sink *sink;
+    pa_source *source;
+    pa_sink_input *i;
+    pa_source_output *o;
+    uint32_t idx;
+
+    pa_assert(c);
+    s = pa_strbuf_new();
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        pa_sink_timing t;
+
+        if (!PA_SINK_IS_LINKED(sink->state))
+            continue;
+
+        pa_sink_get_timing(sink, &t);
+
+        pa_strbuf_printf(s, "sink #%u <%s>\n", sink->index, sink->name);
+        append_histogram(s, "render", &t.render);
+        pa_strbuf_printf(s, "\tsilence skipped: %llu of %llu bytes\n",
+                         (unsigned long long) t.render_silence_bytes, (unsigned long long) t.render_bytes);
+        pa_strbuf_printf(s, "\tformat conversions: %llu samples, %llu per render\n",
+                         (unsigned long long) t.converted_samples,
+                         (unsigned long long) (t.render.count > 0 ? t.converted_samples / t.render.count : 0));
+        append_histogram(s, "sleep", &t.sleep);
+        append_histogram(s, "late", &t.late);
+    }
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        pa_source_timing t;
+
+        if (!PA_SOURCE_IS_LINKED(source->state))
+            continue;
+
+        pa_source_get_timing(source, &t);
+
+        pa_strbuf_printf(s, "source #%u <%s>\n", source->index, source->name);
+        append_histogram(s, "post", &t.post);
+        append_histogram(s, "sleep", &t.sleep);
+        append_histogram(s, "late", &t.late);
+    }
+
+    PA_IDXSET_FOREACH(i, c->sink_inputs, idx) {
+        pa_sink_input_timing t;
+
+        if (!PA_SINK_INPUT_IS_LINKED(i->state))
+            continue;
+
+        pa_sink_input_get_timing(i, &t);
+
+        pa_strbuf_printf(s, "sink input #%u\n", i->index);
+        append_histogram(s, "peek", &t.peek);
+        append_histogram(s, "resample", &t.resample);
+    }
+
+    PA_IDXSET_FOREACH(o, c->source_outputs, idx) {
+        pa_source_output_timing t;
+
+        if (!PA_SOURCE_OUTPUT_IS_LINKED(o->state))
+            continue;
+
+        pa_source_output_get_timing(o, &t);
+
+        pa_strbuf_printf(s, "source output #%u\n", o->index);
+        append_histogram(s, "push", &t.push);
+        append_histogram(s, "resample", &t.resample);
+    }
+
+    return pa_strbuf_to_string_free(s);
+}
+
 char *pa_full_status_string(pa_core *c) {
     pa_strbuf *s;
     int i;
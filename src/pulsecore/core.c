@@ -137,6 +137,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, size_t shm_size) {
     c->scache_idle_time = 20;
 
     c->flat_volumes = true;
+    c->float_processing = false;
     c->disallow_module_loading = false;
     c->disallow_exit = false;
     c->running_as_daemon = false;
@@ -145,6 +146,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, size_t shm_size) {
     c->disable_remixing = false;
     c->disable_lfe_remixing = false;
     c->lfe_crossover_freq = 120;
+    c->render_threads = 0;
     c->deferred_volume = true;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
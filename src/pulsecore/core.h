@@ -170,6 +170,7 @@ struct pa_core {
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
     unsigned lfe_crossover_freq;
+    unsigned render_threads;
 
     pa_defer_event *module_defer_unload_event;
     pa_hashmap *modules_pending_unload; /* pa_module -> pa_module (hashmap-as-a-set) */
@@ -191,6 +192,7 @@ struct pa_core {
     int exit_idle_time, scache_idle_time;
 
     bool flat_volumes:1;
+    bool float_processing:1;
     bool disallow_module_loading:1;
     bool disallow_exit:1;
     bool running_as_daemon:1;
@@ -0,0 +1,547 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "convolver.h"
+
+/* Spectra are stored as n_bins real parts followed by n_bins
+ * imaginary parts */
+
+struct pa_convolver {
+    unsigned block_size;
+    unsigned n_bins;
+    unsigned n_inputs, n_outputs;
+    unsigned ir_length;
+    unsigned n_partitions;
+
+    /* Tables for the complex FFT of block_size points that the real
+     * FFT of 2 * block_size points is built on */
+    unsigned *bitrev;
+    float *cos_table, *sin_table;
+    /* exp(-i*pi*k/block_size), k = 0..block_size */
+    float *w_re, *w_im;
+
+    /* Spectra of the impulse response partitions, indexed by
+     * (input * n_outputs + output) * n_partitions + partition */
+    float *filter;
+
+    /* Spectra of the last n_partitions complete input windows of each
+     * input, indexed by input * n_partitions + block % n_partitions */
+    float *fdl;
+
+    /* For every output, the contribution of all partitions but the
+     * first to the current block */
+    float *tail;
+
+    /* While crossfading, the impulse responses being faded out and
+     * their tail, laid out like filter and tail. The fade runs from
+     * frame position fade_start over fade_length frames. */
+    float *old_filter, *old_tail;
+    bool fading;
+    int64_t fade_start;
+    unsigned fade_length;
+
+    /* Past input, per channel, as a ring buffer of hist_size frames
+     * indexed by absolute frame position. Input before position
+     * hist_start has been lost. */
+    float *history;
+    size_t hist_size;
+    int64_t hist_start;
+    int64_t pos;
+
+    /* Scratch buffers */
+    float *window;
+    float *spectrum;
+    float *acc;
+    float *fade;
+    float *z_re, *z_im;
+};
+
+static void fft(const pa_convolver *c, float *re, float *im) {
+    unsigned n = c->block_size, size, i, j;
+
+    for (i = 0; i < n; i++) {
+        j = c->bitrev[i];
+        if (j > i) {
+            float t;
+
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (size = 2; size <= n; size *= 2) {
+        unsigned half = size / 2, step = n / size;
+
+        for (j = 0; j < half; j++) {
+            float wr = c->cos_table[j * step], wi = -c->sin_table[j * step];
+
+            for (i = j; i < n; i += size) {
+                unsigned k = i + half;
+                float tr = re[k] * wr - im[k] * wi;
+                float ti = re[k] * wi + im[k] * wr;
+
+                re[k] = re[i] - tr;
+                im[k] = im[i] - ti;
+                re[i] += tr;
+                im[i] += ti;
+            }
+        }
+    }
+}
+
+/* Real FFT of 2 * block_size points, from c->window to spectrum */
+static void rfft(const pa_convolver *c, float *spectrum) {
+    unsigned n = c->block_size, k;
+    float *x_re = spectrum, *x_im = spectrum + c->n_bins;
+
+    for (k = 0; k < n; k++) {
+        c->z_re[k] = c->window[2 * k];
+        c->z_im[k] = c->window[2 * k + 1];
+    }
+
+    fft(c, c->z_re, c->z_im);
+
+    /* Separate the transforms of the even and odd samples and combine
+     * them into the first half of the spectrum */
+    for (k = 0; k <= n; k++) {
+        unsigned a = k % n, b = (n - k) % n;
+        float e_re = 0.5f * (c->z_re[a] + c->z_re[b]);
+        float e_im = 0.5f * (c->z_im[a] - c->z_im[b]);
+        float o_re = 0.5f * (c->z_im[a] + c->z_im[b]);
+        float o_im = -0.5f * (c->z_re[a] - c->z_re[b]);
+
+        x_re[k] = e_re + c->w_re[k] * o_re - c->w_im[k] * o_im;
+        x_im[k] = e_im + c->w_re[k] * o_im + c->w_im[k] * o_re;
+    }
+}
+
+/* Inverse of rfft(), from spectrum to c->window, scaled by
+ * 2 * block_size */
+static void irfft(const pa_convolver *c, const float *spectrum) {
+    unsigned n = c->block_size, k;
+    const float *x_re = spectrum, *x_im = spectrum + c->n_bins;
+
+    for (k = 0; k < n; k++) {
+        float e_re = x_re[k] + x_re[n - k];
+        float e_im = x_im[k] - x_im[n - k];
+        float d_re = x_re[k] - x_re[n - k];
+        float d_im = x_im[k] + x_im[n - k];
+        float o_re = d_re * c->w_re[k] + d_im * c->w_im[k];
+        float o_im = d_im * c->w_re[k] - d_re * c->w_im[k];
+
+        c->z_re[k] = e_re - o_im;
+        c->z_im[k] = e_im + o_re;
+    }
+
+    /* Inverse transform by swapping real and imaginary parts */
+    fft(c, c->z_im, c->z_re);
+
+    for (k = 0; k < n; k++) {
+        c->window[2 * k] = c->z_re[k];
+        c->window[2 * k + 1] = c->z_im[k];
+    }
+}
+
+static void mac(float *acc, const float *x, const float *h, unsigned n_bins) {
+    const float *x_re = x, *x_im = x + n_bins, *h_re = h, *h_im = h + n_bins;
+    float *a_re = acc, *a_im = acc + n_bins;
+    unsigned k;
+
+    for (k = 0; k < n_bins; k++) {
+        a_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        a_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+static float *filter_spectrum(const pa_convolver *c, float *filter, unsigned input, unsigned output, unsigned partition) {
+    return filter + (((size_t) input * c->n_outputs + output) * c->n_partitions + partition) * 2 * c->n_bins;
+}
+
+static size_t filter_length(const pa_convolver *c) {
+    return (size_t) c->n_inputs * c->n_outputs * c->n_partitions * 2 * c->n_bins;
+}
+
+/* Weight of the new impulse responses at frame position pos */
+static float fade_gain(const pa_convolver *c, int64_t pos) {
+    if (pos <= c->fade_start)
+        return 0.0f;
+
+    if (pos >= c->fade_start + c->fade_length)
+        return 1.0f;
+
+    return 0.5f - 0.5f * cosf((float) M_PI * (pos - c->fade_start) / c->fade_length);
+}
+
+static float *fdl_spectrum(const pa_convolver *c, unsigned input, int64_t block) {
+    return c->fdl + ((size_t) input * c->n_partitions + (size_t) (block % c->n_partitions)) * 2 * c->n_bins;
+}
+
+/* Fill c->window with the input window ending with the block at
+ * position start + block_size, zero padded after position end */
+static void load_window(const pa_convolver *c, unsigned input, int64_t start, int64_t end) {
+    const float *h = c->history + (size_t) input * c->hist_size;
+    unsigned k;
+
+    for (k = 0; k < 2 * c->block_size; k++) {
+        int64_t p = start + k;
+
+        c->window[k] = (p >= 0 && p < end) ? h[p % (int64_t) c->hist_size] : 0.0f;
+    }
+}
+
+static void compute_tail(pa_convolver *c, float *filter, float *tail) {
+    int64_t block = c->pos / c->block_size;
+    unsigned input, output, p;
+
+    memset(tail, 0, sizeof(float) * 2 * c->n_bins * c->n_outputs);
+
+    for (p = 1; p < c->n_partitions && block - p >= 0; p++)
+        for (input = 0; input < c->n_inputs; input++)
+            for (output = 0; output < c->n_outputs; output++)
+                mac(tail + (size_t) output * 2 * c->n_bins,
+                    fdl_spectrum(c, input, block - p),
+                    filter_spectrum(c, filter, input, output, p),
+                    c->n_bins);
+}
+
+/* Recompute the contribution of the older partitions for the block
+ * starting at c->pos */
+static void update_tail(pa_convolver *c) {
+    compute_tail(c, c->filter, c->tail);
+
+    if (c->fading)
+        compute_tail(c, c->old_filter, c->old_tail);
+}
+
+/* Run the first partition of the given impulse responses over the
+ * transformed input in c->spectrum, leaving the output of the current
+ * block in the second half of c->window */
+static void convolve_block(pa_convolver *c, float *filter, const float *tail, unsigned output) {
+    unsigned input;
+
+    memcpy(c->acc, tail + (size_t) output * 2 * c->n_bins, sizeof(float) * 2 * c->n_bins);
+
+    for (input = 0; input < c->n_inputs; input++)
+        mac(c->acc, c->spectrum + (size_t) input * 2 * c->n_bins, filter_spectrum(c, filter, input, output, 0), c->n_bins);
+
+    irfft(c, c->acc);
+}
+
+pa_convolver *pa_convolver_new(unsigned block_size, unsigned n_inputs, unsigned n_outputs, unsigned ir_length) {
+    pa_convolver *c;
+    unsigned i, bits;
+
+    pa_assert(block_size >= 2);
+    pa_assert((block_size & (block_size - 1)) == 0);
+    pa_assert(n_inputs > 0);
+    pa_assert(n_outputs > 0);
+    pa_assert(ir_length > 0);
+
+    c = pa_xnew0(pa_convolver, 1);
+    c->block_size = block_size;
+    c->n_bins = block_size + 1;
+    c->n_inputs = n_inputs;
+    c->n_outputs = n_outputs;
+    c->ir_length = ir_length;
+    c->n_partitions = (ir_length + block_size - 1) / block_size;
+
+    for (bits = 0; (1U << bits) < block_size; bits++)
+        ;
+
+    c->bitrev = pa_xnew(unsigned, block_size);
+    for (i = 0; i < block_size; i++) {
+        unsigned j, r = 0;
+
+        for (j = 0; j < bits; j++)
+            if (i & (1U << j))
+                r |= 1U << (bits - 1 - j);
+
+        c->bitrev[i] = r;
+    }
+
+    c->cos_table = pa_xnew(float, block_size / 2);
+    c->sin_table = pa_xnew(float, block_size / 2);
+    for (i = 0; i < block_size / 2; i++) {
+        c->cos_table[i] = (float) cos(2 * M_PI * i / block_size);
+        c->sin_table[i] = (float) sin(2 * M_PI * i / block_size);
+    }
+
+    c->w_re = pa_xnew(float, block_size + 1);
+    c->w_im = pa_xnew(float, block_size + 1);
+    for (i = 0; i <= block_size; i++) {
+        c->w_re[i] = (float) cos(M_PI * i / block_size);
+        c->w_im[i] = (float) -sin(M_PI * i / block_size);
+    }
+
+    c->filter = pa_xnew0(float, (size_t) n_inputs * n_outputs * c->n_partitions * 2 * c->n_bins);
+    c->fdl = pa_xnew0(float, (size_t) n_inputs * c->n_partitions * 2 * c->n_bins);
+    c->tail = pa_xnew0(float, (size_t) n_outputs * 2 * c->n_bins);
+    c->old_filter = pa_xnew0(float, filter_length(c));
+    c->old_tail = pa_xnew0(float, (size_t) n_outputs * 2 * c->n_bins);
+
+    c->window = pa_xnew(float, 2 * block_size);
+    c->spectrum = pa_xnew(float, (size_t) n_inputs * 2 * c->n_bins);
+    c->acc = pa_xnew(float, 2 * c->n_bins);
+    c->fade = pa_xnew(float, block_size);
+    c->z_re = pa_xnew(float, block_size);
+    c->z_im = pa_xnew(float, block_size);
+
+    pa_convolver_set_max_rewind(c, 0);
+
+    return c;
+}
+
+void pa_convolver_free(pa_convolver *c) {
+    pa_assert(c);
+
+    pa_xfree(c->bitrev);
+    pa_xfree(c->cos_table);
+    pa_xfree(c->sin_table);
+    pa_xfree(c->w_re);
+    pa_xfree(c->w_im);
+    pa_xfree(c->filter);
+    pa_xfree(c->fdl);
+    pa_xfree(c->tail);
+    pa_xfree(c->old_filter);
+    pa_xfree(c->old_tail);
+    pa_xfree(c->history);
+    pa_xfree(c->window);
+    pa_xfree(c->spectrum);
+    pa_xfree(c->acc);
+    pa_xfree(c->fade);
+    pa_xfree(c->z_re);
+    pa_xfree(c->z_im);
+    pa_xfree(c);
+}
+
+void pa_convolver_set_ir(pa_convolver *c, unsigned input, unsigned output, const float *ir, size_t stride) {
+    unsigned p, k;
+    const float scale = 1.0f / (2 * c->block_size);
+
+    pa_assert(c);
+    pa_assert(input < c->n_inputs);
+    pa_assert(output < c->n_outputs);
+    pa_assert(ir);
+
+    for (p = 0; p < c->n_partitions; p++) {
+        float *h = filter_spectrum(c, c->filter, input, output, p);
+
+        /* The scale of irfft() is folded into the filter */
+        memset(c->window, 0, sizeof(float) * 2 * c->block_size);
+        for (k = 0; k < c->block_size && p * c->block_size + k < c->ir_length; k++)
+            c->window[k] = ir[(p * c->block_size + k) * stride] * scale;
+
+        rfft(c, h);
+    }
+
+    update_tail(c);
+}
+
+void pa_convolver_crossfade(pa_convolver *c, unsigned n_frames) {
+    size_t i, n;
+
+    pa_assert(c);
+
+    if (n_frames == 0) {
+        c->fading = false;
+        return;
+    }
+
+    n = filter_length(c);
+
+    if (c->fading) {
+        /* Mid-fade the output is a mix of both sets of responses, and
+         * since they are applied to the same input that mix is itself
+         * a set of responses. Fade out from exactly that. */
+        float g = fade_gain(c, c->pos);
+
+        for (i = 0; i < n; i++)
+            c->old_filter[i] += g * (c->filter[i] - c->old_filter[i]);
+    } else
+        memcpy(c->old_filter, c->filter, sizeof(float) * n);
+
+    c->fading = true;
+    c->fade_start = c->pos;
+    c->fade_length = n_frames;
+
+    update_tail(c);
+}
+
+void pa_convolver_reset(pa_convolver *c) {
+    pa_assert(c);
+
+    c->fading = false;
+    c->pos = 0;
+    c->hist_start = 0;
+    memset(c->history, 0, sizeof(float) * c->hist_size * c->n_inputs);
+    memset(c->fdl, 0, sizeof(float) * c->n_inputs * c->n_partitions * 2 * c->n_bins);
+    memset(c->tail, 0, sizeof(float) * c->n_outputs * 2 * c->n_bins);
+}
+
+void pa_convolver_set_max_rewind(pa_convolver *c, size_t n_frames) {
+    size_t hist_size, keep, input;
+    float *history;
+    int64_t p;
+
+    pa_assert(c);
+
+    /* Rebuilding the state after a rewind needs the windows of all
+     * partitions before the new position */
+    hist_size = 1;
+    while (hist_size < n_frames + (size_t) (c->n_partitions + 1) * c->block_size)
+        hist_size *= 2;
+
+    if (hist_size == c->hist_size)
+        return;
+
+    history = pa_xnew0(float, hist_size * c->n_inputs);
+
+    if (c->history) {
+        keep = PA_MIN(hist_size, c->hist_size);
+        keep = PA_MIN(keep, (size_t) c->pos);
+
+        for (input = 0; input < c->n_inputs; input++)
+            for (p = c->pos - (int64_t) keep; p < c->pos; p++)
+                history[input * hist_size + (size_t) (p % (int64_t) hist_size)] =
+                    c->history[input * c->hist_size + (size_t) (p % (int64_t) c->hist_size)];
+
+        pa_xfree(c->history);
+
+        c->hist_start = PA_MAX(c->hist_start, c->pos - (int64_t) keep);
+    }
+
+    c->history = history;
+    c->hist_size = hist_size;
+}
+
+void pa_convolver_rewind(pa_convolver *c, size_t n_frames) {
+    int64_t block, b, oldest;
+    unsigned input;
+
+    pa_assert(c);
+
+    if (n_frames == 0)
+        return;
+
+    if ((int64_t) n_frames > c->pos) {
+        pa_convolver_reset(c);
+        return;
+    }
+
+    /* Rebuilding the state needs the windows of all partitions before
+     * the new position */
+    block = (c->pos - (int64_t) n_frames) / c->block_size;
+    oldest = PA_MAX((block - (int64_t) c->n_partitions) * c->block_size, 0);
+
+    if (oldest < c->hist_start || oldest < c->pos - (int64_t) c->hist_size) {
+        pa_log_debug("Rewinding further than the input history, resetting.");
+        pa_convolver_reset(c);
+        return;
+    }
+
+    c->pos -= n_frames;
+
+    /* Recompute the spectra of the complete blocks before the new
+     * position from the input history */
+
+    for (b = PA_MAX(block - (int64_t) c->n_partitions + 1, 0); b < block; b++)
+        for (input = 0; input < c->n_inputs; input++) {
+            load_window(c, input, (b - 1) * c->block_size, (b + 1) * c->block_size);
+            rfft(c, fdl_spectrum(c, input, b));
+        }
+
+    update_tail(c);
+}
+
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    pa_assert(c);
+    pa_assert(src);
+    pa_assert(dst);
+
+    while (n_frames > 0) {
+        int64_t block = c->pos / c->block_size;
+        unsigned offset = (unsigned) (c->pos % c->block_size);
+        unsigned n = PA_MIN(n_frames, c->block_size - offset);
+        unsigned input, output, k;
+
+        /* Append the new frames to the history */
+        for (input = 0; input < c->n_inputs; input++) {
+            float *h = c->history + (size_t) input * c->hist_size;
+
+            for (k = 0; k < n; k++)
+                h[(size_t) ((c->pos + k) % (int64_t) c->hist_size)] = src[k * c->n_inputs + input];
+        }
+
+        c->pos += n;
+
+        /* Transform the window ending with the current, possibly
+         * incomplete, block */
+        for (input = 0; input < c->n_inputs; input++) {
+            load_window(c, input, (block - 1) * c->block_size, c->pos);
+            rfft(c, c->spectrum + (size_t) input * 2 * c->n_bins);
+        }
+
+        for (output = 0; output < c->n_outputs; output++) {
+            if (c->fading) {
+                convolve_block(c, c->old_filter, c->old_tail, output);
+                memcpy(c->fade, c->window + c->block_size + offset, sizeof(float) * n);
+            }
+
+            convolve_block(c, c->filter, c->tail, output);
+
+            for (k = 0; k < n; k++)
+                dst[k * c->n_outputs + output] = c->window[c->block_size + offset + k];
+
+            if (c->fading)
+                for (k = 0; k < n; k++) {
+                    float g = fade_gain(c, c->pos - n + k);
+                    float *d = dst + k * c->n_outputs + output;
+
+                    *d = c->fade[k] + g * (*d - c->fade[k]);
+                }
+        }
+
+        if (c->fading && c->pos >= c->fade_start + c->fade_length)
+            c->fading = false;
+
+        /* Once the block is complete, move it into the delay line */
+        if (offset + n == c->block_size) {
+            for (input = 0; input < c->n_inputs; input++)
+                memcpy(fdl_spectrum(c, input, block), c->spectrum + (size_t) input * 2 * c->n_bins,
+                       sizeof(float) * 2 * c->n_bins);
+
+            update_tail(c);
+        }
+
+        src += n * c->n_inputs;
+        dst += n * c->n_outputs;
+        n_frames -= n;
+    }
+}
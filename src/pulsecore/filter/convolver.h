@@ -0,0 +1,70 @@
+#ifndef fooconvolverhfoo
+#define fooconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+
+/* A multi-channel FIR filter using uniformly partitioned overlap-save
+ * FFT convolution. Every output channel is the sum of all input
+ * channels, each convolved with its own impulse response.
+ *
+ * The impulse responses are split into partitions of block_size
+ * samples. The input block currently being filled is convolved with
+ * the first partition every time pa_convolver_process() is called,
+ * so the output is available immediately and there is no added
+ * latency. The cost per block is one FFT per input channel and one
+ * inverse FFT per output channel, plus a complex multiply-add per
+ * input/output pair and partition.
+ *
+ * Input and output are interleaved float samples. */
+
+typedef struct pa_convolver pa_convolver;
+
+/* block_size must be a power of two. All impulse responses are zero
+ * until set. */
+pa_convolver *pa_convolver_new(unsigned block_size, unsigned n_inputs, unsigned n_outputs, unsigned ir_length);
+void pa_convolver_free(pa_convolver *c);
+
+/* Set the impulse response from the given input to the given output.
+ * ir[k * stride] is tap k, for k < ir_length. */
+void pa_convolver_set_ir(pa_convolver *c, unsigned input, unsigned output, const float *ir, size_t stride);
+
+/* Fade from the current impulse responses to the ones set with
+ * pa_convolver_set_ir() after this call, over the next n_frames
+ * frames. Both sets are applied to the same input history while the
+ * fade lasts, so the switch neither clicks nor restarts the filter
+ * from silence. Starting a new fade while one is running fades out
+ * from the current mix. If n_frames is 0, any running fade is
+ * dropped and the responses set afterwards apply immediately. */
+void pa_convolver_crossfade(pa_convolver *c, unsigned n_frames);
+
+/* Forget all past input */
+void pa_convolver_reset(pa_convolver *c);
+
+/* Keep enough past input around to rewind by up to n_frames frames */
+void pa_convolver_set_max_rewind(pa_convolver *c, size_t n_frames);
+
+/* Go back n_frames frames of input, as if the last n_frames frames
+ * passed to pa_convolver_process() had never been seen. Resets the
+ * convolver if the input history doesn't reach back that far. */
+void pa_convolver_rewind(pa_convolver *c, size_t n_frames);
+
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames);
+
+#endif
@@ -0,0 +1,91 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <fftw3.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+
+#include "fir-design.h"
+
+struct pa_fir_design {
+    size_t fft_size;
+    size_t length;
+
+    float *window;
+    float *impulse;
+    fftwf_complex *spectrum;
+    fftwf_plan plan;
+};
+
+pa_fir_design *pa_fir_design_new(size_t fft_size, size_t length) {
+    pa_fir_design *d;
+    size_t i, half = length / 2;
+
+    pa_assert(length % 2 == 1);
+    pa_assert(length <= fft_size);
+
+    d = pa_xnew0(pa_fir_design, 1);
+    d->fft_size = fft_size;
+    d->length = length;
+
+    d->window = pa_xnew(float, length);
+    for (i = 0; i < length; i++)
+        d->window[i] = (float) (.5 * (1 + cos(M_PI * ((double) i - half) / (half + 1))));
+
+    pa_assert_se(d->impulse = fftwf_malloc(fft_size * sizeof(float)));
+    pa_assert_se(d->spectrum = fftwf_malloc((fft_size / 2 + 1) * sizeof(fftwf_complex)));
+    d->plan = fftwf_plan_dft_c2r_1d((int) fft_size, d->spectrum, d->impulse, FFTW_ESTIMATE);
+
+    return d;
+}
+
+void pa_fir_design_free(pa_fir_design *d) {
+    pa_assert(d);
+
+    fftwf_destroy_plan(d->plan);
+    fftwf_free(d->spectrum);
+    fftwf_free(d->impulse);
+    pa_xfree(d->window);
+    pa_xfree(d);
+}
+
+void pa_fir_design_run(pa_fir_design *d, const float *H, float X, float *taps) {
+    size_t i, half;
+
+    pa_assert(d);
+    pa_assert(H);
+    pa_assert(taps);
+
+    for (i = 0; i < d->fft_size / 2 + 1; i++) {
+        d->spectrum[i][0] = X * H[i];
+        d->spectrum[i][1] = 0;
+    }
+
+    fftwf_execute(d->plan);
+
+    half = d->length / 2;
+    for (i = 0; i < d->length; i++)
+        taps[i] = d->window[i] * d->impulse[(i + d->fft_size - half) % d->fft_size];
+}
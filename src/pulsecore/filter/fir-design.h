@@ -0,0 +1,44 @@
+#ifndef foofirdesignhfoo
+#define foofirdesignhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+
+/* Designs a linear phase FIR from a magnitude response given on the
+ * bins of a real FFT. The inverse transform of the zero phase
+ * response is centred on 0; delaying it by half the filter length and
+ * windowing it with a Hann window gives a causal FIR of length taps
+ * with a group delay of length / 2.
+ *
+ * This needs FFTW, so it is built into its users rather than into
+ * libpulsecore. */
+
+typedef struct pa_fir_design pa_fir_design;
+
+/* length is the number of taps and has to be odd and at most
+ * fft_size */
+pa_fir_design *pa_fir_design_new(size_t fft_size, size_t length);
+void pa_fir_design_free(pa_fir_design *d);
+
+/* H holds the gains of the fft_size / 2 + 1 bins, with the gain of
+ * the unnormalized inverse FFT divided out, and X is an additional
+ * gain for all of them. Writes length taps. */
+void pa_fir_design_run(pa_fir_design *d, const float *H, float X, float *taps);
+
+#endif
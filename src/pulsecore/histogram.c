@@ -0,0 +1,83 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/strbuf.h>
+
+#include "histogram.h"
+
+void pa_histogram_reset(pa_histogram *h) {
+    pa_assert(h);
+
+    memset(h, 0, sizeof(*h));
+}
+
+pa_usec_t pa_histogram_percentile(const pa_histogram *h, double fraction) {
+    uint64_t n, sum = 0;
+    unsigned i;
+
+    pa_assert(h);
+    pa_assert(fraction >= 0 && fraction <= 1);
+
+    if (h->count == 0)
+        return 0;
+
+    n = (uint64_t) (fraction * h->count + 0.5);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS - 1; i++) {
+        sum += h->buckets[i];
+
+        if (sum >= n)
+            return PA_MIN((pa_usec_t) 1 << i, h->max);
+    }
+
+    return h->max;
+}
+
+char *pa_histogram_to_string(const pa_histogram *h) {
+    pa_strbuf *buf;
+    unsigned i, last;
+
+    pa_assert(h);
+
+    if (h->count == 0)
+        return pa_xstrdup("no data");
+
+    buf = pa_strbuf_new();
+
+    pa_strbuf_printf(buf, "n=%llu avg=%llu usec p50<%llu usec p99<%llu usec max=%llu usec |",
+                     (unsigned long long) h->count,
+                     (unsigned long long) (h->total / h->count),
+                     (unsigned long long) pa_histogram_percentile(h, 0.5),
+                     (unsigned long long) pa_histogram_percentile(h, 0.99),
+                     (unsigned long long) h->max);
+
+    for (last = PA_HISTOGRAM_BUCKETS - 1; last > 0 && h->buckets[last] == 0; last--)
+        ;
+
+    for (i = 0; i <= last; i++)
+        pa_strbuf_printf(buf, " %u", h->buckets[i]);
+
+    return pa_strbuf_to_string_free(buf);
+}
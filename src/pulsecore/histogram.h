@@ -0,0 +1,75 @@
+#ifndef foohistogramhfoo
+#define foohistogramhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+/* A histogram of durations with logarithmic buckets, cheap enough to
+ * be updated on every IO thread cycle. Bucket 0 counts durations below
+ * 1 usec, bucket i > 0 the ones from 2^(i-1) usec up to below 2^i
+ * usec. The last bucket also counts everything longer.
+ *
+ * There is no locking: a histogram is only written by one thread at a
+ * time, and other threads get a copy of it by sending a message to
+ * that thread. */
+
+#define PA_HISTOGRAM_BUCKETS 24
+
+typedef struct pa_histogram {
+    uint64_t count;
+    pa_usec_t total;
+    pa_usec_t max;
+    uint32_t buckets[PA_HISTOGRAM_BUCKETS];
+} pa_histogram;
+
+static inline unsigned pa_histogram_bucket(pa_usec_t usec) {
+    if (usec == 0)
+        return 0;
+
+    if (usec >= (1U << (PA_HISTOGRAM_BUCKETS - 2)))
+        return PA_HISTOGRAM_BUCKETS - 1;
+
+    return pa_ulog2((unsigned) usec) + 1;
+}
+
+static inline void pa_histogram_add(pa_histogram *h, pa_usec_t usec) {
+    h->count++;
+    h->total += usec;
+
+    if (usec > h->max)
+        h->max = usec;
+
+    h->buckets[pa_histogram_bucket(usec)]++;
+}
+
+void pa_histogram_reset(pa_histogram *h);
+
+/* Returns the smallest duration d so that at least the given fraction
+ * of all durations is below d, as far as the buckets tell */
+pa_usec_t pa_histogram_percentile(const pa_histogram *h, double fraction);
+
+/* A one-line summary, for the CLI */
+char *pa_histogram_to_string(const pa_histogram *h);
+
+#endif
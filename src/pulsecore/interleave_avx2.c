@@ -0,0 +1,383 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+
+#include <immintrin.h>
+
+/* Interleaving is a transpose of a matrix of channels by frames. The
+ * functions below work on blocks of 8 frames of 32 bit samples or 16
+ * frames of 16 bit samples, one vector per channel, and do the rest with
+ * a plain loop. Only the samples are moved, so 32 bit samples are
+ * treated as floats regardless of their format. */
+
+#define LOAD_PS(p) _mm256_loadu_ps((const float *) (p))
+#define STORE_PS(p, v) _mm256_storeu_ps((float *) (p), (v))
+#define LOAD_SI(p) _mm256_loadu_si256((const __m256i *) (p))
+#define STORE_SI(p, v) _mm256_storeu_si256((__m256i *) (p), (v))
+
+#define INTERLEAVE_REST(type, channels, j, n)                           \
+    for (; j < n; j++)                                                  \
+        for (c = 0; c < channels; c++)                                  \
+            *d++ = ((const type *) src[c])[j];
+
+#define DEINTERLEAVE_REST(type, channels, j, n)                         \
+    for (; j < n; j++)                                                  \
+        for (c = 0; c < channels; c++)                                  \
+            ((type *) dst[c])[j] = *s++;
+
+static void interleave_32_2_avx2(const void *src[], void *dst, unsigned n) {
+    uint32_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, d += 16) {
+        __m256 a = LOAD_PS((const uint32_t *) src[0] + j);
+        __m256 b = LOAD_PS((const uint32_t *) src[1] + j);
+        __m256 lo = _mm256_unpacklo_ps(a, b);
+        __m256 hi = _mm256_unpackhi_ps(a, b);
+
+        STORE_PS(d, _mm256_permute2f128_ps(lo, hi, 0x20));
+        STORE_PS(d + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    INTERLEAVE_REST(uint32_t, 2, j, n);
+}
+
+static void deinterleave_32_2_avx2(const void *src, void *dst[], unsigned n) {
+    const uint32_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, s += 16) {
+        __m256 x = LOAD_PS(s);
+        __m256 y = LOAD_PS(s + 8);
+        __m256 t0 = _mm256_permute2f128_ps(x, y, 0x20);
+        __m256 t1 = _mm256_permute2f128_ps(x, y, 0x31);
+
+        STORE_PS((uint32_t *) dst[0] + j, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(2, 0, 2, 0)));
+        STORE_PS((uint32_t *) dst[1] + j, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    DEINTERLEAVE_REST(uint32_t, 2, j, n);
+}
+
+static void interleave_32_4_avx2(const void *src[], void *dst, unsigned n) {
+    uint32_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, d += 32) {
+        __m256 a = LOAD_PS((const uint32_t *) src[0] + j);
+        __m256 b = LOAD_PS((const uint32_t *) src[1] + j);
+        __m256 e = LOAD_PS((const uint32_t *) src[2] + j);
+        __m256 f = LOAD_PS((const uint32_t *) src[3] + j);
+        __m256 t0 = _mm256_unpacklo_ps(a, b);
+        __m256 t1 = _mm256_unpackhi_ps(a, b);
+        __m256 t2 = _mm256_unpacklo_ps(e, f);
+        __m256 t3 = _mm256_unpackhi_ps(e, f);
+        /* frames 0 and 4, 1 and 5, 2 and 6, 3 and 7 */
+        __m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        STORE_PS(d, _mm256_permute2f128_ps(r0, r1, 0x20));
+        STORE_PS(d + 8, _mm256_permute2f128_ps(r2, r3, 0x20));
+        STORE_PS(d + 16, _mm256_permute2f128_ps(r0, r1, 0x31));
+        STORE_PS(d + 24, _mm256_permute2f128_ps(r2, r3, 0x31));
+    }
+
+    INTERLEAVE_REST(uint32_t, 4, j, n);
+}
+
+static void deinterleave_32_4_avx2(const void *src, void *dst[], unsigned n) {
+    const uint32_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, s += 32) {
+        __m256 x0 = LOAD_PS(s);
+        __m256 x1 = LOAD_PS(s + 8);
+        __m256 x2 = LOAD_PS(s + 16);
+        __m256 x3 = LOAD_PS(s + 24);
+        /* frames 0 and 4, 1 and 5, 2 and 6, 3 and 7 */
+        __m256 r0 = _mm256_permute2f128_ps(x0, x2, 0x20);
+        __m256 r1 = _mm256_permute2f128_ps(x0, x2, 0x31);
+        __m256 r2 = _mm256_permute2f128_ps(x1, x3, 0x20);
+        __m256 r3 = _mm256_permute2f128_ps(x1, x3, 0x31);
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+        STORE_PS((uint32_t *) dst[0] + j, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)));
+        STORE_PS((uint32_t *) dst[1] + j, _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)));
+        STORE_PS((uint32_t *) dst[2] + j, _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+        STORE_PS((uint32_t *) dst[3] + j, _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+    }
+
+    DEINTERLEAVE_REST(uint32_t, 4, j, n);
+}
+
+/* Transpose 8x8 samples, which turns 8 channels into 8 frames and back */
+static inline void transpose_32_8x8(__m256 r[8]) {
+    __m256 t[8], u[8];
+    unsigned k;
+
+    for (k = 0; k < 8; k += 2) {
+        t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+        t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+    }
+
+    for (k = 0; k < 8; k += 4) {
+        u[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        u[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        u[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        u[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    for (k = 0; k < 4; k++) {
+        r[k] = _mm256_permute2f128_ps(u[k], u[k + 4], 0x20);
+        r[k + 4] = _mm256_permute2f128_ps(u[k], u[k + 4], 0x31);
+    }
+}
+
+static void interleave_32_8_avx2(const void *src[], void *dst, unsigned n) {
+    uint32_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, d += 64) {
+        __m256 r[8];
+
+        for (c = 0; c < 8; c++)
+            r[c] = LOAD_PS((const uint32_t *) src[c] + j);
+
+        transpose_32_8x8(r);
+
+        for (c = 0; c < 8; c++)
+            STORE_PS(d + 8 * c, r[c]);
+    }
+
+    INTERLEAVE_REST(uint32_t, 8, j, n);
+}
+
+static void deinterleave_32_8_avx2(const void *src, void *dst[], unsigned n) {
+    const uint32_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 8 <= n; j += 8, s += 64) {
+        __m256 r[8];
+
+        for (c = 0; c < 8; c++)
+            r[c] = LOAD_PS(s + 8 * c);
+
+        transpose_32_8x8(r);
+
+        for (c = 0; c < 8; c++)
+            STORE_PS((uint32_t *) dst[c] + j, r[c]);
+    }
+
+    DEINTERLEAVE_REST(uint32_t, 8, j, n);
+}
+
+static void interleave_16_2_avx2(const void *src[], void *dst, unsigned n) {
+    uint16_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, d += 32) {
+        __m256i a = LOAD_SI((const uint16_t *) src[0] + j);
+        __m256i b = LOAD_SI((const uint16_t *) src[1] + j);
+        __m256i lo = _mm256_unpacklo_epi16(a, b);
+        __m256i hi = _mm256_unpackhi_epi16(a, b);
+
+        STORE_SI(d, _mm256_permute2x128_si256(lo, hi, 0x20));
+        STORE_SI(d + 16, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    INTERLEAVE_REST(uint16_t, 2, j, n);
+}
+
+static void deinterleave_16_2_avx2(const void *src, void *dst[], unsigned n) {
+    /* Even samples to the low, odd samples to the high half of each lane */
+    const __m256i split = _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+        0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+    const uint16_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, s += 32) {
+        __m256i x = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(LOAD_SI(s), split), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i y = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(LOAD_SI(s + 16), split), _MM_SHUFFLE(3, 1, 2, 0));
+
+        STORE_SI((uint16_t *) dst[0] + j, _mm256_permute2x128_si256(x, y, 0x20));
+        STORE_SI((uint16_t *) dst[1] + j, _mm256_permute2x128_si256(x, y, 0x31));
+    }
+
+    DEINTERLEAVE_REST(uint16_t, 2, j, n);
+}
+
+static void interleave_16_4_avx2(const void *src[], void *dst, unsigned n) {
+    uint16_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, d += 64) {
+        __m256i a = LOAD_SI((const uint16_t *) src[0] + j);
+        __m256i b = LOAD_SI((const uint16_t *) src[1] + j);
+        __m256i e = LOAD_SI((const uint16_t *) src[2] + j);
+        __m256i f = LOAD_SI((const uint16_t *) src[3] + j);
+        __m256i t0 = _mm256_unpacklo_epi16(a, b);
+        __m256i t1 = _mm256_unpackhi_epi16(a, b);
+        __m256i t2 = _mm256_unpacklo_epi16(e, f);
+        __m256i t3 = _mm256_unpackhi_epi16(e, f);
+        /* frames 0, 1 and 8, 9; 2, 3 and 10, 11; ... */
+        __m256i r0 = _mm256_unpacklo_epi32(t0, t2);
+        __m256i r1 = _mm256_unpackhi_epi32(t0, t2);
+        __m256i r2 = _mm256_unpacklo_epi32(t1, t3);
+        __m256i r3 = _mm256_unpackhi_epi32(t1, t3);
+
+        STORE_SI(d, _mm256_permute2x128_si256(r0, r1, 0x20));
+        STORE_SI(d + 16, _mm256_permute2x128_si256(r2, r3, 0x20));
+        STORE_SI(d + 32, _mm256_permute2x128_si256(r0, r1, 0x31));
+        STORE_SI(d + 48, _mm256_permute2x128_si256(r2, r3, 0x31));
+    }
+
+    INTERLEAVE_REST(uint16_t, 4, j, n);
+}
+
+static void deinterleave_16_4_avx2(const void *src, void *dst[], unsigned n) {
+    const uint16_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, s += 64) {
+        __m256i x0 = LOAD_SI(s);
+        __m256i x1 = LOAD_SI(s + 16);
+        __m256i x2 = LOAD_SI(s + 32);
+        __m256i x3 = LOAD_SI(s + 48);
+        /* frames 0, 1 and 8, 9; 2, 3 and 10, 11; ... */
+        __m256i r0 = _mm256_permute2x128_si256(x0, x2, 0x20);
+        __m256i r1 = _mm256_permute2x128_si256(x0, x2, 0x31);
+        __m256i r2 = _mm256_permute2x128_si256(x1, x3, 0x20);
+        __m256i r3 = _mm256_permute2x128_si256(x1, x3, 0x31);
+        __m256i p0 = _mm256_unpacklo_epi16(r0, r1);
+        __m256i p1 = _mm256_unpackhi_epi16(r0, r1);
+        __m256i p2 = _mm256_unpacklo_epi16(r2, r3);
+        __m256i p3 = _mm256_unpackhi_epi16(r2, r3);
+        /* four samples each of channels 0 and 1, and of 2 and 3 */
+        __m256i q0 = _mm256_unpacklo_epi16(p0, p1);
+        __m256i q1 = _mm256_unpackhi_epi16(p0, p1);
+        __m256i q2 = _mm256_unpacklo_epi16(p2, p3);
+        __m256i q3 = _mm256_unpackhi_epi16(p2, p3);
+
+        STORE_SI((uint16_t *) dst[0] + j, _mm256_unpacklo_epi64(q0, q2));
+        STORE_SI((uint16_t *) dst[1] + j, _mm256_unpackhi_epi64(q0, q2));
+        STORE_SI((uint16_t *) dst[2] + j, _mm256_unpacklo_epi64(q1, q3));
+        STORE_SI((uint16_t *) dst[3] + j, _mm256_unpackhi_epi64(q1, q3));
+    }
+
+    DEINTERLEAVE_REST(uint16_t, 4, j, n);
+}
+
+/* Transpose two blocks of 8x8 samples, one in each lane */
+static inline void transpose_16_8x8(__m256i r[8]) {
+    __m256i t[8], u[8];
+    unsigned k;
+
+    for (k = 0; k < 8; k += 2) {
+        t[k] = _mm256_unpacklo_epi16(r[k], r[k + 1]);
+        t[k + 1] = _mm256_unpackhi_epi16(r[k], r[k + 1]);
+    }
+
+    for (k = 0; k < 8; k += 4) {
+        u[k] = _mm256_unpacklo_epi32(t[k], t[k + 2]);
+        u[k + 1] = _mm256_unpackhi_epi32(t[k], t[k + 2]);
+        u[k + 2] = _mm256_unpacklo_epi32(t[k + 1], t[k + 3]);
+        u[k + 3] = _mm256_unpackhi_epi32(t[k + 1], t[k + 3]);
+    }
+
+    for (k = 0; k < 4; k++) {
+        r[2 * k] = _mm256_unpacklo_epi64(u[k], u[k + 4]);
+        r[2 * k + 1] = _mm256_unpackhi_epi64(u[k], u[k + 4]);
+    }
+}
+
+static void interleave_16_8_avx2(const void *src[], void *dst, unsigned n) {
+    uint16_t *d = dst;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, d += 128) {
+        __m256i r[8];
+
+        for (c = 0; c < 8; c++)
+            r[c] = LOAD_SI((const uint16_t *) src[c] + j);
+
+        transpose_16_8x8(r);
+
+        /* r[k] holds the frames k and k + 8 */
+        for (c = 0; c < 8; c++) {
+            _mm_storeu_si128((__m128i *) (d + 8 * c), _mm256_castsi256_si128(r[c]));
+            _mm_storeu_si128((__m128i *) (d + 8 * (c + 8)), _mm256_extracti128_si256(r[c], 1));
+        }
+    }
+
+    INTERLEAVE_REST(uint16_t, 8, j, n);
+}
+
+static void deinterleave_16_8_avx2(const void *src, void *dst[], unsigned n) {
+    const uint16_t *s = src;
+    unsigned j, c;
+
+    for (j = 0; j + 16 <= n; j += 16, s += 128) {
+        __m256i r[8];
+
+        for (c = 0; c < 8; c++)
+            r[c] = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (s + 8 * c))),
+                _mm_loadu_si128((const __m128i *) (s + 8 * (c + 8))), 1);
+
+        transpose_16_8x8(r);
+
+        for (c = 0; c < 8; c++)
+            STORE_SI((uint16_t *) dst[c] + j, r[c]);
+    }
+
+    DEINTERLEAVE_REST(uint16_t, 8, j, n);
+}
+
+void pa_interleave_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized interleaving functions.");
+
+    /* 6 channels don't divide the vectors evenly and are left to the
+     * unrolled C version */
+    pa_set_interleave_func(2, 2, interleave_16_2_avx2);
+    pa_set_interleave_func(2, 4, interleave_16_4_avx2);
+    pa_set_interleave_func(2, 8, interleave_16_8_avx2);
+    pa_set_interleave_func(4, 2, interleave_32_2_avx2);
+    pa_set_interleave_func(4, 4, interleave_32_4_avx2);
+    pa_set_interleave_func(4, 8, interleave_32_8_avx2);
+
+    pa_set_deinterleave_func(2, 2, deinterleave_16_2_avx2);
+    pa_set_deinterleave_func(2, 4, deinterleave_16_4_avx2);
+    pa_set_deinterleave_func(2, 8, deinterleave_16_8_avx2);
+    pa_set_deinterleave_func(4, 2, deinterleave_32_2_avx2);
+    pa_set_deinterleave_func(4, 4, deinterleave_32_4_avx2);
+    pa_set_deinterleave_func(4, 8, deinterleave_32_8_avx2);
+}
@@ -41,6 +41,11 @@
 
 #include "iochannel.h"
 
+/* Not all platforms have this */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 struct pa_iochannel {
     int ifd, ofd;
     int ifd_type, ofd_type;
@@ -240,6 +245,92 @@ ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l) {
     return r;
 }
 
+static ssize_t do_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+
+#ifdef HAVE_SYS_UIO_H
+    /* Like pa_write(): sockets get MSG_NOSIGNAL, everything else is
+     * remembered as such in ofd_type after the first ENOTSOCK */
+    if (io->ofd_type == 0) {
+        struct msghdr mh;
+
+        pa_zero(mh);
+        mh.msg_iov = (struct iovec*) iov;
+        mh.msg_iovlen = n;
+
+        for (;;) {
+            if ((r = sendmsg(io->ofd, &mh, MSG_NOSIGNAL)) >= 0)
+                return r;
+
+            if (errno != EINTR)
+                break;
+        }
+
+        if (errno != ENOTSOCK)
+            return r;
+
+        io->ofd_type = 1;
+    }
+
+    for (;;) {
+        if ((r = writev(io->ofd, iov, (int) n)) < 0)
+            if (errno == EINTR)
+                continue;
+
+        return r;
+    }
+#else
+    size_t done = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        if ((r = pa_write(io->ofd, iov[i].iov_base, iov[i].iov_len, &io->ofd_type)) < 0)
+            return done > 0 ? (ssize_t) done : r;
+
+        done += (size_t) r;
+
+        if ((size_t) r < iov[i].iov_len)
+            break;
+    }
+
+    return (ssize_t) done;
+#endif
+}
+
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n) {
+    ssize_t r;
+    size_t l = 0;
+    unsigned i;
+
+    pa_assert(io);
+    pa_assert(iov);
+    pa_assert(n > 0);
+    pa_assert(io->ofd >= 0);
+
+    for (i = 0; i < n; i++)
+        l += iov[i].iov_len;
+
+    pa_assert(l);
+
+    r = do_writev(io, iov, n);
+
+    if ((size_t) r == l)
+        return r;
+
+    if (r < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            r = 0;
+        else
+            return r;
+    }
+
+    /* Partial write - let's get a notification when we can write more */
+    io->writable = io->hungup = false;
+    enable_events(io);
+
+    return r;
+}
+
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l) {
     ssize_t r;
 
@@ -30,6 +30,7 @@
 #include <pulse/mainloop-api.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/socket.h>
 
 /* A wrapper around UNIX file descriptors for attaching them to the a
    main event loop. Every time new data may be read or be written to
@@ -49,6 +50,10 @@ void pa_iochannel_free(pa_iochannel*io);
 /* Returns: length written on success, 0 if a retry is needed, negative value
  * on error. */
 ssize_t pa_iochannel_write(pa_iochannel*io, const void*data, size_t l);
+
+/* Like pa_iochannel_write(), but gathers the data from n buffers in a
+ * single system call where the platform allows it. */
+ssize_t pa_iochannel_writev(pa_iochannel*io, const struct iovec *iov, unsigned n);
 ssize_t pa_iochannel_read(pa_iochannel*io, void*data, size_t l);
 
 #ifdef HAVE_CREDS
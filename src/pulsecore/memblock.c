@@ -47,20 +47,28 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/memtrap.h>
+#include <pulsecore/planar.h>
 
 #include "memblock.h"
 
-/* We can allocate 64*1024*1024 bytes at maximum. That's 64MB. Please
- * note that the footprint is usually much smaller, since the data is
- * stored in SHM and our OS does not commit the memory before we use
- * it for the first time. */
+/* A pool starts out with one segment of 1024 slots of 64K, i.e. 64MB.
+ * Please note that the footprint is usually much smaller, since the
+ * data is stored in SHM and our OS does not commit the memory before
+ * we use it for the first time. Blocks of other sizes go to segments
+ * of other slot sizes, which are created when they are first needed.
+ * When all segments of a slot size are full, another one is added, up
+ * to PA_MEMPOOL_SEGMENTS_MAX segments in total. */
 #define PA_MEMPOOL_SLOTS_MAX 1024
 #define PA_MEMPOOL_SLOT_SIZE (64*1024)
+#define PA_MEMPOOL_SEGMENTS_MAX 16
+#define PA_MEMPOOL_CLASSES_MAX 8
 
 #define PA_MEMEXPORT_SLOTS_MAX 128
 
 #define PA_MEMIMPORT_SLOTS_MAX 160
-#define PA_MEMIMPORT_SEGMENTS_MAX 16
+#define PA_MEMIMPORT_SEGMENTS_MAX 64
+
+#define PA_MEMBLOCK_SILENCE_MAX 4
 
 struct pa_memblock {
     PA_REFCNT_DECLARE; /* the reference counter */
@@ -77,6 +85,19 @@ struct pa_memblock {
     pa_atomic_t n_acquired;
     pa_atomic_t please_signal;
 
+    /* Ranges of the data known to be silence, sorted by index and
+     * neither overlapping nor adjacent */
+    struct {
+        size_t index, length;
+    } silence[PA_MEMBLOCK_SILENCE_MAX];
+    unsigned n_silence;
+
+    /* A copy of length bytes of the data from index on in planar form */
+    struct {
+        pa_planar *planar;
+        size_t index, length;
+    } planar;
+
     union {
         struct {
             /* If type == PA_MEMBLOCK_USER this points to a function for freeing this memory block */
@@ -141,22 +162,45 @@ struct pa_memexport {
     PA_LLIST_FIELDS(pa_memexport);
 };
 
-struct pa_mempool {
-    pa_semaphore *semaphore;
-    pa_mutex *mutex;
+/* A slot size, and the number of slots of the segments with it */
+struct mempool_class {
+    size_t block_size;
+    unsigned n_blocks;
+};
 
+struct mempool_segment {
     pa_shm memory;
+    unsigned class_idx;
     size_t block_size;
     unsigned n_blocks;
-    bool is_remote_writable;
 
     pa_atomic_t n_init;
 
-    PA_LLIST_HEAD(pa_memimport, imports);
-    PA_LLIST_HEAD(pa_memexport, exports);
-
     /* A list of free slots that may be reused */
     pa_flist *free_slots;
+};
+
+struct pa_mempool {
+    pa_semaphore *semaphore;
+    pa_mutex *mutex;
+
+    bool shared;
+    bool is_remote_writable;
+
+    /* Sorted by size. Blocks of up to block_size_max() bytes are taken
+     * from the default class. */
+    struct mempool_class classes[PA_MEMPOOL_CLASSES_MAX];
+    unsigned n_classes;
+    unsigned default_class;
+
+    /* Segments are only ever added, and only with the mutex held. They
+     * are fully set up before n_segments is increased, so that the
+     * lock-free paths can look at the first n_segments segments. */
+    struct mempool_segment *segments[PA_MEMPOOL_SEGMENTS_MAX];
+    pa_atomic_t n_segments;
+
+    PA_LLIST_HEAD(pa_memimport, imports);
+    PA_LLIST_HEAD(pa_memexport, exports);
 
     pa_mempool_stat stat;
 };
@@ -216,8 +260,10 @@ pa_memblock *pa_memblock_new(pa_mempool *p, size_t length) {
     pa_assert(p);
     pa_assert(length);
 
-    if (!(b = pa_memblock_new_pool(p, length)))
+    if (!(b = pa_memblock_new_pool(p, length))) {
         b = memblock_new_appended(p, length);
+        pa_atomic_inc(&p->stat.n_fallback);
+    }
 
     return b;
 }
@@ -239,6 +285,8 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
     b->pool = p;
     b->type = PA_MEMBLOCK_APPENDED;
     b->read_only = b->is_silence = false;
+    b->n_silence = 0;
+    b->planar.planar = NULL;
     pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
     b->length = length;
     pa_atomic_store(&b->n_acquired, 0);
@@ -248,29 +296,129 @@ static pa_memblock *memblock_new_appended(pa_mempool *p, size_t length) {
     return b;
 }
 
+/* Called with the mutex held */
+static struct mempool_segment *segment_new(pa_mempool *p, unsigned class_idx) {
+    struct mempool_segment *seg;
+    char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+
+    seg = pa_xnew0(struct mempool_segment, 1);
+    seg->class_idx = class_idx;
+    seg->block_size = p->classes[class_idx].block_size;
+    seg->n_blocks = p->classes[class_idx].n_blocks;
+
+    if (pa_shm_create_rw(&seg->memory, seg->n_blocks * seg->block_size, p->shared, 0700) < 0) {
+        pa_xfree(seg);
+        return NULL;
+    }
+
+    pa_atomic_store(&seg->n_init, 0);
+    seg->free_slots = pa_flist_new(seg->n_blocks);
+
+    pa_log_debug("Using %s memory pool segment with %u slots of size %s each, total size is %s",
+                 seg->memory.shared ? "shared" : "private",
+                 seg->n_blocks,
+                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) seg->block_size),
+                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) seg->memory.size));
+
+    return seg;
+}
+
+static void segment_free(struct mempool_segment *seg) {
+    pa_flist_free(seg->free_slots, NULL);
+    pa_shm_free(&seg->memory);
+    pa_xfree(seg);
+}
+
+/* Self-locked. Adds another segment for the class, unless another
+ * thread did that in the meantime. Returns the number of segments. */
+static unsigned mempool_grow(pa_mempool *p, unsigned class_idx, unsigned n_segments) {
+    struct mempool_segment *seg;
+    unsigned n;
+
+    pa_mutex_lock(p->mutex);
+
+    n = (unsigned) pa_atomic_load(&p->n_segments);
+
+    if (n == n_segments && n < PA_MEMPOOL_SEGMENTS_MAX && (seg = segment_new(p, class_idx))) {
+        p->segments[n] = seg;
+        pa_atomic_store(&p->n_segments, (int) ++n);
+
+        pa_atomic_inc(&p->stat.n_segments);
+        pa_atomic_add(&p->stat.pool_size, (int) seg->memory.size);
+    }
+
+    pa_mutex_unlock(p->mutex);
+
+    return n;
+}
+
 /* No lock necessary */
-static struct mempool_slot* mempool_allocate_slot(pa_mempool *p) {
+static struct mempool_slot* segment_allocate_slot(struct mempool_segment *seg) {
     struct mempool_slot *slot;
+    int idx;
+
+    if ((slot = pa_flist_pop(seg->free_slots)))
+        return slot;
+
+    /* The free list was empty, we have to allocate a new entry */
+
+    if ((unsigned) (idx = pa_atomic_inc(&seg->n_init)) >= seg->n_blocks) {
+        pa_atomic_dec(&seg->n_init);
+        return NULL;
+    }
+
+    return (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + (seg->block_size * (size_t) idx));
+}
+
+/* No lock necessary, except when the pool needs to grow. Returns a
+ * slot of at least length bytes from the smallest class that has one,
+ * and the size of the slot. */
+static struct mempool_slot* mempool_allocate_slot(pa_mempool *p, size_t length, size_t *block_size) {
+    struct mempool_slot *slot = NULL;
+    unsigned c, i, n_segments;
+
     pa_assert(p);
+    pa_assert(block_size);
 
-    if (!(slot = pa_flist_pop(p->free_slots))) {
-        int idx;
+    for (c = 0; c < p->n_classes && !slot; c++) {
+        if (p->classes[c].block_size < length)
+            continue;
+
+        n_segments = (unsigned) pa_atomic_load(&p->n_segments);
 
-        /* The free list was empty, we have to allocate a new entry */
+        for (i = 0;; i++) {
+            struct mempool_segment *seg;
 
-        if ((unsigned) (idx = pa_atomic_inc(&p->n_init)) >= p->n_blocks)
-            pa_atomic_dec(&p->n_init);
-        else
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) idx));
+            if (i >= n_segments) {
+                unsigned n;
+
+                /* All segments of this size are full, so try to add
+                 * another one. If that fails, try the next size. */
+                if ((n = mempool_grow(p, c, n_segments)) == n_segments)
+                    break;
 
-        if (!slot) {
-            if (pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Pool full");
-            pa_atomic_inc(&p->stat.n_pool_full);
-            return NULL;
+                n_segments = n;
+            }
+
+            seg = p->segments[i];
+
+            if (seg->class_idx == c && (slot = segment_allocate_slot(seg))) {
+                *block_size = seg->block_size;
+                break;
+            }
         }
     }
 
+    if (!slot) {
+        if (pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Pool full");
+        pa_atomic_inc(&p->stat.n_pool_full);
+        return NULL;
+    }
+
+    pa_atomic_inc(&p->stat.n_used_slots);
+    pa_atomic_add(&p->stat.used_slots_size, (int) *block_size);
+
 /* #ifdef HAVE_VALGRIND_MEMCHECK_H */
 /*     if (PA_UNLIKELY(pa_in_valgrind())) { */
 /*         VALGRIND_MALLOCLIKE_BLOCK(slot, p->block_size, 0, 0); */
@@ -286,23 +434,55 @@ static inline void* mempool_slot_data(struct mempool_slot *slot) {
 }
 
 /* No lock necessary */
-static unsigned mempool_slot_idx(pa_mempool *p, void *ptr) {
+static struct mempool_segment* mempool_segment_by_ptr(pa_mempool *p, void *ptr) {
+    unsigned i, n_segments;
+
     pa_assert(p);
 
-    pa_assert((uint8_t*) ptr >= (uint8_t*) p->memory.ptr);
-    pa_assert((uint8_t*) ptr < (uint8_t*) p->memory.ptr + p->memory.size);
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
 
-    return (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) p->memory.ptr) / p->block_size);
+    for (i = 0; i < n_segments; i++) {
+        struct mempool_segment *seg = p->segments[i];
+
+        if ((uint8_t*) ptr >= (uint8_t*) seg->memory.ptr &&
+            (uint8_t*) ptr < (uint8_t*) seg->memory.ptr + seg->memory.size)
+            return seg;
+    }
+
+    return NULL;
 }
 
 /* No lock necessary */
-static struct mempool_slot* mempool_slot_by_ptr(pa_mempool *p, void *ptr) {
+static struct mempool_slot* segment_slot_by_ptr(struct mempool_segment *seg, void *ptr) {
     unsigned idx;
 
-    if ((idx = mempool_slot_idx(p, ptr)) == (unsigned) -1)
-        return NULL;
+    idx = (unsigned) ((size_t) ((uint8_t*) ptr - (uint8_t*) seg->memory.ptr) / seg->block_size);
+
+    return (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + (idx * seg->block_size));
+}
+
+/* No lock necessary */
+static void mempool_free_slot(pa_mempool *p, void *ptr) {
+    struct mempool_segment *seg;
+    struct mempool_slot *slot;
+
+    pa_assert_se(seg = mempool_segment_by_ptr(p, ptr));
+    slot = segment_slot_by_ptr(seg, ptr);
+
+/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
+/*     if (PA_UNLIKELY(pa_in_valgrind())) { */
+/*         VALGRIND_FREELIKE_BLOCK(slot, seg->block_size); */
+/*     } */
+/* #endif */
+
+    pa_atomic_dec(&p->stat.n_used_slots);
+    pa_atomic_sub(&p->stat.used_slots_size, (int) seg->block_size);
 
-    return (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (idx * p->block_size));
+    /* The free list dimensions should easily allow all slots
+     * to fit in, hence try harder if pushing this slot into
+     * the free list fails */
+    while (pa_flist_push(seg->free_slots, slot) < 0)
+        ;
 }
 
 /* No lock necessary */
@@ -322,6 +502,7 @@ void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable) {
 pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     pa_memblock *b = NULL;
     struct mempool_slot *slot;
+    size_t block_size;
     static int mempool_disable = 0;
 
     pa_assert(p);
@@ -339,35 +520,34 @@ pa_memblock *pa_memblock_new_pool(pa_mempool *p, size_t length) {
     if (length == (size_t) -1)
         length = pa_mempool_block_size_max(p);
 
-    if (p->block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
+    if (p->classes[p->n_classes - 1].block_size < length) {
+        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length,
+                     (unsigned long) p->classes[p->n_classes - 1].block_size);
+        pa_atomic_inc(&p->stat.n_too_large_for_pool);
+        return NULL;
+    }
 
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
+    if (!(slot = mempool_allocate_slot(p, length, &block_size)))
+        return NULL;
 
+    if (block_size >= PA_ALIGN(sizeof(pa_memblock)) + length) {
         b = mempool_slot_data(slot);
         b->type = PA_MEMBLOCK_POOL;
         pa_atomic_ptr_store(&b->data, (uint8_t*) b + PA_ALIGN(sizeof(pa_memblock)));
 
-    } else if (p->block_size >= length) {
-
-        if (!(slot = mempool_allocate_slot(p)))
-            return NULL;
-
+    } else {
         if (!(b = pa_flist_pop(PA_STATIC_FLIST_GET(unused_memblocks))))
             b = pa_xnew(pa_memblock, 1);
 
         b->type = PA_MEMBLOCK_POOL_EXTERNAL;
         pa_atomic_ptr_store(&b->data, mempool_slot_data(slot));
-
-    } else {
-        pa_log_debug("Memory block too large for pool: %lu > %lu", (unsigned long) length, (unsigned long) p->block_size);
-        pa_atomic_inc(&p->stat.n_too_large_for_pool);
-        return NULL;
     }
 
     PA_REFCNT_INIT(b);
     b->pool = p;
     b->read_only = b->is_silence = false;
+    b->n_silence = 0;
+    b->planar.planar = NULL;
     b->length = length;
     pa_atomic_store(&b->n_acquired, 0);
     pa_atomic_store(&b->please_signal, 0);
@@ -393,6 +573,8 @@ pa_memblock *pa_memblock_new_fixed(pa_mempool *p, void *d, size_t length, bool r
     b->type = PA_MEMBLOCK_FIXED;
     b->read_only = read_only;
     b->is_silence = false;
+    b->n_silence = 0;
+    b->planar.planar = NULL;
     pa_atomic_ptr_store(&b->data, d);
     b->length = length;
     pa_atomic_store(&b->n_acquired, 0);
@@ -426,6 +608,8 @@ pa_memblock *pa_memblock_new_user(
     b->type = PA_MEMBLOCK_USER;
     b->read_only = read_only;
     b->is_silence = false;
+    b->n_silence = 0;
+    b->planar.planar = NULL;
     pa_atomic_ptr_store(&b->data, d);
     b->length = length;
     pa_atomic_store(&b->n_acquired, 0);
@@ -470,6 +654,185 @@ void pa_memblock_set_is_silence(pa_memblock *b, bool v) {
     b->is_silence = v;
 }
 
+static void remove_silence(pa_memblock *b, unsigned i) {
+    memmove(b->silence + i, b->silence + i + 1, (b->n_silence - i - 1) * sizeof(b->silence[0]));
+    b->n_silence--;
+}
+
+/* Inserts a range that doesn't touch any of the existing ones. If there
+ * is no room the shortest range is forgotten, which might be the new
+ * one. */
+static void insert_silence(pa_memblock *b, size_t index, size_t length) {
+    unsigned i, shortest = 0;
+
+    if (b->n_silence >= PA_MEMBLOCK_SILENCE_MAX) {
+        for (i = 1; i < b->n_silence; i++)
+            if (b->silence[i].length < b->silence[shortest].length)
+                shortest = i;
+
+        if (b->silence[shortest].length >= length)
+            return;
+
+        remove_silence(b, shortest);
+    }
+
+    for (i = 0; i < b->n_silence; i++)
+        if (b->silence[i].index > index)
+            break;
+
+    memmove(b->silence + i + 1, b->silence + i, (b->n_silence - i) * sizeof(b->silence[0]));
+    b->silence[i].index = index;
+    b->silence[i].length = length;
+    b->n_silence++;
+}
+
+/* No lock necessary, but see memblock.h */
+void pa_memblock_add_silence(pa_memblock *b, size_t index, size_t length) {
+    size_t end;
+    unsigned i;
+
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(index + length <= b->length);
+
+    if (length <= 0 || b->is_silence)
+        return;
+
+    end = index + length;
+
+    /* Swallow all ranges that overlap or touch the new one */
+    for (i = 0; i < b->n_silence;) {
+        size_t e = b->silence[i].index + b->silence[i].length;
+
+        if (e < index || b->silence[i].index > end) {
+            i++;
+            continue;
+        }
+
+        index = PA_MIN(index, b->silence[i].index);
+        end = PA_MAX(end, e);
+        remove_silence(b, i);
+    }
+
+    insert_silence(b, index, end - index);
+}
+
+/* No lock necessary, but see memblock.h */
+void pa_memblock_clear_silence(pa_memblock *b, size_t index, size_t length) {
+    size_t end;
+    unsigned i;
+
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(index + length <= b->length);
+
+    if (length <= 0)
+        return;
+
+    end = index + length;
+
+    if (b->is_silence) {
+        /* What is left of the block is still silence */
+        b->is_silence = false;
+        b->n_silence = 0;
+        pa_memblock_add_silence(b, 0, index);
+        pa_memblock_add_silence(b, end, b->length - end);
+        return;
+    }
+
+    for (i = 0; i < b->n_silence;) {
+        size_t s = b->silence[i].index, e = s + b->silence[i].length;
+
+        if (e <= index || s >= end) {
+            i++;
+            continue;
+        }
+
+        remove_silence(b, i);
+
+        /* Put back what is left on either side */
+        if (s < index)
+            insert_silence(b, s, index - s);
+        if (e > end)
+            insert_silence(b, end, e - end);
+
+        /* The pieces we put back are outside of the cleared range, so
+         * it's safe to start over */
+        i = 0;
+    }
+}
+
+/* No lock necessary, but see memblock.h */
+size_t pa_memblock_get_silence(pa_memblock *b, size_t index, size_t length, bool *silent) {
+    unsigned i;
+
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(silent);
+
+    if (b->is_silence) {
+        *silent = true;
+        return length;
+    }
+
+    for (i = 0; i < b->n_silence; i++) {
+        if (b->silence[i].index + b->silence[i].length <= index)
+            continue;
+
+        if (b->silence[i].index <= index) {
+            *silent = true;
+            return PA_MIN(length, b->silence[i].index + b->silence[i].length - index);
+        }
+
+        *silent = false;
+        return PA_MIN(length, b->silence[i].index - index);
+    }
+
+    *silent = false;
+    return length;
+}
+
+/* No lock necessary, but see memblock.h */
+void pa_memblock_set_planar(pa_memblock *b, size_t index, size_t length, pa_planar *p) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(index + length <= b->length);
+    pa_assert(p);
+    pa_assert(!b->read_only);
+
+    pa_memblock_drop_planar(b);
+
+    b->planar.planar = p;
+    b->planar.index = index;
+    b->planar.length = length;
+}
+
+/* No lock necessary, but see memblock.h */
+void pa_memblock_drop_planar(pa_memblock *b) {
+    pa_assert(b);
+
+    if (!b->planar.planar)
+        return;
+
+    pa_planar_free(b->planar.planar);
+    b->planar.planar = NULL;
+}
+
+/* No lock necessary */
+pa_planar *pa_memblock_get_planar(pa_memblock *b, size_t index, size_t length, size_t *offset) {
+    pa_assert(b);
+    pa_assert(PA_REFCNT_VALUE(b) > 0);
+    pa_assert(offset);
+
+    if (!b->planar.planar ||
+        index < b->planar.index ||
+        index + length > b->planar.index + b->planar.length)
+        return NULL;
+
+    *offset = index - b->planar.index;
+    return b->planar.planar;
+}
+
 /* No lock necessary */
 bool pa_memblock_ref_is_one(pa_memblock *b) {
     int r;
@@ -539,6 +902,7 @@ static void memblock_free(pa_memblock *b) {
 
     pa_assert(pa_atomic_load(&b->n_acquired) == 0);
 
+    pa_memblock_drop_planar(b);
     stat_remove(b);
 
     switch (b->type) {
@@ -590,24 +954,11 @@ static void memblock_free(pa_memblock *b) {
 
         case PA_MEMBLOCK_POOL_EXTERNAL:
         case PA_MEMBLOCK_POOL: {
-            struct mempool_slot *slot;
             bool call_free;
 
-            pa_assert_se(slot = mempool_slot_by_ptr(b->pool, pa_atomic_ptr_load(&b->data)));
-
             call_free = b->type == PA_MEMBLOCK_POOL_EXTERNAL;
 
-/* #ifdef HAVE_VALGRIND_MEMCHECK_H */
-/*             if (PA_UNLIKELY(pa_in_valgrind())) { */
-/*                 VALGRIND_FREELIKE_BLOCK(slot, b->pool->block_size); */
-/*             } */
-/* #endif */
-
-            /* The free list dimensions should easily allow all slots
-             * to fit in, hence try harder if pushing this slot into
-             * the free list fails */
-            while (pa_flist_push(b->pool->free_slots, slot) < 0)
-                ;
+            mempool_free_slot(b->pool, pa_atomic_ptr_load(&b->data));
 
             if (call_free)
                 if (pa_flist_push(PA_STATIC_FLIST_GET(unused_memblocks), b) < 0)
@@ -657,10 +1008,11 @@ static void memblock_make_local(pa_memblock *b) {
 
     pa_atomic_dec(&b->pool->stat.n_allocated_by_type[b->type]);
 
-    if (b->length <= b->pool->block_size) {
+    if (b->length <= b->pool->classes[b->pool->n_classes - 1].block_size) {
         struct mempool_slot *slot;
+        size_t block_size;
 
-        if ((slot = mempool_allocate_slot(b->pool))) {
+        if ((slot = mempool_allocate_slot(b->pool, b->length, &block_size))) {
             void *new_data;
             /* We can move it into a local pool, perfect! */
 
@@ -676,6 +1028,7 @@ static void memblock_make_local(pa_memblock *b) {
     }
 
     /* Humm, not enough space in the pool, so lets allocate the memory with malloc() */
+    pa_atomic_inc(&b->pool->stat.n_fallback);
     b->per_type.user.free_cb = pa_xfree;
     pa_atomic_ptr_store(&b->data, pa_xmemdup(pa_atomic_ptr_load(&b->data), b->length));
     b->per_type.user.free_cb_data = pa_atomic_ptr_load(&b->data);
@@ -744,38 +1097,87 @@ static void memblock_replace_import(pa_memblock *b) {
     pa_mutex_unlock(import->mutex);
 }
 
-pa_mempool* pa_mempool_new(bool shared, size_t size) {
-    pa_mempool *p;
-    char t1[PA_BYTES_SNPRINT_MAX], t2[PA_BYTES_SNPRINT_MAX];
+/* The slot sizes can be overridden with a comma separated list in
+ * $PULSE_MEMPOOL_SLOT_SIZES. The default slot size is the largest one
+ * that is not larger than PA_MEMPOOL_SLOT_SIZE. */
+static void mempool_init_classes(pa_mempool *p, size_t size) {
+    static const size_t default_sizes[] = { 4*1024, 16*1024, 64*1024, 256*1024 };
+    size_t sizes[PA_MEMPOOL_CLASSES_MAX], segment_size;
+    unsigned n = 0, i, n_blocks;
+    const char *e;
+
+    if ((e = getenv("PULSE_MEMPOOL_SLOT_SIZES"))) {
+        const char *state = NULL;
+        char *k;
+
+        while (n < PA_MEMPOOL_CLASSES_MAX && (k = pa_split(e, ",", &state))) {
+            uint32_t v;
+
+            /* Sizes must be increasing */
+            if (pa_atou(k, &v) >= 0 && v > 0 && (n == 0 || PA_PAGE_ALIGN(v) > sizes[n-1]))
+                sizes[n++] = PA_PAGE_ALIGN(v);
+            else
+                pa_log_warn("Ignoring invalid memory pool slot size '%s'.", k);
+
+            pa_xfree(k);
+        }
+    }
 
-    p = pa_xnew0(pa_mempool, 1);
+    if (n == 0)
+        for (; n < PA_ELEMENTSOF(default_sizes); n++)
+            sizes[n] = PA_PAGE_ALIGN(default_sizes[n]);
+
+    p->n_classes = n;
+    p->default_class = 0;
 
-    p->block_size = PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE);
-    if (p->block_size < PA_PAGE_SIZE)
-        p->block_size = PA_PAGE_SIZE;
+    for (i = 0; i < n; i++)
+        if (sizes[i] <= PA_PAGE_ALIGN(PA_MEMPOOL_SLOT_SIZE))
+            p->default_class = i;
 
+    /* The segments of the default size have as many slots as the pool
+     * size allows. The others are about as large, but have no more slots
+     * than those. */
     if (size <= 0)
-        p->n_blocks = PA_MEMPOOL_SLOTS_MAX;
+        n_blocks = PA_MEMPOOL_SLOTS_MAX;
     else {
-        p->n_blocks = (unsigned) (size / p->block_size);
+        n_blocks = (unsigned) (size / sizes[p->default_class]);
 
-        if (p->n_blocks < 2)
-            p->n_blocks = 2;
+        if (n_blocks < 2)
+            n_blocks = 2;
     }
 
-    if (pa_shm_create_rw(&p->memory, p->n_blocks * p->block_size, shared, 0700) < 0) {
+    segment_size = n_blocks * sizes[p->default_class];
+
+    for (i = 0; i < n; i++) {
+        p->classes[i].block_size = sizes[i];
+        p->classes[i].n_blocks = i == p->default_class ? n_blocks :
+            PA_CLAMP((unsigned) (segment_size / sizes[i]), 2U, n_blocks);
+    }
+}
+
+pa_mempool* pa_mempool_new(bool shared, size_t size) {
+    pa_mempool *p;
+    struct mempool_segment *seg;
+
+    p = pa_xnew0(pa_mempool, 1);
+    p->shared = shared;
+
+    mempool_init_classes(p, size);
+
+    if (!(seg = segment_new(p, p->default_class))) {
         pa_xfree(p);
         return NULL;
     }
 
-    pa_log_debug("Using %s memory pool with %u slots of size %s each, total size is %s, maximum usable slot size is %lu",
-                 p->memory.shared ? "shared" : "private",
-                 p->n_blocks,
-                 pa_bytes_snprint(t1, sizeof(t1), (unsigned) p->block_size),
-                 pa_bytes_snprint(t2, sizeof(t2), (unsigned) (p->n_blocks * p->block_size)),
-                 (unsigned long) pa_mempool_block_size_max(p));
+    p->segments[0] = seg;
+    pa_atomic_store(&p->n_segments, 1);
 
-    pa_atomic_store(&p->n_init, 0);
+    pa_atomic_store(&p->stat.n_segments, 1);
+    pa_atomic_store(&p->stat.pool_size, (int) seg->memory.size);
+
+    pa_log_debug("Memory pool has %u slot sizes, maximum usable slot size is %lu",
+                 p->n_classes,
+                 (unsigned long) pa_mempool_block_size_max(p));
 
     PA_LLIST_HEAD_INIT(pa_memimport, p->imports);
     PA_LLIST_HEAD_INIT(pa_memexport, p->exports);
@@ -783,12 +1185,12 @@ pa_mempool* pa_mempool_new(bool shared, size_t size) {
     p->mutex = pa_mutex_new(true, true);
     p->semaphore = pa_semaphore_new(0);
 
-    p->free_slots = pa_flist_new(p->n_blocks);
-
     return p;
 }
 
 void pa_mempool_free(pa_mempool *p) {
+    unsigned n_segments, s;
+
     pa_assert(p);
 
     pa_mutex_lock(p->mutex);
@@ -801,7 +1203,7 @@ void pa_mempool_free(pa_mempool *p) {
 
     pa_mutex_unlock(p->mutex);
 
-    pa_flist_free(p->free_slots, NULL);
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
 
     if (pa_atomic_load(&p->stat.n_allocated) > 0) {
 
@@ -813,32 +1215,36 @@ void pa_mempool_free(pa_mempool *p) {
 
         /* Let's try to find at least one of those leaked memory blocks */
 
-        list = pa_flist_new(p->n_blocks);
+        for (s = 0; s < n_segments; s++) {
+            struct mempool_segment *seg = p->segments[s];
 
-        for (i = 0; i < (unsigned) pa_atomic_load(&p->n_init); i++) {
-            struct mempool_slot *slot;
-            pa_memblock *b, *k;
+            list = pa_flist_new(seg->n_blocks);
 
-            slot = (struct mempool_slot*) ((uint8_t*) p->memory.ptr + (p->block_size * (size_t) i));
-            b = mempool_slot_data(slot);
+            for (i = 0; i < (unsigned) pa_atomic_load(&seg->n_init); i++) {
+                struct mempool_slot *slot;
+                pa_memblock *b, *k;
 
-            while ((k = pa_flist_pop(p->free_slots))) {
-                while (pa_flist_push(list, k) < 0)
-                    ;
+                slot = (struct mempool_slot*) ((uint8_t*) seg->memory.ptr + (seg->block_size * (size_t) i));
+                b = mempool_slot_data(slot);
 
-                if (b == k)
-                    break;
-            }
+                while ((k = pa_flist_pop(seg->free_slots))) {
+                    while (pa_flist_push(list, k) < 0)
+                        ;
 
-            if (!k)
-                pa_log("REF: Leaked memory block %p", b);
+                    if (b == k)
+                        break;
+                }
 
-            while ((k = pa_flist_pop(list)))
-                while (pa_flist_push(p->free_slots, k) < 0)
-                    ;
-        }
+                if (!k)
+                    pa_log("REF: Leaked memory block %p", b);
 
-        pa_flist_free(list, NULL);
+                while ((k = pa_flist_pop(list)))
+                    while (pa_flist_push(seg->free_slots, k) < 0)
+                        ;
+            }
+
+            pa_flist_free(list, NULL);
+        }
 
 #endif
 
@@ -847,7 +1253,8 @@ void pa_mempool_free(pa_mempool *p) {
 /*         PA_DEBUG_TRAP; */
     }
 
-    pa_shm_free(&p->memory);
+    for (s = 0; s < n_segments; s++)
+        segment_free(p->segments[s]);
 
     pa_mutex_free(p->mutex);
     pa_semaphore_free(p->semaphore);
@@ -866,40 +1273,56 @@ const pa_mempool_stat* pa_mempool_get_stat(pa_mempool *p) {
 size_t pa_mempool_block_size_max(pa_mempool *p) {
     pa_assert(p);
 
-    return p->block_size - PA_ALIGN(sizeof(pa_memblock));
+    return p->classes[p->default_class].block_size - PA_ALIGN(sizeof(pa_memblock));
+}
+
+/* No lock necessary. Blocks larger than pa_mempool_block_size_max()
+ * are kept outside of their slot, so a block can take up the whole of
+ * the largest one. */
+size_t pa_mempool_block_size_largest(pa_mempool *p) {
+    pa_assert(p);
+
+    return p->classes[p->n_classes - 1].block_size;
 }
 
 /* No lock necessary */
 void pa_mempool_vacuum(pa_mempool *p) {
     struct mempool_slot *slot;
     pa_flist *list;
+    unsigned i, n_segments;
 
     pa_assert(p);
 
-    list = pa_flist_new(p->n_blocks);
+    n_segments = (unsigned) pa_atomic_load(&p->n_segments);
 
-    while ((slot = pa_flist_pop(p->free_slots)))
-        while (pa_flist_push(list, slot) < 0)
-            ;
+    for (i = 0; i < n_segments; i++) {
+        struct mempool_segment *seg = p->segments[i];
 
-    while ((slot = pa_flist_pop(list))) {
-        pa_shm_punch(&p->memory, (size_t) ((uint8_t*) slot - (uint8_t*) p->memory.ptr), p->block_size);
+        list = pa_flist_new(seg->n_blocks);
 
-        while (pa_flist_push(p->free_slots, slot))
-            ;
-    }
+        while ((slot = pa_flist_pop(seg->free_slots)))
+            while (pa_flist_push(list, slot) < 0)
+                ;
+
+        while ((slot = pa_flist_pop(list))) {
+            pa_shm_punch(&seg->memory, (size_t) ((uint8_t*) slot - (uint8_t*) seg->memory.ptr), seg->block_size);
 
-    pa_flist_free(list, NULL);
+            while (pa_flist_push(seg->free_slots, slot))
+                ;
+        }
+
+        pa_flist_free(list, NULL);
+    }
 }
 
-/* No lock necessary */
+/* No lock necessary. Returns the ID of the first segment. */
 int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
     pa_assert(p);
 
-    if (!p->memory.shared)
+    if (!p->shared)
         return -1;
 
-    *id = p->memory.id;
+    *id = p->segments[0]->memory.id;
 
     return 0;
 }
@@ -908,7 +1331,7 @@ int pa_mempool_get_shm_id(pa_mempool *p, uint32_t *id) {
 bool pa_mempool_is_shared(pa_mempool *p) {
     pa_assert(p);
 
-    return p->memory.shared;
+    return p->shared;
 }
 
 /* For receiving blocks from other nodes */
@@ -1042,6 +1465,8 @@ pa_memblock* pa_memimport_get(pa_memimport *i, uint32_t block_id, uint32_t shm_i
     b->type = PA_MEMBLOCK_IMPORTED;
     b->read_only = !writable;
     b->is_silence = false;
+    b->n_silence = 0;
+    b->planar.planar = NULL;
     pa_atomic_ptr_store(&b->data, (uint8_t*) seg->memory.ptr + offset);
     b->length = size;
     pa_atomic_store(&b->n_acquired, 0);
@@ -1090,7 +1515,7 @@ pa_memexport* pa_memexport_new(pa_mempool *p, pa_memexport_revoke_cb_t cb, void
     pa_assert(p);
     pa_assert(cb);
 
-    if (!p->memory.shared)
+    if (!p->shared)
         return NULL;
 
     e = pa_xnew(pa_memexport, 1);
@@ -1259,9 +1684,12 @@ int pa_memexport_put(pa_memexport *e, pa_memblock *b, uint32_t *block_id, uint32
         pa_assert(b->per_type.imported.segment);
         memory = &b->per_type.imported.segment->memory;
     } else {
+        struct mempool_segment *seg;
+
         pa_assert(b->type == PA_MEMBLOCK_POOL || b->type == PA_MEMBLOCK_POOL_EXTERNAL);
         pa_assert(b->pool);
-        memory = &b->pool->memory;
+        pa_assert_se(seg = mempool_segment_by_ptr(b->pool, data));
+        memory = &seg->memory;
     }
 
     pa_assert(data >= memory->ptr);
@@ -22,6 +22,7 @@
 ***/
 
 typedef struct pa_memblock pa_memblock;
+typedef struct pa_planar pa_planar;
 
 #include <sys/types.h>
 #include <inttypes.h>
@@ -73,6 +74,16 @@ struct pa_mempool_stat {
     pa_atomic_t n_too_large_for_pool;
     pa_atomic_t n_pool_full;
 
+    /* Blocks that had to be allocated from the heap instead of the
+     * pool, because it was full or the block too large */
+    pa_atomic_t n_fallback;
+
+    /* The SHM segments of the pool, and how much of them is in use */
+    pa_atomic_t n_segments;
+    pa_atomic_t pool_size;
+    pa_atomic_t n_used_slots;
+    pa_atomic_t used_slots_size;
+
     pa_atomic_t n_allocated_by_type[PA_MEMBLOCK_TYPE_MAX];
     pa_atomic_t n_accumulated_by_type[PA_MEMBLOCK_TYPE_MAX];
 };
@@ -111,6 +122,39 @@ bool pa_memblock_is_silence(pa_memblock *b);
 bool pa_memblock_ref_is_one(pa_memblock *b);
 void pa_memblock_set_is_silence(pa_memblock *b, bool v);
 
+/* Besides the is_silence flag, which says that the whole block is and
+ * stays silence, a memblock can carry a few ranges of its data that are
+ * known to be silence, so that mixing and volume adjustment can skip
+ * them. It's a hint: data that isn't marked might still be silent, and
+ * only the longest ranges are remembered if there are many. Whoever
+ * fills a block should mark the silence it writes, and whoever changes
+ * the data of a block in a way that doesn't keep silence silent must
+ * clear the range. pa_memchunk_make_output(), pa_memchunk_memcpy() and
+ * pa_silence_memchunk() take care of that, see memchunk.h. Like the
+ * data itself, this may only be changed by whoever may write to the
+ * block. */
+void pa_memblock_add_silence(pa_memblock *b, size_t index, size_t length);
+void pa_memblock_clear_silence(pa_memblock *b, size_t index, size_t length);
+
+/* Returns how many of the length bytes starting at index are either all
+ * known to be silence or all not, and which of the two in *silent */
+size_t pa_memblock_get_silence(pa_memblock *b, size_t index, size_t length, bool *silent);
+
+/* A memblock of float samples can carry a copy of length bytes of its
+ * data from index on in planar form, so that a chain of filters that
+ * work on planes deinterleaves the data only once. The block takes
+ * over p. Like the silence ranges above, this may only be changed by
+ * whoever may write to the block, and whoever changes the data must
+ * drop the copy. The memchunk helpers take care of that, see
+ * pa_planar_from_memchunk() for the reading side. */
+void pa_memblock_set_planar(pa_memblock *b, size_t index, size_t length, pa_planar *p);
+void pa_memblock_drop_planar(pa_memblock *b);
+
+/* Returns the planar copy if it covers the length bytes starting at
+ * index, and in *offset where these start in it, in bytes of
+ * interleaved data */
+pa_planar *pa_memblock_get_planar(pa_memblock *b, size_t index, size_t length, size_t *offset);
+
 void* pa_memblock_acquire(pa_memblock *b);
 void *pa_memblock_acquire_chunk(const pa_memchunk *c);
 void pa_memblock_release(pa_memblock *b);
@@ -130,6 +174,7 @@ bool pa_mempool_is_shared(pa_mempool *p);
 bool pa_mempool_is_remote_writable(pa_mempool *p);
 void pa_mempool_set_is_remote_writable(pa_mempool *p, bool writable);
 size_t pa_mempool_block_size_max(pa_mempool *p);
+size_t pa_mempool_block_size_largest(pa_mempool *p);
 
 /* For receiving blocks from other nodes */
 pa_memimport* pa_memimport_new(pa_mempool *p, pa_memimport_release_cb_t cb, void *userdata);
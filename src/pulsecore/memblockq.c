@@ -30,24 +30,29 @@
 #include <pulsecore/log.h>
 #include <pulsecore/mcalign.h>
 #include <pulsecore/macro.h>
-#include <pulsecore/flist.h>
 
 #include "memblockq.h"
 
 /* #define MEMBLOCKQ_DEBUG */
 
-struct list_item {
-    struct list_item *next, *prev;
+#define RING_SIZE_MIN 16
+
+struct block {
     int64_t index;
     pa_memchunk chunk;
 };
 
-PA_STATIC_FLIST_DECLARE(list_items, 0, pa_xfree);
-
 struct pa_memblockq {
-    struct list_item *blocks, *blocks_tail;
-    struct list_item *current_read, *current_write;
-    unsigned n_blocks;
+    /* The blocks ordered by index, kept in a ring of ring_size entries
+     * (a power of two) starting at ring[first]. Blocks are addressed by
+     * their position in the queue, not in the ring. */
+    struct block *ring;
+    unsigned ring_size, first, n_blocks;
+
+    /* The block we read from next, or n_blocks if there is none, and the
+     * last block that starts at or before the write index, or -1. Both
+     * are only hints and are fixed up before use. */
+    int current_read, current_write;
     size_t maxlength, tlength, base, prebuf, minreq, maxrewind;
     int64_t read_index, write_index;
     bool in_prebuf;
@@ -109,6 +114,7 @@ void pa_memblockq_free(pa_memblockq* bq) {
     pa_assert(bq);
 
     pa_memblockq_silence(bq);
+    pa_xfree(bq->ring);
 
     if (bq->silence.memblock)
         pa_memblock_unref(bq->silence.memblock);
@@ -120,94 +126,148 @@ void pa_memblockq_free(pa_memblockq* bq) {
     pa_xfree(bq);
 }
 
-static void fix_current_read(pa_memblockq *bq) {
-    pa_assert(bq);
+static inline struct block *block(pa_memblockq *bq, int i) {
+    return &bq->ring[(bq->first + (unsigned) i) & (bq->ring_size - 1)];
+}
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_read = NULL;
-        return;
-    }
+static inline int64_t block_end(pa_memblockq *bq, int i) {
+    struct block *b = block(bq, i);
+
+    return b->index + (int64_t) b->chunk.length;
+}
 
-    if (PA_UNLIKELY(!bq->current_read))
-        bq->current_read = bq->blocks;
+/* Returns the first block that ends after idx, or n_blocks. Checks the
+ * hint and its successor first, which is where we usually are. */
+static int find_block(pa_memblockq *bq, int64_t idx, int hint) {
+    int n = (int) bq->n_blocks, lo, hi;
 
-    /* Scan left */
-    while (PA_UNLIKELY(bq->current_read->index > bq->read_index))
+    for (lo = PA_CLAMP(hint, 0, n); lo <= hint + 1 && lo <= n; lo++)
+        if ((lo == n || block_end(bq, lo) > idx) && (lo == 0 || block_end(bq, lo - 1) <= idx))
+            return lo;
 
-        if (bq->current_read->prev)
-            bq->current_read = bq->current_read->prev;
+    lo = 0;
+    hi = n;
+
+    while (lo < hi) {
+        int m = lo + (hi - lo) / 2;
+
+        if (block_end(bq, m) > idx)
+            hi = m;
         else
-            break;
+            lo = m + 1;
+    }
 
-    /* Scan right */
-    while (PA_LIKELY(bq->current_read != NULL) && PA_UNLIKELY(bq->current_read->index + (int64_t) bq->current_read->chunk.length <= bq->read_index))
-        bq->current_read = bq->current_read->next;
+    return lo;
+}
+
+static void fix_current_read(pa_memblockq *bq) {
+    pa_assert(bq);
 
-    /* At this point current_read will either point at or left of the
-       next block to play. It may be NULL in case everything in
-       the queue was already played */
+    /* Afterwards current_read points at the next block to play, or
+     * right of it if there is a gap. It is n_blocks in case everything
+     * in the queue was already played */
+    bq->current_read = find_block(bq, bq->read_index, bq->current_read);
 }
 
 static void fix_current_write(pa_memblockq *bq) {
+    int i;
+
     pa_assert(bq);
 
-    if (PA_UNLIKELY(!bq->blocks)) {
-        bq->current_write = NULL;
-        return;
-    }
+    /* Afterwards current_write points at the last block starting at or
+     * left of the write index. It is -1 in case everything in the queue
+     * is still to be played */
+    i = find_block(bq, bq->write_index, bq->current_write);
 
-    if (PA_UNLIKELY(!bq->current_write))
-        bq->current_write = bq->blocks_tail;
+    if (i < (int) bq->n_blocks && block(bq, i)->index <= bq->write_index)
+        bq->current_write = i;
+    else
+        bq->current_write = i - 1;
+}
 
-    /* Scan right */
-    while (PA_UNLIKELY(bq->current_write->index + (int64_t) bq->current_write->chunk.length <= bq->write_index))
+static void grow_ring(pa_memblockq *bq) {
+    struct block *ring;
+    unsigned i, size;
 
-        if (bq->current_write->next)
-            bq->current_write = bq->current_write->next;
-        else
-            break;
+    size = bq->ring_size ? bq->ring_size * 2 : RING_SIZE_MIN;
+    ring = pa_xnew(struct block, size);
 
-    /* Scan left */
-    while (PA_LIKELY(bq->current_write != NULL) && PA_UNLIKELY(bq->current_write->index > bq->write_index))
-        bq->current_write = bq->current_write->prev;
+    for (i = 0; i < bq->n_blocks; i++)
+        ring[i] = *block(bq, (int) i);
 
-    /* At this point current_write will either point at or right of
-       the next block to write data to. It may be NULL in case
-       everything in the queue is still to be played */
+    pa_xfree(bq->ring);
+    bq->ring = ring;
+    bq->ring_size = size;
+    bq->first = 0;
 }
 
-static void drop_block(pa_memblockq *bq, struct list_item *q) {
-    pa_assert(bq);
-    pa_assert(q);
+/* Makes room for a new block at position i, moving whichever side of
+ * the queue is shorter */
+static struct block *insert_block(pa_memblockq *bq, int i) {
+    int n, j;
 
-    pa_assert(bq->n_blocks >= 1);
+    pa_assert(i >= 0 && i <= (int) bq->n_blocks);
 
-    if (q->prev)
-        q->prev->next = q->next;
-    else {
-        pa_assert(bq->blocks == q);
-        bq->blocks = q->next;
-    }
+    if (bq->n_blocks >= bq->ring_size)
+        grow_ring(bq);
+
+    n = (int) bq->n_blocks;
+
+    if (i < n / 2) {
+        bq->first = (bq->first - 1) & (bq->ring_size - 1);
+        bq->n_blocks++;
 
-    if (q->next)
-        q->next->prev = q->prev;
-    else {
-        pa_assert(bq->blocks_tail == q);
-        bq->blocks_tail = q->prev;
+        for (j = 0; j < i; j++)
+            *block(bq, j) = *block(bq, j + 1);
+    } else {
+        bq->n_blocks++;
+
+        for (j = n; j > i; j--)
+            *block(bq, j) = *block(bq, j - 1);
     }
 
-    if (bq->current_write == q)
-        bq->current_write = q->prev;
+    if (bq->current_read >= i)
+        bq->current_read++;
+
+    if (bq->current_write >= i)
+        bq->current_write++;
 
-    if (bq->current_read == q)
-        bq->current_read = q->next;
+    return block(bq, i);
+}
+
+/* Removes the block at position i without touching its memblock */
+static void remove_block(pa_memblockq *bq, int i) {
+    int n, j;
+
+    pa_assert(i >= 0 && i < (int) bq->n_blocks);
+
+    n = (int) bq->n_blocks;
 
-    pa_memblock_unref(q->chunk.memblock);
+    if (i < n / 2) {
+        for (j = i; j > 0; j--)
+            *block(bq, j) = *block(bq, j - 1);
 
-    if (pa_flist_push(PA_STATIC_FLIST_GET(list_items), q) < 0)
-        pa_xfree(q);
+        bq->first = (bq->first + 1) & (bq->ring_size - 1);
+    } else {
+        for (j = i; j < n - 1; j++)
+            *block(bq, j) = *block(bq, j + 1);
+    }
 
     bq->n_blocks--;
+
+    if (bq->current_read > i)
+        bq->current_read--;
+
+    if (bq->current_write >= i)
+        bq->current_write--;
+}
+
+static void drop_block(pa_memblockq *bq, int i) {
+    pa_assert(bq);
+    pa_assert(bq->n_blocks >= 1);
+
+    pa_memblock_unref(block(bq, i)->chunk.memblock);
+    remove_block(bq, i);
 }
 
 static void drop_backlog(pa_memblockq *bq) {
@@ -216,8 +276,8 @@ static void drop_backlog(pa_memblockq *bq) {
 
     boundary = bq->read_index - (int64_t) bq->maxrewind;
 
-    while (bq->blocks && (bq->blocks->index + (int64_t) bq->blocks->chunk.length <= boundary))
-        drop_block(bq, bq->blocks);
+    while (bq->n_blocks > 0 && block_end(bq, 0) <= boundary)
+        drop_block(bq, 0);
 }
 
 static bool can_push(pa_memblockq *bq, size_t l) {
@@ -234,7 +294,7 @@ static bool can_push(pa_memblockq *bq, size_t l) {
             return true;
     }
 
-    end = bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->write_index;
+    end = bq->n_blocks > 0 ? block_end(bq, (int) bq->n_blocks - 1) : bq->write_index;
 
     /* Make sure that the list doesn't get too long */
     if (bq->write_index + (int64_t) l > end)
@@ -275,9 +335,10 @@ static void read_index_changed(pa_memblockq *bq, int64_t old_read_index) {
 }
 
 int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
-    struct list_item *q, *n;
+    struct block *b, *n;
     pa_memchunk chunk;
     int64_t old;
+    int q;
 
     pa_assert(bq);
     pa_assert(uchunk);
@@ -297,82 +358,69 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
     fix_current_write(bq);
     q = bq->current_write;
 
-    /* First we advance the q pointer right of where we want to
-     * write to */
+    /* First we advance q right of where we want to write to */
 
-    if (q) {
-        while (bq->write_index + (int64_t) chunk.length > q->index)
-            if (q->next)
-                q = q->next;
+    if (q >= 0) {
+        while (bq->write_index + (int64_t) chunk.length > block(bq, q)->index)
+            if (q + 1 < (int) bq->n_blocks)
+                q++;
             else
                 break;
     }
 
-    if (!q)
-        q = bq->blocks_tail;
+    if (q < 0)
+        q = (int) bq->n_blocks - 1;
 
     /* We go from back to front to look for the right place to add
      * this new entry. Drop data we will overwrite on the way */
 
-    while (q) {
+    while (q >= 0) {
+        b = block(bq, q);
 
-        if (bq->write_index >= q->index + (int64_t) q->chunk.length)
+        if (bq->write_index >= b->index + (int64_t) b->chunk.length)
             /* We found the entry where we need to place the new entry immediately after */
             break;
-        else if (bq->write_index + (int64_t) chunk.length <= q->index) {
+        else if (bq->write_index + (int64_t) chunk.length <= b->index) {
             /* This entry isn't touched at all, let's skip it */
-            q = q->prev;
-        } else if (bq->write_index <= q->index &&
-                   bq->write_index + (int64_t) chunk.length >= q->index + (int64_t) q->chunk.length) {
+            q--;
+        } else if (bq->write_index <= b->index &&
+                   bq->write_index + (int64_t) chunk.length >= b->index + (int64_t) b->chunk.length) {
 
             /* This entry is fully replaced by the new entry, so let's drop it */
-
-            struct list_item *p;
-            p = q;
-            q = q->prev;
-            drop_block(bq, p);
-        } else if (bq->write_index >= q->index) {
+            drop_block(bq, q);
+            q--;
+        } else if (bq->write_index >= b->index) {
             /* The write index points into this memblock, so let's
              * truncate or split it */
 
-            if (bq->write_index + (int64_t) chunk.length < q->index + (int64_t) q->chunk.length) {
+            if (bq->write_index + (int64_t) chunk.length < b->index + (int64_t) b->chunk.length) {
 
                 /* We need to save the end of this memchunk */
-                struct list_item *p;
+                struct block *p;
                 size_t d;
 
-                /* Create a new list entry for the end of the memchunk */
-                if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-                    p = pa_xnew(struct list_item, 1);
+                /* Create a new entry for the end of the memchunk. This
+                 * may move the entries around. */
+                p = insert_block(bq, q + 1);
+                b = block(bq, q);
 
-                p->chunk = q->chunk;
+                p->chunk = b->chunk;
                 pa_memblock_ref(p->chunk.memblock);
 
                 /* Calculate offset */
-                d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
+                d = (size_t) (bq->write_index + (int64_t) chunk.length - b->index);
                 pa_assert(d > 0);
 
                 /* Drop it from the new entry */
-                p->index = q->index + (int64_t) d;
+                p->index = b->index + (int64_t) d;
+                p->chunk.index += d;
                 p->chunk.length -= d;
-
-                /* Add it to the list */
-                p->prev = q;
-                if ((p->next = q->next))
-                    q->next->prev = p;
-                else
-                    bq->blocks_tail = p;
-                q->next = p;
-
-                bq->n_blocks++;
             }
 
             /* Truncate the chunk */
-            if (!(q->chunk.length = (size_t) (bq->write_index - q->index))) {
-                struct list_item *p;
-                p = q;
-                q = q->prev;
-                drop_block(bq, p);
+            if (!(b->chunk.length = (size_t) (bq->write_index - b->index))) {
+                drop_block(bq, q);
+                q--;
             }
 
             /* We had to truncate this block, hence we're now at the right position */
@@ -380,61 +428,47 @@ int pa_memblockq_push(pa_memblockq* bq, const pa_memchunk *uchunk) {
         } else {
             size_t d;
 
-            pa_assert(bq->write_index + (int64_t)chunk.length > q->index &&
-                      bq->write_index + (int64_t)chunk.length < q->index + (int64_t)q->chunk.length &&
-                      bq->write_index < q->index);
+            pa_assert(bq->write_index + (int64_t)chunk.length > b->index &&
+                      bq->write_index + (int64_t)chunk.length < b->index + (int64_t)b->chunk.length &&
+                      bq->write_index < b->index);
 
             /* The job overwrites the current entry at the end, so let's drop the beginning of this entry */
 
-            d = (size_t) (bq->write_index + (int64_t) chunk.length - q->index);
-            q->index += (int64_t) d;
-            q->chunk.index += d;
-            q->chunk.length -= d;
+            d = (size_t) (bq->write_index + (int64_t) chunk.length - b->index);
+            b->index += (int64_t) d;
+            b->chunk.index += d;
+            b->chunk.length -= d;
 
-            q = q->prev;
+            q--;
         }
     }
 
-    if (q) {
-        pa_assert(bq->write_index >=  q->index + (int64_t)q->chunk.length);
-        pa_assert(!q->next || (bq->write_index + (int64_t)chunk.length <= q->next->index));
+    if (q >= 0) {
+        b = block(bq, q);
+
+        pa_assert(bq->write_index >= b->index + (int64_t) b->chunk.length);
+        pa_assert(q + 1 >= (int) bq->n_blocks || (bq->write_index + (int64_t) chunk.length <= block(bq, q + 1)->index));
 
         /* Try to merge memory blocks */
 
-        if (q->chunk.memblock == chunk.memblock &&
-            q->chunk.index + q->chunk.length == chunk.index &&
-            bq->write_index == q->index + (int64_t) q->chunk.length) {
+        if (b->chunk.memblock == chunk.memblock &&
+            b->chunk.index + b->chunk.length == chunk.index &&
+            bq->write_index == b->index + (int64_t) b->chunk.length) {
 
-            q->chunk.length += chunk.length;
+            b->chunk.length += chunk.length;
             bq->write_index += (int64_t) chunk.length;
             goto finish;
         }
     } else
-        pa_assert(!bq->blocks || (bq->write_index + (int64_t)chunk.length <= bq->blocks->index));
+        pa_assert(bq->n_blocks == 0 || (bq->write_index + (int64_t) chunk.length <= block(bq, 0)->index));
 
-    if (!(n = pa_flist_pop(PA_STATIC_FLIST_GET(list_items))))
-        n = pa_xnew(struct list_item, 1);
+    n = insert_block(bq, q + 1);
 
     n->chunk = chunk;
     pa_memblock_ref(n->chunk.memblock);
     n->index = bq->write_index;
     bq->write_index += (int64_t) n->chunk.length;
 
-    n->next = q ? q->next : bq->blocks;
-    n->prev = q;
-
-    if (n->next)
-        n->next->prev = n;
-    else
-        bq->blocks_tail = n;
-
-    if (n->prev)
-        n->prev->next = n;
-    else
-        bq->blocks = n;
-
-    bq->n_blocks++;
-
 finish:
 
     write_index_changed(bq, old, true);
@@ -472,6 +506,7 @@ static bool update_prebuf(pa_memblockq *bq) {
 }
 
 int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
+    struct block *b;
     int64_t d;
     pa_assert(bq);
     pa_assert(chunk);
@@ -481,14 +516,15 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
         return -1;
 
     fix_current_read(bq);
+    b = bq->current_read < (int) bq->n_blocks ? block(bq, bq->current_read) : NULL;
 
     /* Do we need to spit out silence? */
-    if (!bq->current_read || bq->current_read->index > bq->read_index) {
+    if (!b || b->index > bq->read_index) {
         size_t length;
 
         /* How much silence shall we return? */
-        if (bq->current_read)
-            length = (size_t) (bq->current_read->index - bq->read_index);
+        if (b)
+            length = (size_t) (b->index - bq->read_index);
         else if (bq->write_index > bq->read_index)
             length = (size_t) (bq->write_index - bq->read_index);
         else
@@ -518,11 +554,11 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
     }
 
     /* Ok, let's pass real data to the caller */
-    *chunk = bq->current_read->chunk;
+    *chunk = b->chunk;
     pa_memblock_ref(chunk->memblock);
 
-    pa_assert(bq->read_index >= bq->current_read->index);
-    d = bq->read_index - bq->current_read->index;
+    pa_assert(bq->read_index >= b->index);
+    d = bq->read_index - b->index;
     chunk->index += (size_t) d;
     chunk->length -= (size_t) d;
 
@@ -532,7 +568,8 @@ int pa_memblockq_peek(pa_memblockq* bq, pa_memchunk *chunk) {
 int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchunk *chunk) {
     pa_memchunk tchunk, rchunk;
     int64_t ri;
-    struct list_item *item;
+    struct block *item;
+    int i;
 
     pa_assert(bq);
     pa_assert(block_size > 0);
@@ -559,10 +596,11 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
 
     /* We don't need to call fix_current_read() here, since
      * pa_memblock_peek() already did that */
-    item = bq->current_read;
+    i = bq->current_read;
     ri = bq->read_index + tchunk.length;
 
     while (rchunk.index < block_size) {
+        item = i < (int) bq->n_blocks ? block(bq, i) : NULL;
 
         if (!item || item->index > ri) {
             /* Do we need to append silence? */
@@ -582,7 +620,7 @@ int pa_memblockq_peek_fixed_size(pa_memblockq *bq, size_t block_size, pa_memchun
             tchunk.length -= (size_t) d;
 
             /* Go to next item for the next iteration */
-            item = item->next;
+            i++;
         }
 
         rchunk.length = tchunk.length = PA_MIN(tchunk.length, block_size - rchunk.index);
@@ -614,13 +652,13 @@ void pa_memblockq_drop(pa_memblockq *bq, size_t length) {
 
         fix_current_read(bq);
 
-        if (bq->current_read) {
+        if (bq->current_read < (int) bq->n_blocks) {
             int64_t p, d;
 
             /* We go through this piece by piece to make sure we don't
              * drop more than allowed by prebuf */
 
-            p = bq->current_read->index + (int64_t) bq->current_read->chunk.length;
+            p = block_end(bq, bq->current_read);
             pa_assert(p >= bq->read_index);
             d = p - bq->read_index;
 
@@ -706,7 +744,7 @@ void pa_memblockq_seek(pa_memblockq *bq, int64_t offset, pa_seek_mode_t seek, bo
             bq->write_index = bq->read_index + offset;
             break;
         case PA_SEEK_RELATIVE_END:
-            bq->write_index = (bq->blocks_tail ? bq->blocks_tail->index + (int64_t) bq->blocks_tail->chunk.length : bq->read_index) + offset;
+            bq->write_index = (bq->n_blocks > 0 ? block_end(bq, (int) bq->n_blocks - 1) : bq->read_index) + offset;
             break;
         default:
             pa_assert_not_reached();
@@ -943,13 +981,22 @@ void pa_memblockq_get_attr(pa_memblockq *bq, pa_buffer_attr *a) {
 }
 
 int pa_memblockq_splice(pa_memblockq *bq, pa_memblockq *source) {
+    size_t length;
 
     pa_assert(bq);
     pa_assert(source);
+    pa_assert(bq != source);
 
     pa_memblockq_prebuf_disable(bq);
 
-    for (;;) {
+    /* Only take what is there now, a source with a silence block would
+     * otherwise never run dry */
+    if (source->write_index <= source->read_index)
+        return 0;
+
+    length = (size_t) (source->write_index - source->read_index);
+
+    while (length > 0) {
         pa_memchunk chunk;
 
         if (pa_memblockq_peek(source, &chunk) < 0)
@@ -957,6 +1004,9 @@ int pa_memblockq_splice(pa_memblockq *bq, pa_memblockq *source) {
 
         pa_assert(chunk.length > 0);
 
+        if (chunk.length > length)
+            chunk.length = length;
+
         if (chunk.memblock) {
 
             if (pa_memblockq_push_align(bq, &chunk) < 0) {
@@ -968,19 +1018,22 @@ int pa_memblockq_splice(pa_memblockq *bq, pa_memblockq *source) {
         } else
             pa_memblockq_seek(bq, (int64_t) chunk.length, PA_SEEK_RELATIVE, true);
 
-        pa_memblockq_drop(bq, chunk.length);
+        pa_memblockq_drop(source, chunk.length);
+        length -= chunk.length;
     }
+
+    return 0;
 }
 
 void pa_memblockq_willneed(pa_memblockq *bq) {
-    struct list_item *q;
+    int i;
 
     pa_assert(bq);
 
     fix_current_read(bq);
 
-    for (q = bq->current_read; q; q = q->next)
-        pa_memchunk_will_need(&q->chunk);
+    for (i = bq->current_read; i < (int) bq->n_blocks; i++)
+        pa_memchunk_will_need(&block(bq, i)->chunk);
 }
 
 void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
@@ -999,14 +1052,14 @@ void pa_memblockq_set_silence(pa_memblockq *bq, pa_memchunk *silence) {
 bool pa_memblockq_is_empty(pa_memblockq *bq) {
     pa_assert(bq);
 
-    return !bq->blocks;
+    return bq->n_blocks == 0;
 }
 
 void pa_memblockq_silence(pa_memblockq *bq) {
     pa_assert(bq);
 
-    while (bq->blocks)
-        drop_block(bq, bq->blocks);
+    while (bq->n_blocks > 0)
+        drop_block(bq, (int) bq->n_blocks - 1);
 
     pa_assert(bq->n_blocks == 0);
 }
@@ -31,6 +31,23 @@
 
 #include "memchunk.h"
 
+/* Mark the silence of length bytes of src at si in dst at di */
+static void copy_silence(pa_memblock *dst, size_t di, pa_memblock *src, size_t si, size_t length) {
+    while (length > 0) {
+        bool silent;
+        size_t l;
+
+        l = pa_memblock_get_silence(src, si, length, &silent);
+
+        if (silent)
+            pa_memblock_add_silence(dst, di, l);
+
+        di += l;
+        si += l;
+        length -= l;
+    }
+}
+
 pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min) {
     pa_memblock *n;
     size_t l;
@@ -41,8 +58,14 @@ pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min) {
 
     if (pa_memblock_ref_is_one(c->memblock) &&
         !pa_memblock_is_read_only(c->memblock) &&
-        pa_memblock_get_length(c->memblock) >= c->index+min)
+        pa_memblock_get_length(c->memblock) >= c->index+min) {
+
+        /* The caller may append to the chunk */
+        l = c->index + c->length;
+        pa_memblock_clear_silence(c->memblock, l, pa_memblock_get_length(c->memblock) - l);
+        pa_memblock_drop_planar(c->memblock);
         return c;
+    }
 
     l = PA_MAX(c->length, min);
 
@@ -56,6 +79,7 @@ pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min) {
     pa_memblock_release(c->memblock);
     pa_memblock_release(n);
 
+    copy_silence(n, 0, c->memblock, c->index, c->length);
     pa_memblock_unref(c->memblock);
 
     c->memblock = n;
@@ -105,9 +129,56 @@ pa_memchunk* pa_memchunk_memcpy(pa_memchunk *dst, pa_memchunk *src) {
     pa_memblock_release(dst->memblock);
     pa_memblock_release(src->memblock);
 
+    /* Don't bother with moves within a block */
+    pa_memblock_clear_silence(dst->memblock, dst->index, dst->length);
+    pa_memblock_drop_planar(dst->memblock);
+    if (dst->memblock != src->memblock)
+        copy_silence(dst->memblock, dst->index, src->memblock, src->index, src->length);
+
     return dst;
 }
 
+pa_memchunk* pa_memchunk_make_output(pa_memchunk *dst, const pa_memchunk *c) {
+    pa_assert(dst);
+    pa_assert(c);
+    pa_assert(c->memblock);
+
+    if (pa_memblock_ref_is_one(c->memblock) &&
+        !pa_memblock_is_read_only(c->memblock)) {
+        *dst = *c;
+        pa_memblock_ref(dst->memblock);
+        pa_memblock_clear_silence(dst->memblock, dst->index, dst->length);
+        pa_memblock_drop_planar(dst->memblock);
+        return dst;
+    }
+
+    dst->memblock = pa_memblock_new(pa_memblock_get_pool(c->memblock), c->length);
+    dst->index = 0;
+    dst->length = c->length;
+
+    return dst;
+}
+
+size_t pa_memchunk_get_silence(const pa_memchunk *c, size_t offset, bool *silent) {
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(offset < c->length);
+    pa_assert(silent);
+
+    return pa_memblock_get_silence(c->memblock, c->index + offset, c->length - offset, silent);
+}
+
+bool pa_memchunk_is_silence(const pa_memchunk *c) {
+    bool silent;
+
+    pa_assert(c);
+
+    if (!c->memblock || c->length <= 0)
+        return false;
+
+    return pa_memchunk_get_silence(c, 0, &silent) == c->length && silent;
+}
+
 bool pa_memchunk_isset(pa_memchunk *chunk) {
     pa_assert(chunk);
 
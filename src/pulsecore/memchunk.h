@@ -37,9 +37,20 @@ struct pa_memchunk {
  * exclusive access to the memblock and it is not read-only. If needed
  * the memblock in the structure is replaced by a copy. If min is not
  * 0 it is made sure that the returned memblock is at least of the
- * specified size, i.e. is enlarged if necessary. */
+ * specified size, i.e. is enlarged if necessary. The silence marked in
+ * the chunk is kept, callers that change the data in a way that
+ * doesn't keep silence silent need to clear it. A planar copy of the
+ * data is dropped. */
 pa_memchunk* pa_memchunk_make_writable(pa_memchunk *c, size_t min);
 
+/* Set up dst as the output of processing the data in c. If the caller
+ * has exclusive access to the memblock of c and it is not read-only, dst
+ * refers to the same data, so that it can be processed in place.
+ * Otherwise dst gets a fresh memblock of the same length. Unlike
+ * pa_memchunk_make_writable() this never copies anything. No silence is
+ * marked in dst, and it has no planar copy. */
+pa_memchunk* pa_memchunk_make_output(pa_memchunk *dst, const pa_memchunk *c);
+
 /* Invalidate a memchunk. This does not free the containing memblock,
  * but sets all members to zero. */
 pa_memchunk* pa_memchunk_reset(pa_memchunk *c);
@@ -47,9 +58,17 @@ pa_memchunk* pa_memchunk_reset(pa_memchunk *c);
 /* Map a memory chunk back into memory if it was swapped out */
 pa_memchunk *pa_memchunk_will_need(const pa_memchunk *c);
 
-/* Copy the data in the src memchunk to the dst memchunk */
+/* Copy the data in the src memchunk to the dst memchunk, along with
+ * the silence marked in it */
 pa_memchunk* pa_memchunk_memcpy(pa_memchunk *dst, pa_memchunk *src);
 
+/* Like pa_memblock_get_silence(), starting at offset bytes into the
+ * chunk up to its end */
+size_t pa_memchunk_get_silence(const pa_memchunk *c, size_t offset, bool *silent);
+
+/* Return true if all of the chunk is known to be silence */
+bool pa_memchunk_is_silence(const pa_memchunk *c);
+
 /* Return true if any field is set != 0 */
 bool pa_memchunk_isset(pa_memchunk *c);
 
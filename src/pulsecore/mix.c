@@ -35,6 +35,9 @@
 
 #define VOLUME_PADDING 32
 
+/* pa_mix() only skips silence if there are no more streams than this */
+#define SKIP_STREAMS_MAX 32
+
 static void calc_linear_integer_volume(int32_t linear[], const pa_cvolume *volume) {
     unsigned channel, nchannels, padding;
 
@@ -606,10 +609,58 @@ static pa_do_mix_func_t do_mix_table[] = {
 };
 
 void pa_mix_func_init(const pa_cpu_info *cpu_info) {
-    if (cpu_info->force_generic_code)
+    do_mix_table[PA_SAMPLE_S32NE] = (pa_do_mix_func_t) pa_mix_s32ne_c;
+    do_mix_table[PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_float32ne_c;
+
+    if (cpu_info->force_generic_code) {
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_generic_s16ne;
-    else
-        do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
+        return;
+    }
+
+    do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
+
+    /* The optimized functions are installed here rather than from
+     * pa_cpu_init_x86()/pa_cpu_init_arm(), as those run before us */
+#if defined (__i386__) || defined (__amd64__)
+    if (cpu_info->cpu_type == PA_CPU_X86) {
+#ifdef HAVE_SSE4_1
+        if (cpu_info->flags.x86 & PA_CPU_X86_SSE4_1)
+            pa_mix_func_init_sse4_1(cpu_info->flags.x86);
+#endif
+#ifdef HAVE_AVX2
+        if (cpu_info->flags.x86 & PA_CPU_X86_AVX2)
+            pa_mix_func_init_avx2(cpu_info->flags.x86);
+#endif
+    }
+#endif
+
+#if defined (__arm__) && defined (HAVE_NEON)
+    if (cpu_info->cpu_type == PA_CPU_ARM && (cpu_info->flags.arm & PA_CPU_ARM_NEON))
+        pa_mix_func_init_neon(cpu_info->flags.arm);
+#endif
+}
+
+/* Returns how many bytes starting at offset of c are either all silence
+ * or all not, as a multiple of the frame size fs. Frames that are only
+ * partly known to be silence count as not silent. */
+static size_t silence_run(const pa_memchunk *c, size_t offset, size_t max, size_t fs, bool *silent) {
+    size_t l;
+
+    l = PA_MIN(pa_memchunk_get_silence(c, offset, silent), max);
+
+    if (*silent) {
+        l -= l % fs;
+
+        if (l <= 0) {
+            *silent = false;
+            l = fs;
+        }
+    } else {
+        l = PA_ROUND_UP(l, fs);
+        l = PA_MIN(l, max);
+    }
+
+    return l;
 }
 
 size_t pa_mix(
@@ -622,6 +673,10 @@ size_t pa_mix(
         bool mute) {
 
     pa_cvolume full_volume;
+    pa_mix_info active[SKIP_STREAMS_MAX];
+    bool silent[SKIP_STREAMS_MAX];
+    void *base[SKIP_STREAMS_MAX];
+    size_t fs, p, n;
     unsigned k;
 
     pa_assert(streams);
@@ -641,11 +696,59 @@ size_t pa_mix(
     for (k = 0; k < nstreams; k++) {
         pa_assert(length <= streams[k].chunk.length);
         streams[k].ptr = pa_memblock_acquire_chunk(&streams[k].chunk);
+        streams[k].skipped = 0;
     }
 
     calc_stream_volumes_table[spec->format](streams, nstreams, volume, spec);
-    do_mix_table[spec->format](streams, nstreams, spec->channels, data, length);
 
+    if (nstreams > SKIP_STREAMS_MAX) {
+        do_mix_table[spec->format](streams, nstreams, spec->channels, data, length);
+        goto finish;
+    }
+
+    /* Mix piece by piece, leaving out the streams that are known to be
+     * silent in each piece. Without any silence marked this is one
+     * piece with all streams. */
+    fs = pa_frame_size(spec);
+
+    for (k = 0; k < nstreams; k++)
+        base[k] = streams[k].ptr;
+
+    for (p = 0; p < length; p += n) {
+        unsigned n_active = 0;
+
+        n = length - p;
+
+        for (k = 0; k < nstreams; k++)
+            n = silence_run(&streams[k].chunk, p, n, fs, &silent[k]);
+
+        /* Some mixing functions advance the pointers and some don't,
+         * so point them at this piece from scratch */
+        for (k = 0; k < nstreams; k++) {
+            streams[k].ptr = (uint8_t *) base[k] + p;
+
+            if (silent[k])
+                streams[k].skipped += n;
+            else
+                n_active++;
+        }
+
+        if (n_active == 0)
+            pa_silence_memory((uint8_t *) data + p, n, spec);
+        else if (n_active == nstreams)
+            do_mix_table[spec->format](streams, nstreams, spec->channels, (uint8_t *) data + p, (unsigned) n);
+        else {
+            unsigned j = 0;
+
+            for (k = 0; k < nstreams; k++)
+                if (!silent[k])
+                    active[j++] = streams[k];
+
+            do_mix_table[spec->format](active, n_active, spec->channels, (uint8_t *) data + p, (unsigned) n);
+        }
+    }
+
+finish:
     for (k = 0; k < nstreams; k++)
         pa_memblock_release(streams[k].chunk.memblock);
 
@@ -695,6 +798,7 @@ void pa_volume_memchunk(
     void *ptr;
     volume_val linear[PA_CHANNELS_MAX + VOLUME_PADDING];
     pa_do_volume_func_t do_volume;
+    size_t fs, p, l;
 
     pa_assert(c);
     pa_assert(spec);
@@ -702,7 +806,7 @@ void pa_volume_memchunk(
     pa_assert(pa_frame_aligned(c->length, spec));
     pa_assert(volume);
 
-    if (pa_memblock_is_silence(c->memblock))
+    if (pa_memchunk_is_silence(c))
         return;
 
     if (pa_cvolume_is_norm(volume))
@@ -719,8 +823,17 @@ void pa_volume_memchunk(
     calc_volume_table[spec->format] ((void *)linear, volume);
 
     ptr = pa_memblock_acquire_chunk(c);
+    fs = pa_frame_size(spec);
+
+    /* Silence stays silence */
+    for (p = 0; p < c->length; p += l) {
+        bool silent;
 
-    do_volume(ptr, (void *)linear, spec->channels, c->length);
+        l = silence_run(c, p, c->length - p, fs, &silent);
+
+        if (!silent)
+            do_volume((uint8_t *) ptr + p, (void *)linear, spec->channels, l);
+    }
 
     pa_memblock_release(c->memblock);
 }
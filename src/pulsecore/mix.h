@@ -31,6 +31,10 @@ typedef struct pa_mix_info {
     pa_cvolume volume;
     void *userdata;
 
+    /* Set by pa_mix() to the number of bytes of this stream that were
+     * known to be silence and hence not mixed */
+    size_t skipped;
+
     /* The following fields are used internally by pa_mix(), should
      * not be initialised by the caller of pa_mix(). */
     void *ptr;
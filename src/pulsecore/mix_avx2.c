@@ -0,0 +1,304 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#include <immintrin.h>
+
+/* The mixing functions below work on blocks of BLOCK_SAMPLES samples:
+ * the contributions of all streams are accumulated in a block-sized
+ * buffer one stream at a time, and the result is clamped and stored
+ * at the end. That keeps the accumulator in L1 and reads each stream
+ * sequentially, which is what makes this scale with many streams.
+ *
+ * All functions give bit-identical results to the C versions in
+ * mix.c. Streams are accumulated in the same order and the fixed
+ * point multiplications are computed exactly. */
+
+#define BLOCK_SAMPLES 256U
+
+/* Fill vol[] so that vol[c], ..., vol[c+7] are the volumes of the
+ * eight samples starting at channel c */
+static void fill_volumes_i(int32_t *vol, const pa_mix_info *m, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < channels + 7; i++)
+        vol[i] = m->linear[i % channels].i;
+}
+
+static void fill_volumes_f(float *vol, const pa_mix_info *m, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < channels + 7; i++)
+        vol[i] = m->linear[i % channels].f;
+}
+
+/* Mix the remaining samples at the end of the buffer, starting at
+ * the given channel */
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                           unsigned offset, int16_t *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            int32_t cv = streams[i].linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += pa_mult_s16_volume(((int16_t *) streams[i].ptr)[offset], cv);
+        }
+
+        *data++ = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                           unsigned offset, int32_t *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            int32_t cv = streams[i].linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += (((int32_t *) streams[i].ptr)[offset] * (int64_t) cv) >> 16;
+        }
+
+        *data++ = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                               unsigned offset, float *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            float cv = streams[i].linear[channel].f;
+
+            if (PA_LIKELY(cv > 0))
+                sum += ((float *) streams[i].ptr)[offset] * cv;
+        }
+
+        *data++ = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void pa_mix_s16ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(32, int32_t, acc[BLOCK_SAMPLES]);
+    int32_t vol_hi[PA_CHANNELS_MAX + 8], vol_lo[PA_CHANNELS_MAX + 8];
+    const unsigned step = 8 % channels;
+    unsigned n = length / sizeof(int16_t), offset = 0, channel = 0;
+
+    while (n >= 16) {
+        unsigned block = PA_MIN(n & ~15U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        memset(acc, 0, block * sizeof(int32_t));
+
+        for (i = 0; i < nstreams; i++) {
+            const int16_t *src = (const int16_t *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            /* (v * cv) >> 16 needs 48 bits. Splitting cv into its
+             * high and low 16 bits, it's v * hi + ((v * lo) >> 16)
+             * which can be computed exactly with 32 bit lanes */
+            fill_volumes_i(vol_hi, &streams[i], channels);
+            for (j = 0; j < channels + 7; j++) {
+                vol_lo[j] = vol_hi[j] & 0xFFFF;
+                vol_hi[j] >>= 16;
+            }
+
+            for (j = 0; j < block; j += 8) {
+                __m256i v, t, a;
+
+                v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + j)));
+                t = _mm256_srai_epi32(_mm256_mullo_epi32(v, _mm256_loadu_si256((const __m256i *) (vol_lo + c))), 16);
+                t = _mm256_add_epi32(t, _mm256_mullo_epi32(v, _mm256_loadu_si256((const __m256i *) (vol_hi + c))));
+
+                a = _mm256_load_si256((const __m256i *) (acc + j));
+                _mm256_store_si256((__m256i *) (acc + j), _mm256_add_epi32(a, t));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        for (j = 0; j < block; j += 16) {
+            __m256i s;
+
+            /* packs works within 128 bit lanes, so fix up the order */
+            s = _mm256_packs_epi32(_mm256_load_si256((const __m256i *) (acc + j)),
+                                   _mm256_load_si256((const __m256i *) (acc + j + 8)));
+            s = _mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i *) (data + j), s);
+        }
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+/* Arithmetic shift right by 16 of signed 64 bit lanes, which AVX2
+ * lacks: bias to unsigned, shift logically and remove the bias */
+static inline __m256i srai16_epi64(__m256i p) {
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i bias = _mm256_set1_epi64x(INT64_C(1) << 47);
+
+    return _mm256_sub_epi64(_mm256_srli_epi64(_mm256_xor_si256(p, sign), 16), bias);
+}
+
+static inline __m256i clamp_s32_epi64(__m256i s) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x80000000LL);
+
+    s = _mm256_blendv_epi8(s, max, _mm256_cmpgt_epi64(s, max));
+    return _mm256_blendv_epi8(s, min, _mm256_cmpgt_epi64(min, s));
+}
+
+static void pa_mix_s32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    /* Even and odd samples of each group of 8 are kept in separate
+     * vectors of 64 bit sums */
+    PA_DECLARE_ALIGNED(32, int64_t, acc[BLOCK_SAMPLES]);
+    int32_t vol[PA_CHANNELS_MAX + 8];
+    const unsigned step = 8 % channels;
+    unsigned n = length / sizeof(int32_t), offset = 0, channel = 0;
+
+    while (n >= 8) {
+        unsigned block = PA_MIN(n & ~7U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        memset(acc, 0, block * sizeof(int64_t));
+
+        for (i = 0; i < nstreams; i++) {
+            const int32_t *src = (const int32_t *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            fill_volumes_i(vol, &streams[i], channels);
+
+            for (j = 0; j < block; j += 8) {
+                __m256i v, cv, even, odd;
+
+                v = _mm256_loadu_si256((const __m256i *) (src + j));
+                cv = _mm256_loadu_si256((const __m256i *) (vol + c));
+
+                even = srai16_epi64(_mm256_mul_epi32(v, cv));
+                odd = srai16_epi64(_mm256_mul_epi32(_mm256_srli_epi64(v, 32), _mm256_srli_epi64(cv, 32)));
+
+                _mm256_store_si256((__m256i *) (acc + j),
+                                   _mm256_add_epi64(_mm256_load_si256((const __m256i *) (acc + j)), even));
+                _mm256_store_si256((__m256i *) (acc + j + 4),
+                                   _mm256_add_epi64(_mm256_load_si256((const __m256i *) (acc + j + 4)), odd));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        for (j = 0; j < block; j += 8) {
+            __m256i even, odd;
+
+            even = clamp_s32_epi64(_mm256_load_si256((const __m256i *) (acc + j)));
+            odd = clamp_s32_epi64(_mm256_load_si256((const __m256i *) (acc + j + 4)));
+
+            _mm256_storeu_si256((__m256i *) (data + j),
+                                _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA));
+        }
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+static void pa_mix_float32ne_avx2(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    float vol[PA_CHANNELS_MAX + 8];
+    const unsigned step = 8 % channels;
+    unsigned n = length / sizeof(float), offset = 0, channel = 0;
+
+    while (n >= 8) {
+        unsigned block = PA_MIN(n & ~7U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        /* Accumulate right in the output buffer */
+        memset(data, 0, block * sizeof(float));
+
+        for (i = 0; i < nstreams; i++) {
+            const float *src = (const float *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            fill_volumes_f(vol, &streams[i], channels);
+
+            for (j = 0; j < block; j += 8) {
+                __m256 t;
+
+                t = _mm256_mul_ps(_mm256_loadu_ps(src + j), _mm256_loadu_ps(vol + c));
+                _mm256_storeu_ps(data + j, _mm256_add_ps(_mm256_loadu_ps(data + j), t));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+void pa_mix_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized mixing functions.");
+
+    pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_avx2);
+    pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_avx2);
+    pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_avx2);
+}
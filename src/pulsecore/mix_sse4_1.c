@@ -0,0 +1,276 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+#include "mix.h"
+
+#include <smmintrin.h>
+
+/* Same structure as the AVX2 functions in mix_avx2.c, with four
+ * samples per vector: streams are accumulated one at a time into a
+ * block-sized buffer, giving bit-identical results to mix.c. */
+
+#define BLOCK_SAMPLES 256U
+
+/* Fill vol[] so that vol[c], ..., vol[c+3] are the volumes of the
+ * four samples starting at channel c */
+static void fill_volumes_i(int32_t *vol, const pa_mix_info *m, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < channels + 3; i++)
+        vol[i] = m->linear[i % channels].i;
+}
+
+static void fill_volumes_f(float *vol, const pa_mix_info *m, unsigned channels) {
+    unsigned i;
+
+    for (i = 0; i < channels + 3; i++)
+        vol[i] = m->linear[i % channels].f;
+}
+
+static void mix_s16ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                           unsigned offset, int16_t *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        int32_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            int32_t cv = streams[i].linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += pa_mult_s16_volume(((int16_t *) streams[i].ptr)[offset], cv);
+        }
+
+        *data++ = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_s32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                           unsigned offset, int32_t *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        int64_t sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            int32_t cv = streams[i].linear[channel].i;
+
+            if (PA_LIKELY(cv > 0))
+                sum += (((int32_t *) streams[i].ptr)[offset] * (int64_t) cv) >> 16;
+        }
+
+        *data++ = (int32_t) PA_CLAMP_UNLIKELY(sum, -0x80000000LL, 0x7FFFFFFFLL);
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void mix_float32ne_tail(pa_mix_info streams[], unsigned nstreams, unsigned channels, unsigned channel,
+                               unsigned offset, float *data, unsigned n) {
+    for (; n > 0; n--, offset++) {
+        float sum = 0;
+        unsigned i;
+
+        for (i = 0; i < nstreams; i++) {
+            float cv = streams[i].linear[channel].f;
+
+            if (PA_LIKELY(cv > 0))
+                sum += ((float *) streams[i].ptr)[offset] * cv;
+        }
+
+        *data++ = sum;
+
+        if (PA_UNLIKELY(++channel >= channels))
+            channel = 0;
+    }
+}
+
+static void pa_mix_s16ne_sse4_1(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
+    PA_DECLARE_ALIGNED(16, int32_t, acc[BLOCK_SAMPLES]);
+    int32_t vol_hi[PA_CHANNELS_MAX + 4], vol_lo[PA_CHANNELS_MAX + 4];
+    const unsigned step = 4 % channels;
+    unsigned n = length / sizeof(int16_t), offset = 0, channel = 0;
+
+    while (n >= 8) {
+        unsigned block = PA_MIN(n & ~7U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        memset(acc, 0, block * sizeof(int32_t));
+
+        for (i = 0; i < nstreams; i++) {
+            const int16_t *src = (const int16_t *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            /* See pa_mix_s16ne_avx2() */
+            fill_volumes_i(vol_hi, &streams[i], channels);
+            for (j = 0; j < channels + 3; j++) {
+                vol_lo[j] = vol_hi[j] & 0xFFFF;
+                vol_hi[j] >>= 16;
+            }
+
+            for (j = 0; j < block; j += 4) {
+                __m128i v, t;
+
+                v = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (src + j)));
+                t = _mm_srai_epi32(_mm_mullo_epi32(v, _mm_loadu_si128((const __m128i *) (vol_lo + c))), 16);
+                t = _mm_add_epi32(t, _mm_mullo_epi32(v, _mm_loadu_si128((const __m128i *) (vol_hi + c))));
+
+                _mm_store_si128((__m128i *) (acc + j), _mm_add_epi32(_mm_load_si128((const __m128i *) (acc + j)), t));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        for (j = 0; j < block; j += 8)
+            _mm_storeu_si128((__m128i *) (data + j),
+                             _mm_packs_epi32(_mm_load_si128((const __m128i *) (acc + j)),
+                                             _mm_load_si128((const __m128i *) (acc + j + 4))));
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_s16ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+/* Arithmetic shift right by 16 of signed 64 bit lanes */
+static inline __m128i srai16_epi64(__m128i p) {
+    const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+    const __m128i bias = _mm_set1_epi64x(INT64_C(1) << 47);
+
+    return _mm_sub_epi64(_mm_srli_epi64(_mm_xor_si128(p, sign), 16), bias);
+}
+
+static void pa_mix_s32ne_sse4_1(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    /* Even and odd samples of each group of 4 are kept in separate
+     * vectors of 64 bit sums */
+    PA_DECLARE_ALIGNED(16, int64_t, acc[BLOCK_SAMPLES]);
+    int32_t vol[PA_CHANNELS_MAX + 4];
+    const unsigned step = 4 % channels;
+    unsigned n = length / sizeof(int32_t), offset = 0, channel = 0;
+
+    while (n >= 4) {
+        unsigned block = PA_MIN(n & ~3U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        memset(acc, 0, block * sizeof(int64_t));
+
+        for (i = 0; i < nstreams; i++) {
+            const int32_t *src = (const int32_t *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            fill_volumes_i(vol, &streams[i], channels);
+
+            for (j = 0; j < block; j += 4) {
+                __m128i v, cv, even, odd;
+
+                v = _mm_loadu_si128((const __m128i *) (src + j));
+                cv = _mm_loadu_si128((const __m128i *) (vol + c));
+
+                even = srai16_epi64(_mm_mul_epi32(v, cv));
+                odd = srai16_epi64(_mm_mul_epi32(_mm_srli_epi64(v, 32), _mm_srli_epi64(cv, 32)));
+
+                _mm_store_si128((__m128i *) (acc + j),
+                                _mm_add_epi64(_mm_load_si128((const __m128i *) (acc + j)), even));
+                _mm_store_si128((__m128i *) (acc + j + 2),
+                                _mm_add_epi64(_mm_load_si128((const __m128i *) (acc + j + 2)), odd));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        /* There is no 64 bit compare before SSE4.2, so clamp in C */
+        for (j = 0; j < block; j += 4) {
+            data[j] = (int32_t) PA_CLAMP_UNLIKELY(acc[j], -0x80000000LL, 0x7FFFFFFFLL);
+            data[j + 1] = (int32_t) PA_CLAMP_UNLIKELY(acc[j + 2], -0x80000000LL, 0x7FFFFFFFLL);
+            data[j + 2] = (int32_t) PA_CLAMP_UNLIKELY(acc[j + 1], -0x80000000LL, 0x7FFFFFFFLL);
+            data[j + 3] = (int32_t) PA_CLAMP_UNLIKELY(acc[j + 3], -0x80000000LL, 0x7FFFFFFFLL);
+        }
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_s32ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+static void pa_mix_float32ne_sse4_1(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    float vol[PA_CHANNELS_MAX + 4];
+    const unsigned step = 4 % channels;
+    unsigned n = length / sizeof(float), offset = 0, channel = 0;
+
+    while (n >= 4) {
+        unsigned block = PA_MIN(n & ~3U, BLOCK_SAMPLES);
+        unsigned i, j;
+
+        memset(data, 0, block * sizeof(float));
+
+        for (i = 0; i < nstreams; i++) {
+            const float *src = (const float *) streams[i].ptr + offset;
+            unsigned c = channel;
+
+            fill_volumes_f(vol, &streams[i], channels);
+
+            for (j = 0; j < block; j += 4) {
+                __m128 t;
+
+                t = _mm_mul_ps(_mm_loadu_ps(src + j), _mm_loadu_ps(vol + c));
+                _mm_storeu_ps(data + j, _mm_add_ps(_mm_loadu_ps(data + j), t));
+
+                c += step;
+                if (c >= channels)
+                    c -= channels;
+            }
+        }
+
+        data += block;
+        offset += block;
+        n -= block;
+        channel = (channel + block) % channels;
+    }
+
+    mix_float32ne_tail(streams, nstreams, channels, channel, offset, data, n);
+}
+
+void pa_mix_func_init_sse4_1(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising SSE4.1 optimized mixing functions.");
+
+    pa_set_mix_func(PA_SAMPLE_S16NE, (pa_do_mix_func_t) pa_mix_s16ne_sse4_1);
+    pa_set_mix_func(PA_SAMPLE_S32NE, (pa_do_mix_func_t) pa_mix_s32ne_sse4_1);
+    pa_set_mix_func(PA_SAMPLE_FLOAT32NE, (pa_do_mix_func_t) pa_mix_float32ne_sse4_1);
+}
@@ -183,6 +183,11 @@ enum {
     PA_COMMAND_SET_SINK_LATENCY_OFFSET,
     PA_COMMAND_SET_SOURCE_LATENCY_OFFSET,
 
+    PA_COMMAND_GET_SINK_TIMING_INFO,
+    PA_COMMAND_GET_SOURCE_TIMING_INFO,
+    PA_COMMAND_GET_SINK_INPUT_TIMING_INFO,
+    PA_COMMAND_GET_SOURCE_OUTPUT_TIMING_INFO,
+
     PA_COMMAND_MAX
 };
 
@@ -34,7 +34,7 @@
 
 struct pa_packet {
     PA_REFCNT_DECLARE;
-    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC } type;
+    enum { PA_PACKET_APPENDED, PA_PACKET_DYNAMIC, PA_PACKET_FIXED } type;
     size_t length;
     uint8_t *data;
     union {
@@ -91,6 +91,22 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     return p;
 }
 
+pa_packet* pa_packet_new_fixed(const void* data, size_t length) {
+    pa_packet *p;
+
+    pa_assert(data);
+    pa_assert(length > 0);
+
+    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(packets))))
+        p = pa_xnew(pa_packet, 1);
+    PA_REFCNT_INIT(p);
+    p->length = length;
+    p->data = (uint8_t*) data;
+    p->type = PA_PACKET_FIXED;
+
+    return p;
+}
+
 const void* pa_packet_data(pa_packet *p, size_t *l) {
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
     pa_assert(p->data);
@@ -37,6 +37,10 @@ pa_packet* pa_packet_new_data(const void* data, size_t length);
  * i.e. memory is free()d with the packet */
 pa_packet* pa_packet_new_dynamic(void* data, size_t length);
 
+/* create packet pointing to data owned by the caller, which has to stay
+ * valid as long as the packet is referenced. No copy is made. */
+pa_packet* pa_packet_new_fixed(const void* data, size_t length);
+
 const void* pa_packet_data(pa_packet *p, size_t *l);
 
 pa_packet* pa_packet_ref(pa_packet *p);
@@ -199,6 +199,11 @@ static const char *command_names[PA_COMMAND_MAX] = {
     /* Supported since protocol v31 (9.0) */
     [PA_COMMAND_SET_SINK_LATENCY_OFFSET] = "SET_SINK_LATENCY_OFFSET",
     [PA_COMMAND_SET_SOURCE_LATENCY_OFFSET] = "SET_SOURCE_LATENCY_OFFSET",
+
+    [PA_COMMAND_GET_SINK_TIMING_INFO] = "GET_SINK_TIMING_INFO",
+    [PA_COMMAND_GET_SOURCE_TIMING_INFO] = "GET_SOURCE_TIMING_INFO",
+    [PA_COMMAND_GET_SINK_INPUT_TIMING_INFO] = "GET_SINK_INPUT_TIMING_INFO",
+    [PA_COMMAND_GET_SOURCE_OUTPUT_TIMING_INFO] = "GET_SOURCE_OUTPUT_TIMING_INFO",
 };
 
 #endif
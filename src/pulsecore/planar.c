@@ -0,0 +1,140 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "planar.h"
+
+/* The planes are allocated together, each starting on a cache line */
+#define PLANE_ALIGN 64
+
+static void alloc_planes(pa_planar *p, size_t n_frames) {
+    size_t stride;
+    uint8_t *d;
+    unsigned c;
+
+    stride = PA_ROUND_UP(n_frames * sizeof(float), PLANE_ALIGN);
+    p->buffer = pa_xmalloc(stride * p->channels + PLANE_ALIGN);
+    d = (uint8_t *) PA_ROUND_UP((uintptr_t) p->buffer, PLANE_ALIGN);
+
+    for (c = 0; c < p->channels; c++)
+        p->data[c] = (float *) (d + c * stride);
+
+    p->n_frames = n_frames;
+}
+
+pa_planar *pa_planar_new(unsigned channels, size_t n_frames) {
+    pa_planar *p;
+
+    pa_assert(channels > 0);
+    pa_assert(channels <= PA_CHANNELS_MAX);
+
+    p = pa_xnew0(pa_planar, 1);
+    p->channels = channels;
+
+    if (n_frames > 0)
+        alloc_planes(p, n_frames);
+
+    return p;
+}
+
+void pa_planar_free(pa_planar *p) {
+    pa_assert(p);
+
+    pa_xfree(p->buffer);
+    pa_xfree(p);
+}
+
+void pa_planar_ensure(pa_planar *p, size_t n_frames) {
+    pa_assert(p);
+
+    if (n_frames <= p->n_frames)
+        return;
+
+    pa_xfree(p->buffer);
+    alloc_planes(p, n_frames);
+}
+
+void pa_planar_from_memchunk(pa_planar *buf, const pa_memchunk *c, const float *planes[]) {
+    pa_planar *copy;
+    size_t fs, n, offset;
+    const float *src;
+    unsigned i;
+
+    pa_assert(buf);
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(planes);
+
+    fs = buf->channels * sizeof(float);
+    pa_assert(c->length % fs == 0);
+    n = c->length / fs;
+
+    if ((copy = pa_memblock_get_planar(c->memblock, c->index, c->length, &offset)) &&
+        copy->channels == buf->channels &&
+        offset % fs == 0) {
+
+        for (i = 0; i < buf->channels; i++)
+            planes[i] = copy->data[i] + offset / fs;
+
+        return;
+    }
+
+    pa_planar_ensure(buf, n);
+
+    for (i = 0; i < buf->channels; i++)
+        planes[i] = buf->data[i];
+
+    if (n <= 0)
+        return;
+
+    src = pa_memblock_acquire_chunk(c);
+    pa_deinterleave(src, (void **) buf->data, buf->channels, sizeof(float), (unsigned) n);
+    pa_memblock_release(c->memblock);
+}
+
+void pa_planar_to_memchunk(pa_planar *p, pa_memchunk *c) {
+    size_t fs, n;
+    float *dst;
+
+    pa_assert(p);
+    pa_assert(c);
+    pa_assert(c->memblock);
+
+    fs = p->channels * sizeof(float);
+    pa_assert(c->length % fs == 0);
+    n = c->length / fs;
+    pa_assert(n <= p->n_frames);
+
+    if (n <= 0) {
+        pa_planar_free(p);
+        return;
+    }
+
+    dst = pa_memblock_acquire_chunk(c);
+    pa_interleave((const void **) p->data, p->channels, dst, sizeof(float), (unsigned) n);
+    pa_memblock_release(c->memblock);
+
+    pa_memblock_set_planar(c->memblock, c->index, c->length, p);
+}
@@ -0,0 +1,55 @@
+#ifndef fooplanarhfoo
+#define fooplanarhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/memblock.h>
+#include <pulsecore/memchunk.h>
+
+/* Float samples with one plane per channel, for filters that process
+ * each channel on its own. n_frames is the room in each plane. */
+struct pa_planar {
+    unsigned channels;
+    size_t n_frames;
+    float *data[PA_CHANNELS_MAX];
+
+    void *buffer; /* where the planes are allocated */
+};
+
+pa_planar *pa_planar_new(unsigned channels, size_t n_frames);
+void pa_planar_free(pa_planar *p);
+
+/* Make room for at least n_frames in each plane. What was in the
+ * planes is lost if they need to grow. */
+void pa_planar_ensure(pa_planar *p, size_t n_frames);
+
+/* Get the float32ne data of c as planes, one for each channel of buf.
+ * If the memblock of c carries a planar copy of the data, the planes
+ * point into it and nothing is copied. Otherwise the data is
+ * deinterleaved into buf, which is grown as needed. The planes are
+ * valid as long as buf and the reference to c are. */
+void pa_planar_from_memchunk(pa_planar *buf, const pa_memchunk *c, const float *planes[]);
+
+/* Interleave the first frames of p into c, as many as fit, and attach
+ * p to the memblock of c as its planar copy. c must be writable, and
+ * p belongs to the memblock afterwards. */
+void pa_planar_to_memchunk(pa_planar *p, pa_memchunk *c);
+
+#endif
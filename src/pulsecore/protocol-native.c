@@ -71,6 +71,9 @@
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
 
+/* The shortest silence worth marking when detect-silence is enabled */
+#define SILENCE_DETECT_MIN_USEC (5*PA_USEC_PER_MSEC)
+
 struct pa_native_protocol;
 
 typedef struct record_stream {
@@ -269,6 +272,7 @@ static void command_finish_upload_stream(pa_pdispatch *pd, uint32_t command, uin
 static void command_play_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_timing_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -402,6 +406,11 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SINK_LATENCY_OFFSET] = command_set_sink_latency_offset,
     [PA_COMMAND_SET_SOURCE_LATENCY_OFFSET] = command_set_source_latency_offset,
 
+    [PA_COMMAND_GET_SINK_TIMING_INFO] = command_get_timing_info,
+    [PA_COMMAND_GET_SOURCE_TIMING_INFO] = command_get_timing_info,
+    [PA_COMMAND_GET_SINK_INPUT_TIMING_INFO] = command_get_timing_info,
+    [PA_COMMAND_GET_SOURCE_OUTPUT_TIMING_INFO] = command_get_timing_info,
+
     [PA_COMMAND_ENABLE_SRBCHANNEL] = command_enable_srbchannel,
 
     [PA_COMMAND_EXTENSION] = command_extension
@@ -2595,6 +2604,7 @@ static void setup_srbchannel(pa_native_connection *c) {
     pa_memchunk mc;
     pa_tagstruct *t;
     int fdlist[2];
+    size_t size;
 
     if (!c->options->srbchannel) {
         pa_log_debug("Disabling srbchannel, reason: Must be enabled by module parameter");
@@ -2616,12 +2626,18 @@ static void setup_srbchannel(pa_native_connection *c) {
         return;
     }
 
-    srb = pa_srbchannel_new(c->protocol->core->mainloop, c->protocol->core->rw_mempool);
+    size = c->options->srbchannel_size;
+    if (size != (size_t) -1 && size > pa_mempool_block_size_largest(c->protocol->core->rw_mempool)) {
+        pa_log_debug("srbchannel-size=%zu does not fit in the rw memory pool, using the default size", size);
+        size = (size_t) -1;
+    }
+
+    srb = pa_srbchannel_new(c->protocol->core->mainloop, c->protocol->core->rw_mempool, size);
     if (!srb) {
         pa_log_debug("Failed to create srbchannel");
         return;
     }
-    pa_log_debug("Enabling srbchannel...");
+    pa_log_debug("Enabling srbchannel with a capacity of 2 * %lu bytes...", (unsigned long) pa_srbchannel_get_capacity(srb));
     pa_srbchannel_export(srb, &srbt);
 
     /* Send enable command to client */
@@ -3636,6 +3652,105 @@ static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, p
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+static void histogram_fill_tagstruct(pa_tagstruct *t, const char *name, const pa_histogram *h) {
+    unsigned i;
+
+    pa_tagstruct_puts(t, name);
+    pa_tagstruct_putu64(t, h->count);
+    pa_tagstruct_put_usec(t, h->total);
+    pa_tagstruct_put_usec(t, h->max);
+    pa_tagstruct_putu32(t, PA_HISTOGRAM_BUCKETS);
+
+    for (i = 0; i < PA_HISTOGRAM_BUCKETS; i++)
+        pa_tagstruct_putu32(t, h->buckets[i]);
+}
+
+static void command_get_timing_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    uint32_t idx;
+    pa_tagstruct *reply;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu32(t, &idx) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, c->version >= 32, tag, PA_ERR_NOTSUPPORTED);
+    CHECK_VALIDITY(c->pstream, idx != PA_INVALID_INDEX, tag, PA_ERR_INVALID);
+
+    if (command == PA_COMMAND_GET_SINK_TIMING_INFO) {
+        pa_sink *sink;
+        pa_sink_timing timing;
+
+        sink = pa_idxset_get_by_index(c->protocol->core->sinks, idx);
+        CHECK_VALIDITY(c->pstream, sink && PA_SINK_IS_LINKED(sink->state), tag, PA_ERR_NOENTITY);
+
+        pa_sink_get_timing(sink, &timing);
+
+        reply = reply_new(tag);
+        pa_tagstruct_putu32(reply, idx);
+        pa_tagstruct_putu32(reply, 3);
+        histogram_fill_tagstruct(reply, "render", &timing.render);
+        histogram_fill_tagstruct(reply, "sleep", &timing.sleep);
+        histogram_fill_tagstruct(reply, "late", &timing.late);
+
+    } else if (command == PA_COMMAND_GET_SOURCE_TIMING_INFO) {
+        pa_source *source;
+        pa_source_timing timing;
+
+        source = pa_idxset_get_by_index(c->protocol->core->sources, idx);
+        CHECK_VALIDITY(c->pstream, source && PA_SOURCE_IS_LINKED(source->state), tag, PA_ERR_NOENTITY);
+
+        pa_source_get_timing(source, &timing);
+
+        reply = reply_new(tag);
+        pa_tagstruct_putu32(reply, idx);
+        pa_tagstruct_putu32(reply, 3);
+        histogram_fill_tagstruct(reply, "post", &timing.post);
+        histogram_fill_tagstruct(reply, "sleep", &timing.sleep);
+        histogram_fill_tagstruct(reply, "late", &timing.late);
+
+    } else if (command == PA_COMMAND_GET_SINK_INPUT_TIMING_INFO) {
+        pa_sink_input *si;
+        pa_sink_input_timing timing;
+
+        si = pa_idxset_get_by_index(c->protocol->core->sink_inputs, idx);
+        CHECK_VALIDITY(c->pstream, si && PA_SINK_INPUT_IS_LINKED(si->state), tag, PA_ERR_NOENTITY);
+
+        pa_sink_input_get_timing(si, &timing);
+
+        reply = reply_new(tag);
+        pa_tagstruct_putu32(reply, idx);
+        pa_tagstruct_putu32(reply, 2);
+        histogram_fill_tagstruct(reply, "peek", &timing.peek);
+        histogram_fill_tagstruct(reply, "resample", &timing.resample);
+
+    } else {
+        pa_source_output *so;
+        pa_source_output_timing timing;
+
+        pa_assert(command == PA_COMMAND_GET_SOURCE_OUTPUT_TIMING_INFO);
+
+        so = pa_idxset_get_by_index(c->protocol->core->source_outputs, idx);
+        CHECK_VALIDITY(c->pstream, so && PA_SOURCE_OUTPUT_IS_LINKED(so->state), tag, PA_ERR_NOENTITY);
+
+        pa_source_output_get_timing(so, &timing);
+
+        reply = reply_new(tag);
+        pa_tagstruct_putu32(reply, idx);
+        pa_tagstruct_putu32(reply, 2);
+        histogram_fill_tagstruct(reply, "push", &timing.push);
+        histogram_fill_tagstruct(reply, "resample", &timing.resample);
+    }
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_idxset *i;
@@ -5005,6 +5120,13 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
             return;
         }
 
+        /* We may only mark silence in blocks nobody else can be looking
+         * at, which is usually the case for blocks fresh from the
+         * pstream */
+        if (c->options->detect_silence && chunk->memblock && pa_memblock_ref_is_one(chunk->memblock))
+            pa_memchunk_detect_silence(chunk, &ps->sink_input->sample_spec,
+                                       pa_usec_to_bytes(SILENCE_DETECT_MIN_USEC, &ps->sink_input->sample_spec));
+
         pa_atomic_inc(&ps->seek_or_post_in_queue);
         if (chunk->memblock) {
             if (seek != PA_SEEK_RELATIVE || offset != 0)
@@ -5363,6 +5485,7 @@ pa_native_options* pa_native_options_new(void) {
     pa_native_options *o;
 
     o = pa_xnew0(pa_native_options, 1);
+    o->srbchannel_size = (size_t) -1;
     PA_REFCNT_INIT(o);
 
     return o;
@@ -5401,6 +5524,7 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
 
     pa_assert(o);
     pa_assert(PA_REFCNT_VALUE(o) >= 1);
+    pa_assert(c);
     pa_assert(ma);
 
     o->srbchannel = true;
@@ -5409,11 +5533,35 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    /* The client takes the ringbuffer layout from the block it is sent,
+     * so the size is entirely up to us */
+    o->srbchannel_size = (size_t) -1;
+    if (pa_modargs_get_value(ma, "srbchannel-size", NULL)) {
+        uint32_t size;
+        size_t size_max;
+
+        /* The ringbuffer is a single block from the pool */
+        size_max = pa_mempool_block_size_largest(c->rw_mempool ? c->rw_mempool : c->mempool);
+
+        if (pa_modargs_get_value_u32(ma, "srbchannel-size", &size) < 0 ||
+            size < PA_SRBCHANNEL_SIZE_MIN || size > size_max) {
+            pa_log("srbchannel-size= expects a size between %u and %zu bytes.", PA_SRBCHANNEL_SIZE_MIN, size_max);
+            return -1;
+        }
+
+        o->srbchannel_size = size;
+    }
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "detect-silence", &o->detect_silence) < 0) {
+        pa_log("detect-silence= expects a boolean argument.");
+        return -1;
+    }
+
     enabled = true;
     if (pa_modargs_get_value_boolean(ma, "auth-group-enable", &enabled) < 0) {
         pa_log("auth-group-enable= expects a boolean argument.");
@@ -42,7 +42,9 @@ typedef struct pa_native_options {
     pa_module *module;
 
     bool auth_anonymous;
+    bool detect_silence;
     bool srbchannel;
+    size_t srbchannel_size;
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
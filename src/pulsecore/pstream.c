@@ -75,6 +75,15 @@ typedef uint32_t pa_pstream_descriptor[PA_PSTREAM_DESCRIPTOR_MAX];
 
 #define MINIBUF_SIZE (256)
 
+/* How many queued items may be coalesced into a single write */
+#define WRITE_BATCH_MAX (16)
+
+/* Socket reads go through a buffer of this size, so that one read can
+ * pick up several frames. Large payloads are read directly into their
+ * memblock or packet when the buffer is empty. */
+#define READ_BUFFER_SIZE (64*1024)
+#define READ_DIRECT_MIN (4*1024)
+
 /* To allow uploading a single sample in one frame, this value should be the
  * same size (16 MB) as PA_SCACHE_ENTRY_SIZE_MAX from pulsecore/core-scache.h.
  */
@@ -107,6 +116,21 @@ struct item_info {
     uint32_t block_id;
 };
 
+struct pstream_write {
+    union {
+        uint8_t minibuf[MINIBUF_SIZE];
+        pa_pstream_descriptor descriptor;
+    };
+    struct item_info* current;
+    void *data;
+    size_t index;
+    int minibuf_validsize;
+    pa_memchunk memchunk;
+#ifdef HAVE_CREDS
+    bool send_ancil_data_now;
+#endif
+};
+
 struct pstream_read {
     pa_pstream_descriptor descriptor;
     pa_memblock *memblock;
@@ -129,20 +153,23 @@ struct pa_pstream {
 
     bool dead;
 
-    struct {
-        union {
-            uint8_t minibuf[MINIBUF_SIZE];
-            pa_pstream_descriptor descriptor;
-        };
-        struct item_info* current;
-        void *data;
-        size_t index;
-        int minibuf_validsize;
-        pa_memchunk memchunk;
-    } write;
+    /* Items taken off the send queue, in order. Only the first one
+     * may have been written partially. */
+    struct pstream_write write[WRITE_BATCH_MAX];
+    unsigned write_idx, write_n;
+
+    /* Write calls issued and items written, to see what batching saves */
+    uint64_t n_write_calls, n_written_items;
 
     struct pstream_read readio, readsrb;
 
+    /* Data read from the iochannel that has not been parsed yet */
+    uint8_t *read_buffer;
+    size_t read_buffer_index, read_buffer_length;
+
+    /* Read calls issued and frames received, to see what buffering saves */
+    uint64_t n_read_calls, n_read_frames;
+
     bool use_shm;
     pa_memimport *import;
     pa_memexport *export;
@@ -168,12 +195,17 @@ struct pa_pstream {
     pa_mempool *mempool;
 
 #ifdef HAVE_CREDS
-    pa_cmsg_ancil_data read_ancil_data, write_ancil_data;
-    bool send_ancil_data_now;
+    pa_cmsg_ancil_data read_ancil_data;
+
+    /* Ancillary data that came with the buffered data. It belongs to the
+     * frame the last buffered byte is part of. */
+    pa_cmsg_ancil_data read_buffer_ancil_data;
+    bool read_buffer_has_ancil_data;
 #endif
 };
 
 static int do_write(pa_pstream *p);
+static void finish_write_item(pa_pstream *p);
 static int do_read(pa_pstream *p, struct pstream_read *re);
 
 static void do_pstream_read_write(pa_pstream *p) {
@@ -192,6 +224,11 @@ static void do_pstream_read_write(pa_pstream *p) {
     if (!p->dead && pa_iochannel_is_readable(p->io)) {
         if (do_read(p, &p->readio) < 0)
             goto fail;
+
+        /* Parse whatever else the read picked up, without reading again */
+        while (!p->dead && p->read_buffer_index < p->read_buffer_length)
+            if (do_read(p, &p->readio) < 0)
+                goto fail;
     } else if (!p->dead && pa_iochannel_is_hungup(p->io))
         goto fail;
 
@@ -310,11 +347,13 @@ static void pstream_free(pa_pstream *p) {
 
     pa_queue_free(p->send_queue, item_free);
 
-    if (p->write.current)
-        item_free(p->write.current);
+    while (p->write_n > 0)
+        finish_write_item(p);
 
-    if (p->write.memchunk.memblock)
-        pa_memblock_unref(p->write.memchunk.memblock);
+    if (p->n_write_calls > 0)
+        pa_log_debug("Wrote %llu items in %llu calls.",
+                     (unsigned long long) p->n_written_items,
+                     (unsigned long long) p->n_write_calls);
 
     if (p->readsrb.memblock)
         pa_memblock_unref(p->readsrb.memblock);
@@ -328,6 +367,13 @@ static void pstream_free(pa_pstream *p) {
     if (p->readio.packet)
         pa_packet_unref(p->readio.packet);
 
+    if (p->n_read_calls > 0)
+        pa_log_debug("Read %llu frames in %llu calls.",
+                     (unsigned long long) p->n_read_frames,
+                     (unsigned long long) p->n_read_calls);
+
+    pa_xfree(p->read_buffer);
+
     pa_xfree(p);
 }
 
@@ -480,67 +526,74 @@ static void memexport_revoke_cb(pa_memexport *e, uint32_t block_id, void *userda
         pa_pstream_send_revoke(p, block_id);
 }
 
-static void prepare_next_write_item(pa_pstream *p) {
+/* Takes the next item off the send queue and appends it to the write
+ * batch. Returns NULL if the queue is empty. */
+static struct pstream_write *prepare_next_write_item(pa_pstream *p) {
+    struct pstream_write *w;
+    struct item_info *i;
+
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
+    pa_assert(p->write_n < WRITE_BATCH_MAX);
 
-    p->write.current = pa_queue_pop(p->send_queue);
+    if (!(i = pa_queue_pop(p->send_queue)))
+        return NULL;
 
-    if (!p->write.current)
-        return;
-    p->write.index = 0;
-    p->write.data = NULL;
-    p->write.minibuf_validsize = 0;
-    pa_memchunk_reset(&p->write.memchunk);
-
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
-    p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
-
-    if (p->write.current->type == PA_PSTREAM_ITEM_PACKET) {
+    w = &p->write[(p->write_idx + p->write_n++) % WRITE_BATCH_MAX];
+    w->current = i;
+    w->index = 0;
+    w->data = NULL;
+    w->minibuf_validsize = 0;
+    pa_memchunk_reset(&w->memchunk);
+
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl((uint32_t) -1);
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = 0;
+    w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = 0;
+
+    if (w->current->type == PA_PSTREAM_ITEM_PACKET) {
         size_t plen;
 
-        pa_assert(p->write.current->packet);
+        pa_assert(w->current->packet);
 
-        p->write.data = (void *) pa_packet_data(p->write.current->packet, &plen);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
+        w->data = (void *) pa_packet_data(w->current->packet, &plen);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) plen);
 
         if (plen <= MINIBUF_SIZE - PA_PSTREAM_DESCRIPTOR_SIZE) {
-            memcpy(&p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], p->write.data, plen);
-            p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
+            memcpy(&w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE], w->data, plen);
+            w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + plen;
         }
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMRELEASE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMRELEASE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
-    } else if (p->write.current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
+    } else if (w->current->type == PA_PSTREAM_ITEM_SHMREVOKE) {
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(p->write.current->block_id);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(PA_FLAG_SHMREVOKE);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl(w->current->block_id);
 
     } else {
         uint32_t flags;
         bool send_payload = true;
 
-        pa_assert(p->write.current->type == PA_PSTREAM_ITEM_MEMBLOCK);
-        pa_assert(p->write.current->chunk.memblock);
+        pa_assert(w->current->type == PA_PSTREAM_ITEM_MEMBLOCK);
+        pa_assert(w->current->chunk.memblock);
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(p->write.current->channel);
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) p->write.current->offset) >> 32));
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) p->write.current->offset));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_CHANNEL] = htonl(w->current->channel);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_HI] = htonl((uint32_t) (((uint64_t) w->current->offset) >> 32));
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_OFFSET_LO] = htonl((uint32_t) ((uint64_t) w->current->offset));
 
-        flags = (uint32_t) (p->write.current->seek_mode & PA_FLAG_SEEKMASK);
+        flags = (uint32_t) (w->current->seek_mode & PA_FLAG_SEEKMASK);
 
         if (p->use_shm) {
             uint32_t block_id, shm_id;
             size_t offset, length;
-            uint32_t *shm_info = (uint32_t *) &p->write.minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
+            uint32_t *shm_info = (uint32_t *) &w->minibuf[PA_PSTREAM_DESCRIPTOR_SIZE];
             size_t shm_size = sizeof(uint32_t) * PA_PSTREAM_SHM_MAX;
-            pa_mempool *current_pool = pa_memblock_get_pool(p->write.current->chunk.memblock);
+            pa_mempool *current_pool = pa_memblock_get_pool(w->current->chunk.memblock);
             pa_memexport *current_export;
 
             if (p->mempool == current_pool)
@@ -549,7 +602,7 @@ static void prepare_next_write_item(pa_pstream *p) {
                 pa_assert_se(current_export = pa_memexport_new(current_pool, memexport_revoke_cb, p));
 
             if (pa_memexport_put(current_export,
-                                 p->write.current->chunk.memblock,
+                                 w->current->chunk.memblock,
                                  &block_id,
                                  &shm_id,
                                  &offset,
@@ -562,11 +615,11 @@ static void prepare_next_write_item(pa_pstream *p) {
 
                 shm_info[PA_PSTREAM_SHM_BLOCKID] = htonl(block_id);
                 shm_info[PA_PSTREAM_SHM_SHMID] = htonl(shm_id);
-                shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + p->write.current->chunk.index));
-                shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
+                shm_info[PA_PSTREAM_SHM_INDEX] = htonl((uint32_t) (offset + w->current->chunk.index));
+                shm_info[PA_PSTREAM_SHM_LENGTH] = htonl((uint32_t) w->current->chunk.length);
 
-                p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
-                p->write.minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
+                w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl(shm_size);
+                w->minibuf_validsize = PA_PSTREAM_DESCRIPTOR_SIZE + shm_size;
             }
 /*             else */
 /*                 pa_log_warn("Failed to export memory block."); */
@@ -576,20 +629,87 @@ static void prepare_next_write_item(pa_pstream *p) {
         }
 
         if (send_payload) {
-            p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) p->write.current->chunk.length);
-            p->write.memchunk = p->write.current->chunk;
-            pa_memblock_ref(p->write.memchunk.memblock);
+            w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH] = htonl((uint32_t) w->current->chunk.length);
+            w->memchunk = w->current->chunk;
+            pa_memblock_ref(w->memchunk.memblock);
         }
 
-        p->write.descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
+        w->descriptor[PA_PSTREAM_DESCRIPTOR_FLAGS] = htonl(flags);
     }
 
 #ifdef HAVE_CREDS
-    if ((p->send_ancil_data_now = p->write.current->with_ancil_data))
-        p->write_ancil_data = p->write.current->ancil_data;
+    w->send_ancil_data_now = w->current->with_ancil_data;
 #endif
+
+    return w;
 }
 
+/* Frees the first item of the write batch once it is written completely */
+static void finish_write_item(pa_pstream *p) {
+    struct pstream_write *w;
+
+    pa_assert(p->write_n > 0);
+
+    w = &p->write[p->write_idx];
+
+    pa_assert(w->current);
+    item_free(w->current);
+    w->current = NULL;
+
+    if (w->memchunk.memblock)
+        pa_memblock_unref(w->memchunk.memblock);
+
+    pa_memchunk_reset(&w->memchunk);
+
+    p->write_idx = (p->write_idx + 1) % WRITE_BATCH_MAX;
+    p->write_n--;
+}
+
+/* Fills in the buffers of w that still need to be written and returns
+ * their number, at most two. A memblock payload is acquired and stored
+ * in *acquired, the caller releases it after writing. */
+static unsigned write_item_iovecs(struct pstream_write *w, struct iovec *iov, pa_memblock **acquired) {
+    size_t length;
+    unsigned n = 0;
+
+    pa_assert(w->current);
+
+    *acquired = NULL;
+
+    if (w->minibuf_validsize > 0) {
+        iov[0].iov_base = w->minibuf + w->index;
+        iov[0].iov_len = w->minibuf_validsize - w->index;
+        return 1;
+    }
+
+    if (w->index < PA_PSTREAM_DESCRIPTOR_SIZE) {
+        iov[n].iov_base = (uint8_t*) w->descriptor + w->index;
+        iov[n].iov_len = PA_PSTREAM_DESCRIPTOR_SIZE - w->index;
+        n++;
+    }
+
+    if ((length = ntohl(w->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) > 0) {
+        size_t skip = w->index > PA_PSTREAM_DESCRIPTOR_SIZE ? w->index - PA_PSTREAM_DESCRIPTOR_SIZE : 0;
+        void *d;
+
+        pa_assert(w->data || w->memchunk.memblock);
+
+        if (w->data)
+            d = w->data;
+        else {
+            d = pa_memblock_acquire_chunk(&w->memchunk);
+            *acquired = w->memchunk.memblock;
+        }
+
+        iov[n].iov_base = (uint8_t*) d + skip;
+        iov[n].iov_len = length - skip;
+        n++;
+    }
+
+    return n;
+}
+
+
 static void check_srbpending(pa_pstream *p) {
     if (!p->is_srbpending)
         return;
@@ -605,90 +725,183 @@ static void check_srbpending(pa_pstream *p) {
 }
 
 static int do_write(pa_pstream *p) {
-    void *d;
-    size_t l;
+    struct pstream_write *first;
+    struct iovec iov[WRITE_BATCH_MAX * 2];
+    pa_memblock *acquired[WRITE_BATCH_MAX];
+    unsigned n_iov = 0, n_items, i;
+    size_t l = 0, left;
     ssize_t r;
-    pa_memblock *release_memblock = NULL;
+    bool finished = false;
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (!p->write.current)
-        prepare_next_write_item(p);
-
-    if (!p->write.current) {
+    if (p->write_n == 0 && !prepare_next_write_item(p)) {
         /* The out queue is empty, so switching channels is safe */
         check_srbpending(p);
         return 0;
     }
 
-    if (p->write.minibuf_validsize > 0) {
-        d = p->write.minibuf + p->write.index;
-        l = p->write.minibuf_validsize - p->write.index;
-    } else if (p->write.index < PA_PSTREAM_DESCRIPTOR_SIZE) {
-        d = (uint8_t*) p->write.descriptor + p->write.index;
-        l = PA_PSTREAM_DESCRIPTOR_SIZE - p->write.index;
-    } else {
-        pa_assert(p->write.data || p->write.memchunk.memblock);
+    /* Coalesce as many queued items as possible into one write */
+    while (p->write_n < WRITE_BATCH_MAX && prepare_next_write_item(p))
+        ;
 
-        if (p->write.data)
-            d = p->write.data;
-        else {
-            d = pa_memblock_acquire_chunk(&p->write.memchunk);
-            release_memblock = p->write.memchunk.memblock;
-        }
+    first = &p->write[p->write_idx];
+
+    for (n_items = 0; n_items < p->write_n; n_items++) {
+        struct pstream_write *w = &p->write[(p->write_idx + n_items) % WRITE_BATCH_MAX];
+
+#ifdef HAVE_CREDS
+        /* Ancillary data is attached to the first byte of its item, so
+         * such an item is written on its own */
+        if (n_items > 0 && (first->send_ancil_data_now || w->send_ancil_data_now))
+            break;
+#endif
 
-        d = (uint8_t*) d + p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE;
-        l = ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - (p->write.index - PA_PSTREAM_DESCRIPTOR_SIZE);
+        n_iov += write_item_iovecs(w, iov + n_iov, &acquired[n_items]);
     }
 
+    for (i = 0; i < n_iov; i++)
+        l += iov[i].iov_len;
+
     pa_assert(l > 0);
 
 #ifdef HAVE_CREDS
-    if (p->send_ancil_data_now) {
-        if (p->write_ancil_data.creds_valid) {
-            pa_assert(p->write_ancil_data.nfd == 0);
-            if ((r = pa_iochannel_write_with_creds(p->io, d, l, &p->write_ancil_data.creds)) < 0)
-                goto fail;
+    if (first->send_ancil_data_now) {
+        pa_cmsg_ancil_data *ancil_data = &first->current->ancil_data;
+
+        l = iov[0].iov_len;
+
+        if (ancil_data->creds_valid) {
+            pa_assert(ancil_data->nfd == 0);
+            r = pa_iochannel_write_with_creds(p->io, iov[0].iov_base, l, &ancil_data->creds);
         }
         else
-            if ((r = pa_iochannel_write_with_fds(p->io, d, l, p->write_ancil_data.nfd, p->write_ancil_data.fds)) < 0)
-                goto fail;
-        p->send_ancil_data_now = false;
+            r = pa_iochannel_write_with_fds(p->io, iov[0].iov_base, l, ancil_data->nfd, ancil_data->fds);
+
+        if (r >= 0)
+            first->send_ancil_data_now = false;
     } else
 #endif
     if (p->srb)
-        r = pa_srbchannel_write(p->srb, d, l);
-    else if ((r = pa_iochannel_write(p->io, d, l)) < 0)
-        goto fail;
+        r = (ssize_t) pa_srbchannel_writev(p->srb, iov, n_iov);
+    else
+        r = pa_iochannel_writev(p->io, iov, n_iov);
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+    for (i = 0; i < n_items; i++)
+        if (acquired[i])
+            pa_memblock_release(acquired[i]);
 
-    p->write.index += (size_t) r;
+    if (r < 0)
+        return -1;
 
-    if (p->write.index >= PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(p->write.descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH])) {
-        pa_assert(p->write.current);
-        item_free(p->write.current);
-        p->write.current = NULL;
+    p->n_write_calls++;
 
-        if (p->write.memchunk.memblock)
-            pa_memblock_unref(p->write.memchunk.memblock);
+    for (left = (size_t) r; left > 0;) {
+        size_t rest = PA_PSTREAM_DESCRIPTOR_SIZE + ntohl(first->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) - first->index;
 
-        pa_memchunk_reset(&p->write.memchunk);
+        if (left < rest) {
+            first->index += left;
+            break;
+        }
 
-        if (p->drain_callback && !pa_pstream_is_pending(p))
-            p->drain_callback(p, p->drain_callback_userdata);
+        left -= rest;
+        finish_write_item(p);
+        p->n_written_items++;
+        finished = true;
+
+        first = &p->write[p->write_idx];
     }
 
+    if (finished && p->drain_callback && !pa_pstream_is_pending(p))
+        p->drain_callback(p, p->drain_callback_userdata);
+
     return (size_t) r == l ? 1 : 0;
+}
 
-fail:
+#ifdef HAVE_CREDS
+static void merge_ancil_data(pa_cmsg_ancil_data *a, const pa_cmsg_ancil_data *b) {
+    if (b->creds_valid) {
+        a->creds_valid = true;
+        a->creds = b->creds;
+    }
+    if (b->nfd > 0) {
+        pa_assert(b->nfd <= MAX_ANCIL_DATA_FDS);
+        a->nfd = b->nfd;
+        memcpy(a->fds, b->fds, sizeof(int) * b->nfd);
+    }
+}
+#endif
 
-    if (release_memblock)
-        pa_memblock_release(release_memblock);
+/* Reads from the iochannel. Ancillary data is attributed to the current
+ * frame, or, when reading into the buffer, to the one the last byte read
+ * belongs to. The kernel never merges data across an item sent with
+ * ancillary data, and such items are written on their own. */
+static ssize_t read_io(pa_pstream *p, void *d, size_t l, bool buffered) {
+    ssize_t r;
 
-    return -1;
+    p->n_read_calls++;
+
+#ifdef HAVE_CREDS
+    {
+        pa_cmsg_ancil_data b;
+
+        if ((r = pa_iochannel_read_with_ancil_data(p->io, d, l, &b)) <= 0)
+            return r;
+
+        if (b.creds_valid || b.nfd > 0) {
+            if (buffered) {
+                p->read_buffer_ancil_data = b;
+                p->read_buffer_has_ancil_data = true;
+            } else
+                merge_ancil_data(&p->read_ancil_data, &b);
+        }
+    }
+#else
+    r = pa_iochannel_read(p->io, d, l);
+#endif
+
+    return r;
+}
+
+static void read_buffer_consume(pa_pstream *p, size_t l) {
+    pa_assert(p->read_buffer_index + l <= p->read_buffer_length);
+
+    p->read_buffer_index += l;
+
+#ifdef HAVE_CREDS
+    if (p->read_buffer_index == p->read_buffer_length && p->read_buffer_has_ancil_data) {
+        merge_ancil_data(&p->read_ancil_data, &p->read_buffer_ancil_data);
+        p->read_buffer_has_ancil_data = false;
+    }
+#endif
+}
+
+/* Fills d with up to l bytes of the current frame. Reads go into the
+ * read buffer, so that the following frames don't need another read. */
+static ssize_t read_buffered(pa_pstream *p, void *d, size_t l) {
+    ssize_t r;
+
+    if (p->read_buffer_index >= p->read_buffer_length) {
+
+        if (l >= READ_DIRECT_MIN)
+            return read_io(p, d, l, false);
+
+        if (!p->read_buffer)
+            p->read_buffer = pa_xmalloc(READ_BUFFER_SIZE);
+
+        if ((r = read_io(p, p->read_buffer, READ_BUFFER_SIZE, true)) <= 0)
+            return r;
+
+        p->read_buffer_index = 0;
+        p->read_buffer_length = (size_t) r;
+    }
+
+    l = PA_MIN(l, p->read_buffer_length - p->read_buffer_index);
+    memcpy(d, p->read_buffer + p->read_buffer_index, l);
+    read_buffer_consume(p, l);
+
+    return (ssize_t) l;
 }
 
 static void memblock_complete(pa_pstream *p, struct pstream_read *re) {
@@ -748,28 +961,8 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
             return 1;
         }
     }
-    else
-#ifdef HAVE_CREDS
-    {
-        pa_cmsg_ancil_data b;
-
-        if ((r = pa_iochannel_read_with_ancil_data(p->io, d, l, &b)) <= 0)
-            goto fail;
-
-        if (b.creds_valid) {
-            p->read_ancil_data.creds_valid = true;
-            p->read_ancil_data.creds = b.creds;
-        }
-        if (b.nfd > 0) {
-            pa_assert(b.nfd <= MAX_ANCIL_DATA_FDS);
-            p->read_ancil_data.nfd = b.nfd;
-            memcpy(p->read_ancil_data.fds, b.fds, sizeof(int) * b.nfd);
-        }
-    }
-#else
-    if ((r = pa_iochannel_read(p->io, d, l)) <= 0)
+    else if ((r = read_buffered(p, d, l)) <= 0)
         goto fail;
-#endif
 
     if (release_memblock)
         pa_memblock_release(release_memblock);
@@ -830,8 +1023,17 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
             }
 
             /* Frame is a packet frame */
-            re->packet = pa_packet_new(length);
-            re->data = (void *) pa_packet_data(re->packet, &plen);
+            if (re == &p->readio && p->read_buffer_length - p->read_buffer_index >= length) {
+
+                /* It has been read completely already, so dispatch it
+                 * straight from the read buffer */
+                re->packet = pa_packet_new_fixed(p->read_buffer + p->read_buffer_index, length);
+                read_buffer_consume(p, length);
+                re->index += length;
+            } else {
+                re->packet = pa_packet_new(length);
+                re->data = (void *) pa_packet_data(re->packet, &plen);
+            }
 
         } else {
 
@@ -862,8 +1064,10 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
                 return -1;
             }
         }
+    }
 
-    } else if (re->index >= ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) + PA_PSTREAM_DESCRIPTOR_SIZE) {
+    if (re->index > PA_PSTREAM_DESCRIPTOR_SIZE &&
+        re->index >= ntohl(re->descriptor[PA_PSTREAM_DESCRIPTOR_LENGTH]) + PA_PSTREAM_DESCRIPTOR_SIZE) {
         /* Frame complete */
 
         if (re->memblock) {
@@ -931,6 +1135,9 @@ static int do_read(pa_pstream *p, struct pstream_read *re) {
     return 0;
 
 frame_done:
+    if (re == &p->readio)
+        p->n_read_frames++;
+
     re->memblock = NULL;
     re->packet = NULL;
     re->index = 0;
@@ -1007,7 +1214,7 @@ bool pa_pstream_is_pending(pa_pstream *p) {
     if (p->dead)
         b = false;
     else
-        b = p->write.current || !pa_queue_isempty(p->send_queue);
+        b = p->write_n > 0 || !pa_queue_isempty(p->send_queue);
 
     return b;
 }
@@ -0,0 +1,372 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/remap.h>
+
+#include "cpu-x86.h"
+
+#include <immintrin.h>
+
+/* The matrix remapping functions below work on blocks of eight frames.
+ * The samples of each input channel that is used at all are gathered
+ * into a vector with one frame per element, then each output channel
+ * is computed as the sum of the products with its non-zero
+ * coefficients only, and the results are interleaved again.
+ *
+ * The terms are summed up in the same order and with the same
+ * precision as the C versions in remap.c, so the results are
+ * bit-identical. */
+
+#define BLOCK 8
+
+typedef struct remap_term {
+    unsigned input;     /* index into remap_matrix.inputs */
+    float f;
+    int32_t i;
+} remap_term;
+
+/* The sparse form of the remapping matrix, kept in pa_remap_t.state */
+typedef struct remap_matrix {
+    unsigned n_inputs;
+    unsigned inputs[PA_CHANNELS_MAX];
+
+    unsigned n_terms[PA_CHANNELS_MAX];
+    remap_term terms[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+
+    /* The coefficients of each input for up to eight output channels */
+    float column_f[PA_CHANNELS_MAX][BLOCK];
+    int32_t column_i[PA_CHANNELS_MAX][BLOCK];
+} remap_matrix;
+
+static pa_init_remap_func_t init_remap_prev = NULL;
+
+/* Interleave the output channels of a block, keeping the low 16 bits of
+ * the sums like the C version does */
+static inline void store_s16(int16_t *dst, const __m256i *out, unsigned n_oc) {
+    const __m256i low = _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    PA_DECLARE_ALIGNED(32, int32_t, buf[PA_CHANNELS_MAX][BLOCK]);
+    unsigned oc, i;
+    __m256i v;
+
+    switch (n_oc) {
+        case 1:
+            v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(out[0], low), 0x08);
+            _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(v));
+            break;
+
+        case 2:
+            v = _mm256_blend_epi16(out[0], _mm256_slli_epi32(out[1], 16), 0xAA);
+            _mm256_storeu_si256((__m256i *) dst, v);
+            break;
+
+        default:
+            for (oc = 0; oc < n_oc; oc++)
+                _mm256_store_si256((__m256i *) buf[oc], out[oc]);
+
+            for (i = 0; i < BLOCK; i++)
+                for (oc = 0; oc < n_oc; oc++)
+                    *dst++ = (int16_t) buf[oc][i];
+            break;
+    }
+}
+
+static inline void store_float(float *dst, const __m256 *out, unsigned n_oc) {
+    PA_DECLARE_ALIGNED(32, float, buf[PA_CHANNELS_MAX][BLOCK]);
+    unsigned oc, i;
+    __m256 lo, hi;
+
+    switch (n_oc) {
+        case 1:
+            _mm256_storeu_ps(dst, out[0]);
+            break;
+
+        case 2:
+            /* frames 0, 1, 4, 5 and 2, 3, 6, 7 */
+            lo = _mm256_unpacklo_ps(out[0], out[1]);
+            hi = _mm256_unpackhi_ps(out[0], out[1]);
+            _mm256_storeu_ps(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+            break;
+
+        default:
+            for (oc = 0; oc < n_oc; oc++)
+                _mm256_store_ps(buf[oc], out[oc]);
+
+            for (i = 0; i < BLOCK; i++)
+                for (oc = 0; oc < n_oc; oc++)
+                    *dst++ = buf[oc][i];
+            break;
+    }
+}
+
+/* The gather reads 32 bits per sample, so the 16 bits following the
+ * last sample of the block must be readable */
+static inline void remap_block_s16(const remap_matrix *t, int16_t *dst, const int16_t *src, unsigned n_ic, unsigned n_oc) {
+    __m256i in[PA_CHANNELS_MAX], out[PA_CHANNELS_MAX];
+    const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(n_ic));
+    unsigned u, oc, k;
+
+    for (u = 0; u < t->n_inputs; u++) {
+        __m256i v = _mm256_i32gather_epi32((const int *) (src + t->inputs[u]), index, 2);
+        in[u] = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+    }
+
+    for (oc = 0; oc < n_oc; oc++) {
+        __m256i sum = _mm256_setzero_si256();
+
+        /* Each product fits into 32 bits and its upper 16 bits fit into
+         * an int16_t, the sum wraps around in the end like in C */
+        for (k = 0; k < t->n_terms[oc]; k++) {
+            const remap_term *term = &t->terms[oc][k];
+            __m256i p = _mm256_mullo_epi32(in[term->input], _mm256_set1_epi32(term->i));
+
+            sum = _mm256_add_epi32(sum, _mm256_srai_epi32(p, 16));
+        }
+
+        out[oc] = sum;
+    }
+
+    store_s16(dst, out, n_oc);
+}
+
+static inline void remap_block_float(const remap_matrix *t, float *dst, const float *src, unsigned n_ic, unsigned n_oc) {
+    __m256 in[PA_CHANNELS_MAX], out[PA_CHANNELS_MAX];
+    const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(n_ic));
+    unsigned u, oc, k;
+
+    for (u = 0; u < t->n_inputs; u++)
+        in[u] = _mm256_i32gather_ps(src + t->inputs[u], index, 4);
+
+    for (oc = 0; oc < n_oc; oc++) {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (k = 0; k < t->n_terms[oc]; k++) {
+            const remap_term *term = &t->terms[oc][k];
+
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(in[term->input], _mm256_set1_ps(term->f)));
+        }
+
+        out[oc] = sum;
+    }
+
+    store_float(dst, out, n_oc);
+}
+
+/* Define a remapping function from a block function. The remaining
+ * frames at the end are processed through zero padded buffers, which
+ * have room for the extra sample the s16 gather reads. */
+#define DEFINE_REMAP_MATRIX(name, type, block_func, pad)                \
+    static void name(pa_remap_t *m, type *dst, const type *src, unsigned n) { \
+        const remap_matrix *t = m->state;                               \
+        unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels;      \
+                                                                        \
+        for (; n >= BLOCK + (pad); n -= BLOCK) {                        \
+            block_func(t, dst, src, n_ic, n_oc);                        \
+            src += BLOCK * n_ic;                                        \
+            dst += BLOCK * n_oc;                                        \
+        }                                                               \
+                                                                        \
+        if (n > 0) {                                                    \
+            type in[(BLOCK + 1) * PA_CHANNELS_MAX] = { 0 };             \
+            type out[BLOCK * PA_CHANNELS_MAX];                          \
+                                                                        \
+            memcpy(in, src, n * n_ic * sizeof(type));                   \
+            block_func(t, out, in, n_ic, n_oc);                         \
+            memcpy(dst, out, n * n_oc * sizeof(type));                  \
+        }                                                               \
+    }
+
+DEFINE_REMAP_MATRIX(remap_channels_matrix_s16ne_avx2, int16_t, remap_block_s16, 1)
+DEFINE_REMAP_MATRIX(remap_channels_matrix_float32ne_avx2, float, remap_block_float, 0)
+
+/* With more output channels, interleaving them again costs more than
+ * the matrix itself. Instead each frame is computed as one vector, the
+ * sum of the products of its samples with the coefficient columns of
+ * the matrix. The coefficients of the channels that are not in a term
+ * are zero, which leaves the sums unchanged. */
+static inline void remap_frame_s16(const remap_matrix *t, int16_t *dst, const int16_t *src) {
+    const __m256i low = _mm256_setr_epi8(
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i sum = _mm256_setzero_si256();
+    unsigned u;
+
+    for (u = 0; u < t->n_inputs; u++) {
+        __m256i p = _mm256_mullo_epi32(_mm256_set1_epi32(src[t->inputs[u]]),
+                                       _mm256_loadu_si256((const __m256i *) t->column_i[u]));
+
+        sum = _mm256_add_epi32(sum, _mm256_srai_epi32(p, 16));
+    }
+
+    sum = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(sum, low), 0x08);
+    _mm_storeu_si128((__m128i *) dst, _mm256_castsi256_si128(sum));
+}
+
+static inline void remap_frame_float(const remap_matrix *t, float *dst, const float *src) {
+    __m256 sum = _mm256_setzero_ps();
+    unsigned u;
+
+    for (u = 0; u < t->n_inputs; u++)
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_broadcast_ss(src + t->inputs[u]),
+                                               _mm256_loadu_ps(t->column_f[u])));
+
+    _mm256_storeu_ps(dst, sum);
+}
+
+/* The frame functions store eight samples, of which the ones beyond the
+ * frame are overwritten by the next frame. The last frames are computed
+ * into a buffer. */
+#define DEFINE_REMAP_COLUMNS(name, type, frame_func)                    \
+    static void name(pa_remap_t *m, type *dst, const type *src, unsigned n) { \
+        const remap_matrix *t = m->state;                               \
+        unsigned n_ic = m->i_ss.channels, n_oc = m->o_ss.channels, i;   \
+                                                                        \
+        for (; n * n_oc >= BLOCK; n--) {                                \
+            frame_func(t, dst, src);                                    \
+            src += n_ic;                                                \
+            dst += n_oc;                                                \
+        }                                                               \
+                                                                        \
+        if (n > 0) {                                                    \
+            type out[2 * BLOCK];                                        \
+                                                                        \
+            for (i = 0; i < n; i++)                                     \
+                frame_func(t, out + i * n_oc, src + i * n_ic);          \
+            memcpy(dst, out, n * n_oc * sizeof(type));                  \
+        }                                                               \
+    }
+
+DEFINE_REMAP_COLUMNS(remap_channels_columns_s16ne_avx2, int16_t, remap_frame_s16)
+DEFINE_REMAP_COLUMNS(remap_channels_columns_float32ne_avx2, float, remap_frame_float)
+
+static inline bool is_zero_coefficient(const pa_remap_t *m, unsigned oc, unsigned ic) {
+    if (m->format == PA_SAMPLE_S16NE)
+        return m->map_table_i[oc][ic] <= 0;
+
+    return m->map_table_f[oc][ic] <= 0.0f;
+}
+
+/* Collect the non-zero coefficients of the matrix, clamped the same way
+ * the C versions treat them */
+static remap_matrix *setup_remap_matrix(const pa_remap_t *m) {
+    remap_matrix *t;
+    int8_t input_index[PA_CHANNELS_MAX];
+    unsigned n_ic, n_oc, ic, oc;
+
+    n_ic = m->i_ss.channels;
+    n_oc = m->o_ss.channels;
+
+    t = pa_xnew0(remap_matrix, 1);
+    memset(input_index, -1, sizeof(input_index));
+
+    /* The inputs are kept in channel order, so that the column functions
+     * add up the terms in the same order as the C version */
+    for (ic = 0; ic < n_ic; ic++) {
+        for (oc = 0; oc < n_oc; oc++) {
+            if (!is_zero_coefficient(m, oc, ic)) {
+                input_index[ic] = t->n_inputs;
+                t->inputs[t->n_inputs++] = ic;
+                break;
+            }
+        }
+    }
+
+    for (oc = 0; oc < n_oc; oc++) {
+        for (ic = 0; ic < n_ic; ic++) {
+            remap_term *term;
+
+            if (is_zero_coefficient(m, oc, ic))
+                continue;
+
+            term = &t->terms[oc][t->n_terms[oc]++];
+            term->input = input_index[ic];
+            term->f = PA_MIN(m->map_table_f[oc][ic], 1.0f);
+            term->i = PA_MIN(m->map_table_i[oc][ic], 0x10000);
+
+            if (oc < BLOCK) {
+                t->column_f[term->input][oc] = term->f;
+                t->column_i[term->input][oc] = term->i;
+            }
+        }
+    }
+
+    return t;
+}
+
+/* The special cases, which are faster than any matrix, are left to the
+ * previously installed init function and the C code */
+static bool is_special_remap(pa_remap_t *m) {
+    unsigned n_oc, n_ic;
+    int8_t arrange[PA_CHANNELS_MAX];
+
+    n_oc = m->o_ss.channels;
+    n_ic = m->i_ss.channels;
+
+    if (pa_setup_remap_arrange(m, arrange) && (n_oc == 1 || n_oc == 2 || n_oc == 4))
+        return true;
+
+    if (n_ic == 2 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x8000 && m->map_table_i[0][1] == 0x8000)
+        return true;
+
+    if (n_ic == 4 && n_oc == 1 &&
+            m->map_table_i[0][0] == 0x4000 && m->map_table_i[0][1] == 0x4000 &&
+            m->map_table_i[0][2] == 0x4000 && m->map_table_i[0][3] == 0x4000)
+        return true;
+
+    return false;
+}
+
+/* set the function that will execute the remapping based on the matrices */
+static void init_remap_avx2(pa_remap_t *m) {
+    if (is_special_remap(m)) {
+        init_remap_prev(m);
+        return;
+    }
+
+    if (m->o_ss.channels > 2 && m->o_ss.channels <= BLOCK) {
+        pa_log_info("Using AVX2 column matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_channels_columns_s16ne_avx2,
+            (pa_do_remap_func_t) remap_channels_columns_float32ne_avx2);
+    } else {
+        pa_log_info("Using AVX2 matrix remapping");
+        pa_set_remap_func(m, (pa_do_remap_func_t) remap_channels_matrix_s16ne_avx2,
+            (pa_do_remap_func_t) remap_channels_matrix_float32ne_avx2);
+    }
+
+    /* setup state */
+    m->state = setup_remap_matrix(m);
+}
+
+void pa_remap_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized remappers.");
+
+    init_remap_prev = pa_get_init_remap_func();
+    pa_set_init_remap_func((pa_init_remap_func_t) init_remap_avx2);
+}
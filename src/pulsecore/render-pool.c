@@ -0,0 +1,202 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/semaphore.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+
+#include "render-pool.h"
+
+struct worker {
+    pa_render_pool *pool;
+    pa_thread *thread;
+    pa_semaphore *sem;
+};
+
+struct pa_render_pool {
+    pa_core *core;
+    pa_thread_mq *thread_mq;
+
+    struct worker *workers;
+    unsigned n_workers;
+
+    /* The current batch. Only written by the IO thread while all
+     * workers are idle. */
+    pa_sink_input **inputs;
+    pa_mix_info *info;
+    unsigned n_inputs;
+    size_t length;
+
+    /* Index of the next input to be claimed */
+    pa_atomic_t next;
+    /* Number of participants (woken workers plus the IO thread) that
+     * have not yet run out of work for the current batch */
+    pa_atomic_t running;
+    pa_semaphore *done;
+
+    bool quit;
+};
+
+static void run_batch(pa_render_pool *p) {
+    int k;
+
+    while ((k = pa_atomic_inc(&p->next)) < (int) p->n_inputs)
+        pa_sink_input_peek(p->inputs[k], p->length, &p->info[k].chunk, &p->info[k].volume);
+
+    /* The last participant to leave the batch wakes up the IO thread */
+    if (pa_atomic_dec(&p->running) == 1)
+        pa_semaphore_post(p->done);
+}
+
+static void thread_func(void *userdata) {
+    struct worker *w = userdata;
+    pa_render_pool *p;
+
+    pa_assert(w);
+    p = w->pool;
+
+    if (p->core->realtime_scheduling)
+        pa_make_realtime(p->core->realtime_priority);
+
+    pa_thread_mq_install(p->thread_mq);
+
+    for (;;) {
+        pa_semaphore_wait(w->sem);
+
+        if (p->quit)
+            break;
+
+        run_batch(p);
+    }
+}
+
+/* Called from IO thread context */
+pa_render_pool *pa_render_pool_new(pa_core *c, pa_thread_mq *thread_mq, const char *name, unsigned n_threads) {
+    pa_render_pool *p;
+    unsigned i;
+
+    pa_assert(c);
+    pa_assert(thread_mq);
+    pa_assert(name);
+    pa_assert(n_threads > 0);
+
+    p = pa_xnew0(pa_render_pool, 1);
+    p->core = c;
+    p->thread_mq = thread_mq;
+    p->done = pa_semaphore_new(0);
+    p->workers = pa_xnew0(struct worker, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        struct worker *w = &p->workers[i];
+        char *t;
+
+        w->pool = p;
+        w->sem = pa_semaphore_new(0);
+
+        t = pa_sprintf_malloc("%s-render-%u", name, i);
+        w->thread = pa_thread_new(t, thread_func, w);
+        pa_xfree(t);
+
+        if (!w->thread) {
+            pa_log("Failed to create render thread.");
+            pa_semaphore_free(w->sem);
+            break;
+        }
+
+        p->n_workers++;
+    }
+
+    if (p->n_workers == 0) {
+        pa_render_pool_free(p);
+        return NULL;
+    }
+
+    pa_log_debug("Created render pool with %u threads for %s.", p->n_workers, name);
+
+    return p;
+}
+
+/* Called from main context or IO thread context, but never while a
+ * batch is being processed */
+void pa_render_pool_free(pa_render_pool *p) {
+    unsigned i;
+
+    pa_assert(p);
+
+    p->quit = true;
+
+    for (i = 0; i < p->n_workers; i++)
+        pa_semaphore_post(p->workers[i].sem);
+
+    for (i = 0; i < p->n_workers; i++) {
+        pa_thread_free(p->workers[i].thread);
+        pa_semaphore_free(p->workers[i].sem);
+    }
+
+    pa_semaphore_free(p->done);
+    pa_xfree(p->workers);
+    pa_xfree(p);
+}
+
+pa_thread_mq *pa_render_pool_get_thread_mq(pa_render_pool *p) {
+    pa_assert(p);
+
+    return p->thread_mq;
+}
+
+/* Called from IO thread context */
+void pa_render_pool_peek(pa_render_pool *p, pa_sink_input *inputs[], pa_mix_info info[], unsigned n, size_t length) {
+    unsigned i, n_wake;
+
+    pa_assert(p);
+    pa_assert(inputs);
+    pa_assert(info);
+    pa_assert(pa_thread_mq_get() == p->thread_mq);
+
+    if (n == 0)
+        return;
+
+    p->inputs = inputs;
+    p->info = info;
+    p->n_inputs = n;
+    p->length = length;
+
+    /* The IO thread handles one input itself, so we need at most n-1
+     * helpers */
+    n_wake = PA_MIN(n - 1, p->n_workers);
+
+    pa_atomic_store(&p->next, 0);
+    pa_atomic_store(&p->running, (int) n_wake + 1);
+
+    for (i = 0; i < n_wake; i++)
+        pa_semaphore_post(p->workers[i].sem);
+
+    run_batch(p);
+
+    pa_semaphore_wait(p->done);
+}
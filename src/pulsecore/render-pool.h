@@ -0,0 +1,51 @@
+#ifndef foopulserenderpoolhfoo
+#define foopulserenderpoolhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulsecore/typedefs.h>
+#include <pulsecore/thread-mq.h>
+#include <pulsecore/mix.h>
+
+/* A small pool of helper threads that a sink's IO thread can use to
+ * peek several of its inputs concurrently. The expensive part of
+ * pa_sink_input_peek() (popping, remapping, resampling, volume
+ * scaling) only touches the input's own thread_info, so independent
+ * inputs can be processed in parallel. The calling IO thread takes
+ * part in the work itself and pa_render_pool_peek() returns only once
+ * all inputs have been peeked, so everything that follows (mixing,
+ * dropping, rewinding) stays on the IO thread and in order.
+ *
+ * The helper threads act on behalf of the IO thread: they install the
+ * IO thread's pa_thread_mq so that the usual IO context assertions
+ * and message posting from pop() callbacks keep working. A pool is
+ * therefore bound to the pa_thread_mq it was created with. */
+
+typedef struct pa_render_pool pa_render_pool;
+
+pa_render_pool *pa_render_pool_new(pa_core *c, pa_thread_mq *thread_mq, const char *name, unsigned n_threads);
+void pa_render_pool_free(pa_render_pool *p);
+
+pa_thread_mq *pa_render_pool_get_thread_mq(pa_render_pool *p);
+
+/* Peek n inputs in parallel, each for length bytes. The results are
+ * stored in info[0..n-1] in the same order as the inputs array, with
+ * info[k].chunk and info[k].volume filled in. */
+void pa_render_pool_peek(pa_render_pool *p, pa_sink_input *inputs[], pa_mix_info info[], unsigned n, size_t length);
+
+#endif
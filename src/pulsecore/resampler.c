@@ -23,11 +23,14 @@
 
 #include <string.h>
 
+#include <pulse/gccmacro.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/mutex.h>
 
 #include "resampler.h"
 
@@ -38,9 +41,39 @@ struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
 
+/* Everything that follows from the method, the formats, the channel
+ * maps and the flags alone. It doesn't change after creation, so it is
+ * shared by all resamplers with the same parameters. The sample rates
+ * are not part of the key, since nothing in here depends on them.
+ *
+ * This is only the conversion and remapping setup. The state of the
+ * resampling implementation, including the filter tables speex and
+ * the other libraries compute, and the work buffers stay per
+ * resampler. Of the implementations only the sinc one shares its
+ * tables, see resampler/sinc.c. */
+struct pa_resampler_setup {
+    pa_resample_method_t method;
+    pa_resample_flags_t flags;
+    pa_sample_format_t i_format, o_format;
+    pa_channel_map i_cm, o_cm;
+
+    bool map_required;
+    bool lfe_remixed;
+    pa_sample_format_t work_format;
+    pa_convert_func_t to_work_format_func;
+    pa_convert_func_t from_work_format_func;
+    pa_remap_t remap;
+
+    unsigned ref;
+    PA_LLIST_FIELDS(pa_resampler_setup);
+};
+
+static pa_static_mutex setups_mutex = PA_STATIC_MUTEX_INIT;
+static PA_LLIST_HEAD(pa_resampler_setup, setups) = NULL;
+
 static int copy_init(pa_resampler *r);
 
-static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed);
+static void setup_remap(const pa_resampler *r, pa_sample_format_t work_format, pa_remap_t *m, bool *lfe_remixed);
 static void free_remap(pa_remap_t *m);
 
 static int (* const init_table[])(pa_resampler *r) = {
@@ -118,6 +151,9 @@ static int (* const init_table[])(pa_resampler *r) = {
     [PA_RESAMPLER_SOXR_HQ]                 = NULL,
     [PA_RESAMPLER_SOXR_VHQ]                = NULL,
 #endif
+    [PA_RESAMPLER_SINC_LOW]                = pa_resampler_sinc_init,
+    [PA_RESAMPLER_SINC_MEDIUM]             = pa_resampler_sinc_init,
+    [PA_RESAMPLER_SINC_HIGH]               = pa_resampler_sinc_init,
 };
 
 static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
@@ -125,10 +161,8 @@ static pa_resample_method_t choose_auto_resampler(pa_resample_flags_t flags) {
 
     if (pa_resample_method_supported(PA_RESAMPLER_SPEEX_FLOAT_BASE + 1))
         method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
-    else if (flags & PA_RESAMPLER_VARIABLE_RATE)
-        method = PA_RESAMPLER_TRIVIAL;
     else
-        method = PA_RESAMPLER_FFMPEG;
+        method = PA_RESAMPLER_SINC_LOW;
 
     return method;
 }
@@ -299,6 +333,8 @@ static pa_sample_format_t choose_work_format(
         case PA_RESAMPLER_SOXR_MQ:
         case PA_RESAMPLER_SOXR_HQ:
         case PA_RESAMPLER_SOXR_VHQ:
+        case PA_RESAMPLER_SINC_LOW:
+        case PA_RESAMPLER_SINC_MEDIUM:
             /* Do processing with max precision of input and output. */
             if (sample_format_more_precise(a, PA_SAMPLE_S16NE) ||
                 sample_format_more_precise(b, PA_SAMPLE_S16NE))
@@ -314,6 +350,103 @@ static pa_sample_format_t choose_work_format(
     return work_format;
 }
 
+static pa_resampler_setup *setup_new(pa_resampler *r) {
+    pa_resampler_setup *s;
+
+    s = pa_xnew0(pa_resampler_setup, 1);
+    s->method = r->method;
+    s->flags = r->flags;
+    s->i_format = r->i_ss.format;
+    s->o_format = r->o_ss.format;
+    s->i_cm = r->i_cm;
+    s->o_cm = r->o_cm;
+
+    s->map_required = (r->i_ss.channels != r->o_ss.channels || (!(r->flags & PA_RESAMPLER_NO_REMAP) &&
+        !pa_channel_map_equal(&r->i_cm, &r->o_cm)));
+
+    s->work_format = choose_work_format(r->method, r->i_ss.format, r->o_ss.format, s->map_required);
+
+    if (r->i_ss.format != s->work_format) {
+        if (s->work_format == PA_SAMPLE_FLOAT32NE) {
+            if (!(s->to_work_format_func = pa_get_convert_to_float32ne_function(r->i_ss.format)))
+                goto fail;
+        } else {
+            pa_assert(s->work_format == PA_SAMPLE_S16NE);
+            if (!(s->to_work_format_func = pa_get_convert_to_s16ne_function(r->i_ss.format)))
+                goto fail;
+        }
+    }
+
+    if (r->o_ss.format != s->work_format) {
+        if (s->work_format == PA_SAMPLE_FLOAT32NE) {
+            if (!(s->from_work_format_func = pa_get_convert_from_float32ne_function(r->o_ss.format)))
+                goto fail;
+        } else {
+            pa_assert(s->work_format == PA_SAMPLE_S16NE);
+            if (!(s->from_work_format_func = pa_get_convert_from_s16ne_function(r->o_ss.format)))
+                goto fail;
+        }
+    }
+
+    /* set up the remap structure */
+    if (s->map_required)
+        setup_remap(r, s->work_format, &s->remap, &s->lfe_remixed);
+
+    return s;
+
+fail:
+    pa_xfree(s);
+
+    return NULL;
+}
+
+/* Returns the setup for r's method, formats, channel maps and flags,
+ * creating it if no other resampler uses it yet */
+static pa_resampler_setup *setup_ref(pa_resampler *r) {
+    pa_resampler_setup *s;
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&setups_mutex, false, false);
+    pa_mutex_lock(m);
+
+    PA_LLIST_FOREACH(s, setups)
+        if (s->method == r->method &&
+            s->flags == r->flags &&
+            s->i_format == r->i_ss.format &&
+            s->o_format == r->o_ss.format &&
+            pa_channel_map_equal(&s->i_cm, &r->i_cm) &&
+            pa_channel_map_equal(&s->o_cm, &r->o_cm))
+            break;
+
+    if (s)
+        s->ref++;
+    else if ((s = setup_new(r))) {
+        s->ref = 1;
+        PA_LLIST_PREPEND(pa_resampler_setup, setups, s);
+    }
+
+    pa_mutex_unlock(m);
+
+    return s;
+}
+
+static void setup_unref(pa_resampler_setup *s) {
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&setups_mutex, false, false);
+    pa_mutex_lock(m);
+
+    pa_assert(s->ref > 0);
+
+    if (--s->ref == 0) {
+        PA_LLIST_REMOVE(pa_resampler_setup, setups, s);
+        free_remap(&s->remap);
+        pa_xfree(s);
+    }
+
+    pa_mutex_unlock(m);
+}
+
 pa_resampler* pa_resampler_new(
         pa_mempool *pool,
         const pa_sample_spec *a,
@@ -325,7 +458,6 @@ pa_resampler* pa_resampler_new(
         pa_resample_flags_t flags) {
 
     pa_resampler *r = NULL;
-    bool lfe_remixed = false;
 
     pa_assert(pool);
     pa_assert(a);
@@ -359,33 +491,14 @@ pa_resampler* pa_resampler_new(
     r->i_fz = pa_frame_size(a);
     r->o_fz = pa_frame_size(b);
 
-    r->map_required = (r->i_ss.channels != r->o_ss.channels || (!(r->flags & PA_RESAMPLER_NO_REMAP) &&
-        !pa_channel_map_equal(&r->i_cm, &r->o_cm)));
+    if (!(r->setup = setup_ref(r)))
+        goto fail;
 
-    r->work_format = choose_work_format(method, a->format, b->format, r->map_required);
+    r->map_required = r->setup->map_required;
+    r->work_format = r->setup->work_format;
     r->w_sz = pa_sample_size_of_format(r->work_format);
-
-    if (r->i_ss.format != r->work_format) {
-        if (r->work_format == PA_SAMPLE_FLOAT32NE) {
-            if (!(r->to_work_format_func = pa_get_convert_to_float32ne_function(r->i_ss.format)))
-                goto fail;
-        } else {
-            pa_assert(r->work_format == PA_SAMPLE_S16NE);
-            if (!(r->to_work_format_func = pa_get_convert_to_s16ne_function(r->i_ss.format)))
-                goto fail;
-        }
-    }
-
-    if (r->o_ss.format != r->work_format) {
-        if (r->work_format == PA_SAMPLE_FLOAT32NE) {
-            if (!(r->from_work_format_func = pa_get_convert_from_float32ne_function(r->o_ss.format)))
-                goto fail;
-        } else {
-            pa_assert(r->work_format == PA_SAMPLE_S16NE);
-            if (!(r->from_work_format_func = pa_get_convert_from_s16ne_function(r->o_ss.format)))
-                goto fail;
-        }
-    }
+    r->to_work_format_func = r->setup->to_work_format_func;
+    r->from_work_format_func = r->setup->from_work_format_func;
 
     if (r->o_ss.channels <= r->i_ss.channels) {
         /* pipeline is: format conv. -> remap -> resample -> format conv. */
@@ -412,11 +525,7 @@ pa_resampler* pa_resampler_new(
                  pa_sample_format_to_string(b->format), pa_sample_format_to_string(r->work_format));
     pa_log_debug("  channels %d -> %d (resampling %d)", a->channels, b->channels, r->work_channels);
 
-    /* set up the remap structure */
-    if (r->map_required)
-        setup_remap(r, &r->remap, &lfe_remixed);
-
-    if (lfe_remixed && crossover_freq > 0) {
+    if (r->setup->lfe_remixed && crossover_freq > 0) {
         pa_sample_spec wss = r->o_ss;
         wss.format = r->work_format;
         /* FIXME: For now just hardcode maxrewind to 3 seconds */
@@ -431,6 +540,12 @@ pa_resampler* pa_resampler_new(
     return r;
 
 fail:
+    if (r->lfe_filter)
+        pa_lfe_filter_free(r->lfe_filter);
+
+    if (r->setup)
+        setup_unref(r->setup);
+
     pa_xfree(r);
 
     return NULL;
@@ -456,7 +571,7 @@ void pa_resampler_free(pa_resampler *r) {
     if (r->from_work_format_buf.memblock)
         pa_memblock_unref(r->from_work_format_buf.memblock);
 
-    free_remap(&r->remap);
+    setup_unref(r->setup);
 
     pa_xfree(r);
 }
@@ -578,18 +693,40 @@ void pa_resampler_reset(pa_resampler *r) {
     *r->have_leftover = false;
 }
 
-void pa_resampler_rewind(pa_resampler *r, size_t out_frames) {
+size_t pa_resampler_rewind(pa_resampler *r, size_t in_length) {
+    unsigned out_n_frames = (unsigned) -1;
+    size_t out_length;
+
     pa_assert(r);
 
-    /* For now, we don't have any rewindable resamplers, so we just
-       reset the resampler instead (and hope that nobody hears the difference). */
-    if (r->impl.reset)
-        r->impl.reset(r);
+    if (r->impl.rewind && !*r->have_leftover)
+        out_n_frames = r->impl.rewind(r, (unsigned) (in_length / r->i_fz));
+
+    if (out_n_frames != (unsigned) -1)
+        out_length = out_n_frames * r->o_fz;
+    else {
+        /* The resampler can't go back exactly, so we just reset it
+         * instead (and hope that nobody hears the difference). */
+        out_length = pa_resampler_result(r, in_length);
+        out_n_frames = (unsigned) (out_length / r->o_fz);
+
+        if (r->impl.reset)
+            r->impl.reset(r);
 
+        *r->have_leftover = false;
+    }
+
+    /* The LFE filter works on the work format */
     if (r->lfe_filter)
-        pa_lfe_filter_rewind(r->lfe_filter, out_frames);
+        pa_lfe_filter_rewind(r->lfe_filter, out_n_frames * r->w_sz * r->o_ss.channels);
 
-    *r->have_leftover = false;
+    return out_length;
+}
+
+void pa_resampler_set_max_rewind(pa_resampler *r, size_t in_length) {
+    pa_assert(r);
+
+    r->max_rewind = in_length / r->i_fz;
 }
 
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r) {
@@ -657,7 +794,10 @@ static const char * const resample_methods[] = {
     "peaks",
     "soxr-mq",
     "soxr-hq",
-    "soxr-vhq"
+    "soxr-vhq",
+    "sinc-low",
+    "sinc-medium",
+    "sinc-high"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -708,6 +848,9 @@ pa_resample_method_t pa_parse_resample_method(const char *string) {
     if (pa_streq(string, "speex-float"))
         return PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
+    if (pa_streq(string, "sinc"))
+        return PA_RESAMPLER_SINC_MEDIUM;
+
     return PA_RESAMPLER_INVALID;
 }
 
@@ -794,7 +937,7 @@ static int front_rear_side(pa_channel_position_t p) {
     return ON_OTHER;
 }
 
-static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed) {
+static void setup_remap(const pa_resampler *r, pa_sample_format_t work_format, pa_remap_t *m, bool *lfe_remixed) {
     unsigned oc, ic;
     unsigned n_oc, n_ic;
     bool ic_connected[PA_CHANNELS_MAX];
@@ -808,7 +951,7 @@ static void setup_remap(const pa_resampler *r, pa_remap_t *m, bool *lfe_remixed)
     n_oc = r->o_ss.channels;
     n_ic = r->i_ss.channels;
 
-    m->format = r->work_format;
+    m->format = work_format;
     m->i_ss = r->i_ss;
     m->o_ss = r->o_ss;
 
@@ -1229,9 +1372,10 @@ static pa_memchunk* convert_to_work_format(pa_resampler *r, pa_memchunk *input)
     src = pa_memblock_acquire_chunk(input);
     dst = (uint8_t *) pa_memblock_acquire(r->to_work_format_buf.memblock) + leftover_length;
 
-    if (r->to_work_format_func)
+    if (r->to_work_format_func) {
         r->to_work_format_func(in_n_samples, src, dst);
-    else
+        r->converted_samples += in_n_samples;
+    } else
         memcpy(dst, src, input->length);
 
     pa_memblock_release(input->memblock);
@@ -1277,7 +1421,7 @@ static pa_memchunk *remap_channels(pa_resampler *r, pa_memchunk *input) {
     dst = (uint8_t *) pa_memblock_acquire(r->remap_buf.memblock) + leftover_length;
 
     if (r->map_required) {
-        pa_remap_t *remap = &r->remap;
+        pa_remap_t *remap = &r->setup->remap;
 
         pa_assert(remap->do_remap);
         remap->do_remap(remap, dst, src, in_n_frames);
@@ -1356,6 +1500,7 @@ static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input
     src = pa_memblock_acquire_chunk(input);
     dst = pa_memblock_acquire(r->from_work_format_buf.memblock);
     r->from_work_format_func(n_samples, src, dst);
+    r->converted_samples += n_samples;
     pa_memblock_release(input->memblock);
     pa_memblock_release(r->from_work_format_buf.memblock);
 
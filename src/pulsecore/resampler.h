@@ -30,6 +30,7 @@
 
 typedef struct pa_resampler pa_resampler;
 typedef struct pa_resampler_impl pa_resampler_impl;
+typedef struct pa_resampler_setup pa_resampler_setup;
 
 struct pa_resampler_impl {
     void (*free)(pa_resampler *r);
@@ -39,6 +40,13 @@ struct pa_resampler_impl {
     unsigned (*resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_n_frames, pa_memchunk *out, unsigned *out_n_frames);
 
     void (*reset)(pa_resampler *r);
+
+    /* Optional. Forgets the last in_n_frames frames of input, as if they
+     * had never been passed in. Returns the number of output frames that
+     * were generated from them, or (unsigned) -1 if the implementation
+     * cannot go back that far. */
+    unsigned (*rewind)(pa_resampler *r, unsigned in_n_frames);
+
     void *data;
 };
 
@@ -61,6 +69,9 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_SOXR_MQ,
     PA_RESAMPLER_SOXR_HQ,
     PA_RESAMPLER_SOXR_VHQ,
+    PA_RESAMPLER_SINC_LOW,
+    PA_RESAMPLER_SINC_MEDIUM,
+    PA_RESAMPLER_SINC_HIGH,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -98,17 +109,28 @@ struct pa_resampler {
     bool leftover_in_remap;
     bool leftover_in_to_work;
 
+    /* The work format, conversion functions and remap matrix, shared
+     * with all resamplers with the same method, formats, channel maps
+     * and flags. The fields below are copied from it. */
+    pa_resampler_setup *setup;
+
     pa_sample_format_t work_format;
     uint8_t work_channels;
 
     pa_convert_func_t to_work_format_func;
     pa_convert_func_t from_work_format_func;
 
-    pa_remap_t remap;
     bool map_required;
 
     pa_lfe_filter_t *lfe_filter;
 
+    /* How many samples were converted to or from the work format.
+     * Users read and reset this after pa_resampler_run(). */
+    uint64_t converted_samples;
+
+    /* In input frames */
+    size_t max_rewind;
+
     pa_resampler_impl impl;
 };
 
@@ -145,8 +167,12 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate);
 /* Reinitialize state of the resampler, possibly due to seeking or other discontinuities */
 void pa_resampler_reset(pa_resampler *r);
 
-/* Rewind resampler */
-void pa_resampler_rewind(pa_resampler *r, size_t out_frames);
+/* Rewind the resampler by the specified amount of input, which will be
+ * passed in again. Returns the amount of output that has to be discarded. */
+size_t pa_resampler_rewind(pa_resampler *r, size_t in_length);
+
+/* Keep enough history to be able to rewind by up to in_length of input */
+void pa_resampler_set_max_rewind(pa_resampler *r, size_t in_length);
 
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
@@ -172,6 +198,7 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_sinc_init(pa_resampler *r);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
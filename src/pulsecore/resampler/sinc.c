@@ -0,0 +1,745 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/gccmacro.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/resampler.h>
+
+#include "sinc.h"
+
+/* A polyphase windowed-sinc resampler.
+ *
+ * Output frame n is centered on input position n * in_rate / out_rate.
+ * The position is kept as an input frame index plus a fraction in
+ * units of 1/den, where num/den is the reduced rate ratio, so it is
+ * exact for any pair of rates no matter how long the stream runs. That
+ * is what makes it possible to rewind by an exact number of input
+ * frames.
+ *
+ * Every output sample is the dot product of n_taps history samples
+ * around that position with the row of filter coefficients for its
+ * fractional part. If den is small (160 for 44.1 kHz -> 48 kHz) the
+ * table has a row for each possible fraction. Otherwise, e.g. for rates
+ * that are being adjusted with pa_sink_input_set_rate(), it has a fixed
+ * number of rows and the coefficients are interpolated linearly between
+ * the two closest ones.
+ *
+ * The tables only depend on the method and the rate ratio, so they are
+ * shared by all resamplers that use the same ones. */
+
+/* Largest table with one row per fraction, in coefficients */
+#define MAX_DIRECT_COEFFS (1 << 17)
+
+/* Largest interpolated table, in coefficients */
+#define MAX_INTERPOLATED_COEFFS (1 << 18)
+
+/* Interpolated tables are keyed by the downsampling ratio rounded up to
+ * a multiple of 1/RATIO_STEPS, so that small rate adjustments map to
+ * the same table and the cutoff never ends up too high */
+#define RATIO_STEPS 64
+
+/* How many tables that no resampler uses any more to keep around */
+#define MAX_UNUSED_TABLES 4
+
+struct preset {
+    unsigned n_taps;
+    unsigned n_phases;      /* rows of an interpolated table */
+    double cutoff;          /* relative to the lower of the two Nyquist frequencies */
+    double beta;            /* of the Kaiser window */
+};
+
+static const struct preset presets[] = {
+    [PA_RESAMPLER_SINC_LOW - PA_RESAMPLER_SINC_LOW]       = { 16, 64, 0.78, 5.1 },     /* ~55 dB stop band */
+    [PA_RESAMPLER_SINC_MEDIUM - PA_RESAMPLER_SINC_LOW]    = { 48, 256, 0.90, 7.3 },    /* ~75 dB */
+    [PA_RESAMPLER_SINC_HIGH - PA_RESAMPLER_SINC_LOW]      = { 128, 512, 0.945, 10.6 }, /* ~105 dB */
+};
+
+struct table {
+    pa_resample_method_t method;
+    unsigned num, den;
+    bool interpolate;
+
+    unsigned n_taps;
+    unsigned n_phases;
+
+    /* n_phases rows of n_taps coefficients, and one more row for
+     * interpolated tables. Row p is for the fraction p / n_phases. */
+    float *coeffs;
+
+    /* The same as s16, scaled by 2^s16_shift. Only for direct tables. */
+    int16_t *coeffs_s16;
+    unsigned s16_shift;
+
+    unsigned ref;
+    PA_LLIST_FIELDS(struct table);
+};
+
+static pa_static_mutex tables_mutex = PA_STATIC_MUTEX_INIT;
+static PA_LLIST_HEAD(struct table, tables) = NULL;
+static unsigned n_unused_tables = 0;
+
+struct sinc_data {
+    struct table *table;
+    unsigned n_taps;
+
+    /* The reduced rate ratio, and the distance between two output
+     * frames in input frames: step_int + step_frac / den */
+    unsigned num, den;
+    unsigned step_int, step_frac;
+
+    /* The input history, with one row of history_size frames per
+     * channel. Column t of row c is channel c of input frame
+     * history_index + t. */
+    void *history;
+    size_t history_size;
+    int64_t history_index;
+
+    /* Index of the next input frame */
+    int64_t in_index;
+
+    /* Position of the next output frame */
+    int64_t pos_int;
+    unsigned pos_frac;
+
+    /* Position of the first output frame after the last reset or rate
+     * change, and how many frames have been output since */
+    int64_t epoch_int;
+    unsigned epoch_frac;
+    uint64_t epoch_n_out;
+
+    /* Interpolated coefficients */
+    float *row;
+    int16_t *row_s16;
+};
+
+static float dot_float_generic(const float *x, const float *h, unsigned n) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    unsigned i;
+
+    for (i = 0; i < n; i += 4) {
+        s0 += x[i] * h[i];
+        s1 += x[i + 1] * h[i + 1];
+        s2 += x[i + 2] * h[i + 2];
+        s3 += x[i + 3] * h[i + 3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static int64_t dot_s16_generic(const int16_t *x, const int16_t *h, unsigned n) {
+    int64_t s0 = 0, s1 = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i += 2) {
+        s0 += (int32_t) x[i] * h[i];
+        s1 += (int32_t) x[i + 1] * h[i + 1];
+    }
+
+    return s0 + s1;
+}
+
+static pa_sinc_dot_float_func_t dot_float_func = dot_float_generic;
+static pa_sinc_dot_s16_func_t dot_s16_func = dot_s16_generic;
+
+pa_sinc_dot_float_func_t pa_get_sinc_dot_float_func(void) {
+    return dot_float_func;
+}
+
+void pa_set_sinc_dot_float_func(pa_sinc_dot_float_func_t func) {
+    dot_float_func = func;
+}
+
+pa_sinc_dot_s16_func_t pa_get_sinc_dot_s16_func(void) {
+    return dot_s16_func;
+}
+
+void pa_set_sinc_dot_s16_func(pa_sinc_dot_s16_func_t func) {
+    dot_s16_func = func;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0, y = x * x / 4.0;
+    unsigned k;
+
+    for (k = 1; k < 100 && term > sum * 1e-14; k++) {
+        term *= y / ((double) k * k);
+        sum += term;
+    }
+
+    return sum;
+}
+
+/* The low pass filter with the given cutoff, at time t, windowed with
+ * a Kaiser window that spans [-half, half] */
+static double kaiser_sinc(double t, double half, double cutoff, double beta, double i0_beta) {
+    double x = t / half, w;
+
+    if (fabs(x) >= 1.0)
+        return 0.0;
+
+    w = bessel_i0(beta * sqrt(1.0 - x * x)) / i0_beta;
+
+    if (fabs(t) < 1e-9)
+        return cutoff * w;
+
+    return sin(M_PI * cutoff * t) / (M_PI * t) * w;
+}
+
+static const struct preset *get_preset(pa_resample_method_t method) {
+    pa_assert(method >= PA_RESAMPLER_SINC_LOW && method <= PA_RESAMPLER_SINC_HIGH);
+
+    return &presets[method - PA_RESAMPLER_SINC_LOW];
+}
+
+/* When downsampling, the filter gets longer by the ratio */
+static unsigned get_n_taps(const struct preset *p, unsigned num, unsigned den) {
+    uint64_t n = p->n_taps;
+
+    if (num > den)
+        n = (n * num + den - 1) / den;
+
+    return PA_ROUND_UP((unsigned) n, 16);
+}
+
+static void get_table_key(pa_resample_method_t method, unsigned num, unsigned den,
+                          unsigned *key_num, unsigned *key_den, bool *interpolate) {
+
+    if ((uint64_t) den * get_n_taps(get_preset(method), num, den) <= MAX_DIRECT_COEFFS) {
+        *key_num = num;
+        *key_den = den;
+        *interpolate = false;
+    } else if (num <= den) {
+        *key_num = *key_den = 1;
+        *interpolate = true;
+    } else {
+        *key_num = (unsigned) (((uint64_t) num * RATIO_STEPS + den - 1) / den);
+        *key_den = RATIO_STEPS;
+        *interpolate = true;
+    }
+}
+
+static int16_t coeff_to_s16(float h, unsigned shift) {
+    long v = lrintf(h * (float) (1 << shift));
+
+    return (int16_t) PA_CLAMP_UNLIKELY(v, -0x8000, 0x7FFF);
+}
+
+static struct table *table_new(pa_resample_method_t method, unsigned num, unsigned den, bool interpolate) {
+    const struct preset *p = get_preset(method);
+    struct table *t;
+    double cutoff, half, i0_beta, max_coeff = 0.0, max_lane_sum = 0.0, *row;
+    unsigned n_rows, i, k;
+
+    t = pa_xnew0(struct table, 1);
+    t->method = method;
+    t->num = num;
+    t->den = den;
+    t->interpolate = interpolate;
+    t->n_taps = get_n_taps(p, num, den);
+
+    if (interpolate) {
+        t->n_phases = p->n_phases;
+        while (t->n_phases > 32 && (t->n_phases + 1) * t->n_taps > MAX_INTERPOLATED_COEFFS)
+            t->n_phases /= 2;
+        n_rows = t->n_phases + 1;
+    } else {
+        t->n_phases = den;
+        n_rows = den;
+    }
+
+    cutoff = num > den ? p->cutoff * den / num : p->cutoff;
+    half = t->n_taps / 2;
+    i0_beta = bessel_i0(p->beta);
+
+    pa_log_debug("Computing %s sinc table for ratio %u/%u: %u taps, %u rows, cutoff %0.3f",
+                 interpolate ? "interpolated" : "direct", num, den, t->n_taps, n_rows, cutoff);
+
+    t->coeffs = pa_xnew(float, n_rows * t->n_taps);
+    row = pa_xnew(double, t->n_taps);
+
+    for (i = 0; i < n_rows; i++) {
+        double f = (double) i / t->n_phases, sum = 0.0, lane_sum[8] = { 0.0 };
+
+        /* Tap k is applied to the input frame at offset k - half + 1
+         * from the integer part of the position */
+        for (k = 0; k < t->n_taps; k++) {
+            row[k] = kaiser_sinc(k - half + 1 - f, half, cutoff, p->beta, i0_beta);
+            sum += row[k];
+        }
+
+        /* Normalize every row to unity gain at DC */
+        for (k = 0; k < t->n_taps; k++) {
+            t->coeffs[i * t->n_taps + k] = (float) (row[k] / sum);
+            max_coeff = PA_MAX(max_coeff, fabs(row[k] / sum));
+            lane_sum[(k % 16) / 2] += fabs(row[k] / sum);
+        }
+
+        for (k = 0; k < 8; k++)
+            max_lane_sum = PA_MAX(max_lane_sum, lane_sum[k]);
+    }
+
+    pa_xfree(row);
+
+    /* Make sure that the coefficients fit, and that the partial sums of
+     * the products of a full scale s16 signal with the rounded
+     * coefficients stay below 2^31 */
+    t->s16_shift = 15;
+    while (t->s16_shift > 1 &&
+           (max_coeff * (1 << t->s16_shift) >= 0x7FFF ||
+            max_lane_sum * (1 << t->s16_shift) + t->n_taps / 8 >= 0x10000))
+        t->s16_shift--;
+
+    if (!interpolate) {
+        t->coeffs_s16 = pa_xnew(int16_t, n_rows * t->n_taps);
+        for (k = 0; k < n_rows * t->n_taps; k++)
+            t->coeffs_s16[k] = coeff_to_s16(t->coeffs[k], t->s16_shift);
+    }
+
+    return t;
+}
+
+static void table_free(struct table *t) {
+    pa_xfree(t->coeffs);
+    pa_xfree(t->coeffs_s16);
+    pa_xfree(t);
+}
+
+static struct table *table_ref(pa_resample_method_t method, unsigned num, unsigned den, bool interpolate) {
+    pa_mutex *m;
+    struct table *t;
+
+    m = pa_static_mutex_get(&tables_mutex, false, false);
+    pa_mutex_lock(m);
+
+    PA_LLIST_FOREACH(t, tables)
+        if (t->method == method && t->num == num && t->den == den && t->interpolate == interpolate)
+            break;
+
+    if (t) {
+        if (t->ref++ == 0)
+            n_unused_tables--;
+    } else {
+        t = table_new(method, num, den, interpolate);
+        t->ref = 1;
+        PA_LLIST_PREPEND(struct table, tables, t);
+    }
+
+    pa_mutex_unlock(m);
+
+    return t;
+}
+
+static void table_unref(struct table *t) {
+    pa_mutex *m;
+
+    m = pa_static_mutex_get(&tables_mutex, false, false);
+    pa_mutex_lock(m);
+
+    pa_assert(t->ref > 0);
+
+    if (--t->ref == 0) {
+        struct table *i, *oldest = NULL;
+
+        /* Move it to the front, so that the unused tables at the end of
+         * the list are the ones that have been unused the longest */
+        PA_LLIST_REMOVE(struct table, tables, t);
+        PA_LLIST_PREPEND(struct table, tables, t);
+
+        if (++n_unused_tables > MAX_UNUSED_TABLES) {
+            PA_LLIST_FOREACH(i, tables)
+                if (i->ref == 0)
+                    oldest = i;
+
+            PA_LLIST_REMOVE(struct table, tables, oldest);
+            table_free(oldest);
+            n_unused_tables--;
+        }
+    }
+
+    pa_mutex_unlock(m);
+}
+
+static void free_unused_tables(void) PA_GCC_DESTRUCTOR;
+
+static void free_unused_tables(void) {
+    struct table *t, *n;
+
+    PA_LLIST_FOREACH_SAFE(t, n, tables)
+        if (t->ref == 0) {
+            PA_LLIST_REMOVE(struct table, tables, t);
+            table_free(t);
+        }
+}
+
+/* Make room in the history for frames [first, in_index + n_frames).
+ * Frames before first are dropped. If first is before the beginning of
+ * the history, it is padded with silence. */
+static void fit_history(pa_resampler *r, struct sinc_data *d, int64_t first, size_t n_frames) {
+    size_t sz = r->w_sz, size, n_zero, n_copy;
+    int64_t copy_from;
+    uint8_t *history;
+    unsigned c;
+
+    pa_assert(first <= d->in_index);
+
+    if (first >= d->history_index && (size_t) (d->in_index - d->history_index) + n_frames <= d->history_size)
+        return;
+
+    copy_from = PA_MAX(first, d->history_index);
+    n_copy = (size_t) (d->in_index - copy_from);
+    n_zero = (size_t) (copy_from - first);
+
+    size = d->history_size;
+    if (n_zero + n_copy + n_frames > size) {
+        size = (n_zero + n_copy + n_frames) * 2;
+        history = pa_xmalloc(size * r->work_channels * sz);
+    } else
+        history = d->history;
+
+    for (c = 0; c < r->work_channels; c++) {
+        uint8_t *dst = history + c * size * sz;
+
+        if (n_copy > 0)
+            memmove(dst + n_zero * sz,
+                    (uint8_t *) d->history + (c * d->history_size + (size_t) (copy_from - d->history_index)) * sz,
+                    n_copy * sz);
+        memset(dst, 0, n_zero * sz);
+    }
+
+    if (history != d->history) {
+        pa_xfree(d->history);
+        d->history = history;
+        d->history_size = size;
+    }
+
+    d->history_index = first;
+}
+
+static void append_history(pa_resampler *r, struct sinc_data *d, const void *src, unsigned n_frames) {
+    size_t offset = (size_t) (d->in_index - d->history_index);
+    unsigned c, i, channels = r->work_channels;
+
+    if (r->work_format == PA_SAMPLE_FLOAT32NE) {
+        const float *s = src;
+
+        for (c = 0; c < channels; c++) {
+            float *dst = (float *) d->history + c * d->history_size + offset;
+
+            for (i = 0; i < n_frames; i++)
+                dst[i] = s[i * channels + c];
+        }
+    } else {
+        const int16_t *s = src;
+
+        for (c = 0; c < channels; c++) {
+            int16_t *dst = (int16_t *) d->history + c * d->history_size + offset;
+
+            for (i = 0; i < n_frames; i++)
+                dst[i] = s[i * channels + c];
+        }
+    }
+
+    d->in_index += n_frames;
+}
+
+static void set_position(struct sinc_data *d, uint64_t n_out) {
+    uint64_t q = d->epoch_frac + n_out * d->num;
+
+    d->pos_int = d->epoch_int + (int64_t) (q / d->den);
+    d->pos_frac = (unsigned) (q % d->den);
+    d->epoch_n_out = n_out;
+}
+
+static void advance(struct sinc_data *d) {
+    d->pos_int += d->step_int;
+    d->pos_frac += d->step_frac;
+
+    if (d->pos_frac >= d->den) {
+        d->pos_frac -= d->den;
+        d->pos_int++;
+    }
+}
+
+/* Returns the two rows to interpolate between for the current
+ * position, and the weight of the second one */
+static float get_rows(struct sinc_data *d, const float **h0) {
+    const struct table *t = d->table;
+    uint64_t p = (uint64_t) d->pos_frac * t->n_phases;
+
+    *h0 = t->coeffs + (p / d->den) * t->n_taps;
+
+    return (float) (p % d->den) / (float) d->den;
+}
+
+static unsigned produce_float(pa_resampler *r, struct sinc_data *d, float *out, unsigned max_n_frames) {
+    pa_sinc_dot_float_func_t dot = dot_float_func;
+    unsigned n, k, c, channels = r->work_channels, n_taps = d->n_taps, half = n_taps / 2;
+
+    for (n = 0; n < max_n_frames && d->pos_int + half < d->in_index; n++) {
+        const float *x = (const float *) d->history + (d->pos_int - half + 1 - d->history_index);
+        const float *h;
+
+        if (!d->table->interpolate)
+            h = d->table->coeffs + d->pos_frac * n_taps;
+        else {
+            const float *h0, *h1;
+            float a = get_rows(d, &h0);
+
+            h1 = h0 + n_taps;
+            for (k = 0; k < n_taps; k++)
+                d->row[k] = h0[k] + a * (h1[k] - h0[k]);
+
+            h = d->row;
+        }
+
+        for (c = 0; c < channels; c++)
+            *out++ = dot(x + c * d->history_size, h, n_taps);
+
+        advance(d);
+    }
+
+    d->epoch_n_out += n;
+
+    return n;
+}
+
+static unsigned produce_s16(pa_resampler *r, struct sinc_data *d, int16_t *out, unsigned max_n_frames) {
+    pa_sinc_dot_s16_func_t dot = dot_s16_func;
+    unsigned n, k, c, channels = r->work_channels, n_taps = d->n_taps, half = n_taps / 2;
+    unsigned shift = d->table->s16_shift;
+    int64_t round = 1 << (shift - 1);
+
+    for (n = 0; n < max_n_frames && d->pos_int + half < d->in_index; n++) {
+        const int16_t *x = (const int16_t *) d->history + (d->pos_int - half + 1 - d->history_index);
+        const int16_t *h;
+
+        if (!d->table->interpolate)
+            h = d->table->coeffs_s16 + d->pos_frac * n_taps;
+        else {
+            const float *h0, *h1;
+            float a = get_rows(d, &h0);
+
+            h1 = h0 + n_taps;
+            for (k = 0; k < n_taps; k++)
+                d->row_s16[k] = coeff_to_s16(h0[k] + a * (h1[k] - h0[k]), shift);
+
+            h = d->row_s16;
+        }
+
+        for (c = 0; c < channels; c++) {
+            int64_t sum = (dot(x + c * d->history_size, h, n_taps) + round) >> shift;
+
+            *out++ = (int16_t) PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
+        }
+
+        advance(d);
+    }
+
+    d->epoch_n_out += n;
+
+    return n;
+}
+
+static unsigned sinc_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    struct sinc_data *d;
+    int64_t first;
+    void *src, *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+
+    /* Keep what the next output frame needs, and enough to be able to
+     * rewind by max_rewind frames */
+    first = PA_MIN(d->pos_int - (int64_t) (d->n_taps / 2) + 1,
+                   d->in_index - (int64_t) r->max_rewind - (int64_t) d->n_taps + 1);
+    fit_history(r, d, PA_MAX(first, d->history_index), in_n_frames);
+
+    src = pa_memblock_acquire_chunk(input);
+    append_history(r, d, src, in_n_frames);
+    pa_memblock_release(input->memblock);
+
+    dst = pa_memblock_acquire_chunk(output);
+    if (r->work_format == PA_SAMPLE_FLOAT32NE)
+        *out_n_frames = produce_float(r, d, dst, *out_n_frames);
+    else
+        *out_n_frames = produce_s16(r, d, dst, *out_n_frames);
+    pa_memblock_release(output->memblock);
+
+    /* All input is kept in the history */
+    return 0;
+}
+
+static unsigned sinc_rewind(pa_resampler *r, unsigned in_n_frames) {
+    struct sinc_data *d;
+    int64_t in_index, m, pos_int;
+    unsigned half, pos_frac;
+    uint64_t n_out, epoch_n_out;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    half = d->n_taps / 2;
+    in_index = d->in_index - in_n_frames;
+
+    /* We only know where the output frames since the last reset or rate
+     * change were taken from. Those before may have used frames from
+     * in_index on only if in_index is close to the epoch. */
+    m = in_index - half - d->epoch_int;
+    if (in_index < d->history_index || m < 1)
+        return (unsigned) -1;
+
+    /* Output frame n stays valid if all of its input does, i.e. if
+     * pos_int(n) + half < in_index */
+    n_out = ((uint64_t) m * d->den - d->epoch_frac + d->num - 1) / d->num;
+    n_out = PA_MIN(n_out, d->epoch_n_out);
+
+    pos_int = d->pos_int;
+    pos_frac = d->pos_frac;
+    epoch_n_out = d->epoch_n_out;
+
+    set_position(d, n_out);
+
+    if (d->pos_int - half + 1 < d->history_index) {
+        d->pos_int = pos_int;
+        d->pos_frac = pos_frac;
+        d->epoch_n_out = epoch_n_out;
+        return (unsigned) -1;
+    }
+
+    d->in_index = in_index;
+
+    return (unsigned) (epoch_n_out - n_out);
+}
+
+static void set_rates(pa_resampler *r, struct sinc_data *d) {
+    unsigned g, num, den;
+    bool interpolate;
+    struct table *t;
+
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+    d->num = r->i_ss.rate / g;
+    d->den = r->o_ss.rate / g;
+    d->step_int = d->num / d->den;
+    d->step_frac = d->num % d->den;
+
+    get_table_key(r->method, d->num, d->den, &num, &den, &interpolate);
+
+    if (d->table && d->table->num == num && d->table->den == den && d->table->interpolate == interpolate)
+        return;
+
+    t = table_ref(r->method, num, den, interpolate);
+    if (d->table)
+        table_unref(d->table);
+    d->table = t;
+
+    d->n_taps = t->n_taps;
+    d->row = pa_xrenew(float, d->row, d->n_taps);
+    d->row_s16 = pa_xrenew(int16_t, d->row_s16, d->n_taps);
+}
+
+static void sinc_update_rates(pa_resampler *r) {
+    struct sinc_data *d;
+    unsigned den;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    den = d->den;
+
+    set_rates(r, d);
+
+    /* Carry the position over, and start a new epoch there */
+    d->pos_frac = (unsigned) ((uint64_t) d->pos_frac * d->den / den);
+    d->epoch_int = d->pos_int;
+    d->epoch_frac = d->pos_frac;
+    d->epoch_n_out = 0;
+
+    /* The filter may have become longer */
+    fit_history(r, d, PA_MIN(d->pos_int - (int64_t) (d->n_taps / 2) + 1, d->history_index), 0);
+}
+
+static void sinc_reset(pa_resampler *r) {
+    struct sinc_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    d->history_index = d->in_index = 0;
+    d->pos_int = d->epoch_int = 0;
+    d->pos_frac = d->epoch_frac = 0;
+    d->epoch_n_out = 0;
+
+    /* The first output frame is centered on the first input frame, the
+     * history before that is silence */
+    fit_history(r, d, - (int64_t) (d->n_taps / 2) + 1, 0);
+}
+
+static void sinc_free(pa_resampler *r) {
+    struct sinc_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+    if (!d)
+        return;
+
+    if (d->table)
+        table_unref(d->table);
+
+    pa_xfree(d->history);
+    pa_xfree(d->row);
+    pa_xfree(d->row_s16);
+    pa_xfree(d);
+}
+
+int pa_resampler_sinc_init(pa_resampler *r) {
+    struct sinc_data *d;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE || r->work_format == PA_SAMPLE_S16NE);
+
+    d = pa_xnew0(struct sinc_data, 1);
+    set_rates(r, d);
+
+    r->impl.free = sinc_free;
+    r->impl.update_rates = sinc_update_rates;
+    r->impl.resample = sinc_resample;
+    r->impl.rewind = sinc_rewind;
+    r->impl.reset = sinc_reset;
+    r->impl.data = d;
+
+    sinc_reset(r);
+
+    return 0;
+}
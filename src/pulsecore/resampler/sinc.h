@@ -0,0 +1,37 @@
+#ifndef foosinchfoo
+#define foosinchfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+/* The inner loops of the polyphase sinc resampler: the dot product of
+ * n history samples of one channel with n filter coefficients. n is
+ * always a multiple of 16. The s16 version returns the plain sum of
+ * the products. The coefficients are scaled such that the products of
+ * the taps with the same (k % 16) / 2 can be summed up in 32 bits. */
+typedef float (*pa_sinc_dot_float_func_t) (const float *x, const float *h, unsigned n);
+typedef int64_t (*pa_sinc_dot_s16_func_t) (const int16_t *x, const int16_t *h, unsigned n);
+
+pa_sinc_dot_float_func_t pa_get_sinc_dot_float_func(void);
+void pa_set_sinc_dot_float_func(pa_sinc_dot_float_func_t func);
+
+pa_sinc_dot_s16_func_t pa_get_sinc_dot_s16_func(void);
+void pa_set_sinc_dot_s16_func(pa_sinc_dot_s16_func_t func);
+
+#endif
@@ -0,0 +1,79 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-x86.h>
+
+#include "sinc.h"
+
+#include <immintrin.h>
+
+/* n is a multiple of 16. The float version sums in a different order
+ * than the C version, so the results may differ in the last bits. The
+ * s16 version is exact. */
+
+static float dot_float_avx2(const float *x, const float *h, unsigned n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m128 s;
+    unsigned i;
+
+    for (i = 0; i < n; i += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(h + i + 8)));
+    }
+
+    s0 = _mm256_add_ps(s0, s1);
+    s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+
+    return _mm_cvtss_f32(s);
+}
+
+static int64_t dot_s16_avx2(const int16_t *x, const int16_t *h, unsigned n) {
+    __m256i s0 = _mm256_setzero_si256(), s64;
+    __m128i s;
+    int64_t sum;
+    unsigned i;
+
+    /* Lane l sums up the products of taps 2l and 2l + 1 of each block
+     * of 16, which the tables guarantee to fit */
+    for (i = 0; i < n; i += 16)
+        s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *) (x + i)),
+                                                     _mm256_loadu_si256((const __m256i *) (h + i))));
+
+    /* The total might not */
+    s64 = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(s0)),
+                           _mm256_cvtepi32_epi64(_mm256_extracti128_si256(s0, 1)));
+    s = _mm_add_epi64(_mm256_castsi256_si128(s64), _mm256_extracti128_si256(s64, 1));
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    _mm_storel_epi64((__m128i *) &sum, s);
+
+    return sum;
+}
+
+void pa_sinc_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized sinc resampler functions.");
+
+    pa_set_sinc_dot_float_func(dot_float_avx2);
+    pa_set_sinc_dot_s16_func(dot_s16_avx2);
+}
@@ -26,6 +26,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -38,12 +46,31 @@
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
 
 /* #define DEBUG_TIMING */
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#define USE_EPOLL
+#endif
+
+#ifdef USE_EPOLL
+/* An fd registered with epoll, together with the pollfds that refer
+ * to it */
+struct epoll_fd {
+    int fd;
+    uint32_t events;
+    uint32_t wanted;
+    unsigned *slots;
+    unsigned n_slots, n_slots_alloc;
+    struct epoll_fd *next_dead;
+};
+#endif
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
@@ -51,6 +78,27 @@ struct pa_rtpoll {
     struct timeval next_elapse;
     bool timer_enabled:1;
 
+    pa_rtpoll_backend_t backend;
+
+#ifdef USE_EPOLL
+    int epoll_fd, timer_fd;
+
+    /* fd -> struct epoll_fd */
+    pa_hashmap *epoll_fds;
+
+    /* The fd and events of every pollfd as last registered with epoll,
+     * to detect changes. Only valid if !epoll_resync. */
+    struct pollfd *registered;
+    unsigned n_registered_alloc;
+    bool epoll_resync:1;
+
+    struct epoll_event *epoll_events;
+    unsigned n_epoll_events_alloc;
+
+    struct timeval timer_armed;
+    bool timer_is_armed:1;
+#endif
+
     bool scan_for_dead:1;
     bool running:1;
     bool rebuild_needed:1;
@@ -62,6 +110,11 @@ struct pa_rtpoll {
     pa_usec_t slept, awake;
 #endif
 
+    /* How long each sleep took, and how late we woke up when the
+     * timer elapsed */
+    pa_histogram sleep_histogram;
+    pa_histogram late_histogram;
+
     PA_LLIST_HEAD(pa_rtpoll_item, items);
 };
 
@@ -84,15 +137,131 @@ struct pa_rtpoll_item {
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
-pa_rtpoll *pa_rtpoll_new(void) {
+static pa_rtpoll_backend_t default_backend = PA_RTPOLL_BACKEND_POLL;
+
+static const char * const backend_table[PA_RTPOLL_BACKEND_MAX] = {
+    [PA_RTPOLL_BACKEND_POLL] = "poll",
+    [PA_RTPOLL_BACKEND_EPOLL] = "epoll",
+};
+
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t b) {
+    if (b < 0 || b >= PA_RTPOLL_BACKEND_MAX)
+        return NULL;
+
+    return backend_table[b];
+}
+
+int pa_parse_rtpoll_backend(const char *string) {
+    pa_rtpoll_backend_t b;
+
+    pa_assert(string);
+
+    for (b = 0; b < PA_RTPOLL_BACKEND_MAX; b++)
+        if (pa_streq(string, backend_table[b]))
+            return b;
+
+    return -1;
+}
+
+bool pa_rtpoll_backend_supported(pa_rtpoll_backend_t b) {
+    switch (b) {
+        case PA_RTPOLL_BACKEND_POLL:
+            return true;
+        case PA_RTPOLL_BACKEND_EPOLL:
+#ifdef USE_EPOLL
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+/* Called from main context before any IO threads are started */
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t b) {
+    pa_assert(b >= 0 && b < PA_RTPOLL_BACKEND_MAX);
+
+    if (!pa_rtpoll_backend_supported(b)) {
+        pa_log_warn("rtpoll backend %s not supported, using %s.",
+                    pa_rtpoll_backend_to_string(b), pa_rtpoll_backend_to_string(PA_RTPOLL_BACKEND_POLL));
+        b = PA_RTPOLL_BACKEND_POLL;
+    }
+
+    default_backend = b;
+}
+
+#ifdef USE_EPOLL
+static void epoll_fd_free(struct epoll_fd *e) {
+    pa_xfree(e->slots);
+    pa_xfree(e);
+}
+
+static int epoll_init(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_warn("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return -1;
+    }
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)) < 0) {
+        pa_log_warn("timerfd_create() failed: %s", pa_cstrerror(errno));
+        pa_close(p->epoll_fd);
+        return -1;
+    }
+
+    /* The timer is the only event without an epoll_fd */
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_warn("Failed to add timerfd to epoll: %s", pa_cstrerror(errno));
+        pa_close(p->timer_fd);
+        pa_close(p->epoll_fd);
+        return -1;
+    }
+
+    p->epoll_fds = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL,
+                                       (pa_free_cb_t) epoll_fd_free);
+    p->epoll_resync = true;
+
+    return 0;
+}
+
+static void epoll_done(pa_rtpoll *p) {
+    pa_hashmap_free(p->epoll_fds);
+    p->epoll_fds = NULL;
+
+    pa_close(p->timer_fd);
+    pa_close(p->epoll_fd);
+
+    pa_xfree(p->registered);
+    p->registered = NULL;
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+}
+#endif
+
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t b) {
     pa_rtpoll *p;
 
+    pa_assert(b >= 0 && b < PA_RTPOLL_BACKEND_MAX);
+
     p = pa_xnew0(pa_rtpoll, 1);
 
     p->n_pollfd_alloc = 32;
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+    p->backend = PA_RTPOLL_BACKEND_POLL;
+
+#ifdef USE_EPOLL
+    if (b == PA_RTPOLL_BACKEND_EPOLL && epoll_init(p) >= 0)
+        p->backend = PA_RTPOLL_BACKEND_EPOLL;
+#endif
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -100,6 +269,26 @@ pa_rtpoll *pa_rtpoll_new(void) {
     return p;
 }
 
+pa_rtpoll *pa_rtpoll_new(void) {
+    return pa_rtpoll_new_with_backend(default_backend);
+}
+
+void pa_rtpoll_get_histograms(pa_rtpoll *p, pa_histogram *sleep, pa_histogram *late) {
+    pa_assert(p);
+
+    if (sleep)
+        *sleep = p->sleep_histogram;
+
+    if (late)
+        *late = p->late_histogram;
+}
+
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p) {
+    pa_assert(p);
+
+    return p->backend;
+}
+
 static void rtpoll_rebuild(pa_rtpoll *p) {
 
     struct pollfd *e, *t;
@@ -143,8 +332,218 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
 
     if (ra)
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
+
+#ifdef USE_EPOLL
+    /* The pollfds have moved, so their slots have changed */
+    p->epoll_resync = true;
+#endif
 }
 
+#ifdef USE_EPOLL
+/* Register, modify or remove e from the epoll set, as needed. The fd
+ * may have been closed and its number reused behind our back, so with
+ * force the registration is renewed even if nothing changed. */
+static int epoll_update(pa_rtpoll *p, struct epoll_fd *e, bool force) {
+    struct epoll_event ev;
+    int r;
+
+    if (e->n_slots == 0) {
+        /* A closed fd has been removed from the epoll set already */
+        if (epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, e->fd, NULL) < 0 && errno != EBADF && errno != ENOENT)
+            pa_log_warn("Failed to remove fd %i from epoll: %s", e->fd, pa_cstrerror(errno));
+
+        return 0;
+    }
+
+    if (e->wanted == e->events && !force)
+        return 0;
+
+    pa_zero(ev);
+    ev.events = e->wanted;
+    ev.data.ptr = e;
+
+    if (e->events) {
+        if ((r = epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, e->fd, &ev)) < 0 && errno == ENOENT)
+            r = epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, e->fd, &ev);
+    } else {
+        if ((r = epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, e->fd, &ev)) < 0 && errno == EEXIST)
+            r = epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, e->fd, &ev);
+    }
+
+    if (r < 0) {
+        pa_log_debug("Failed to add fd %i to epoll: %s", e->fd, pa_cstrerror(errno));
+        return -1;
+    }
+
+    e->events = e->wanted;
+    return 0;
+}
+
+/* Bring the epoll set in line with the pollfd array. Returns negative
+ * if some fd can't be used with epoll. */
+static int epoll_sync(pa_rtpoll *p) {
+    struct epoll_fd *e, *dead = NULL;
+    void *state;
+    unsigned k;
+    bool force;
+    int r = 0;
+
+    if (!p->epoll_resync) {
+        /* Users may change fds and events at any time, so look for
+         * changes. This is cheap compared to what poll() does with
+         * every fd in the kernel on every call. */
+        for (k = 0; k < p->n_pollfd_used; k++)
+            if (p->pollfd[k].fd != p->registered[k].fd || p->pollfd[k].events != p->registered[k].events)
+                break;
+
+        if (k >= p->n_pollfd_used)
+            return 0;
+    }
+
+    /* Items have been added or removed, so fds may have been closed
+     * and reopened */
+    force = p->epoll_resync;
+
+    if (p->n_registered_alloc < p->n_pollfd_alloc) {
+        p->n_registered_alloc = p->n_pollfd_alloc;
+        p->registered = pa_xrealloc(p->registered, p->n_registered_alloc * sizeof(struct pollfd));
+    }
+
+    PA_HASHMAP_FOREACH(e, p->epoll_fds, state) {
+        e->n_slots = 0;
+        e->wanted = 0;
+    }
+
+    for (k = 0; k < p->n_pollfd_used; k++) {
+        struct pollfd *f = &p->pollfd[k];
+
+        p->registered[k] = *f;
+
+        /* Like poll(), ignore negative fds */
+        if (f->fd < 0)
+            continue;
+
+        if (!(e = pa_hashmap_get(p->epoll_fds, PA_INT_TO_PTR(f->fd)))) {
+            e = pa_xnew0(struct epoll_fd, 1);
+            e->fd = f->fd;
+            pa_hashmap_put(p->epoll_fds, PA_INT_TO_PTR(f->fd), e);
+        }
+
+        if (e->n_slots >= e->n_slots_alloc) {
+            e->n_slots_alloc = PA_MAX(2 * e->n_slots_alloc, 1U);
+            e->slots = pa_xrealloc(e->slots, e->n_slots_alloc * sizeof(unsigned));
+        }
+
+        e->slots[e->n_slots++] = k;
+
+        /* Errors and hangups are always reported, like with poll() */
+        e->wanted |= (uint32_t) f->events | EPOLLERR | EPOLLHUP;
+    }
+
+    PA_HASHMAP_FOREACH(e, p->epoll_fds, state) {
+        if (epoll_update(p, e, force) < 0)
+            r = -1;
+
+        if (e->n_slots == 0) {
+            e->next_dead = dead;
+            dead = e;
+        }
+    }
+
+    while (dead) {
+        e = dead;
+        dead = e->next_dead;
+        pa_hashmap_remove_and_free(p->epoll_fds, PA_INT_TO_PTR(e->fd));
+    }
+
+    if (p->n_epoll_events_alloc < pa_hashmap_size(p->epoll_fds) + 1) {
+        p->n_epoll_events_alloc = 2 * (pa_hashmap_size(p->epoll_fds) + 1);
+        p->epoll_events = pa_xrealloc(p->epoll_events, p->n_epoll_events_alloc * sizeof(struct epoll_event));
+    }
+
+    p->epoll_resync = r < 0;
+    return r;
+}
+
+static void epoll_set_timer(pa_rtpoll *p, bool enable) {
+    struct itimerspec its;
+
+    if (enable && p->timer_is_armed && pa_timeval_cmp(&p->timer_armed, &p->next_elapse) == 0)
+        return;
+
+    if (!enable && !p->timer_is_armed)
+        return;
+
+    pa_zero(its);
+
+    if (enable) {
+        its.it_value.tv_sec = p->next_elapse.tv_sec;
+        its.it_value.tv_nsec = p->next_elapse.tv_usec * 1000;
+    }
+
+    if (timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        pa_log_error("timerfd_settime(): %s", pa_cstrerror(errno));
+        p->timer_is_armed = false;
+        return;
+    }
+
+    p->timer_armed = p->next_elapse;
+    p->timer_is_armed = enable;
+}
+
+/* Like poll() on the pollfd array, with the timeout given as for
+ * ppoll() */
+static int epoll_wait_pollfds(pa_rtpoll *p, const struct timeval *timeout) {
+    int timeout_ms = -1, n, k, r = 0;
+
+    if (timeout) {
+        if (timeout->tv_sec > 0 || timeout->tv_usec > 0)
+            /* The rtpoll clock is CLOCK_MONOTONIC, which is what the
+             * timerfd uses, so we can arm it with the absolute time */
+            epoll_set_timer(p, true);
+        else
+            timeout_ms = 0;
+    } else
+        epoll_set_timer(p, false);
+
+    n = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_epoll_events_alloc, timeout_ms);
+
+    if (n < 0)
+        return n;
+
+    for (k = 0; (unsigned) k < p->n_pollfd_used; k++)
+        p->pollfd[k].revents = 0;
+
+    for (k = 0; k < n; k++) {
+        struct epoll_fd *e = p->epoll_events[k].data.ptr;
+        unsigned j;
+
+        if (!e) {
+            uint64_t expirations;
+
+            /* Just acknowledge the timer. Whether it elapsed is decided
+             * like with poll(): when nothing else happened. */
+            if (read(p->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                pa_log_error("Failed to read timerfd: %s", pa_cstrerror(errno));
+
+            p->timer_is_armed = false;
+            continue;
+        }
+
+        for (j = 0; j < e->n_slots; j++) {
+            struct pollfd *f = &p->pollfd[e->slots[j]];
+
+            f->revents = (short) (p->epoll_events[k].events & ((uint32_t) f->events | EPOLLERR | EPOLLHUP));
+
+            if (f->revents)
+                r++;
+        }
+    }
+
+    return r;
+}
+#endif
+
 static void rtpoll_item_destroy(pa_rtpoll_item *i) {
     pa_rtpoll *p;
 
@@ -154,12 +553,13 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
 
     PA_LLIST_REMOVE(pa_rtpoll_item, p->items, i);
 
+    if (i->n_pollfd > 0)
+        p->rebuild_needed = true;
+
     p->n_pollfd_used -= i->n_pollfd;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(items), i) < 0)
         pa_xfree(i);
-
-    p->rebuild_needed = true;
 }
 
 void pa_rtpoll_free(pa_rtpoll *p) {
@@ -171,6 +571,11 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        epoll_done(p);
+#endif
+
     pa_xfree(p);
 }
 
@@ -205,6 +610,7 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     pa_rtpoll_item *i;
     int r = 0;
     struct timeval timeout;
+    pa_usec_t sleep_start, wake_up;
 
     pa_assert(p);
     pa_assert(!p->running);
@@ -305,20 +711,45 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 #endif
 
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL && epoll_sync(p) < 0) {
+        /* Some fds, like regular files, don't work with epoll */
+        pa_log_info("Falling back to poll() for this rtpoll.");
+        epoll_done(p);
+        p->backend = PA_RTPOLL_BACKEND_POLL;
+    }
+#endif
+
     /* OK, now let's sleep */
-#ifdef HAVE_PPOLL
+    sleep_start = pa_rtclock_now();
+
+#ifdef USE_EPOLL
+    if (p->backend == PA_RTPOLL_BACKEND_EPOLL)
+        r = epoll_wait_pollfds(p, (p->quit || p->timer_enabled) ? &timeout : NULL);
+    else
+#endif
     {
+#ifdef HAVE_PPOLL
         struct timespec ts;
         ts.tv_sec = timeout.tv_sec;
         ts.tv_nsec = timeout.tv_usec * 1000;
         r = ppoll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? &ts : NULL, NULL);
-    }
 #else
-    r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
+        r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
 #endif
+    }
 
     p->timer_elapsed = r == 0;
 
+    wake_up = pa_rtclock_now();
+    pa_histogram_add(&p->sleep_histogram, wake_up - sleep_start);
+
+    if (p->timer_elapsed && p->timer_enabled && !p->quit) {
+        pa_usec_t deadline = pa_timeval_load(&p->next_elapse);
+
+        pa_histogram_add(&p->late_histogram, wake_up > deadline ? wake_up - deadline : 0);
+    }
+
 #ifdef DEBUG_TIMING
     {
         pa_usec_t now = pa_rtclock_now();
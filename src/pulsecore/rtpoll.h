@@ -26,6 +26,7 @@
 #include <pulse/sample.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/fdsem.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/macro.h>
 
 /* An implementation of a "real-time" poll loop. Basically, this is
@@ -51,9 +52,35 @@ typedef enum pa_rtpoll_priority {
     PA_RTPOLL_NEVER  = INT_MAX,       /* For stuff that doesn't register any callbacks, but only fds to listen on */
 } pa_rtpoll_priority_t;
 
+/* How pa_rtpoll_run() sleeps. The epoll backend keeps the fds
+ * registered with the kernel between iterations and uses a timerfd
+ * for the timer, which is cheaper than poll() when there are many
+ * fds. Fds that epoll can't handle make an rtpoll fall back to
+ * poll(). */
+typedef enum pa_rtpoll_backend {
+    PA_RTPOLL_BACKEND_POLL,
+    PA_RTPOLL_BACKEND_EPOLL,
+    PA_RTPOLL_BACKEND_MAX
+} pa_rtpoll_backend_t;
+
+const char *pa_rtpoll_backend_to_string(pa_rtpoll_backend_t b);
+int pa_parse_rtpoll_backend(const char *string);
+bool pa_rtpoll_backend_supported(pa_rtpoll_backend_t b);
+
+/* Select the backend used by pa_rtpoll_new() */
+void pa_rtpoll_set_default_backend(pa_rtpoll_backend_t b);
+
 pa_rtpoll *pa_rtpoll_new(void);
+pa_rtpoll *pa_rtpoll_new_with_backend(pa_rtpoll_backend_t b);
 void pa_rtpoll_free(pa_rtpoll *p);
 
+pa_rtpoll_backend_t pa_rtpoll_get_backend(pa_rtpoll *p);
+
+/* Copy the histograms of how long the thread slept in each iteration
+ * and of how late it woke up whenever the timer elapsed. Only call
+ * this from the thread that runs the rtpoll. */
+void pa_rtpoll_get_histograms(pa_rtpoll *p, pa_histogram *sleep, pa_histogram *late);
+
 /* Sleep on the rtpoll until the time event, or any of the fd events
  * is triggered. Returns negative on error, positive if the loop
  * should continue to run, 0 when the loop should be terminated
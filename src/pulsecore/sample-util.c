@@ -51,6 +51,9 @@ pa_memblock *pa_silence_memblock(pa_memblock* b, const pa_sample_spec *spec) {
     pa_silence_memory(data, pa_memblock_get_length(b), spec);
     pa_memblock_release(b);
 
+    pa_memblock_add_silence(b, 0, pa_memblock_get_length(b));
+    pa_memblock_drop_planar(b);
+
     return b;
 }
 
@@ -65,6 +68,9 @@ pa_memchunk* pa_silence_memchunk(pa_memchunk *c, const pa_sample_spec *spec) {
     pa_silence_memory((uint8_t*) data+c->index, c->length, spec);
     pa_memblock_release(c->memblock);
 
+    pa_memblock_add_silence(c->memblock, c->index, c->length);
+    pa_memblock_drop_planar(c->memblock);
+
     return c;
 }
 
@@ -101,6 +107,66 @@ void* pa_silence_memory(void *p, size_t length, const pa_sample_spec *spec) {
     return p;
 }
 
+static inline uint64_t load_word(const uint8_t *p) {
+    uint64_t w;
+
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+void pa_memchunk_detect_silence(const pa_memchunk *c, const pa_sample_spec *spec, size_t min_length) {
+    const uint8_t *d;
+    uint8_t b;
+    uint64_t pattern;
+    size_t fs, i, end;
+
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(spec);
+
+    fs = pa_frame_size(spec);
+    min_length = PA_MAX(min_length, fs);
+
+    b = silence_byte(spec->format);
+    pattern = b * UINT64_C(0x0101010101010101);
+
+    d = pa_memblock_acquire_chunk(c);
+
+    /* Audio that isn't silent hardly ever contains eight silence bytes
+     * in a row, so we skip it a word at a time, and only look at single
+     * bytes at the edges of the silent runs we find */
+    for (i = 0, end = 0; i + sizeof(pattern) <= c->length;) {
+        size_t start;
+
+        if (load_word(d + i) != pattern) {
+            i += sizeof(pattern);
+            continue;
+        }
+
+        start = i;
+        while (start > end && d[start - 1] == b)
+            start--;
+
+        for (i += sizeof(pattern); i + sizeof(pattern) <= c->length && load_word(d + i) == pattern; i += sizeof(pattern))
+            ;
+        while (i < c->length && d[i] == b)
+            i++;
+
+        end = i;
+
+        /* Only whole frames count */
+        start = PA_ROUND_UP(start, fs);
+        i = end - end % fs;
+
+        if (i > start && i - start >= min_length)
+            pa_memblock_add_silence(c->memblock, c->index + start, i - start);
+
+        i = end;
+    }
+
+    pa_memblock_release(c->memblock);
+}
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) {
     size_t fs;
 
@@ -121,7 +187,96 @@ bool pa_frame_aligned(size_t l, const pa_sample_spec *ss) {
     return l % fs == 0;
 }
 
+/* Interleaving with a channel count and sample size known at compile
+ * time lets the compiler unroll the inner loop. These are the defaults
+ * for the common cases, which optimized versions can replace. */
+#define DEFINE_INTERLEAVE(type, channels)                               \
+    static void interleave_##type##_##channels(const void *src[], void *dst, unsigned n) { \
+        type *d = dst;                                                  \
+        unsigned c, j;                                                  \
+                                                                        \
+        for (j = 0; j < n; j++)                                         \
+            for (c = 0; c < channels; c++)                              \
+                *d++ = ((const type *) src[c])[j];                      \
+    }                                                                   \
+                                                                        \
+    static void deinterleave_##type##_##channels(const void *src, void *dst[], unsigned n) { \
+        const type *s = src;                                            \
+        unsigned c, j;                                                  \
+                                                                        \
+        for (j = 0; j < n; j++)                                         \
+            for (c = 0; c < channels; c++)                              \
+                ((type *) dst[c])[j] = *s++;                            \
+    }
+
+DEFINE_INTERLEAVE(uint16_t, 2)
+DEFINE_INTERLEAVE(uint16_t, 4)
+DEFINE_INTERLEAVE(uint16_t, 6)
+DEFINE_INTERLEAVE(uint16_t, 8)
+DEFINE_INTERLEAVE(uint32_t, 2)
+DEFINE_INTERLEAVE(uint32_t, 4)
+DEFINE_INTERLEAVE(uint32_t, 6)
+DEFINE_INTERLEAVE(uint32_t, 8)
+
+/* Indexed by the sample size (2 or 4 bytes) and the channel count (2,
+ * 4, 6 or 8) */
+static pa_do_interleave_func_t interleave_table[2][4] = {
+    { interleave_uint16_t_2, interleave_uint16_t_4, interleave_uint16_t_6, interleave_uint16_t_8 },
+    { interleave_uint32_t_2, interleave_uint32_t_4, interleave_uint32_t_6, interleave_uint32_t_8 },
+};
+
+static pa_do_deinterleave_func_t deinterleave_table[2][4] = {
+    { deinterleave_uint16_t_2, deinterleave_uint16_t_4, deinterleave_uint16_t_6, deinterleave_uint16_t_8 },
+    { deinterleave_uint32_t_2, deinterleave_uint32_t_4, deinterleave_uint32_t_6, deinterleave_uint32_t_8 },
+};
+
+static inline bool interleave_index(size_t ss, unsigned channels, unsigned *i, unsigned *j) {
+    if ((ss != 2 && ss != 4) || channels < 2 || channels > 8 || (channels & 1))
+        return false;
+
+    *i = ss / 4;
+    *j = channels / 2 - 1;
+    return true;
+}
+
+pa_do_interleave_func_t pa_get_interleave_func(size_t ss, unsigned channels) {
+    unsigned i, j;
+
+    if (!interleave_index(ss, channels, &i, &j))
+        return NULL;
+
+    return interleave_table[i][j];
+}
+
+void pa_set_interleave_func(size_t ss, unsigned channels, pa_do_interleave_func_t func) {
+    unsigned i, j;
+
+    pa_assert_se(interleave_index(ss, channels, &i, &j));
+    pa_assert(func);
+
+    interleave_table[i][j] = func;
+}
+
+pa_do_deinterleave_func_t pa_get_deinterleave_func(size_t ss, unsigned channels) {
+    unsigned i, j;
+
+    if (!interleave_index(ss, channels, &i, &j))
+        return NULL;
+
+    return deinterleave_table[i][j];
+}
+
+void pa_set_deinterleave_func(size_t ss, unsigned channels, pa_do_deinterleave_func_t func) {
+    unsigned i, j;
+
+    pa_assert_se(interleave_index(ss, channels, &i, &j));
+    pa_assert(func);
+
+    deinterleave_table[i][j] = func;
+}
+
 void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+    pa_do_interleave_func_t func;
     unsigned c;
     size_t fs;
 
@@ -131,6 +286,11 @@ void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, u
     pa_assert(ss > 0);
     pa_assert(n > 0);
 
+    if ((func = pa_get_interleave_func(ss, channels))) {
+        func(src, dst, n);
+        return;
+    }
+
     fs = ss * channels;
 
     for (c = 0; c < channels; c++) {
@@ -150,6 +310,7 @@ void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, u
 }
 
 void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+    pa_do_deinterleave_func_t func;
     size_t fs;
     unsigned c;
 
@@ -159,6 +320,11 @@ void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss,
     pa_assert(ss > 0);
     pa_assert(n > 0);
 
+    if ((func = pa_get_deinterleave_func(ss, channels))) {
+        func(src, dst, n);
+        return;
+    }
+
     fs = ss * channels;
 
     for (c = 0; c < channels; c++) {
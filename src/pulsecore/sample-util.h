@@ -43,6 +43,10 @@ void *pa_silence_memory(void *p, size_t length, const pa_sample_spec *spec);
 pa_memchunk* pa_silence_memchunk(pa_memchunk *c, const pa_sample_spec *spec);
 pa_memblock* pa_silence_memblock(pa_memblock *b, const pa_sample_spec *spec);
 
+/* Look for runs of silence of at least min_length bytes in c and mark
+ * them in its memblock, see pa_memblock_add_silence() */
+void pa_memchunk_detect_silence(const pa_memchunk *c, const pa_sample_spec *spec, size_t min_length);
+
 pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
 
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
@@ -52,6 +56,17 @@ bool pa_frame_aligned(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
 void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n);
 void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n);
 
+/* pa_interleave() and pa_deinterleave() use these for 16 and 32 bit
+ * samples with 2, 4, 6 or 8 channels. The get functions return NULL for
+ * anything else. */
+typedef void (*pa_do_interleave_func_t) (const void *src[], void *dst, unsigned n);
+typedef void (*pa_do_deinterleave_func_t) (const void *src, void *dst[], unsigned n);
+
+pa_do_interleave_func_t pa_get_interleave_func(size_t ss, unsigned channels);
+void pa_set_interleave_func(size_t ss, unsigned channels, pa_do_interleave_func_t func);
+pa_do_deinterleave_func_t pa_get_deinterleave_func(size_t ss, unsigned channels);
+void pa_set_deinterleave_func(size_t ss, unsigned channels, pa_do_deinterleave_func_t func);
+
 void pa_sample_clamp(pa_sample_format_t format, void *dst, size_t dstr, const void *src, size_t sstr, unsigned n);
 
 static inline int32_t pa_mult_s16_volume(int16_t v, int32_t cv) {
@@ -0,0 +1,353 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "sconv.h"
+
+#include <immintrin.h>
+
+/* All conversions work on blocks of eight samples. The integer formats
+ * are loaded into, and stored from, vectors of 32 bit samples in which
+ * full scale is 2^31, so that every integer format can be converted to
+ * any other one, or to float, with a single intermediate step. The
+ * byte swapping for the big endian formats and the packing of the
+ * 16 and 24 bit formats is done with byte shuffles.
+ *
+ * The results are bit-identical to the C versions in sconv.c and
+ * sconv-s16le.c. */
+
+#define BLOCK 8
+
+#define Z (-1)
+
+/* Loading */
+
+static inline __m256i load_s16le(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, Z, 0, 1, Z, Z, 2, 3, Z, Z, 4, 5, Z, Z, 6, 7,
+        Z, Z, 8, 9, Z, Z, 10, 11, Z, Z, 12, 13, Z, Z, 14, 15);
+
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) a)), shuffle);
+}
+
+static inline __m256i load_s16be(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, Z, 1, 0, Z, Z, 3, 2, Z, Z, 5, 4, Z, Z, 7, 6,
+        Z, Z, 9, 8, Z, Z, 11, 10, Z, Z, 13, 12, Z, Z, 15, 14);
+
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) a)), shuffle);
+}
+
+static inline __m256i load_s32le(const uint8_t *a) {
+    return _mm256_loadu_si256((const __m256i *) a);
+}
+
+static inline __m256i load_s32be(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) a), shuffle);
+}
+
+static inline __m256i load_s24_32le(const uint8_t *a) {
+    return _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) a), 8);
+}
+
+static inline __m256i load_s24_32be(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13,
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13);
+
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) a), shuffle);
+}
+
+/* The 24 bytes of a block of packed 24 bit samples are loaded as bytes
+ * 0-15 into the low lane and bytes 8-23 into the high lane, so that
+ * each lane holds four complete samples without reading beyond the
+ * block */
+static inline __m256i load_24(const uint8_t *a) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) a)),
+                                   _mm_loadu_si128((const __m128i *) (a + 8)), 1);
+}
+
+static inline __m256i load_s24le(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11,
+        Z, 4, 5, 6, Z, 7, 8, 9, Z, 10, 11, 12, Z, 13, 14, 15);
+
+    return _mm256_shuffle_epi8(load_24(a), shuffle);
+}
+
+static inline __m256i load_s24be(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 2, 1, 0, Z, 5, 4, 3, Z, 8, 7, 6, Z, 11, 10, 9,
+        Z, 6, 5, 4, Z, 9, 8, 7, Z, 12, 11, 10, Z, 15, 14, 13);
+
+    return _mm256_shuffle_epi8(load_24(a), shuffle);
+}
+
+static inline __m256 load_float32le(const uint8_t *a) {
+    return _mm256_loadu_ps((const float *) a);
+}
+
+static inline __m256 load_float32be(const uint8_t *a) {
+    return _mm256_castsi256_ps(load_s32be(a));
+}
+
+/* Storing */
+
+static inline void store_s16(uint8_t *b, __m256i v, __m256i shuffle) {
+    /* Gather the low halves of both lanes */
+    v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, shuffle), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i *) b, _mm256_castsi256_si128(v));
+}
+
+static inline void store_s16le(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 3, 6, 7, 10, 11, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z,
+        2, 3, 6, 7, 10, 11, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z);
+
+    store_s16(b, v, shuffle);
+}
+
+static inline void store_s16be(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 7, 6, 11, 10, 15, 14, Z, Z, Z, Z, Z, Z, Z, Z,
+        3, 2, 7, 6, 11, 10, 15, 14, Z, Z, Z, Z, Z, Z, Z, Z);
+
+    store_s16(b, v, shuffle);
+}
+
+static inline void store_s32le(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, v);
+}
+
+static inline void store_s32be(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    _mm256_storeu_si256((__m256i *) b, _mm256_shuffle_epi8(v, shuffle));
+}
+
+static inline void store_s24_32le(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, _mm256_srli_epi32(v, 8));
+}
+
+static inline void store_s24_32be(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13,
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13);
+
+    _mm256_storeu_si256((__m256i *) b, _mm256_shuffle_epi8(v, shuffle));
+}
+
+static inline void store_24(uint8_t *b, __m256i v, __m256i shuffle) {
+    /* Pack 12 bytes in each lane, then move the 24 bytes together */
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), gather);
+    _mm_storeu_si128((__m128i *) b, _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i *) (b + 16), _mm256_extracti128_si256(v, 1));
+}
+
+static inline void store_s24le(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, Z, Z, Z, Z,
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, Z, Z, Z, Z);
+
+    store_24(b, v, shuffle);
+}
+
+static inline void store_s24be(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, Z, Z, Z, Z,
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, Z, Z, Z, Z);
+
+    store_24(b, v, shuffle);
+}
+
+static inline void store_float32le(uint8_t *b, __m256 v) {
+    _mm256_storeu_ps((float *) b, v);
+}
+
+static inline void store_float32be(uint8_t *b, __m256 v) {
+    store_s32be(b, _mm256_castps_si256(v));
+}
+
+/* Conversion between float and the 32 bit intermediate format */
+
+static inline __m256 int_to_float(__m256i v) {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / (1U << 31)));
+}
+
+/* Scale to 32 bits and round. cvtps2dq returns 0x80000000 for anything
+ * out of range, which is correct for large negative values only. */
+static inline __m256i float_to_int(__m256 v) {
+    const __m256 limit = _mm256_set1_ps((float) (1U << 31));
+    __m256i r;
+
+    v = _mm256_mul_ps(v, limit);
+    r = _mm256_cvtps_epi32(v);
+
+    return _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7FFFFFFF), _mm256_castps_si256(_mm256_cmp_ps(v, limit, _CMP_GE_OQ)));
+}
+
+/* The 16 bit formats are rounded at 16 bits, not truncated from 32 */
+static inline __m256i float_to_int16(__m256 v) {
+    v = _mm256_mul_ps(v, _mm256_set1_ps(1 << 15));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-0x8000)), _mm256_set1_ps(0x7FFF));
+
+    return _mm256_slli_epi32(_mm256_cvtps_epi32(v), 16);
+}
+
+/* Define a conversion function from a function that converts one block
+ * of eight samples. The remaining samples are converted through zero
+ * padded buffers. */
+#define DEFINE_CONVERT(name, in_size, out_size, block_func)             \
+    static void name(unsigned n, const uint8_t *a, uint8_t *b) {        \
+        for (; n >= BLOCK; n -= BLOCK) {                                \
+            block_func(a, b);                                           \
+            a += BLOCK * (in_size);                                     \
+            b += BLOCK * (out_size);                                    \
+        }                                                               \
+                                                                        \
+        if (n > 0) {                                                    \
+            uint8_t in[BLOCK * 4] = { 0 }, out[BLOCK * 4];              \
+                                                                        \
+            memcpy(in, a, n * (in_size));                               \
+            block_func(in, out);                                        \
+            memcpy(b, out, n * (out_size));                             \
+        }                                                               \
+    }
+
+#define DEFINE_INT_CONVERSIONS(format, size)                            \
+    static inline void format##_to_float32ne_block(const uint8_t *a, uint8_t *b) { \
+        store_float32le(b, int_to_float(load_##format(a)));             \
+    }                                                                   \
+    static inline void format##_from_float32ne_block(const uint8_t *a, uint8_t *b) { \
+        store_##format(b, float_to_int(load_float32le(a)));             \
+    }                                                                   \
+    static inline void format##_to_s16ne_block(const uint8_t *a, uint8_t *b) { \
+        store_s16le(b, load_##format(a));                               \
+    }                                                                   \
+    static inline void format##_from_s16ne_block(const uint8_t *a, uint8_t *b) { \
+        store_##format(b, load_s16le(a));                               \
+    }                                                                   \
+    DEFINE_CONVERT(format##_to_float32ne_avx2, size, 4, format##_to_float32ne_block) \
+    DEFINE_CONVERT(format##_from_float32ne_avx2, 4, size, format##_from_float32ne_block) \
+    DEFINE_CONVERT(format##_to_s16ne_avx2, size, 2, format##_to_s16ne_block) \
+    DEFINE_CONVERT(format##_from_s16ne_avx2, 2, size, format##_from_s16ne_block)
+
+DEFINE_INT_CONVERSIONS(s32le, 4)
+DEFINE_INT_CONVERSIONS(s32be, 4)
+DEFINE_INT_CONVERSIONS(s24le, 3)
+DEFINE_INT_CONVERSIONS(s24be, 3)
+DEFINE_INT_CONVERSIONS(s24_32le, 4)
+DEFINE_INT_CONVERSIONS(s24_32be, 4)
+
+/* s16 <-> float, and s16 byte swapping */
+
+static inline void s16le_to_float32ne_block(const uint8_t *a, uint8_t *b) {
+    store_float32le(b, int_to_float(load_s16le(a)));
+}
+
+static inline void s16be_to_float32ne_block(const uint8_t *a, uint8_t *b) {
+    store_float32le(b, int_to_float(load_s16be(a)));
+}
+
+static inline void s16le_from_float32ne_block(const uint8_t *a, uint8_t *b) {
+    store_s16le(b, float_to_int16(load_float32le(a)));
+}
+
+static inline void s16be_from_float32ne_block(const uint8_t *a, uint8_t *b) {
+    store_s16be(b, float_to_int16(load_float32le(a)));
+}
+
+static inline void float32be_to_s16ne_block(const uint8_t *a, uint8_t *b) {
+    store_s16le(b, float_to_int16(load_float32be(a)));
+}
+
+static inline void float32be_from_s16ne_block(const uint8_t *a, uint8_t *b) {
+    store_float32be(b, int_to_float(load_s16le(a)));
+}
+
+static inline void s16re_to_s16ne_block(const uint8_t *a, uint8_t *b) {
+    store_s16le(b, load_s16be(a));
+}
+
+DEFINE_CONVERT(s16le_to_float32ne_avx2, 2, 4, s16le_to_float32ne_block)
+DEFINE_CONVERT(s16be_to_float32ne_avx2, 2, 4, s16be_to_float32ne_block)
+DEFINE_CONVERT(s16le_from_float32ne_avx2, 4, 2, s16le_from_float32ne_block)
+DEFINE_CONVERT(s16be_from_float32ne_avx2, 4, 2, s16be_from_float32ne_block)
+DEFINE_CONVERT(float32be_to_s16ne_avx2, 4, 2, float32be_to_s16ne_block)
+DEFINE_CONVERT(float32be_from_s16ne_avx2, 2, 4, float32be_from_s16ne_block)
+DEFINE_CONVERT(s16re_to_s16ne_avx2, 2, 2, s16re_to_s16ne_block)
+
+/* float byte swapping */
+
+static inline void float32re_to_float32ne_block(const uint8_t *a, uint8_t *b) {
+    store_float32le(b, load_float32be(a));
+}
+
+DEFINE_CONVERT(float32re_to_float32ne_avx2, 4, 4, float32re_to_float32ne_block)
+
+void pa_convert_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized conversions.");
+
+#define SET_INT_CONVERSIONS(format, name)                                                       \
+    pa_set_convert_to_float32ne_function(format, (pa_convert_func_t) name##_to_float32ne_avx2);     \
+    pa_set_convert_from_float32ne_function(format, (pa_convert_func_t) name##_from_float32ne_avx2); \
+    pa_set_convert_to_s16ne_function(format, (pa_convert_func_t) name##_to_s16ne_avx2);             \
+    pa_set_convert_from_s16ne_function(format, (pa_convert_func_t) name##_from_s16ne_avx2)
+
+    SET_INT_CONVERSIONS(PA_SAMPLE_S32LE, s32le);
+    SET_INT_CONVERSIONS(PA_SAMPLE_S32BE, s32be);
+    SET_INT_CONVERSIONS(PA_SAMPLE_S24LE, s24le);
+    SET_INT_CONVERSIONS(PA_SAMPLE_S24BE, s24be);
+    SET_INT_CONVERSIONS(PA_SAMPLE_S24_32LE, s24_32le);
+    SET_INT_CONVERSIONS(PA_SAMPLE_S24_32BE, s24_32be);
+
+#undef SET_INT_CONVERSIONS
+
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_to_float32ne_avx2);
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_to_float32ne_avx2);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) s16le_from_float32ne_avx2);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16be_from_float32ne_avx2);
+
+    /* float32ne <-> s16ne is the same function as s16ne <-> float32ne */
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) s16le_from_float32ne_avx2);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) s16le_to_float32ne_avx2);
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) float32be_to_s16ne_avx2);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) float32be_from_s16ne_avx2);
+
+    pa_set_convert_to_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16re_to_s16ne_avx2);
+    pa_set_convert_from_s16ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) s16re_to_s16ne_avx2);
+
+    pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) float32re_to_float32ne_avx2);
+    pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) float32re_to_float32ne_avx2);
+}
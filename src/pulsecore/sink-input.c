@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/utf8.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
@@ -834,6 +835,22 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from main context */
+void pa_sink_input_get_timing(pa_sink_input *i, pa_sink_input_timing *t) {
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->state));
+    pa_assert(t);
+
+    pa_zero(*t);
+
+    /* While the stream is being moved, nobody updates the histograms */
+    if (!i->sink)
+        return;
+
+    pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
     bool do_volume_adj_here, need_volume_factor_sink;
@@ -841,6 +858,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     size_t block_size_max_sink, block_size_max_sink_input;
     size_t ilength;
     size_t ilength_full;
+    pa_usec_t start;
 
     pa_sink_input_assert_ref(i);
     pa_sink_input_assert_io_context(i);
@@ -849,6 +867,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
     pa_assert(chunk);
     pa_assert(volume);
 
+    start = pa_rtclock_now();
+
 #ifdef SINK_INPUT_DEBUG
     pa_log_debug("peek");
 #endif
@@ -962,7 +982,10 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                 pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
             } else {
                 pa_memchunk rchunk;
+                pa_usec_t resample_start = pa_rtclock_now();
+
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_histogram_add(&i->thread_info.resample_histogram, pa_rtclock_now() - resample_start);
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -1012,6 +1035,8 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
         *volume = i->thread_info.soft_volume;
+
+    pa_histogram_add(&i->thread_info.peek_histogram, pa_rtclock_now() - start);
 }
 
 /* Called from thread context */
@@ -1095,9 +1120,9 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
                 i->process_rewind(i, amount);
             called = true;
 
-            /* Convert back to sink domain */
+            /* Rewind the resampler, and convert back to sink domain */
             if (i->thread_info.resampler)
-                amount = pa_resampler_result(i->thread_info.resampler, amount);
+                amount = pa_resampler_rewind(i->thread_info.resampler, amount);
 
             if (amount > 0)
                 /* Ok, now update the write pointer */
@@ -1105,10 +1130,6 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
 
             if (i->thread_info.rewrite_flush)
                 pa_memblockq_silence(i->thread_info.render_memblockq);
-
-            /* And rewind the resampler */
-            if (i->thread_info.resampler)
-                pa_resampler_rewind(i->thread_info.resampler, amount);
         }
     }
 
@@ -1149,8 +1170,14 @@ void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the
 
     pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, nbytes);
 
+    /* Transform into local domain */
+    if (i->thread_info.resampler) {
+        nbytes = pa_resampler_request(i->thread_info.resampler, nbytes);
+        pa_resampler_set_max_rewind(i->thread_info.resampler, nbytes);
+    }
+
     if (i->update_max_rewind)
-        i->update_max_rewind(i, i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, nbytes) : nbytes);
+        i->update_max_rewind(i, nbytes);
 }
 
 /* Called from thread context */
@@ -1982,6 +2009,14 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
             *r = i->thread_info.requested_sink_latency;
             return 0;
         }
+
+        case PA_SINK_INPUT_MESSAGE_GET_TIMING: {
+            pa_sink_input_timing *t = userdata;
+
+            t->peek = i->thread_info.peek_histogram;
+            t->resample = i->thread_info.resample_histogram;
+            return 0;
+        }
     }
 
     return -PA_ERR_NOTIMPLEMENTED;
@@ -26,6 +26,7 @@
 #include <pulsecore/typedefs.h>
 #include <pulse/sample.h>
 #include <pulse/format.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
@@ -249,6 +250,11 @@ struct pa_sink_input {
         pa_usec_t requested_sink_latency;
 
         pa_hashmap *direct_outputs;
+
+        /* How long each pa_sink_input_peek() call took, and how much
+         * of that was spent in the resampler */
+        pa_histogram peek_histogram;
+        pa_histogram resample_histogram;
     } thread_info;
 
     void *userdata;
@@ -265,9 +271,16 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_STATE,
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
+    PA_SINK_INPUT_MESSAGE_GET_TIMING,
     PA_SINK_INPUT_MESSAGE_MAX
 };
 
+/* Timing statistics of a sink input, see pa_sink_input_get_timing() */
+typedef struct pa_sink_input_timing {
+    pa_histogram peek;
+    pa_histogram resample;
+} pa_sink_input_timing;
+
 typedef struct pa_sink_input_send_event_hook_data {
     pa_sink_input *sink_input;
     const char *event;
@@ -363,6 +376,7 @@ size_t pa_sink_input_get_max_request(pa_sink_input *i);
 void pa_sink_input_kill(pa_sink_input*i);
 
 pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency);
+void pa_sink_input_get_timing(pa_sink_input *i, pa_sink_input_timing *t);
 
 bool pa_sink_input_is_passthrough(pa_sink_input *i);
 bool pa_sink_input_is_volume_readable(pa_sink_input *i);
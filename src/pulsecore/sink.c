@@ -41,6 +41,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/planar.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -50,6 +51,7 @@
 #include "sink.h"
 
 #define MAX_MIX_CHANNELS 32
+#define MAX_RENDER_THREADS (MAX_MIX_CHANNELS-1U)
 #define MIX_BUFFER_LENGTH (PA_PAGE_SIZE)
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
@@ -179,7 +181,7 @@ pa_sink* pa_sink_new(
     const char *name;
     char st[PA_SAMPLE_SPEC_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX];
     pa_source_new_data source_data;
-    const char *dn;
+    const char *dn, *rt;
     char *pt;
 
     pa_assert(core);
@@ -267,6 +269,17 @@ pa_sink* pa_sink_new(
 
     s->priority = pa_device_init_priority(s->proplist);
 
+    s->render_threads = core->render_threads;
+    if ((rt = pa_proplist_gets(s->proplist, PA_SINK_PROP_RENDER_THREADS))) {
+        uint32_t n;
+
+        if (pa_atou(rt, &n) < 0)
+            pa_log_warn("Invalid %s property '%s', ignoring.", PA_SINK_PROP_RENDER_THREADS, rt);
+        else
+            s->render_threads = n;
+    }
+    s->render_threads = PA_MIN(s->render_threads, MAX_RENDER_THREADS);
+
     s->sample_spec = data->sample_spec;
     s->channel_map = data->channel_map;
     s->default_sample_rate = s->sample_spec.rate;
@@ -357,6 +370,8 @@ pa_sink* pa_sink_new(
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
     s->thread_info.port_latency_offset = s->port_latency_offset;
     s->thread_info.latency_offset = s->latency_offset;
+    s->thread_info.render_threads = s->render_threads;
+    s->thread_info.render_pool = NULL;
 
     /* FIXME: This should probably be moved to pa_sink_put() */
     pa_assert_se(pa_idxset_put(core->sinks, s, &s->index) >= 0);
@@ -748,6 +763,9 @@ static void sink_free(pa_object *o) {
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
 
+    if (s->thread_info.render_pool)
+        pa_render_pool_free(s->thread_info.render_pool);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -1036,27 +1054,136 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     }
 }
 
+/* Called from IO thread context */
+static pa_render_pool *get_render_pool(pa_sink *s) {
+    pa_thread_mq *q;
+
+    if (s->thread_info.render_threads <= 0)
+        return NULL;
+
+    q = pa_thread_mq_get();
+
+    /* Filter sinks change their IO thread when their master sink
+     * changes, and the pool is bound to the IO thread's message queue */
+    if (s->thread_info.render_pool && pa_render_pool_get_thread_mq(s->thread_info.render_pool) != q) {
+        pa_render_pool_free(s->thread_info.render_pool);
+        s->thread_info.render_pool = NULL;
+    }
+
+    if (!s->thread_info.render_pool)
+        if (!(s->thread_info.render_pool = pa_render_pool_new(s->core, q, s->name, s->thread_info.render_threads)))
+            /* Don't try again, just render serially */
+            s->thread_info.render_threads = 0;
+
+    return s->thread_info.render_pool;
+}
+
+/* Called from IO thread context, after the input has been peeked */
+static void account_converted(pa_sink *s, pa_sink_input *i) {
+    if (!i->thread_info.resampler)
+        return;
+
+    s->thread_info.converted_samples += i->thread_info.resampler->converted_samples;
+    i->thread_info.resampler->converted_samples = 0;
+}
+
+/* Called from IO thread context */
+static unsigned fill_mix_info_parallel(pa_sink *s, pa_render_pool *pool, size_t *length, pa_mix_info *info, unsigned maxinfo) {
+    pa_sink_input *inputs[MAX_MIX_CHANNELS];
+    pa_sink_input *i = NULL;
+    unsigned n = 0, n_silent = 0;
+    void *state = NULL;
+    size_t mixlength = *length;
+
+    pa_assert(maxinfo <= MAX_MIX_CHANNELS);
+
+    /* Just like the serial version below, we peek inputs in order
+     * until we have found maxinfo non-silent ones. We do that in
+     * batches of at most maxinfo inputs that are peeked in parallel,
+     * and then evaluate the results in order, so that the resulting
+     * pa_mix_info array is the same as when rendering serially. */
+
+    for (;;) {
+        unsigned n_batch = 0, n_mixed = 0, k;
+
+        while (n_batch < maxinfo && (i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL))) {
+            pa_sink_input_assert_ref(i);
+            inputs[n_batch++] = i;
+        }
+
+        if (n_batch == 0)
+            break;
+
+        pa_render_pool_peek(pool, inputs, info, n_batch, *length);
+
+        for (k = 0; k < n_batch; k++) {
+            account_converted(s, inputs[k]);
+
+            if (mixlength == 0 || info[k].chunk.length < mixlength)
+                mixlength = info[k].chunk.length;
+
+            if (pa_memchunk_is_silence(&info[k].chunk)) {
+                pa_memblock_unref(info[k].chunk.memblock);
+                n_silent++;
+                continue;
+            }
+
+            pa_assert(info[k].chunk.memblock);
+            pa_assert(info[k].chunk.length > 0);
+
+            if (k != n_mixed) {
+                info[n_mixed].chunk = info[k].chunk;
+                info[n_mixed].volume = info[k].volume;
+            }
+
+            info[n_mixed].userdata = pa_sink_input_ref(inputs[k]);
+            n_mixed++;
+        }
+
+        info += n_mixed;
+        maxinfo -= n_mixed;
+        n += n_mixed;
+
+        if (!i || maxinfo <= 0)
+            break;
+    }
+
+    if (mixlength > 0)
+        *length = mixlength;
+
+    s->thread_info.render_bytes += (n + n_silent) * *length;
+    s->thread_info.render_silence_bytes += n_silent * *length;
+
+    return n;
+}
+
 /* Called from IO thread context */
 static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, unsigned maxinfo) {
     pa_sink_input *i;
-    unsigned n = 0;
+    unsigned n = 0, n_silent = 0;
     void *state = NULL;
     size_t mixlength = *length;
+    pa_render_pool *pool;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (pa_hashmap_size(s->thread_info.inputs) > 1 && (pool = get_render_pool(s)))
+        return fill_mix_info_parallel(s, pool, length, info, maxinfo);
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
         pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
+        account_converted(s, i);
 
         if (mixlength == 0 || info->chunk.length < mixlength)
             mixlength = info->chunk.length;
 
-        if (pa_memblock_is_silence(info->chunk.memblock)) {
+        if (pa_memchunk_is_silence(&info->chunk)) {
             pa_memblock_unref(info->chunk.memblock);
+            n_silent++;
             continue;
         }
 
@@ -1073,9 +1200,20 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     if (mixlength > 0)
         *length = mixlength;
 
+    s->thread_info.render_bytes += (n + n_silent) * *length;
+    s->thread_info.render_silence_bytes += n_silent * *length;
+
     return n;
 }
 
+/* Called from IO thread context */
+static void account_skipped(pa_sink *s, pa_mix_info *info, unsigned n) {
+    unsigned k;
+
+    for (k = 0; k < n; k++)
+        s->thread_info.render_silence_bytes += info[k].skipped;
+}
+
 /* Called from IO thread context */
 static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
     pa_sink_input *i;
@@ -1179,6 +1317,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1198,6 +1337,8 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_sink_ref(s);
 
+    start = pa_rtclock_now();
+
     if (length <= 0)
         length = pa_frame_align(MIX_BUFFER_LENGTH, &s->sample_spec);
 
@@ -1251,11 +1392,15 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                 s->thread_info.soft_muted);
         pa_memblock_release(result->memblock);
 
+        account_skipped(s, info, n);
+
         result->index = 0;
     }
 
     inputs_drop(s, info, n, result);
 
+    pa_histogram_add(&s->thread_info.render_histogram, pa_rtclock_now() - start);
+
     pa_sink_unref(s);
 }
 
@@ -1264,6 +1409,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_usec_t start;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1283,6 +1429,8 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_sink_ref(s);
 
+    start = pa_rtclock_now();
+
     length = target->length;
     block_size_max = pa_mempool_block_size_max(s->core->mempool);
     if (length > block_size_max)
@@ -1337,10 +1485,16 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
                                 s->thread_info.soft_muted);
 
         pa_memblock_release(target->memblock);
+
+        pa_memblock_clear_silence(target->memblock, target->index, target->length);
+        pa_memblock_drop_planar(target->memblock);
+        account_skipped(s, info, n);
     }
 
     inputs_drop(s, info, n, target);
 
+    pa_histogram_add(&s->thread_info.render_histogram, pa_rtclock_now() - start);
+
     pa_sink_unref(s);
 }
 
@@ -1383,6 +1537,18 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
     pa_sink_unref(s);
 }
 
+/* Called from IO thread context */
+void pa_sink_render_planar(pa_sink *s, size_t length, pa_memchunk *result, pa_planar *buf, const float *planes[]) {
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(s->sample_spec.format == PA_SAMPLE_FLOAT32NE);
+    pa_assert(buf);
+    pa_assert(buf->channels == s->sample_spec.channels);
+
+    pa_sink_render(s, length, result);
+    pa_planar_from_memchunk(buf, result, planes);
+}
+
 /* Called from IO thread context */
 void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
     pa_sink_assert_ref(s);
@@ -1534,6 +1700,18 @@ pa_usec_t pa_sink_get_latency(pa_sink *s) {
     return usec;
 }
 
+/* Called from main thread */
+void pa_sink_get_timing(pa_sink *s, pa_sink_timing *t) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_IS_LINKED(s->state));
+    pa_assert(t);
+
+    pa_zero(*t);
+
+    pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_sink_get_latency_within_thread(pa_sink *s) {
     pa_usec_t usec = 0;
@@ -2923,6 +3101,20 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_TIMING: {
+            pa_sink_timing *t = userdata;
+
+            t->render = s->thread_info.render_histogram;
+            t->render_bytes = s->thread_info.render_bytes;
+            t->render_silence_bytes = s->thread_info.render_silence_bytes;
+            t->converted_samples = s->thread_info.converted_samples;
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_get_histograms(s->thread_info.rtpoll, &t->sleep, &t->late);
+
+            return 0;
+        }
+
         case PA_SINK_MESSAGE_GET_LATENCY:
         case PA_SINK_MESSAGE_MAX:
             ;
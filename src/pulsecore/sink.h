@@ -40,12 +40,17 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/render-pool.h>
 #include <pulsecore/sink-input.h>
 
 #define PA_MAX_INPUTS_PER_SINK 256
 
+/* Per-sink override of the daemon-wide render-threads setting */
+#define PA_SINK_PROP_RENDER_THREADS "sink.render_threads"
+
 /* Returns true if sink is linked: registered and accessible from client side. */
 static inline bool PA_SINK_IS_LINKED(pa_sink_state_t x) {
     return x == PA_SINK_RUNNING || x == PA_SINK_IDLE || x == PA_SINK_SUSPENDED;
@@ -120,6 +125,10 @@ struct pa_sink {
 
     unsigned priority;
 
+    /* Number of helper threads used to peek the inputs in parallel,
+     * 0 to peek them one after another on the IO thread */
+    unsigned render_threads;
+
     bool set_mute_in_progress;
 
     /* Called when the main loop requests a state change. Called from
@@ -305,6 +314,23 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* Copy of render_threads, reset to 0 if the pool can't be
+         * created. The pool is created lazily on the first render. */
+        unsigned render_threads;
+        pa_render_pool *render_pool;
+
+        /* How long each pa_sink_render() and pa_sink_render_into()
+         * call took */
+        pa_histogram render_histogram;
+
+        /* How many bytes of the inputs were rendered, and how many of
+         * those were known to be silence and not mixed */
+        uint64_t render_bytes, render_silence_bytes;
+
+        /* How many samples the resamplers of the inputs converted
+         * between sample formats */
+        uint64_t converted_samples;
     } thread_info;
 
     void *userdata;
@@ -340,9 +366,20 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_PORT_LATENCY_OFFSET,
     PA_SINK_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_GET_TIMING,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
+/* Timing statistics of a sink, see pa_sink_get_timing() */
+typedef struct pa_sink_timing {
+    pa_histogram render;
+    uint64_t render_bytes, render_silence_bytes;
+    uint64_t converted_samples;
+    /* Of the rtpoll of the IO thread, if the sink has one */
+    pa_histogram sleep;
+    pa_histogram late;
+} pa_sink_timing;
+
 typedef struct pa_sink_new_data {
     pa_suspend_cause_t suspend_cause;
 
@@ -433,6 +470,7 @@ void pa_sink_set_latency_offset(pa_sink *s, int64_t offset);
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_sink_get_latency(pa_sink *s);
 pa_usec_t pa_sink_get_requested_latency(pa_sink *s);
+void pa_sink_get_timing(pa_sink *s, pa_sink_timing *t);
 void pa_sink_get_latency_range(pa_sink *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 
@@ -497,6 +535,11 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result);
 void pa_sink_render_into(pa_sink*s, pa_memchunk *target);
 void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target);
 
+/* Like pa_sink_render(), for sinks of float samples whose driver works
+ * on planes, see pa_planar_from_memchunk(). If the data comes from
+ * another such filter, it is not deinterleaved again. */
+void pa_sink_render_planar(pa_sink *s, size_t length, pa_memchunk *result, pa_planar *buf, const float *planes[]);
+
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes);
 
 int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
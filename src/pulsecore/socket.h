@@ -17,4 +17,15 @@ typedef long suseconds_t;
 #include <ws2tcpip.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#else
+#include <stddef.h>
+
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
 #endif
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/utf8.h>
 #include <pulse/xmalloc.h>
 #include <pulse/util.h>
@@ -709,12 +710,29 @@ pa_usec_t pa_source_output_get_latency(pa_source_output *o, pa_usec_t *source_la
     return r[0];
 }
 
+/* Called from main context */
+void pa_source_output_get_timing(pa_source_output *o, pa_source_output_timing *t) {
+    pa_source_output_assert_ref(o);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_OUTPUT_IS_LINKED(o->state));
+    pa_assert(t);
+
+    pa_zero(*t);
+
+    /* While the stream is being moved, nobody updates the histograms */
+    if (!o->source)
+        return;
+
+    pa_asyncmsgq_send(o->source->asyncmsgq, PA_MSGOBJECT(o), PA_SOURCE_OUTPUT_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from thread context */
 void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
     bool need_volume_factor_source;
     bool volume_is_norm;
     size_t length;
     size_t limit, mbs = 0;
+    pa_usec_t start;
 
     pa_source_output_assert_ref(o);
     pa_source_output_assert_io_context(o);
@@ -727,6 +745,8 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
     pa_assert(o->thread_info.state == PA_SOURCE_OUTPUT_RUNNING);
 
+    start = pa_rtclock_now();
+
     if (pa_memblockq_push(o->thread_info.delay_memblockq, chunk) < 0) {
         pa_log_debug("Delay queue overflow!");
         pa_memblockq_seek(o->thread_info.delay_memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
@@ -801,6 +821,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             o->push(o, &qchunk);
         else {
             pa_memchunk rchunk;
+            pa_usec_t resample_start;
 
             if (mbs == 0)
                 mbs = pa_resampler_max_block_size(o->thread_info.resampler);
@@ -808,7 +829,9 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             if (qchunk.length > mbs)
                 qchunk.length = mbs;
 
+            resample_start = pa_rtclock_now();
             pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+            pa_histogram_add(&o->thread_info.resample_histogram, pa_rtclock_now() - resample_start);
 
             if (rchunk.length > 0)
                 o->push(o, &rchunk);
@@ -820,6 +843,8 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
         pa_memblock_unref(qchunk.memblock);
         pa_memblockq_drop(o->thread_info.delay_memblockq, qchunk.length);
     }
+
+    pa_histogram_add(&o->thread_info.push_histogram, pa_rtclock_now() - start);
 }
 
 /* Called from thread context */
@@ -836,17 +861,15 @@ void pa_source_output_process_rewind(pa_source_output *o, size_t nbytes /* in so
     if (o->process_rewind) {
         pa_assert(pa_memblockq_get_length(o->thread_info.delay_memblockq) == 0);
 
+        /* Rewind the resampler, and convert to our domain */
         if (o->thread_info.resampler)
-            nbytes = pa_resampler_result(o->thread_info.resampler, nbytes);
+            nbytes = pa_resampler_rewind(o->thread_info.resampler, nbytes);
 
         pa_log_debug("Have to rewind %lu bytes on implementor.", (unsigned long) nbytes);
 
         if (nbytes > 0)
             o->process_rewind(o, nbytes);
 
-        if (o->thread_info.resampler)
-            pa_resampler_rewind(o->thread_info.resampler, nbytes);
-
     } else
         pa_memblockq_rewind(o->thread_info.delay_memblockq, nbytes);
 }
@@ -866,6 +889,9 @@ void pa_source_output_update_max_rewind(pa_source_output *o, size_t nbytes  /* i
     pa_assert(PA_SOURCE_OUTPUT_IS_LINKED(o->thread_info.state));
     pa_assert(pa_frame_aligned(nbytes, &o->source->sample_spec));
 
+    if (o->thread_info.resampler)
+        pa_resampler_set_max_rewind(o->thread_info.resampler, nbytes);
+
     if (o->update_max_rewind)
         o->update_max_rewind(o, o->thread_info.resampler ? pa_resampler_result(o->thread_info.resampler, nbytes) : nbytes);
 }
@@ -1567,6 +1593,14 @@ int pa_source_output_process_msg(pa_msgobject *mo, int code, void *userdata, int
                 o->thread_info.muted = o->muted;
             }
             return 0;
+
+        case PA_SOURCE_OUTPUT_MESSAGE_GET_TIMING: {
+            pa_source_output_timing *t = userdata;
+
+            t->push = o->thread_info.push_histogram;
+            t->resample = o->thread_info.resample_histogram;
+            return 0;
+        }
     }
 
     return -PA_ERR_NOTIMPLEMENTED;
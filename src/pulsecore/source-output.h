@@ -25,6 +25,7 @@
 #include <pulsecore/typedefs.h>
 #include <pulse/sample.h>
 #include <pulse/format.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
@@ -207,6 +208,11 @@ struct pa_source_output {
         pa_usec_t requested_source_latency;
 
         pa_sink_input *direct_on_input;       /* may be NULL */
+
+        /* How long each pa_source_output_push() call took, and how
+         * much of that was spent in the resampler */
+        pa_histogram push_histogram;
+        pa_histogram resample_histogram;
     } thread_info;
 
     void *userdata;
@@ -223,9 +229,16 @@ enum {
     PA_SOURCE_OUTPUT_MESSAGE_GET_REQUESTED_LATENCY,
     PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_VOLUME,
     PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_MUTE,
+    PA_SOURCE_OUTPUT_MESSAGE_GET_TIMING,
     PA_SOURCE_OUTPUT_MESSAGE_MAX
 };
 
+/* Timing statistics of a source output, see pa_source_output_get_timing() */
+typedef struct pa_source_output_timing {
+    pa_histogram push;
+    pa_histogram resample;
+} pa_source_output_timing;
+
 typedef struct pa_source_output_send_event_hook_data {
     pa_source_output *source_output;
     const char *event;
@@ -308,6 +321,7 @@ size_t pa_source_output_get_max_rewind(pa_source_output *o);
 void pa_source_output_kill(pa_source_output*o);
 
 pa_usec_t pa_source_output_get_latency(pa_source_output *o, pa_usec_t *source_latency);
+void pa_source_output_get_timing(pa_source_output *o, pa_source_output_timing *t);
 
 bool pa_source_output_is_volume_readable(pa_source_output *o);
 bool pa_source_output_is_passthrough(pa_source_output *o);
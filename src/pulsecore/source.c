@@ -913,6 +913,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
+    pa_usec_t start;
 
     pa_source_assert_ref(s);
     pa_source_assert_io_context(s);
@@ -922,6 +923,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     if (s->thread_info.state == PA_SOURCE_SUSPENDED)
         return;
 
+    start = pa_rtclock_now();
+
     if (s->thread_info.soft_muted || !pa_cvolume_is_norm(&s->thread_info.soft_volume)) {
         pa_memchunk vchunk = *chunk;
 
@@ -950,6 +953,8 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
                 pa_source_output_push(o, chunk);
         }
     }
+
+    pa_histogram_add(&s->thread_info.post_histogram, pa_rtclock_now() - start);
 }
 
 /* Called from IO thread context */
@@ -1125,6 +1130,18 @@ pa_usec_t pa_source_get_latency(pa_source *s) {
     return usec;
 }
 
+/* Called from main thread */
+void pa_source_get_timing(pa_source *s, pa_source_timing *t) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_IS_LINKED(s->state));
+    pa_assert(t);
+
+    pa_zero(*t);
+
+    pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_TIMING, t, 0, NULL);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_source_get_latency_within_thread(pa_source *s) {
     pa_usec_t usec = 0;
@@ -2274,6 +2291,17 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             s->thread_info.latency_offset = offset;
             return 0;
 
+        case PA_SOURCE_MESSAGE_GET_TIMING: {
+            pa_source_timing *t = userdata;
+
+            t->post = s->thread_info.post_histogram;
+
+            if (s->thread_info.rtpoll)
+                pa_rtpoll_get_histograms(s->thread_info.rtpoll, &t->sleep, &t->late);
+
+            return 0;
+        }
+
         case PA_SOURCE_MESSAGE_MAX:
             ;
     }
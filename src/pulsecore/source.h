@@ -41,6 +41,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/card.h>
 #include <pulsecore/device-port.h>
+#include <pulsecore/histogram.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/source-output.h>
@@ -247,6 +248,9 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+
+        /* How long each pa_source_post() call took */
+        pa_histogram post_histogram;
     } thread_info;
 
     void *userdata;
@@ -278,9 +282,18 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_PORT_LATENCY_OFFSET,
     PA_SOURCE_MESSAGE_SET_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_GET_TIMING,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
+/* Timing statistics of a source, see pa_source_get_timing() */
+typedef struct pa_source_timing {
+    pa_histogram post;
+    /* Of the rtpoll of the IO thread, if the source has one */
+    pa_histogram sleep;
+    pa_histogram late;
+} pa_source_timing;
+
 typedef struct pa_source_new_data {
     pa_suspend_cause_t suspend_cause;
 
@@ -366,6 +379,7 @@ void pa_source_set_latency_offset(pa_source *s, int64_t offset);
 /* The returned value is supposed to be in the time domain of the sound card! */
 pa_usec_t pa_source_get_latency(pa_source *s);
 pa_usec_t pa_source_get_requested_latency(pa_source *s);
+void pa_source_get_timing(pa_source *s, pa_source_timing *t);
 void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t *max_latency);
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
 
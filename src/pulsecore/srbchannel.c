@@ -97,7 +97,7 @@ struct pa_srbchannel {
  *    completely full, and want the other side to continue writing
 */
 
-size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
+static size_t write_data(pa_srbchannel *sr, const void *data, size_t l) {
     size_t written = 0;
 
     while (l > 0) {
@@ -120,6 +120,13 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
         data = (uint8_t*) data + towrite;
         l -= towrite;
     }
+
+    return written;
+}
+
+size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
+    size_t written = write_data(sr, data, l);
+
 #ifdef DEBUG_SRBCHANNEL
     pa_log("Wrote %d bytes to srbchannel, signalling fdsem", (int) written);
 #endif
@@ -128,6 +135,27 @@ size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l) {
     return written;
 }
 
+size_t pa_srbchannel_writev(pa_srbchannel *sr, const struct iovec *iov, unsigned n) {
+    size_t written = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        size_t w = write_data(sr, iov[i].iov_base, iov[i].iov_len);
+
+        written += w;
+
+        if (w < iov[i].iov_len)
+            break;
+    }
+
+#ifdef DEBUG_SRBCHANNEL
+    pa_log("Wrote %d bytes in %u buffers to srbchannel, signalling fdsem", (int) written, n);
+#endif
+
+    pa_fdsem_post(sr->sem_write);
+    return written;
+}
+
 size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l) {
     size_t isread = 0;
 
@@ -221,14 +249,18 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
     srbchannel_rwloop(sr);
 }
 
-pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p) {
+pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p, size_t size) {
     int capacity;
     int readfd;
     struct srbheader *srh;
 
     pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
     sr->mainloop = m;
-    sr->memblock = pa_memblock_new_pool(p, -1);
+
+    if (size != (size_t) -1 && size < PA_SRBCHANNEL_SIZE_MIN)
+        size = PA_SRBCHANNEL_SIZE_MIN;
+
+    sr->memblock = pa_memblock_new_pool(p, size);
     if (!sr->memblock)
         goto fail;
 
@@ -289,7 +321,8 @@ static void pa_srbchannel_swap(pa_srbchannel *sr) {
 
 pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel_template *t)
 {
-    int temp;
+    int temp, capacity, readbuf_offset, writebuf_offset;
+    size_t length;
     struct srbheader *srh;
     pa_srbchannel* sr = pa_xmalloc0(sizeof(pa_srbchannel));
 
@@ -298,12 +331,35 @@ pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel
     pa_memblock_ref(sr->memblock);
     srh = pa_memblock_acquire(sr->memblock);
 
-    sr->rb_read.capacity = sr->rb_write.capacity = srh->capacity;
+    /* The size of the rings is up to the other side, so make sure they
+     * are actually inside the block. The header is in shared memory the
+     * other side can still write to, so read it only once. */
+    length = pa_memblock_get_length(sr->memblock);
+    if (length < sizeof(*srh)) {
+        pa_log_warn("Invalid srbchannel ringbuffer layout.");
+        goto fail;
+    }
+
+    capacity = srh->capacity;
+    readbuf_offset = srh->readbuf_offset;
+    writebuf_offset = srh->writebuf_offset;
+
+    if (capacity <= 0 ||
+        readbuf_offset < (int) sizeof(*srh) ||
+        writebuf_offset < (int) sizeof(*srh) ||
+        (size_t) readbuf_offset + (size_t) capacity > length ||
+        (size_t) writebuf_offset + (size_t) capacity > length ||
+        PA_MAX(readbuf_offset, writebuf_offset) - PA_MIN(readbuf_offset, writebuf_offset) < capacity) {
+        pa_log_warn("Invalid srbchannel ringbuffer layout.");
+        goto fail;
+    }
+
+    sr->rb_read.capacity = sr->rb_write.capacity = capacity;
     sr->rb_read.count = &srh->read_count;
     sr->rb_write.count = &srh->write_count;
 
-    sr->rb_read.memory = (uint8_t*) srh + srh->readbuf_offset;
-    sr->rb_write.memory = (uint8_t*) srh + srh->writebuf_offset;
+    sr->rb_read.memory = (uint8_t*) srh + readbuf_offset;
+    sr->rb_write.memory = (uint8_t*) srh + writebuf_offset;
 
     sr->sem_read = pa_fdsem_open_shm(&srh->read_semdata, t->readfd);
     if (!sr->sem_read)
@@ -331,6 +387,12 @@ fail:
     return NULL;
 }
 
+size_t pa_srbchannel_get_capacity(pa_srbchannel *sr) {
+    pa_assert(sr);
+
+    return (size_t) sr->rb_write.capacity;
+}
+
 void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t) {
     t->memblock = sr->memblock;
     t->readfd = pa_fdsem_get(sr->sem_read);
@@ -23,6 +23,7 @@
 #include <pulse/mainloop-api.h>
 #include <pulsecore/fdsem.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/socket.h>
 
 /* An shm ringbuffer that is used for low overhead server-client communication.
  * Signaling is done through eventfd semaphores (pa_fdsem). */
@@ -34,7 +35,12 @@ typedef struct pa_srbchannel_template {
     pa_memblock *memblock;
 } pa_srbchannel_template;
 
-pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p);
+/* The smallest shm block we put the two ringbuffers in */
+#define PA_SRBCHANNEL_SIZE_MIN (4U*1024U)
+
+/* size is the size of the shm block that holds both ringbuffers, pass
+ * (size_t) -1 for the default block size of the pool. */
+pa_srbchannel* pa_srbchannel_new(pa_mainloop_api *m, pa_mempool *p, size_t size);
 /* Note: this creates a srbchannel with swapped read and write. */
 pa_srbchannel* pa_srbchannel_new_from_template(pa_mainloop_api *m, pa_srbchannel_template *t);
 
@@ -42,7 +48,12 @@ void pa_srbchannel_free(pa_srbchannel *sr);
 
 void pa_srbchannel_export(pa_srbchannel *sr, pa_srbchannel_template *t);
 
+/* The capacity of each of the two ringbuffers */
+size_t pa_srbchannel_get_capacity(pa_srbchannel *sr);
+
 size_t pa_srbchannel_write(pa_srbchannel *sr, const void *data, size_t l);
+/* Writes as much of the n buffers as fits, and signals the other side only once */
+size_t pa_srbchannel_writev(pa_srbchannel *sr, const struct iovec *iov, unsigned n);
 size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 
 /* Set the callback function that is called whenever data becomes available for reading.
@@ -0,0 +1,233 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "cpu-x86.h"
+
+#include <immintrin.h>
+
+/* The volume functions below work on blocks of eight samples. The
+ * integer formats are loaded into vectors of 32 bit samples in which
+ * full scale is 2^31, the same as the C versions do, multiplied with
+ * the 16.16 fixed point volumes in 64 bits and clamped. The byte
+ * swapping for the reverse endian formats and the packing of the 24
+ * bit format is done with byte shuffles.
+ *
+ * The volume array has at least eight entries beyond the channels
+ * that repeat the first ones, so the volumes for a block can always be
+ * loaded in one go starting at the channel of its first sample.
+ *
+ * The results are bit-identical to the C versions in svolume_c.c. */
+
+#define BLOCK 8
+
+#define Z (-1)
+
+/* Loading and storing */
+
+static inline __m256i load_s32ne(const uint8_t *a) {
+    return _mm256_loadu_si256((const __m256i *) a);
+}
+
+static inline __m256i load_s32re(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) a), shuffle);
+}
+
+static inline __m256i load_s24_32ne(const uint8_t *a) {
+    return _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) a), 8);
+}
+
+static inline __m256i load_s24_32re(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13,
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13);
+
+    return _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) a), shuffle);
+}
+
+/* The 24 bytes of a block of packed 24 bit samples are loaded as bytes
+ * 0-15 into the low lane and bytes 8-23 into the high lane, so that
+ * each lane holds four complete samples without reading beyond the
+ * block */
+static inline __m256i load_24(const uint8_t *a) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) a)),
+                                   _mm_loadu_si128((const __m128i *) (a + 8)), 1);
+}
+
+static inline __m256i load_s24ne(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11,
+        Z, 4, 5, 6, Z, 7, 8, 9, Z, 10, 11, 12, Z, 13, 14, 15);
+
+    return _mm256_shuffle_epi8(load_24(a), shuffle);
+}
+
+static inline __m256i load_s24re(const uint8_t *a) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 2, 1, 0, Z, 5, 4, 3, Z, 8, 7, 6, Z, 11, 10, 9,
+        Z, 6, 5, 4, Z, 9, 8, 7, Z, 12, 11, 10, Z, 15, 14, 13);
+
+    return _mm256_shuffle_epi8(load_24(a), shuffle);
+}
+
+static inline void store_s32ne(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, v);
+}
+
+static inline void store_s32re(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    _mm256_storeu_si256((__m256i *) b, _mm256_shuffle_epi8(v, shuffle));
+}
+
+static inline void store_s24_32ne(uint8_t *b, __m256i v) {
+    _mm256_storeu_si256((__m256i *) b, _mm256_srli_epi32(v, 8));
+}
+
+static inline void store_s24_32re(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13,
+        Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13);
+
+    _mm256_storeu_si256((__m256i *) b, _mm256_shuffle_epi8(v, shuffle));
+}
+
+static inline void store_24(uint8_t *b, __m256i v, __m256i shuffle) {
+    /* Pack 12 bytes in each lane, then move the 24 bytes together */
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), gather);
+    _mm_storeu_si128((__m128i *) b, _mm256_castsi256_si128(v));
+    _mm_storel_epi64((__m128i *) (b + 16), _mm256_extracti128_si256(v, 1));
+}
+
+static inline void store_s24ne(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, Z, Z, Z, Z,
+        1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, Z, Z, Z, Z);
+
+    store_24(b, v, shuffle);
+}
+
+static inline void store_s24re(uint8_t *b, __m256i v) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, Z, Z, Z, Z,
+        3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, Z, Z, Z, Z);
+
+    store_24(b, v, shuffle);
+}
+
+/* Computes (v * vol) >> 16 and clamps it to 32 bits. The products are
+ * computed in 64 bits for the even and odd samples separately. Clamping
+ * them to [-2^47, 2^47 - 1] before the shift is the same as clamping
+ * the result afterwards, and then bits 16-47 of the products are the
+ * result, which saves us the arithmetic 64 bit shift AVX2 doesn't
+ * have. */
+static inline __m256i clamp_product(__m256i p) {
+    const __m256i max = _mm256_set1_epi64x(0x7FFFFFFFFFFFLL);
+    const __m256i min = _mm256_set1_epi64x(-0x800000000000LL);
+
+    p = _mm256_blendv_epi8(p, max, _mm256_cmpgt_epi64(p, max));
+    return _mm256_blendv_epi8(p, min, _mm256_cmpgt_epi64(min, p));
+}
+
+static inline __m256i volume_s32(__m256i v, __m256i vol) {
+    __m256i even, odd;
+
+    even = clamp_product(_mm256_mul_epi32(v, vol));
+    odd = clamp_product(_mm256_mul_epi32(_mm256_srli_epi64(v, 32), _mm256_srli_epi64(vol, 32)));
+
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 16), _mm256_slli_epi64(odd, 16), 0xAA);
+}
+
+/* Define a volume function from the loading and storing functions of
+ * a format. The remaining samples at the end are processed through a
+ * zero padded buffer. */
+#define DEFINE_VOLUME(name, size, block_func, vol_type)                 \
+    static void name(uint8_t *samples, const vol_type *volumes, unsigned channels, unsigned length) { \
+        unsigned channel = 0, step = BLOCK % channels, n = length / (size); \
+                                                                        \
+        for (; n >= BLOCK; n -= BLOCK) {                                \
+            block_func(samples, volumes + channel);                     \
+            samples += BLOCK * (size);                                  \
+                                                                        \
+            if ((channel += step) >= channels)                          \
+                channel -= channels;                                    \
+        }                                                               \
+                                                                        \
+        if (n > 0) {                                                    \
+            uint8_t buf[BLOCK * 4] = { 0 };                             \
+                                                                        \
+            memcpy(buf, samples, n * (size));                           \
+            block_func(buf, volumes + channel);                         \
+            memcpy(samples, buf, n * (size));                           \
+        }                                                               \
+    }
+
+#define DEFINE_INT_VOLUME(format, size)                                 \
+    static inline void format##_block(uint8_t *a, const int32_t *volumes) { \
+        store_##format(a, volume_s32(load_##format(a), _mm256_loadu_si256((const __m256i *) volumes))); \
+    }                                                                   \
+    DEFINE_VOLUME(pa_volume_##format##_avx2, size, format##_block, int32_t)
+
+DEFINE_INT_VOLUME(s32ne, 4)
+DEFINE_INT_VOLUME(s32re, 4)
+DEFINE_INT_VOLUME(s24_32ne, 4)
+DEFINE_INT_VOLUME(s24_32re, 4)
+DEFINE_INT_VOLUME(s24ne, 3)
+DEFINE_INT_VOLUME(s24re, 3)
+
+static inline void float32ne_block(uint8_t *a, const float *volumes) {
+    _mm256_storeu_ps((float *) a, _mm256_mul_ps(_mm256_loadu_ps((const float *) a), _mm256_loadu_ps(volumes)));
+}
+
+static inline void float32re_block(uint8_t *a, const float *volumes) {
+    __m256 v = _mm256_castsi256_ps(load_s32re(a));
+
+    store_s32re(a, _mm256_castps_si256(_mm256_mul_ps(v, _mm256_loadu_ps(volumes))));
+}
+
+DEFINE_VOLUME(pa_volume_float32ne_avx2, 4, float32ne_block, float)
+DEFINE_VOLUME(pa_volume_float32re_avx2, 4, float32re_block, float)
+
+void pa_volume_func_init_avx2(pa_cpu_x86_flag_t flags) {
+    pa_log_info("Initialising AVX2 optimized volume functions.");
+
+    pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_avx2);
+    pa_set_volume_func(PA_SAMPLE_FLOAT32RE, (pa_do_volume_func_t) pa_volume_float32re_avx2);
+    pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_avx2);
+    pa_set_volume_func(PA_SAMPLE_S32RE, (pa_do_volume_func_t) pa_volume_s32re_avx2);
+    pa_set_volume_func(PA_SAMPLE_S24NE, (pa_do_volume_func_t) pa_volume_s24ne_avx2);
+    pa_set_volume_func(PA_SAMPLE_S24RE, (pa_do_volume_func_t) pa_volume_s24re_avx2);
+    pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_avx2);
+    pa_set_volume_func(PA_SAMPLE_S24_32RE, (pa_do_volume_func_t) pa_volume_s24_32re_avx2);
+}
@@ -25,6 +25,9 @@
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/log.h>
@@ -37,6 +40,9 @@ enum {
     QUIT
 };
 
+#define MAX_PRODUCERS 8
+#define MESSAGES 100000
+
 static void the_thread(void *_q) {
     pa_asyncmsgq *q = _q;
     int quit = 0;
@@ -105,15 +111,98 @@ START_TEST (asyncmsgq_test) {
 }
 END_TEST
 
+struct producer {
+    pa_asyncmsgq *q;
+    pa_thread *thread;
+    unsigned id;
+};
+
+static void producer_thread(void *userdata) {
+    struct producer *p = userdata;
+    unsigned i;
+
+    /* Every message carries its sequence number, so that the consumer
+     * can check that each producer's messages arrive in order. The
+     * final send must be processed after all posts. */
+    for (i = 0; i < MESSAGES; i++)
+        pa_asyncmsgq_post(p->q, NULL, OPERATION_A, PA_UINT_TO_PTR(i), p->id, NULL, NULL);
+
+    pa_asyncmsgq_send(p->q, NULL, OPERATION_B, PA_UINT_TO_PTR(i), p->id, NULL);
+}
+
+static void run_contention_test(unsigned n_producers) {
+    struct producer producers[MAX_PRODUCERS];
+    unsigned next[MAX_PRODUCERS];
+    unsigned i, n_done = 0;
+    pa_asyncmsgq *q;
+    pa_usec_t start, stop;
+
+    q = pa_asyncmsgq_new(0);
+
+    for (i = 0; i < n_producers; i++)
+        next[i] = 0;
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < n_producers; i++) {
+        producers[i].q = q;
+        producers[i].id = i;
+        fail_unless((producers[i].thread = pa_thread_new("producer", producer_thread, &producers[i])) != NULL);
+    }
+
+    while (n_done < n_producers) {
+        int code;
+        void *data;
+        int64_t offset;
+
+        pa_assert_se(pa_asyncmsgq_get(q, NULL, &code, &data, &offset, NULL, true) == 0);
+
+        fail_unless(offset >= 0 && offset < n_producers);
+        fail_unless(PA_PTR_TO_UINT(data) == next[offset]);
+        next[offset]++;
+
+        if (code == OPERATION_B)
+            n_done++;
+
+        pa_asyncmsgq_done(q, 0);
+    }
+
+    stop = pa_rtclock_now();
+
+    for (i = 0; i < n_producers; i++) {
+        pa_thread_free(producers[i].thread);
+        fail_unless(next[i] == MESSAGES + 1);
+    }
+
+    pa_asyncmsgq_unref(q);
+
+    pa_log_info("%u producers: %u messages in %llu usec (%llu messages/ms)", n_producers, n_producers * MESSAGES,
+                (unsigned long long) (stop - start),
+                (unsigned long long) (n_producers * MESSAGES * PA_USEC_PER_MSEC / PA_MAX(stop - start, 1U)));
+}
+
+START_TEST (asyncmsgq_contention_test) {
+    unsigned n;
+
+    for (n = 1; n <= MAX_PRODUCERS; n *= 2)
+        run_contention_test(n);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
     s = suite_create("Async Message Queue");
     tc = tcase_create("asyncmsgq");
     tcase_add_test(tc, asyncmsgq_test);
+    tcase_add_test(tc, asyncmsgq_contention_test);
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
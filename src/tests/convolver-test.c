@@ -0,0 +1,316 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/filter/convolver.h>
+
+#include "runtime-test-util.h"
+
+#define FRAMES 8192
+#define TOLERANCE 1e-4f
+
+/* The time domain convolution, as formerly done by
+ * module-virtual-surround-sink */
+struct direct {
+    unsigned n_inputs, n_outputs, ir_length;
+    const float *ir;
+    float *input_buffer;
+    int input_buffer_offset;
+};
+
+static void direct_process(struct direct *d, const float *src, float *dst, unsigned n) {
+    unsigned j, k, l, o;
+
+    for (l = 0; l < n; l++) {
+        memcpy(d->input_buffer + d->input_buffer_offset * d->n_inputs, src + l * d->n_inputs, d->n_inputs * sizeof(float));
+
+        for (o = 0; o < d->n_outputs; o++) {
+            float sum = 0;
+
+            for (j = 0; j < d->ir_length; j++)
+                for (k = 0; k < d->n_inputs; k++)
+                    sum += d->input_buffer[((d->input_buffer_offset + j) % d->ir_length) * d->n_inputs + k] *
+                        d->ir[(j * d->n_inputs + k) * d->n_outputs + o];
+
+            dst[l * d->n_outputs + o] = sum;
+        }
+
+        d->input_buffer_offset--;
+        if (d->input_buffer_offset < 0)
+            d->input_buffer_offset += d->ir_length;
+    }
+}
+
+static float random_sample(void) {
+    uint16_t r;
+
+    pa_random(&r, sizeof(r));
+    return (float) r / 0x8000 - 1.0f;
+}
+
+/* ir[(tap * n_inputs + input) * n_outputs + output], decaying so that
+ * the sums stay in a sensible range */
+static float *make_ir(unsigned n_inputs, unsigned n_outputs, unsigned ir_length) {
+    float *ir;
+    unsigned i;
+
+    ir = pa_xnew(float, ir_length * n_inputs * n_outputs);
+    for (i = 0; i < ir_length * n_inputs * n_outputs; i++)
+        ir[i] = random_sample() * expf(-4.0f * i / (ir_length * n_inputs * n_outputs)) / n_inputs;
+
+    return ir;
+}
+
+static pa_convolver *make_convolver(unsigned block_size, unsigned n_inputs, unsigned n_outputs, unsigned ir_length, const float *ir) {
+    pa_convolver *c;
+    unsigned i, o;
+
+    c = pa_convolver_new(block_size, n_inputs, n_outputs, ir_length);
+
+    for (i = 0; i < n_inputs; i++)
+        for (o = 0; o < n_outputs; o++)
+            pa_convolver_set_ir(c, i, o, ir + i * n_outputs + o, n_inputs * n_outputs);
+
+    return c;
+}
+
+static void compare(const float *a, const float *b, unsigned n, const char *what) {
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        if (fabsf(a[i] - b[i]) > TOLERANCE) {
+            pa_log_error("%s: mismatch at %u: %g != %g", what, i, a[i], b[i]);
+            fail();
+            return;
+        }
+}
+
+static void run_convolver_test(unsigned block_size, unsigned n_inputs, unsigned n_outputs, unsigned ir_length) {
+    struct direct d;
+    pa_convolver *c;
+    float *ir, *src, *out, *out_ref;
+    unsigned i, done;
+
+    pa_log_debug("Checking block size %u, %u inputs, %u outputs, %u taps", block_size, n_inputs, n_outputs, ir_length);
+
+    ir = make_ir(n_inputs, n_outputs, ir_length);
+    src = pa_xnew(float, FRAMES * n_inputs);
+    out = pa_xnew(float, FRAMES * n_outputs);
+    out_ref = pa_xnew(float, FRAMES * n_outputs);
+
+    for (i = 0; i < FRAMES * n_inputs; i++)
+        src[i] = random_sample();
+
+    d.n_inputs = n_inputs;
+    d.n_outputs = n_outputs;
+    d.ir_length = ir_length;
+    d.ir = ir;
+    d.input_buffer = pa_xnew0(float, ir_length * n_inputs);
+    d.input_buffer_offset = 0;
+    direct_process(&d, src, out_ref, FRAMES);
+
+    c = make_convolver(block_size, n_inputs, n_outputs, ir_length, ir);
+    pa_convolver_set_max_rewind(c, 3000);
+
+    /* Feed the input in chunks of varying size, so that blocks are
+     * completed at all sorts of offsets */
+    for (done = 0, i = 1; done < FRAMES; i = i * 3 % 1031) {
+        unsigned n = PA_MIN(i, FRAMES - done);
+
+        pa_convolver_process(c, src + done * n_inputs, out + done * n_outputs, n);
+        done += n;
+    }
+
+    compare(out, out_ref, FRAMES * n_outputs, "process");
+
+    /* Rewind by various amounts and check that processing the same
+     * input again gives the same output */
+    for (i = 1; i <= 3000; i = i * 2 + 7) {
+        pa_convolver_rewind(c, i);
+        pa_convolver_process(c, src + (FRAMES - i) * n_inputs, out + (FRAMES - i) * n_outputs, i);
+        compare(out + (FRAMES - i) * n_outputs, out_ref + (FRAMES - i) * n_outputs, i * n_outputs, "rewind");
+    }
+
+    /* Rewinding further than the history resets */
+    pa_convolver_rewind(c, FRAMES);
+    memset(src, 0, ir_length * n_inputs * sizeof(float));
+    pa_convolver_process(c, src, out, ir_length);
+    for (i = 0; i < ir_length * n_outputs; i++)
+        fail_unless(fabsf(out[i]) <= TOLERANCE);
+
+    pa_convolver_free(c);
+    pa_xfree(d.input_buffer);
+    pa_xfree(ir);
+    pa_xfree(src);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+}
+
+/* A crossfade must give the same output as running both filters and
+ * mixing their outputs with the fade curve */
+static void run_crossfade_test(unsigned block_size, unsigned ir_length, unsigned fade_start, unsigned fade_length) {
+    pa_convolver *c, *c_old, *c_new;
+    float *ir_old, *ir_new, *src, *out, *out_old, *out_new;
+    unsigned i;
+
+    pa_log_debug("Checking crossfade over %u frames at %u, block size %u, %u taps", fade_length, fade_start, block_size, ir_length);
+
+    ir_old = make_ir(1, 1, ir_length);
+    ir_new = make_ir(1, 1, ir_length);
+    src = pa_xnew(float, FRAMES);
+    out = pa_xnew(float, FRAMES);
+    out_old = pa_xnew(float, FRAMES);
+    out_new = pa_xnew(float, FRAMES);
+
+    for (i = 0; i < FRAMES; i++)
+        src[i] = random_sample();
+
+    c_old = make_convolver(block_size, 1, 1, ir_length, ir_old);
+    c_new = make_convolver(block_size, 1, 1, ir_length, ir_new);
+    pa_convolver_process(c_old, src, out_old, FRAMES);
+    pa_convolver_process(c_new, src, out_new, FRAMES);
+
+    c = make_convolver(block_size, 1, 1, ir_length, ir_old);
+    pa_convolver_process(c, src, out, fade_start);
+    pa_convolver_crossfade(c, fade_length);
+    pa_convolver_set_ir(c, 0, 0, ir_new, 1);
+    pa_convolver_process(c, src + fade_start, out + fade_start, FRAMES - fade_start);
+
+    for (i = 0; i < FRAMES; i++) {
+        float g;
+
+        if (i <= fade_start)
+            g = 0.0f;
+        else if (i >= fade_start + fade_length)
+            g = 1.0f;
+        else
+            g = 0.5f - 0.5f * cosf((float) M_PI * (i - fade_start) / fade_length);
+
+        out_old[i] += g * (out_new[i] - out_old[i]);
+    }
+
+    compare(out, out_old, FRAMES, "crossfade");
+
+    pa_convolver_free(c);
+    pa_convolver_free(c_old);
+    pa_convolver_free(c_new);
+    pa_xfree(ir_old);
+    pa_xfree(ir_new);
+    pa_xfree(src);
+    pa_xfree(out);
+    pa_xfree(out_old);
+    pa_xfree(out_new);
+}
+
+START_TEST (convolver_test) {
+    run_convolver_test(4, 1, 1, 1);
+    run_convolver_test(16, 1, 1, 7);
+    run_convolver_test(64, 2, 2, 64);
+    run_convolver_test(64, 6, 2, 1000);
+    run_convolver_test(256, 8, 2, 1024);
+    run_convolver_test(128, 2, 3, 300);
+
+    run_crossfade_test(64, 1000, 3000, 960);
+    run_crossfade_test(256, 300, 1111, 1);
+    run_crossfade_test(16, 64, 0, 5000);
+}
+END_TEST
+
+#define PERF_FRAMES 1024
+#define TIMES 10
+#define TIMES2 10
+
+static void run_perf_test(unsigned block_size, unsigned n_inputs, unsigned ir_length) {
+    struct direct d;
+    pa_convolver *c;
+    float *ir, *src, *out;
+    unsigned i;
+
+    pa_log_debug("Testing performance with %u inputs and %u taps, block size %u", n_inputs, ir_length, block_size);
+
+    ir = make_ir(n_inputs, 2, ir_length);
+    src = pa_xnew(float, PERF_FRAMES * n_inputs);
+    out = pa_xnew(float, PERF_FRAMES * 2);
+
+    for (i = 0; i < PERF_FRAMES * n_inputs; i++)
+        src[i] = random_sample();
+
+    c = make_convolver(block_size, n_inputs, 2, ir_length, ir);
+
+    PA_RUNTIME_TEST_RUN_START("convolver", TIMES, TIMES2) {
+        pa_convolver_process(c, src, out, PERF_FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    d.n_inputs = n_inputs;
+    d.n_outputs = 2;
+    d.ir_length = ir_length;
+    d.ir = ir;
+    d.input_buffer = pa_xnew0(float, ir_length * n_inputs);
+    d.input_buffer_offset = 0;
+
+    PA_RUNTIME_TEST_RUN_START("direct", TIMES, TIMES2) {
+        direct_process(&d, src, out, PERF_FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_convolver_free(c);
+    pa_xfree(d.input_buffer);
+    pa_xfree(ir);
+    pa_xfree(src);
+    pa_xfree(out);
+}
+
+START_TEST (convolver_perf_test) {
+    run_perf_test(64, 6, 64);
+    run_perf_test(128, 6, 1024);
+    run_perf_test(256, 6, 4096);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Convolver");
+    tc = tcase_create("convolver");
+    tcase_add_test(tc, convolver_test);
+    tcase_add_test(tc, convolver_perf_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,163 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/random.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "runtime-test-util.h"
+
+/* Not a multiple of the block sizes, so that the tails are tested too */
+#define FRAMES 1037
+#define TIMES 1000
+#define TIMES2 100
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+static void run_interleave_test(
+        pa_do_interleave_func_t func,
+        pa_do_interleave_func_t orig_func,
+        pa_do_deinterleave_func_t dfunc,
+        pa_do_deinterleave_func_t orig_dfunc,
+        size_t ss,
+        unsigned channels,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, planes[8][FRAMES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, planes_ref[8][FRAMES * 4]) = { { 0 } };
+    PA_DECLARE_ALIGNED(8, uint8_t, out[8 * FRAMES * 4 + 1]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, out_ref[8 * FRAMES * 4 + 1]) = { 0 };
+    const void *src[8];
+    void *dst[8], *dst_ref[8];
+    unsigned c;
+
+    for (c = 0; c < channels; c++) {
+        pa_random(planes[c], FRAMES * ss);
+        src[c] = planes[c];
+    }
+
+    orig_func(src, out_ref, FRAMES);
+    func(src, out, FRAMES);
+
+    /* Nothing may be written beyond the data either */
+    fail_unless(memcmp(out, out_ref, sizeof(out)) == 0);
+
+    memset(planes, 0, sizeof(planes));
+
+    for (c = 0; c < channels; c++) {
+        dst[c] = planes[c];
+        dst_ref[c] = planes_ref[c];
+    }
+
+    orig_dfunc(out_ref, dst_ref, FRAMES);
+    dfunc(out_ref, dst, FRAMES);
+
+    fail_unless(memcmp(planes, planes_ref, sizeof(planes)) == 0);
+
+    if (perf) {
+        pa_log_debug("Testing interleave performance with %u channels of %u bytes", channels, (unsigned) ss);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(src, out, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(src, out_ref, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        pa_log_debug("Testing deinterleave performance with %u channels of %u bytes", channels, (unsigned) ss);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            dfunc(out, dst, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_dfunc(out, dst_ref, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+START_TEST (interleave_avx2_test) {
+    static const size_t sizes[] = { 2, 4 };
+    static const unsigned channels[] = { 2, 4, 6, 8 };
+    pa_do_interleave_func_t orig_func[2][4];
+    pa_do_deinterleave_func_t orig_dfunc[2][4];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++)
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            orig_func[i][j] = pa_get_interleave_func(sizes[i], channels[j]);
+            orig_dfunc[i][j] = pa_get_deinterleave_func(sizes[i], channels[j]);
+        }
+
+    pa_interleave_func_init_avx2(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++)
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            pa_do_interleave_func_t func = pa_get_interleave_func(sizes[i], channels[j]);
+            pa_do_deinterleave_func_t dfunc = pa_get_deinterleave_func(sizes[i], channels[j]);
+
+            /* Not replaced by an optimized version */
+            if (func == orig_func[i][j] && dfunc == orig_dfunc[i][j])
+                continue;
+
+            pa_log_debug("Checking AVX2 interleave (%u channels of %u bytes)", channels[j], (unsigned) sizes[i]);
+            run_interleave_test(func, orig_func[i][j], dfunc, orig_dfunc[i][j], sizes[i], channels[j], true);
+        }
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("CPU");
+
+    tc = tcase_create("interleave");
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, interleave_avx2_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,10 +19,13 @@
 #include <config.h>
 #endif
 
+#include <math.h>
+
 #include <check.h>
 
 #include <pulsecore/cpu.h>
 #include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/mix.h>
@@ -32,6 +35,7 @@
 #define SAMPLES 1028
 #define TIMES 1000
 #define TIMES2 100
+#define MAX_STREAMS 8
 
 static void acquire_mix_streams(pa_mix_info streams[], unsigned nstreams) {
     unsigned i;
@@ -145,6 +149,154 @@ static void run_mix_test(
     pa_mempool_free(pool);
 }
 
+#if (defined (__i386__) || defined (__amd64__)) && (defined (HAVE_SSE4_1) || defined (HAVE_AVX2))
+/* Mix nstreams streams of the given format, with volumes differing per
+ * stream and channel, some of them above 0 dB so that clipping is
+ * exercised too */
+static void run_mix_format_test(
+        pa_do_mix_func_t func,
+        pa_do_mix_func_t orig_func,
+        pa_sample_format_t format,
+        unsigned nstreams,
+        unsigned channels,
+        bool correct,
+        bool perf) {
+
+    pa_sample_spec ss;
+    pa_mempool *pool;
+    pa_mix_info m[MAX_STREAMS];
+    void *samples, *samples_ref;
+    size_t bs, length;
+    unsigned nsamples, i, j;
+
+    pa_assert(nstreams <= MAX_STREAMS);
+
+    ss.format = format;
+    ss.channels = channels;
+    ss.rate = 44100;
+
+    bs = pa_sample_size(&ss);
+    /* Not a multiple of the vector width, so that the tails are
+     * tested as well */
+    nsamples = (SAMPLES - 1) * channels;
+    length = nsamples * bs;
+
+    fail_unless((pool = pa_mempool_new(false, 0)) != NULL, NULL);
+
+    for (i = 0; i < nstreams; i++) {
+        void *d;
+
+        m[i].chunk.memblock = pa_memblock_new(pool, length);
+        m[i].chunk.index = 0;
+        m[i].chunk.length = length;
+
+        d = pa_memblock_acquire(m[i].chunk.memblock);
+        pa_random(d, length);
+        if (format == PA_SAMPLE_FLOAT32NE)
+            for (j = 0; j < nsamples; j++)
+                ((float *) d)[j] = (float) ((int16_t *) d)[j] / 0x8000;
+        pa_memblock_release(m[i].chunk.memblock);
+
+        m[i].volume.channels = channels;
+        for (j = 0; j < channels; j++) {
+            int32_t v = 0x3000 + ((i * 7 + j * 3) % 16) * 0x1800;
+
+            m[i].volume.values[j] = PA_VOLUME_NORM;
+            if (format == PA_SAMPLE_FLOAT32NE)
+                m[i].linear[j].f = (float) v / 0x10000;
+            else
+                m[i].linear[j].i = v;
+        }
+    }
+
+    samples = pa_xmalloc(length);
+    samples_ref = pa_xmalloc(length);
+
+    if (correct) {
+        acquire_mix_streams(m, nstreams);
+        orig_func(m, nstreams, channels, samples_ref, length);
+        release_mix_streams(m, nstreams);
+
+        acquire_mix_streams(m, nstreams);
+        func(m, nstreams, channels, samples, length);
+        release_mix_streams(m, nstreams);
+
+        for (i = 0; i < nsamples; i++) {
+            bool ok;
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ok = fabsf(((float *) samples)[i] - ((float *) samples_ref)[i]) <= 1e-6f;
+            else if (format == PA_SAMPLE_S32NE)
+                ok = ((int32_t *) samples)[i] == ((int32_t *) samples_ref)[i];
+            else
+                ok = ((int16_t *) samples)[i] == ((int16_t *) samples_ref)[i];
+
+            if (!ok) {
+                pa_log_debug("Correctness test failed: format=%s, streams=%u, channels=%u, sample %u",
+                             pa_sample_format_to_string(format), nstreams, channels, i);
+                fail();
+            }
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %s %u-stream %u-channel mixing performance",
+                     pa_sample_format_to_string(format), nstreams, channels);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            func(m, nstreams, channels, samples, length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            acquire_mix_streams(m, nstreams);
+            orig_func(m, nstreams, channels, samples_ref, length);
+            release_mix_streams(m, nstreams);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_xfree(samples);
+    pa_xfree(samples_ref);
+
+    for (i = 0; i < nstreams; i++)
+        pa_memblock_unref(m[i].chunk.memblock);
+
+    pa_mempool_free(pool);
+}
+
+static void run_mix_x86_tests(const char *name, void (*init_func)(pa_cpu_x86_flag_t), pa_cpu_x86_flag_t flags) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_S32NE, PA_SAMPLE_FLOAT32NE };
+    static const unsigned channels[] = { 1, 2, 3, 4, 6, 8 };
+    static const unsigned nstreams[] = { 1, 2, 3, 8 };
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    pa_do_mix_func_t orig_func[PA_ELEMENTSOF(formats)], func[PA_ELEMENTSOF(formats)];
+    unsigned f, c, n;
+
+    pa_mix_func_init(&cpu_info);
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        orig_func[f] = pa_get_mix_func(formats[f]);
+
+    init_func(flags);
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        func[f] = pa_get_mix_func(formats[f]);
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        pa_log_debug("Checking %s mix (%s)", name, pa_sample_format_to_string(formats[f]));
+
+        for (c = 0; c < PA_ELEMENTSOF(channels); c++)
+            for (n = 0; n < PA_ELEMENTSOF(nstreams); n++)
+                run_mix_format_test(func[f], orig_func[f], formats[f], nstreams[n], channels[c], true, false);
+
+        run_mix_format_test(func[f], orig_func[f], formats[f], 2, 2, false, true);
+        run_mix_format_test(func[f], orig_func[f], formats[f], 8, 2, false, true);
+        run_mix_format_test(func[f], orig_func[f], formats[f], 8, 6, false, true);
+    }
+
+    pa_mix_func_init(&cpu_info);
+}
+#endif /* (defined (__i386__) || defined (__amd64__)) && (defined (HAVE_SSE4_1) || defined (HAVE_AVX2)) */
+
 START_TEST (mix_special_test) {
     pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
     pa_do_mix_func_t orig_func, special_func;
@@ -196,6 +348,38 @@ START_TEST (mix_neon_test) {
 END_TEST
 #endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE4_1)
+START_TEST (mix_sse4_1_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE4_1)) {
+        pa_log_info("SSE4.1 not supported. Skipping");
+        return;
+    }
+
+    run_mix_x86_tests("SSE4.1", pa_mix_func_init_sse4_1, flags);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE4_1) */
+
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (mix_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    run_mix_x86_tests("AVX2", pa_mix_func_init_avx2, flags);
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -211,6 +395,12 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, mix_special_test);
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, mix_neon_test);
+#endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE4_1)
+    tcase_add_test(tc, mix_sse4_1_test);
+#endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, mix_avx2_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
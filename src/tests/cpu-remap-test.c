@@ -171,6 +171,31 @@ static void setup_remap_channels(
     }
 }
 
+/* Set up a matrix like the ones of the downmixes and upmixes, in which
+ * each output channel mixes a few of the input channels and some of the
+ * coefficients are at or above full scale */
+static void setup_remap_channels_sparse(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            float v = ((o + i) % 3 == 0) ? 0.0f : 0.3f * ((o + 2 * i) % 5);
+
+            m->map_table_f[o][i] = v;
+            m->map_table_i[o][i] = (int32_t) (v * 0x10000);
+        }
+    }
+}
+
 static void remap_test_channels(
     pa_remap_t *remap_func, pa_remap_t *remap_orig) {
 
@@ -223,6 +248,24 @@ static void remap_init_test_channels(
     remap_test_channels(&remap_func, &remap_orig);
 }
 
+static void remap_init_sparse_test_channels(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels) {
+
+    pa_remap_t remap_orig, remap_func;
+
+    setup_remap_channels_sparse(&remap_orig, f, in_channels, out_channels);
+    orig_init_func(&remap_orig);
+
+    setup_remap_channels_sparse(&remap_func, f, in_channels, out_channels);
+    init_func(&remap_func);
+
+    remap_test_channels(&remap_func, &remap_orig);
+}
+
 static void remap_init2_test_channels(
         pa_sample_format_t f,
         unsigned in_channels,
@@ -325,6 +368,39 @@ START_TEST (remap_sse2_test) {
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+START_TEST (remap_avx2_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+    const pa_sample_format_t formats[] = { PA_SAMPLE_FLOAT32NE, PA_SAMPLE_S16NE };
+    const unsigned channels[][2] = { { 6, 2 }, { 8, 2 }, { 6, 1 }, { 2, 6 }, { 2, 8 }, { 3, 5 }, { 8, 8 } };
+    unsigned i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_avx2(flags);
+    init_func = pa_get_init_remap_func();
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        const char *name = pa_sample_format_to_string(formats[i]);
+
+        pa_log_debug("Checking AVX2 remap (%s, 6-channel->stereo)", name);
+        remap_init_test_channels(init_func, orig_init_func, formats[i], 6, 2, false);
+
+        for (j = 0; j < PA_ELEMENTSOF(channels); j++) {
+            pa_log_debug("Checking AVX2 remap (%s, sparse %u-channel->%u-channel)", name, channels[j][0], channels[j][1]);
+            remap_init_sparse_test_channels(init_func, orig_init_func, formats[i], channels[j][0], channels[j][1]);
+        }
+    }
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (remap_neon_test) {
     pa_cpu_arm_flag_t flags = 0;
@@ -411,6 +487,9 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, remap_mmx_test);
     tcase_add_test(tc, remap_sse2_test);
 #endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, remap_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
 #endif
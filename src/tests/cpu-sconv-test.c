@@ -23,6 +23,7 @@
 
 #include <pulsecore/cpu-arm.h>
 #include <pulsecore/cpu-x86.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/sconv.h>
@@ -190,6 +191,158 @@ START_TEST (sconv_sse_test) {
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+#define PERF_TIMES 100
+#define PERF_TIMES2 10
+
+/* Fill the buffer with random samples. Floats are kept in a sensible
+ * range, but slightly beyond full scale to test clipping, and include
+ * values that need rounding to even. */
+static void fill_samples(pa_sample_format_t f, void *data, unsigned n) {
+    unsigned i;
+
+    if (f != PA_SAMPLE_FLOAT32LE && f != PA_SAMPLE_FLOAT32BE) {
+        pa_random(data, n * pa_sample_size_of_format(f));
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        float v;
+
+        switch (i % 8) {
+            case 0:
+                v = (rand() % 0x10000 - 0x8000 + 0.5f) / 0x8000;
+                break;
+            case 1:
+                v = (i & 16) ? 1.0f : -1.0f;
+                break;
+            default:
+                v = 2.1f * (rand()/(float) RAND_MAX - 0.5f);
+                break;
+        }
+
+        if (f == PA_SAMPLE_FLOAT32NE)
+            ((float *) data)[i] = v;
+        else
+            PA_WRITE_FLOAT32RE((float *) data + i, v);
+    }
+}
+
+static void run_conv_test(
+        pa_convert_func_t func,
+        pa_convert_func_t orig_func,
+        pa_sample_format_t in_format,
+        pa_sample_format_t out_format,
+        int align,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, in_buf[SAMPLES * 4]);
+    PA_DECLARE_ALIGNED(8, uint8_t, out_buf[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, out_ref_buf[SAMPLES * 4]) = { 0 };
+    size_t in_size, out_size;
+    uint8_t *in, *out, *out_ref;
+    int i, nsamples;
+
+    in_size = pa_sample_size_of_format(in_format);
+    out_size = pa_sample_size_of_format(out_format);
+
+    /* Force sample alignment as requested */
+    in = in_buf + (8 - align) * in_size;
+    out = out_buf + (8 - align) * out_size;
+    out_ref = out_ref_buf + (8 - align) * out_size;
+    nsamples = SAMPLES - (8 - align);
+
+    fill_samples(in_format, in, nsamples);
+
+    if (correct) {
+        orig_func(nsamples, in, out_ref);
+        func(nsamples, in, out);
+
+        for (i = 0; i < nsamples; i++) {
+            if (memcmp(out + i * out_size, out_ref + i * out_size, out_size)) {
+                pa_log_debug("Correctness test failed: %s -> %s, align=%d, sample %d",
+                             pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format), align, i);
+                fail();
+                break;
+            }
+        }
+
+        /* Nothing may be written outside of the samples either */
+        fail_unless(memcmp(out_buf, out_ref_buf, sizeof(out_buf)) == 0);
+    }
+
+    if (perf) {
+        pa_log_debug("Testing sconv performance of %s -> %s",
+                     pa_sample_format_to_string(in_format), pa_sample_format_to_string(out_format));
+
+        PA_RUNTIME_TEST_RUN_START("func", PERF_TIMES, PERF_TIMES2) {
+            func(nsamples, in, out);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", PERF_TIMES, PERF_TIMES2) {
+            orig_func(nsamples, in, out_ref);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+static void run_conv_tests(pa_convert_func_t func, pa_convert_func_t orig_func,
+                           pa_sample_format_t in_format, pa_sample_format_t out_format) {
+    int align;
+
+    /* Not replaced by an optimized version */
+    if (func == orig_func)
+        return;
+
+    for (align = 0; align < 8; align++)
+        run_conv_test(func, orig_func, in_format, out_format, align, true, align == 7);
+}
+
+START_TEST (sconv_avx2_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_S16LE, PA_SAMPLE_S16BE,
+        PA_SAMPLE_S32LE, PA_SAMPLE_S32BE,
+        PA_SAMPLE_S24LE, PA_SAMPLE_S24BE,
+        PA_SAMPLE_S24_32LE, PA_SAMPLE_S24_32BE,
+        PA_SAMPLE_FLOAT32LE, PA_SAMPLE_FLOAT32BE
+    };
+    pa_convert_func_t orig_to_float[PA_ELEMENTSOF(formats)], orig_from_float[PA_ELEMENTSOF(formats)];
+    pa_convert_func_t orig_to_s16[PA_ELEMENTSOF(formats)], orig_from_s16[PA_ELEMENTSOF(formats)];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned i;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        orig_to_float[i] = pa_get_convert_to_float32ne_function(formats[i]);
+        orig_from_float[i] = pa_get_convert_from_float32ne_function(formats[i]);
+        orig_to_s16[i] = pa_get_convert_to_s16ne_function(formats[i]);
+        orig_from_s16[i] = pa_get_convert_from_s16ne_function(formats[i]);
+    }
+
+    pa_convert_func_init_avx2(flags);
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        pa_log_debug("Checking AVX2 sconv (%s)", pa_sample_format_to_string(formats[i]));
+
+        run_conv_tests(pa_get_convert_to_float32ne_function(formats[i]), orig_to_float[i],
+                       formats[i], PA_SAMPLE_FLOAT32NE);
+        run_conv_tests(pa_get_convert_from_float32ne_function(formats[i]), orig_from_float[i],
+                       PA_SAMPLE_FLOAT32NE, formats[i]);
+        run_conv_tests(pa_get_convert_to_s16ne_function(formats[i]), orig_to_s16[i],
+                       formats[i], PA_SAMPLE_S16NE);
+        run_conv_tests(pa_get_convert_from_s16ne_function(formats[i]), orig_from_s16[i],
+                       PA_SAMPLE_S16NE, formats[i]);
+    }
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
 START_TEST (sconv_neon_test) {
     pa_cpu_arm_flag_t flags = 0;
@@ -248,6 +401,9 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, sconv_sse2_test);
     tcase_add_test(tc, sconv_sse_test);
 #endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, sconv_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, sconv_neon_test);
 #endif
@@ -26,6 +26,7 @@
 #include <pulsecore/cpu-orc.h>
 #include <pulsecore/random.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/sample-util.h>
 
 #include "runtime-test-util.h"
@@ -156,6 +157,141 @@ START_TEST (svolume_sse_test) {
 END_TEST
 #endif /* defined (__i386__) || defined (__amd64__) */
 
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+/* Like run_volume_test(), but for any sample format other than s16.
+ * Floats are kept in a sensible range and get float volumes. */
+static void run_volume_format_test(
+        pa_do_volume_func_t func,
+        pa_do_volume_func_t orig_func,
+        pa_sample_format_t format,
+        int align,
+        int channels,
+        bool correct,
+        bool perf) {
+
+    PA_DECLARE_ALIGNED(8, uint8_t, s[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_ref[SAMPLES * 4]) = { 0 };
+    PA_DECLARE_ALIGNED(8, uint8_t, s_orig[SAMPLES * 4]) = { 0 };
+    int32_t volumes[channels + PADDING];
+    float volumes_f[channels + PADDING];
+    uint8_t *samples, *samples_ref, *samples_orig;
+    const void *vol;
+    bool is_float;
+    int i, padding, nsamples, size, ssize;
+
+    ssize = pa_sample_size_of_format(format);
+    is_float = format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_FLOAT32RE;
+
+    /* Force sample alignment as requested */
+    samples = s + (8 - align) * ssize;
+    samples_ref = s_ref + (8 - align) * ssize;
+    samples_orig = s_orig + (8 - align) * ssize;
+    nsamples = SAMPLES - (8 - align);
+    if (nsamples % channels)
+        nsamples -= nsamples % channels;
+    size = nsamples * ssize;
+
+    if (is_float) {
+        for (i = 0; i < nsamples; i++) {
+            float v = 2.0f * (rand() / (float) RAND_MAX - 0.5f);
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ((float *) samples)[i] = v;
+            else
+                PA_WRITE_FLOAT32RE((float *) samples + i, v);
+        }
+    } else
+        pa_random(samples, size);
+
+    memcpy(samples_ref, samples, size);
+    memcpy(samples_orig, samples, size);
+
+    for (i = 0; i < channels; i++) {
+        volumes[i] = PA_CLAMP_VOLUME((pa_volume_t)(rand() >> 15));
+        volumes_f[i] = (float) pa_sw_volume_to_linear(volumes[i]);
+    }
+    for (padding = 0; padding < PADDING; padding++, i++) {
+        volumes[i] = volumes[padding];
+        volumes_f[i] = volumes_f[padding];
+    }
+
+    vol = is_float ? (const void *) volumes_f : (const void *) volumes;
+
+    if (correct) {
+        orig_func(samples_ref, vol, channels, size);
+        func(samples, vol, channels, size);
+
+        for (i = 0; i < nsamples; i++) {
+            if (memcmp(samples + i * ssize, samples_ref + i * ssize, ssize)) {
+                pa_log_debug("Correctness test failed: %s, align=%d, channels=%d, sample %d",
+                             pa_sample_format_to_string(format), align, channels, i);
+                fail();
+                break;
+            }
+        }
+
+        /* Nothing may be written outside of the samples either */
+        fail_unless(memcmp(s, s_ref, sizeof(s)) == 0);
+    }
+
+    if (perf) {
+        pa_log_debug("Testing svolume %s %dch performance with %d sample alignment",
+                     pa_sample_format_to_string(format), channels, align);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            memcpy(samples, samples_orig, size);
+            func(samples, vol, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            memcpy(samples_ref, samples_orig, size);
+            orig_func(samples_ref, vol, channels, size);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        fail_unless(memcmp(samples_ref, samples, size) == 0);
+    }
+}
+
+START_TEST (svolume_avx2_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_FLOAT32NE, PA_SAMPLE_FLOAT32RE,
+        PA_SAMPLE_S32NE, PA_SAMPLE_S32RE,
+        PA_SAMPLE_S24NE, PA_SAMPLE_S24RE,
+        PA_SAMPLE_S24_32NE, PA_SAMPLE_S24_32RE
+    };
+    pa_do_volume_func_t orig_funcs[PA_ELEMENTSOF(formats)], avx2_func;
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned f;
+    int i, j;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        orig_funcs[f] = pa_get_volume_func(formats[f]);
+
+    pa_volume_func_init_avx2(flags);
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        avx2_func = pa_get_volume_func(formats[f]);
+
+        pa_log_debug("Checking AVX2 svolume (%s)", pa_sample_format_to_string(formats[f]));
+        for (i = 1; i <= 9; i++) {
+            for (j = 0; j < 7; j++)
+                run_volume_format_test(avx2_func, orig_funcs[f], formats[f], j, i, true, false);
+        }
+        run_volume_format_test(avx2_func, orig_funcs[f], formats[f], 7, 1, true, true);
+        run_volume_format_test(avx2_func, orig_funcs[f], formats[f], 7, 2, true, true);
+        run_volume_format_test(avx2_func, orig_funcs[f], formats[f], 7, 6, true, true);
+    }
+}
+END_TEST
+#endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2) */
+
 #if defined (__arm__) && defined (__linux__)
 START_TEST (svolume_arm_test) {
     pa_do_volume_func_t orig_func, arm_func;
@@ -231,6 +367,9 @@ int main(int argc, char *argv[]) {
     tcase_add_test(tc, svolume_mmx_test);
     tcase_add_test(tc, svolume_sse_test);
 #endif
+#if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_AVX2)
+    tcase_add_test(tc, svolume_avx2_test);
+#endif
 #if defined (__arm__) && defined (__linux__)
     tcase_add_test(tc, svolume_arm_test);
 #endif
@@ -0,0 +1,116 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/filter/fir-design.h>
+
+/* Checks that the FIR design used by the partitioned mode of
+ * module-equalizer-sink has the frequency response it was designed
+ * from */
+
+#define RATE 48000
+/* The module's FFT size for RATE */
+#define FFT_SIZE 65536
+#define PREAMP 0.8f
+
+/* The response to design for, as a gain at frequency f */
+static double response(double f) {
+    /* A low shelf of +6 dB and a dip of -6 dB around 4 kHz */
+    return (1 + 1 / (1 + pow(f / 300, 2))) *
+        (1 - 0.5 * exp(-pow((f - 4000) / 800, 2)));
+}
+
+static void check_fir(size_t fir_length) {
+    pa_fir_design *design;
+    float *H, *taps;
+    size_t i, half = fir_length / 2;
+    double f, max_error = 0;
+
+    pa_log_debug("Checking a FIR of %zu coefficients", fir_length);
+
+    /* H as the module keeps it, with the FFT gain divided out */
+    H = pa_xnew(float, FFT_SIZE / 2 + 1);
+    for (i = 0; i < FFT_SIZE / 2 + 1; i++)
+        H[i] = (float) (response((double) i * RATE / FFT_SIZE) / FFT_SIZE);
+
+    taps = pa_xnew(float, fir_length);
+    design = pa_fir_design_new(FFT_SIZE, fir_length);
+    pa_fir_design_run(design, H, PREAMP, taps);
+    pa_fir_design_free(design);
+
+    /* Symmetric, so that the phase is linear with a delay of half */
+    for (i = 0; i < half; i++)
+        fail_unless(fabsf(taps[i] - taps[fir_length - 1 - i]) <= 1e-4f * fabsf(taps[half]));
+
+    /* Compare the response at a few frequencies from 20 Hz to 20 kHz,
+     * after taking out the delay */
+    for (f = 20; f < 20000; f *= 1.25) {
+        double w = 2 * M_PI * f / RATE, re = 0, im = 0, error;
+
+        for (i = 0; i < fir_length; i++) {
+            re += taps[i] * cos(w * ((double) i - half));
+            im -= taps[i] * sin(w * ((double) i - half));
+        }
+
+        error = fabs(sqrt(re * re + im * im) / (PREAMP * response(f)) - 1);
+        max_error = PA_MAX(max_error, error);
+    }
+
+    pa_log_debug("Largest relative error of the response is %g", max_error);
+    fail_unless(max_error < 0.02);
+
+    pa_xfree(taps);
+    pa_xfree(H);
+}
+
+START_TEST (equalizer_fir_test) {
+    check_fir(1023);
+    check_fir(4095);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Equalizer FIR");
+    tc = tcase_create("equalizer-fir");
+    tcase_add_test(tc, equalizer_fir_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
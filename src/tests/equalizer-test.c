@@ -0,0 +1,198 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <fftw3.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/filter/convolver.h>
+
+#include "runtime-test-util.h"
+
+/* Compares the CPU cost per channel of STFT overlap-add filtering and
+ * of the partitioned convolver, for a filter of a given resolution.
+ * The convolver is the one module-equalizer-sink's partitioned mode
+ * runs; the STFT filter below is a plain version of the algorithm of
+ * its stft mode, without the module's buffering and SIMD code, so
+ * the numbers compare the two algorithms rather than the modes. */
+
+#define FRAMES 16384
+#define BLOCK_SIZE 256
+#define TIMES 5
+#define TIMES2 10
+
+/* An STFT overlap-add filter with the window and hop size the
+ * module's stft mode picks for a window of about n_coefs samples */
+struct stft {
+    size_t fft_size, window_size, R, overlap_size;
+    float *W, *H, *input, *overlap, *work;
+    fftwf_complex *output_window;
+    fftwf_plan forward_plan, inverse_plan;
+};
+
+static void stft_init(struct stft *s, unsigned n_coefs) {
+    size_t i;
+
+    s->fft_size = 2 * n_coefs;
+    s->window_size = n_coefs - 1;
+    s->R = (s->window_size + 1) / 2;
+    s->overlap_size = s->window_size - s->R;
+
+    s->W = fftwf_malloc(s->window_size * sizeof(float));
+    for (i = 0; i < s->window_size; i++)
+        s->W[i] = (float) .5 * (1 - cos(2*M_PI*i / (s->window_size+1)));
+
+    s->H = fftwf_malloc((s->fft_size / 2 + 1) * sizeof(float));
+    for (i = 0; i < s->fft_size / 2 + 1; i++)
+        s->H[i] = 1.0f / s->fft_size;
+
+    s->input = fftwf_malloc(s->window_size * sizeof(float));
+    s->overlap = fftwf_malloc(s->overlap_size * sizeof(float));
+    s->work = fftwf_malloc(s->fft_size * sizeof(float));
+    s->output_window = fftwf_malloc((s->fft_size / 2 + 1) * sizeof(fftwf_complex));
+    memset(s->input, 0, s->window_size * sizeof(float));
+    memset(s->overlap, 0, s->overlap_size * sizeof(float));
+
+    s->forward_plan = fftwf_plan_dft_r2c_1d(s->fft_size, s->work, s->output_window, FFTW_ESTIMATE);
+    s->inverse_plan = fftwf_plan_dft_c2r_1d(s->fft_size, s->output_window, s->work, FFTW_ESTIMATE);
+}
+
+static void stft_done(struct stft *s) {
+    fftwf_destroy_plan(s->forward_plan);
+    fftwf_destroy_plan(s->inverse_plan);
+    fftwf_free(s->W);
+    fftwf_free(s->H);
+    fftwf_free(s->input);
+    fftwf_free(s->overlap);
+    fftwf_free(s->work);
+    fftwf_free(s->output_window);
+}
+
+/* n must be a multiple of the hop size */
+static void stft_process(struct stft *s, const float *src, float *dst, unsigned n) {
+    size_t i, j;
+
+    for (i = 0; i < n; i += s->R) {
+        memmove(s->input, s->input + s->R, s->overlap_size * sizeof(float));
+        memcpy(s->input + s->overlap_size, src + i, s->R * sizeof(float));
+
+        for (j = 0; j < s->window_size; j++)
+            s->work[j] = s->W[j] * s->input[j];
+        memset(s->work + s->window_size, 0, (s->fft_size - s->window_size) * sizeof(float));
+
+        fftwf_execute_dft_r2c(s->forward_plan, s->work, s->output_window);
+        for (j = 0; j < s->fft_size / 2 + 1; j++) {
+            s->output_window[j][0] *= s->H[j];
+            s->output_window[j][1] *= s->H[j];
+        }
+        fftwf_execute_dft_c2r(s->inverse_plan, s->output_window, s->work);
+
+        for (j = 0; j < s->overlap_size; j++) {
+            s->work[j] += s->overlap[j];
+            s->overlap[j] = s->work[s->R + j];
+        }
+
+        memcpy(dst + i, s->work, s->R * sizeof(float));
+    }
+}
+
+static float random_sample(void) {
+    uint16_t r;
+
+    pa_random(&r, sizeof(r));
+    return (float) r / 0x8000 - 1.0f;
+}
+
+static void run_perf_test(unsigned n_coefs) {
+    struct stft s;
+    pa_convolver *c;
+    float *ir, *src, *out;
+    unsigned i;
+
+    pa_log_debug("Testing performance with %u coefficients", n_coefs);
+
+    src = pa_xnew(float, FRAMES);
+    out = pa_xnew(float, FRAMES);
+    for (i = 0; i < FRAMES; i++)
+        src[i] = random_sample();
+
+    ir = pa_xnew(float, n_coefs);
+    for (i = 0; i < n_coefs; i++)
+        ir[i] = random_sample() / n_coefs;
+
+    c = pa_convolver_new(BLOCK_SIZE, 1, 1, n_coefs);
+    pa_convolver_set_ir(c, 0, 0, ir, 1);
+
+    /* Delivered in the module's usual request sizes */
+    PA_RUNTIME_TEST_RUN_START("partitioned", TIMES, TIMES2) {
+        for (i = 0; i < FRAMES; i += 1024)
+            pa_convolver_process(c, src + i, out + i, 1024);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    stft_init(&s, n_coefs);
+    pa_assert(FRAMES % s.R == 0);
+
+    PA_RUNTIME_TEST_RUN_START("stft", TIMES, TIMES2) {
+        stft_process(&s, src, out, FRAMES);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    stft_done(&s);
+    pa_convolver_free(c);
+    pa_xfree(ir);
+    pa_xfree(src);
+    pa_xfree(out);
+}
+
+START_TEST (equalizer_perf_test) {
+    run_perf_test(1024);
+    run_perf_test(4096);
+    run_perf_test(16384);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Equalizer");
+    tc = tcase_create("equalizer");
+    tcase_add_test(tc, equalizer_perf_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
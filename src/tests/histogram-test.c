@@ -0,0 +1,99 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/histogram.h>
+#include <pulsecore/log.h>
+
+START_TEST (bucket_test) {
+    fail_unless(pa_histogram_bucket(0) == 0);
+    fail_unless(pa_histogram_bucket(1) == 1);
+    fail_unless(pa_histogram_bucket(2) == 2);
+    fail_unless(pa_histogram_bucket(3) == 2);
+    fail_unless(pa_histogram_bucket(4) == 3);
+    fail_unless(pa_histogram_bucket(1023) == 10);
+    fail_unless(pa_histogram_bucket(1024) == 11);
+    fail_unless(pa_histogram_bucket((pa_usec_t) -1) == PA_HISTOGRAM_BUCKETS - 1);
+}
+END_TEST
+
+START_TEST (histogram_test) {
+    pa_histogram h;
+    char *s;
+    unsigned i;
+
+    pa_histogram_reset(&h);
+
+    s = pa_histogram_to_string(&h);
+    fail_unless(pa_streq(s, "no data"));
+    pa_xfree(s);
+    fail_unless(pa_histogram_percentile(&h, 0.5) == 0);
+
+    /* 90 fast calls and 10 slow ones */
+    for (i = 0; i < 90; i++)
+        pa_histogram_add(&h, 100);
+    for (i = 0; i < 10; i++)
+        pa_histogram_add(&h, 5000);
+
+    fail_unless(h.count == 100);
+    fail_unless(h.total == 90 * 100 + 10 * 5000);
+    fail_unless(h.max == 5000);
+    fail_unless(h.buckets[pa_histogram_bucket(100)] == 90);
+    fail_unless(h.buckets[pa_histogram_bucket(5000)] == 10);
+
+    fail_unless(pa_histogram_percentile(&h, 0.5) == 128);
+    fail_unless(pa_histogram_percentile(&h, 0.9) == 128);
+    fail_unless(pa_histogram_percentile(&h, 0.99) == 5000);
+    fail_unless(pa_histogram_percentile(&h, 1.0) == 5000);
+
+    s = pa_histogram_to_string(&h);
+    pa_log_debug("%s", s);
+    fail_unless(pa_startswith(s, "n=100 avg=590 usec p50<128 usec p99<5000 usec max=5000 usec |"));
+    pa_xfree(s);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Histogram");
+    tc = tcase_create("histogram");
+    tcase_add_test(tc, bucket_test);
+    tcase_add_test(tc, histogram_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
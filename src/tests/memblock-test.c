@@ -29,6 +29,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/planar.h>
 
 static void release_cb(pa_memimport *i, uint32_t block_id, void *userdata) {
     pa_log("%s: Imported block %u is released.", (char*) userdata, block_id);
@@ -52,6 +53,11 @@ static void print_stats(pa_mempool *p, const char *text) {
                  "\texported_size = %u\n"
                  "\tn_too_large_for_pool = %u\n"
                  "\tn_pool_full = %u\n"
+                 "\tn_fallback = %u\n"
+                 "\tn_segments = %u\n"
+                 "\tpool_size = %u\n"
+                 "\tn_used_slots = %u\n"
+                 "\tused_slots_size = %u\n"
                  "}",
            text,
            (unsigned) pa_atomic_load(&s->n_allocated),
@@ -63,7 +69,12 @@ static void print_stats(pa_mempool *p, const char *text) {
            (unsigned) pa_atomic_load(&s->imported_size),
            (unsigned) pa_atomic_load(&s->exported_size),
            (unsigned) pa_atomic_load(&s->n_too_large_for_pool),
-           (unsigned) pa_atomic_load(&s->n_pool_full));
+           (unsigned) pa_atomic_load(&s->n_pool_full),
+           (unsigned) pa_atomic_load(&s->n_fallback),
+           (unsigned) pa_atomic_load(&s->n_segments),
+           (unsigned) pa_atomic_load(&s->pool_size),
+           (unsigned) pa_atomic_load(&s->n_used_slots),
+           (unsigned) pa_atomic_load(&s->used_slots_size));
 }
 
 START_TEST (memblock_test) {
@@ -124,7 +135,8 @@ START_TEST (memblock_test) {
 
         r = pa_memexport_put(export_a, mb_a, &id, &shm_id, &offset, &size);
         fail_unless(r >= 0);
-        fail_unless(shm_id == id_a);
+        /* Small blocks live in another segment of pool A than the first one */
+        fail_unless(shm_id != id_b && shm_id != id_c);
 
         pa_log("A: Memory block exported as %u", id);
 
@@ -132,7 +144,7 @@ START_TEST (memblock_test) {
         fail_unless(mb_b != NULL);
         r = pa_memexport_put(export_b, mb_b, &id, &shm_id, &offset, &size);
         fail_unless(r >= 0);
-        fail_unless(shm_id == id_a || shm_id == id_b);
+        fail_unless(shm_id != id_c);
         pa_memblock_unref(mb_b);
 
         pa_log("B: Memory block exported as %u", id);
@@ -175,6 +187,191 @@ START_TEST (memblock_test) {
 }
 END_TEST
 
+START_TEST (mempool_grow_test) {
+    pa_mempool *pool;
+    const pa_mempool_stat *stat;
+    pa_memblock *blocks[10], *small, *large;
+    size_t max;
+    unsigned i;
+
+    /* Room for four blocks of the maximum size in the first segment */
+    pool = pa_mempool_new(true, 4 * 64 * 1024);
+    fail_unless(pool != NULL);
+    stat = pa_mempool_get_stat(pool);
+    max = pa_mempool_block_size_max(pool);
+
+    fail_unless(pa_atomic_load(&stat->n_segments) == 1);
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        fail_unless((blocks[i] = pa_memblock_new(pool, max)) != NULL);
+
+    /* The pool grew instead of falling back to the heap */
+    fail_unless(pa_atomic_load(&stat->n_segments) == 3);
+    fail_unless(pa_atomic_load(&stat->n_fallback) == 0);
+    fail_unless(pa_atomic_load(&stat->n_used_slots) == PA_ELEMENTSOF(blocks));
+
+    /* Small blocks get small slots */
+    small = pa_memblock_new(pool, 100);
+    fail_unless(pa_atomic_load(&stat->n_segments) == 4);
+    fail_unless(pa_atomic_load(&stat->used_slots_size) == (int) (PA_ELEMENTSOF(blocks) * 64 * 1024 + 4 * 1024));
+
+    /* Blocks larger than the largest slot come from the heap */
+    large = pa_memblock_new(pool, 1024 * 1024);
+    fail_unless(pa_atomic_load(&stat->n_too_large_for_pool) == 1);
+    fail_unless(pa_atomic_load(&stat->n_fallback) == 1);
+
+    print_stats(pool, "grown pool");
+
+    /* Blocks in other segments can be exported */
+    {
+        pa_memexport *export;
+        uint32_t id, shm_id, first_id;
+        size_t offset, size;
+
+        fail_unless((export = pa_memexport_new(pool, revoke_cb, (void*) "grow")) != NULL);
+        fail_unless(pa_memexport_put(export, blocks[PA_ELEMENTSOF(blocks) - 1], &id, &shm_id, &offset, &size) == 0);
+        fail_unless(pa_mempool_get_shm_id(pool, &first_id) == 0);
+        fail_unless(shm_id != first_id);
+        fail_unless(size == max);
+        pa_memexport_free(export);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(blocks); i++)
+        pa_memblock_unref(blocks[i]);
+    pa_memblock_unref(small);
+    pa_memblock_unref(large);
+
+    fail_unless(pa_atomic_load(&stat->n_used_slots) == 0);
+    fail_unless(pa_atomic_load(&stat->used_slots_size) == 0);
+
+    pa_mempool_vacuum(pool);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+/* Checks that the length bytes at index are marked as silent or not */
+static bool check_silence(pa_memblock *b, size_t index, size_t length, bool silent) {
+    bool s;
+
+    return pa_memblock_get_silence(b, index, length, &s) == length && s == silent;
+}
+
+START_TEST (memblock_silence_test) {
+    pa_mempool *pool;
+    pa_memblock *b;
+    unsigned i;
+
+    pool = pa_mempool_new(false, 0);
+    fail_unless(pool != NULL);
+    b = pa_memblock_new(pool, 4096);
+
+    fail_unless(check_silence(b, 0, 4096, false));
+
+    /* Touching ranges are merged */
+    pa_memblock_add_silence(b, 100, 100);
+    pa_memblock_add_silence(b, 300, 100);
+    fail_unless(check_silence(b, 0, 100, false));
+    fail_unless(check_silence(b, 100, 100, true));
+    fail_unless(check_silence(b, 200, 100, false));
+    pa_memblock_add_silence(b, 200, 100);
+    fail_unless(check_silence(b, 100, 300, true));
+    fail_unless(check_silence(b, 400, 3696, false));
+
+    /* Clearing splits them */
+    pa_memblock_clear_silence(b, 150, 10);
+    fail_unless(check_silence(b, 100, 50, true));
+    fail_unless(check_silence(b, 150, 10, false));
+    fail_unless(check_silence(b, 160, 240, true));
+
+    /* Only the longest ranges are remembered */
+    for (i = 0; i < 4; i++)
+        pa_memblock_add_silence(b, 500 + i * 1000, 10 + i * 100);
+    fail_unless(check_silence(b, 100, 50, false));
+    fail_unless(check_silence(b, 160, 240, true));
+    fail_unless(check_silence(b, 500, 10, false));
+    fail_unless(check_silence(b, 1500, 110, true));
+    fail_unless(check_silence(b, 2500, 210, true));
+    fail_unless(check_silence(b, 3500, 310, true));
+
+    pa_memblock_clear_silence(b, 0, 4096);
+    fail_unless(check_silence(b, 0, 4096, false));
+
+    /* Clearing part of a silence block leaves the rest silent */
+    pa_memblock_set_is_silence(b, true);
+    pa_memblock_clear_silence(b, 1000, 1000);
+    fail_unless(!pa_memblock_is_silence(b));
+    fail_unless(check_silence(b, 0, 1000, true));
+    fail_unless(check_silence(b, 1000, 1000, false));
+    fail_unless(check_silence(b, 2000, 2096, true));
+
+    pa_memblock_unref(b);
+    pa_mempool_free(pool);
+}
+END_TEST
+
+/* The planar conversions only move samples around, so they have to be
+ * bit exact */
+static bool float_equal(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+START_TEST (memblock_planar_test) {
+    pa_mempool *pool;
+    pa_memchunk c, d;
+    pa_planar *p, *buf;
+    const float *planes[2];
+    float *data;
+    unsigned i;
+
+    pool = pa_mempool_new(false, 0);
+    fail_unless(pool != NULL);
+
+    c.memblock = pa_memblock_new(pool, 100 * 2 * sizeof(float));
+    c.index = 0;
+    c.length = pa_memblock_get_length(c.memblock);
+
+    p = pa_planar_new(2, 100);
+    for (i = 0; i < 100; i++) {
+        p->data[0][i] = (float) i;
+        p->data[1][i] = -(float) i;
+    }
+
+    pa_planar_to_memchunk(p, &c);
+
+    data = pa_memblock_acquire(c.memblock);
+    for (i = 0; i < 100; i++) {
+        fail_unless(float_equal(data[2 * i], (float) i));
+        fail_unless(float_equal(data[2 * i + 1], -(float) i));
+    }
+    pa_memblock_release(c.memblock);
+
+    /* Reading a part of the data gives the planar copy */
+    buf = pa_planar_new(2, 0);
+    d = c;
+    d.index += 10 * 2 * sizeof(float);
+    d.length = 20 * 2 * sizeof(float);
+    pa_planar_from_memchunk(buf, &d, planes);
+    fail_unless(planes[0] == p->data[0] + 10);
+    fail_unless(planes[1] == p->data[1] + 10);
+    fail_unless(buf->n_frames == 0);
+
+    /* Writing to the block drops it, after which the data is
+     * deinterleaved */
+    pa_memchunk_make_writable(&d, 0);
+    pa_planar_from_memchunk(buf, &d, planes);
+    fail_unless(planes[0] == buf->data[0]);
+    fail_unless(buf->n_frames >= 20);
+    for (i = 0; i < 20; i++) {
+        fail_unless(float_equal(planes[0][i], (float) (i + 10)));
+        fail_unless(float_equal(planes[1][i], -(float) (i + 10)));
+    }
+
+    pa_planar_free(buf);
+    pa_memblock_unref(c.memblock);
+    pa_mempool_free(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -187,6 +384,9 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock");
     tc = tcase_create("memblock");
     tcase_add_test(tc, memblock_test);
+    tcase_add_test(tc, mempool_grow_test);
+    tcase_add_test(tc, memblock_silence_test);
+    tcase_add_test(tc, memblock_planar_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -30,8 +30,10 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/sample-util.h>
 
 #include <pulse/xmalloc.h>
+#include <pulse/rtclock.h>
 
 static const char *fixed[] = {
     "1122444411441144__22__11______3333______________________________",
@@ -93,6 +95,23 @@ static void dump(pa_memblockq *bq, int n) {
     fprintf(stderr, "<\n");
 }
 
+static char *read_all(pa_memblockq *bq) {
+    pa_memchunk out;
+    pa_strbuf *buf = pa_strbuf_new();
+
+    while (pa_memblockq_get_length(bq) > 0) {
+        fail_unless(pa_memblockq_peek(bq, &out) >= 0);
+
+        dump_chunk(&out, buf);
+        pa_memblock_unref(out.memblock);
+        pa_memblockq_drop(bq, out.length);
+    }
+
+    fprintf(stderr, "\n");
+
+    return pa_strbuf_to_string_free(buf);
+}
+
 START_TEST (memblockq_test) {
     int ret;
 
@@ -212,6 +231,201 @@ START_TEST (memblockq_test) {
 }
 END_TEST
 
+START_TEST (memblockq_splice_test) {
+    pa_mempool *p;
+    pa_memblockq *bq, *source;
+    pa_memchunk chunk1, chunk2, chunk3, chunk4;
+    pa_memchunk silence;
+    char *str;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 1
+    };
+
+    p = pa_mempool_new(false, 0);
+
+    silence.memblock = pa_memblock_new_fixed(p, (char*) "__", 2, 1);
+    silence.index = 0;
+    silence.length = 2;
+
+    chunk1.memblock = pa_memblock_new_fixed(p, (char*) "11", 2, 1);
+    chunk1.index = 0;
+    chunk1.length = 2;
+
+    chunk2.memblock = pa_memblock_new_fixed(p, (char*) "XX22", 4, 1);
+    chunk2.index = 2;
+    chunk2.length = 2;
+
+    chunk3.memblock = pa_memblock_new_fixed(p, (char*) "3333", 4, 1);
+    chunk3.index = 0;
+    chunk3.length = 4;
+
+    chunk4.memblock = pa_memblock_new_fixed(p, (char*) "44444444", 8, 1);
+    chunk4.index = 0;
+    chunk4.length = 8;
+
+    /* The readable data of the source is appended to bq, with the hole
+     * filled with silence, but not the part that was read already */
+    source = pa_memblockq_new("source memblockq", 0, 200, 0, &ss, 0, 2, 40, &silence);
+    bq = pa_memblockq_new("test memblockq", 0, 200, 0, &ss, 0, 2, 40, &silence);
+
+    fail_unless(pa_memblockq_push(source, &chunk1) == 0);
+    fail_unless(pa_memblockq_push(source, &chunk2) == 0);
+    pa_memblockq_seek(source, 4, PA_SEEK_RELATIVE, true);
+    fail_unless(pa_memblockq_push(source, &chunk3) == 0);
+    fail_unless(pa_memblockq_push(source, &chunk4) == 0);
+    pa_memblockq_drop(source, 2);
+
+    fail_unless(pa_memblockq_push(bq, &chunk1) == 0);
+
+    fail_unless(pa_memblockq_splice(bq, source) == 0);
+    fail_unless(pa_memblockq_get_length(source) == 0);
+    fail_unless(pa_memblockq_get_length(bq) == 20);
+
+    /* The source keeps working as before */
+    fail_unless(pa_memblockq_push(source, &chunk3) == 0);
+    str = read_all(source);
+    fail_unless(pa_streq(str, "3333"));
+    pa_xfree(str);
+
+    str = read_all(bq);
+    fail_unless(pa_streq(str, "1122____333344444444"));
+    pa_xfree(str);
+
+    /* Data of bq behind its write index is overwritten */
+    fail_unless(pa_memblockq_push(bq, &chunk4) == 0);
+    pa_memblockq_seek(bq, -4, PA_SEEK_RELATIVE, true);
+
+    fail_unless(pa_memblockq_push(source, &chunk1) == 0);
+    fail_unless(pa_memblockq_push(source, &chunk2) == 0);
+
+    fail_unless(pa_memblockq_splice(bq, source) == 0);
+    fail_unless(pa_memblockq_get_length(source) == 0);
+
+    str = read_all(bq);
+    fail_unless(pa_streq(str, "44441122"));
+    pa_xfree(str);
+
+    pa_memblockq_free(bq);
+    pa_memblockq_free(source);
+    pa_memblock_unref(silence.memblock);
+    pa_memblock_unref(chunk1.memblock);
+    pa_memblock_unref(chunk2.memblock);
+    pa_memblock_unref(chunk3.memblock);
+    pa_memblock_unref(chunk4.memblock);
+
+    pa_mempool_free(p);
+}
+END_TEST
+
+/* Pushes packets of packet_size bytes, reads them back in pieces of
+ * read_size bytes and rewinds a bit every now and then, keeping about
+ * queue_size bytes in the queue. With coalesce the packets are adjacent
+ * pieces of the same memblock, otherwise every packet has its own. */
+static void benchmark(pa_mempool *p, const char *name, size_t packet_size, size_t read_size, size_t queue_size, bool coalesce) {
+    pa_memblockq *bq;
+    pa_memchunk silence, chunk, out;
+    pa_usec_t start, stop;
+    size_t pushed = 0, read = 0, rewound = 0;
+    unsigned i, n_blocks = 0;
+    pa_sample_spec ss = {
+        .format = PA_SAMPLE_S16LE,
+        .rate = 48000,
+        .channels = 2
+    };
+
+    silence.memblock = pa_memblock_new(p, 4096);
+    silence.index = 0;
+    silence.length = 4096;
+    pa_silence_memchunk(&silence, &ss);
+
+    chunk.memblock = pa_memblock_new(p, 65536);
+    chunk.index = 0;
+    chunk.length = packet_size;
+
+    bq = pa_memblockq_new("benchmark memblockq", 0, 4 * queue_size, 0, &ss, 0, 4, queue_size, &silence);
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < 20000; i++) {
+
+        if (coalesce) {
+            if (chunk.index + packet_size > 65536) {
+                pa_memblock_unref(chunk.memblock);
+                chunk.memblock = pa_memblock_new(p, 65536);
+                chunk.index = 0;
+            }
+        } else {
+            pa_memblock_unref(chunk.memblock);
+            chunk.memblock = pa_memblock_new(p, packet_size);
+        }
+
+        fail_unless(pa_memblockq_push(bq, &chunk) == 0);
+        pushed += packet_size;
+
+        if (coalesce)
+            chunk.index += packet_size;
+
+        /* Every now and then a packet is lost */
+        if (i % 97 == 0) {
+            pa_memblockq_seek(bq, (int64_t) packet_size, PA_SEEK_RELATIVE, true);
+            pushed += packet_size;
+        }
+
+        while (pa_memblockq_get_length(bq) > queue_size) {
+            size_t l = read_size;
+
+            while (l > 0) {
+                fail_unless(pa_memblockq_peek(bq, &out) >= 0);
+                out.length = PA_MIN(out.length, l);
+
+                if (out.memblock)
+                    pa_memblock_unref(out.memblock);
+
+                pa_memblockq_drop(bq, out.length);
+                read += out.length;
+                l -= out.length;
+            }
+        }
+
+        /* The sink asks for a rewind every now and then */
+        if (i % 13 == 0 && read >= read_size) {
+            pa_memblockq_rewind(bq, read_size);
+            read -= read_size;
+            rewound += read_size;
+        }
+
+        n_blocks = PA_MAX(n_blocks, pa_memblockq_get_nblocks(bq));
+    }
+
+    stop = pa_rtclock_now();
+
+    fail_unless(read + pa_memblockq_get_length(bq) == pushed);
+
+    pa_log_info("%s: %u packets of %zu bytes, up to %u blocks queued, %zu bytes rewound: %llu usec",
+                name, i, packet_size, n_blocks, rewound, (unsigned long long) (stop - start));
+
+    pa_memblockq_free(bq);
+    pa_memblock_unref(chunk.memblock);
+    pa_memblock_unref(silence.memblock);
+}
+
+START_TEST (memblockq_benchmark) {
+    pa_mempool *p;
+
+    p = pa_mempool_new(false, 0);
+
+    /* RTP with 20ms packets from a receive buffer */
+    benchmark(p, "rtp", 3840, 1920, 192000, true);
+
+    /* A tunnel that gets lots of small separate blocks */
+    benchmark(p, "tunnel", 256, 4096, 384000, false);
+
+    pa_mempool_free(p);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -221,6 +435,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Memblock Queue");
     tc = tcase_create("memblockq");
     tcase_add_test(tc, memblockq_test);
+    tcase_add_test(tc, memblockq_splice_test);
+    tcase_add_test(tc, memblockq_benchmark);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
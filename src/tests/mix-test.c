@@ -20,6 +20,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include <check.h>
@@ -30,6 +31,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
 
@@ -342,6 +344,227 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+#define SILENCE_FRAMES 4096
+
+/* Copies c into a new block, without the silence marked in it */
+static void copy_unmarked(pa_mempool *pool, const pa_memchunk *c, pa_memchunk *r) {
+    void *src, *dst;
+
+    r->memblock = pa_memblock_new(pool, c->length);
+    r->index = 0;
+    r->length = c->length;
+
+    src = pa_memblock_acquire_chunk(c);
+    dst = pa_memblock_acquire(r->memblock);
+    memcpy(dst, src, c->length);
+    pa_memblock_release(r->memblock);
+    pa_memblock_release(c->memblock);
+}
+
+static bool chunks_equal(const pa_memchunk *a, const pa_memchunk *b) {
+    void *p, *q;
+    bool equal;
+
+    p = pa_memblock_acquire_chunk(a);
+    q = pa_memblock_acquire_chunk(b);
+    equal = a->length == b->length && memcmp(p, q, a->length) == 0;
+    pa_memblock_release(a->memblock);
+    pa_memblock_release(b->memblock);
+
+    return equal;
+}
+
+START_TEST (mix_silence_test) {
+    pa_mempool *pool;
+    pa_sample_spec a;
+    pa_cvolume v;
+    pa_memchunk in[3], ref[3], out, out_ref, c;
+    pa_mix_info m[3];
+    size_t fs;
+    unsigned k;
+    bool silent;
+    void *ptr;
+
+    pool = pa_mempool_new(false, 0);
+    fail_unless(pool != NULL);
+
+    a.format = PA_SAMPLE_S16NE;
+    a.channels = 2;
+    a.rate = 44100;
+    fs = pa_frame_size(&a);
+
+    pa_cvolume_set(&v, a.channels, pa_sw_volume_from_linear(0.7));
+
+    /* Three streams of noise with some silence each, partly
+     * overlapping, and one of them silent except for a short burst */
+    for (k = 0; k < 3; k++) {
+        in[k].memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+        in[k].index = 0;
+        in[k].length = SILENCE_FRAMES * fs;
+
+        ptr = pa_memblock_acquire(in[k].memblock);
+        pa_random(ptr, in[k].length);
+        pa_memblock_release(in[k].memblock);
+
+        ref[k] = in[k];
+    }
+
+    c.memblock = in[0].memblock;
+    c.index = 1000 * fs;
+    c.length = 1000 * fs;
+    pa_silence_memchunk(&c, &a);
+
+    c.memblock = in[1].memblock;
+    c.index = 1500 * fs;
+    c.length = 2000 * fs;
+    pa_silence_memchunk(&c, &a);
+
+    c.memblock = in[2].memblock;
+    c.index = 0;
+    c.length = 2000 * fs;
+    pa_silence_memchunk(&c, &a);
+    c.index = 2100 * fs;
+    c.length = 1996 * fs;
+    pa_silence_memchunk(&c, &a);
+
+    for (k = 0; k < 3; k++)
+        copy_unmarked(pool, &in[k], &ref[k]);
+
+    /* Mixing with and without the silence marked gives the same */
+    out.memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+    out.index = 0;
+    out.length = SILENCE_FRAMES * fs;
+    out_ref.memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+    out_ref.index = 0;
+    out_ref.length = SILENCE_FRAMES * fs;
+
+    for (k = 0; k < 3; k++) {
+        m[k].chunk = in[k];
+        m[k].volume = v;
+    }
+
+    ptr = pa_memblock_acquire(out.memblock);
+    pa_mix(m, 3, ptr, out.length, &a, NULL, false);
+    pa_memblock_release(out.memblock);
+
+    fail_unless(m[0].skipped == 1000 * fs);
+    fail_unless(m[1].skipped == 2000 * fs);
+    fail_unless(m[2].skipped == 3996 * fs);
+
+    for (k = 0; k < 3; k++)
+        m[k].chunk = ref[k];
+
+    ptr = pa_memblock_acquire(out_ref.memblock);
+    pa_mix(m, 3, ptr, out_ref.length, &a, NULL, false);
+    pa_memblock_release(out_ref.memblock);
+
+    fail_unless(m[0].skipped == 0);
+    fail_unless(chunks_equal(&out, &out_ref));
+
+    /* Detection finds what we marked above */
+    pa_memchunk_detect_silence(&ref[2], &a, 100 * fs);
+    fail_unless(pa_memchunk_get_silence(&ref[2], 0, &silent) == 2000 * fs && silent);
+    fail_unless(pa_memchunk_get_silence(&ref[2], 2000 * fs, &silent) == 100 * fs && !silent);
+    fail_unless(pa_memchunk_get_silence(&ref[2], 2100 * fs, &silent) == 1996 * fs && silent);
+
+    /* Volume leaves silence alone */
+    pa_volume_memchunk(&in[1], &a, &v);
+    pa_volume_memchunk(&ref[1], &a, &v);
+    fail_unless(chunks_equal(&in[1], &ref[1]));
+
+    for (k = 0; k < 3; k++) {
+        pa_memblock_unref(in[k].memblock);
+        pa_memblock_unref(ref[k].memblock);
+    }
+    pa_memblock_unref(out.memblock);
+    pa_memblock_unref(out_ref.memblock);
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
+/* Mixes a piece with all streams active, then one where only some are,
+ * in formats without SIMD mixing functions. Their mixing functions
+ * advance the stream pointers themselves. */
+START_TEST (mix_silence_pieces_test) {
+    static const pa_sample_format_t formats[] = {
+        PA_SAMPLE_U8, PA_SAMPLE_ULAW, PA_SAMPLE_S16RE, PA_SAMPLE_S24NE, PA_SAMPLE_S32RE
+    };
+    pa_mempool *pool;
+    pa_sample_spec a;
+    pa_memchunk in[2], ref[2], out, out_ref, c;
+    pa_mix_info m[2];
+    size_t fs;
+    unsigned i, k;
+    void *ptr;
+
+    pool = pa_mempool_new(false, 0);
+    fail_unless(pool != NULL);
+
+    for (i = 0; i < PA_ELEMENTSOF(formats); i++) {
+        a.format = formats[i];
+        a.channels = 2;
+        a.rate = 44100;
+        fs = pa_frame_size(&a);
+
+        for (k = 0; k < 2; k++) {
+            in[k].memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+            in[k].index = 0;
+            in[k].length = SILENCE_FRAMES * fs;
+
+            ptr = pa_memblock_acquire(in[k].memblock);
+            pa_random(ptr, in[k].length);
+            pa_memblock_release(in[k].memblock);
+        }
+
+        c.memblock = in[1].memblock;
+        c.index = 1000 * fs;
+        c.length = 2000 * fs;
+        pa_silence_memchunk(&c, &a);
+
+        for (k = 0; k < 2; k++)
+            copy_unmarked(pool, &in[k], &ref[k]);
+
+        out.memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+        out.index = 0;
+        out.length = SILENCE_FRAMES * fs;
+        out_ref.memblock = pa_memblock_new(pool, SILENCE_FRAMES * fs);
+        out_ref.index = 0;
+        out_ref.length = SILENCE_FRAMES * fs;
+
+        for (k = 0; k < 2; k++) {
+            m[k].chunk = in[k];
+            pa_cvolume_set(&m[k].volume, a.channels, pa_sw_volume_from_linear(0.5));
+        }
+
+        ptr = pa_memblock_acquire(out.memblock);
+        pa_mix(m, 2, ptr, out.length, &a, NULL, false);
+        pa_memblock_release(out.memblock);
+
+        fail_unless(m[0].skipped == 0);
+        fail_unless(m[1].skipped == 2000 * fs);
+
+        for (k = 0; k < 2; k++)
+            m[k].chunk = ref[k];
+
+        ptr = pa_memblock_acquire(out_ref.memblock);
+        pa_mix(m, 2, ptr, out_ref.length, &a, NULL, false);
+        pa_memblock_release(out_ref.memblock);
+
+        fail_unless(chunks_equal(&out, &out_ref));
+
+        for (k = 0; k < 2; k++) {
+            pa_memblock_unref(in[k].memblock);
+            pa_memblock_unref(ref[k].memblock);
+        }
+        pa_memblock_unref(out.memblock);
+        pa_memblock_unref(out_ref.memblock);
+    }
+
+    pa_mempool_free(pool);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -351,6 +574,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+    tcase_add_test(tc, mix_silence_test);
+    tcase_add_test(tc, mix_silence_pieces_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,384 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/iochannel.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/pstream.h>
+
+/* Queues many packets and memory blocks before the main loop gets to
+ * run, so that they are written in batches, and checks that they come
+ * out in order and intact on the other side */
+
+#define N_ITEMS 150
+#define FD_ITEM 37
+
+static unsigned items_received;
+static bool with_fd;
+
+static bool item_is_memblock(unsigned k) {
+    return k % 3 == 1;
+}
+
+static size_t item_size(unsigned k) {
+    /* Mostly small items, with the odd one above the direct read size
+     * and some packets larger than the read buffer */
+    if (k % 7 == 0)
+        return 5000 + k * 13;
+    if (k % 11 == 5 && !item_is_memblock(k))
+        return 70000 + k;
+    return 1 + (k * 37) % 300;
+}
+
+static uint8_t item_byte(unsigned k, size_t i) {
+    return (uint8_t) (k * 31 + i);
+}
+
+static void check_item(unsigned k, const uint8_t *d, size_t length) {
+    size_t i;
+
+    fail_unless(length == item_size(k));
+
+    for (i = 0; i < length; i++)
+        fail_unless(d[i] == item_byte(k, i));
+}
+
+static void packet_received(pa_pstream *p, pa_packet *packet, const pa_cmsg_ancil_data *ancil_data, void *userdata) {
+    const uint8_t *d;
+    size_t length;
+
+    fail_unless(items_received < N_ITEMS);
+    fail_unless(!item_is_memblock(items_received));
+
+    d = pa_packet_data(packet, &length);
+    check_item(items_received, d, length);
+
+    if (with_fd && items_received == FD_ITEM) {
+        char c;
+
+        /* The fd is the read end of a pipe with one byte in it */
+        fail_unless(ancil_data != NULL);
+        fail_unless(ancil_data->nfd == 1);
+        fail_unless(read(ancil_data->fds[0], &c, 1) == 1);
+        fail_unless(c == 'x');
+        pa_close(ancil_data->fds[0]);
+    } else
+        fail_unless(!ancil_data || ancil_data->nfd == 0);
+
+    items_received++;
+}
+
+static void memblock_received(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    fail_unless(items_received < N_ITEMS);
+    fail_unless(item_is_memblock(items_received));
+    fail_unless(channel == items_received);
+    fail_unless(offset == items_received * 2);
+    fail_unless(seek == PA_SEEK_RELATIVE);
+
+    check_item(items_received, (uint8_t *) pa_memblock_acquire(chunk->memblock) + chunk->index, chunk->length);
+    pa_memblock_release(chunk->memblock);
+
+    items_received++;
+}
+
+static void send_items(pa_mainloop *ml, pa_mempool *pool, pa_pstream *p1, pa_pstream *p2) {
+    int pipefd[2] = { -1, -1 };
+    unsigned k;
+
+    items_received = 0;
+    pa_pstream_set_receive_packet_callback(p2, packet_received, NULL);
+    pa_pstream_set_receive_memblock_callback(p2, memblock_received, NULL);
+
+    if (with_fd) {
+        fail_unless(pipe(pipefd) == 0);
+        fail_unless(write(pipefd[1], "x", 1) == 1);
+    }
+
+    for (k = 0; k < N_ITEMS; k++) {
+        size_t i, length = item_size(k);
+
+        if (item_is_memblock(k)) {
+            pa_memchunk chunk;
+            uint8_t *d;
+
+            chunk.memblock = pa_memblock_new(pool, length);
+            chunk.index = 0;
+            chunk.length = length;
+
+            d = pa_memblock_acquire(chunk.memblock);
+            for (i = 0; i < length; i++)
+                d[i] = item_byte(k, i);
+            pa_memblock_release(chunk.memblock);
+
+            pa_pstream_send_memblock(p1, k, k * 2, PA_SEEK_RELATIVE, &chunk);
+            pa_memblock_unref(chunk.memblock);
+        } else {
+            pa_packet *packet;
+            uint8_t *d;
+
+            packet = pa_packet_new(length);
+            d = (uint8_t *) pa_packet_data(packet, &length);
+            for (i = 0; i < length; i++)
+                d[i] = item_byte(k, i);
+
+            if (with_fd && k == FD_ITEM) {
+                pa_cmsg_ancil_data ancil;
+
+                pa_zero(ancil);
+                ancil.nfd = 1;
+                ancil.fds[0] = pipefd[0];
+                pa_pstream_send_packet(p1, packet, &ancil);
+            } else
+                pa_pstream_send_packet(p1, packet, NULL);
+
+            pa_packet_unref(packet);
+        }
+    }
+
+    while (items_received < N_ITEMS)
+        fail_unless(pa_mainloop_iterate(ml, 1, NULL) >= 0);
+
+    fail_unless(!pa_pstream_is_pending(p1));
+
+    if (with_fd) {
+        pa_close(pipefd[0]);
+        pa_close(pipefd[1]);
+    }
+}
+
+START_TEST (pstream_batch_test) {
+    int fds[2];
+    pa_mainloop *ml;
+    pa_mempool *pool;
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+
+    ml = pa_mainloop_new();
+    pool = pa_mempool_new(false, 0);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[0], fds[0]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, pool);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, pool);
+
+    with_fd = false;
+    send_items(ml, pool, p1, p2);
+
+#ifdef HAVE_CREDS
+    /* An item with an fd has to be written on its own, and the fd must
+     * end up with that item and no other */
+    with_fd = true;
+    send_items(ml, pool, p1, p2);
+#endif
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_free(pool);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+START_TEST (pstream_batch_srbchannel_test) {
+    int pipefd[4];
+    pa_mainloop *ml;
+    pa_mempool *pool;
+    pa_iochannel *io1, *io2;
+    pa_pstream *p1, *p2;
+    pa_srbchannel *sr1, *sr2;
+    pa_srbchannel_template srt;
+
+    ml = pa_mainloop_new();
+    pool = pa_mempool_new(true, 0);
+
+    fail_unless(pipe(pipefd) == 0);
+    fail_unless(pipe(&pipefd[2]) == 0);
+    io1 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]);
+    io2 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]);
+    p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, pool);
+    p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, pool);
+
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), pool, (size_t) -1);
+    pa_srbchannel_export(sr1, &srt);
+    pa_pstream_set_srbchannel(p1, sr1);
+    sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+    pa_pstream_set_srbchannel(p2, sr2);
+
+    with_fd = false;
+    send_items(ml, pool, p1, p2);
+
+    pa_pstream_unref(p1);
+    pa_pstream_unref(p2);
+    pa_mempool_free(pool);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+/* Serialises all items into frames, as they would go over the wire */
+static uint8_t *build_frames(size_t *length) {
+    uint8_t *buf, *d;
+    unsigned k;
+
+    *length = 0;
+    for (k = 0; k < N_ITEMS; k++)
+        *length += 5 * sizeof(uint32_t) + item_size(k);
+
+    d = buf = pa_xmalloc(*length);
+
+    for (k = 0; k < N_ITEMS; k++) {
+        /* Descriptor: length, channel, offset high, offset low, flags */
+        uint32_t descriptor[5];
+        size_t i, l = item_size(k);
+
+        descriptor[0] = htonl((uint32_t) l);
+        descriptor[1] = htonl(item_is_memblock(k) ? k : (uint32_t) -1);
+        descriptor[2] = 0;
+        descriptor[3] = htonl(item_is_memblock(k) ? k * 2 : 0);
+        descriptor[4] = htonl(item_is_memblock(k) ? PA_SEEK_RELATIVE : 0);
+
+        memcpy(d, descriptor, sizeof(descriptor));
+        d += sizeof(descriptor);
+
+        for (i = 0; i < l; i++)
+            *(d++) = item_byte(k, i);
+    }
+
+    return buf;
+}
+
+/* Writes frames to the socket in odd-sized pieces, so that reads end up
+ * anywhere in a frame, and several frames come in with one read */
+START_TEST (pstream_read_test) {
+    static const size_t pieces[] = { 1, 19, 4099, 333, 30011, 7, 20 };
+    int fds[2];
+    pa_mainloop *ml;
+    pa_mempool *pool;
+    pa_iochannel *io;
+    pa_pstream *p;
+    uint8_t *frames;
+    size_t length, index = 0;
+    unsigned n = 0;
+
+    ml = pa_mainloop_new();
+    pool = pa_mempool_new(false, 0);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    io = pa_iochannel_new(pa_mainloop_get_api(ml), fds[1], fds[1]);
+    p = pa_pstream_new(pa_mainloop_get_api(ml), io, pool);
+
+    items_received = 0;
+    with_fd = false;
+    pa_pstream_set_receive_packet_callback(p, packet_received, NULL);
+    pa_pstream_set_receive_memblock_callback(p, memblock_received, NULL);
+
+    frames = build_frames(&length);
+
+    while (index < length) {
+        size_t l = PA_MIN(pieces[n % PA_ELEMENTSOF(pieces)], length - index);
+
+        fail_unless(pa_loop_write(fds[0], frames + index, l, NULL) == (ssize_t) l);
+        index += l;
+
+        /* Let a few pieces pile up before reading */
+        if (++n % 3 == 0)
+            while (pa_mainloop_iterate(ml, 0, NULL) > 0)
+                ;
+    }
+
+    while (items_received < N_ITEMS)
+        fail_unless(pa_mainloop_iterate(ml, 1, NULL) >= 0);
+
+    pa_xfree(frames);
+    pa_pstream_unref(p);
+    pa_close(fds[0]);
+    pa_mempool_free(pool);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+START_TEST (iochannel_writev_test) {
+    static const char *parts[] = { "Hello", ", ", "", "vectored", " world" };
+    struct iovec iov[PA_ELEMENTSOF(parts)];
+    char buf[64];
+    int pipefd[2];
+    pa_mainloop *ml;
+    pa_iochannel *io;
+    size_t l = 0;
+    unsigned i;
+
+    ml = pa_mainloop_new();
+
+    fail_unless(pipe(pipefd) == 0);
+    io = pa_iochannel_new(pa_mainloop_get_api(ml), -1, pipefd[1]);
+
+    for (i = 0; i < PA_ELEMENTSOF(parts); i++) {
+        iov[i].iov_base = (void *) parts[i];
+        iov[i].iov_len = strlen(parts[i]);
+        l += iov[i].iov_len;
+    }
+
+    fail_unless(pa_iochannel_writev(io, iov, PA_ELEMENTSOF(parts)) == (ssize_t) l);
+    fail_unless(read(pipefd[0], buf, sizeof(buf)) == (ssize_t) l);
+    fail_unless(memcmp(buf, "Hello, vectored world", l) == 0);
+
+    pa_iochannel_free(io);
+    pa_close(pipefd[0]);
+    pa_mainloop_free(ml);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("pstream");
+    tc = tcase_create("pstream");
+    tcase_add_test(tc, pstream_batch_test);
+    tcase_add_test(tc, pstream_batch_srbchannel_test);
+    tcase_add_test(tc, pstream_read_test);
+    tcase_add_test(tc, iochannel_writev_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
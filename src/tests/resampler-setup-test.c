@@ -0,0 +1,168 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+
+/* Checks that resamplers with the same formats, channel maps and flags
+ * share their setup, and that sharing it doesn't change their output */
+
+#define FRAMES 4096
+
+static pa_mempool *pool;
+
+static const pa_sample_spec in_ss = { PA_SAMPLE_S16NE, 44100, 2 };
+static const pa_sample_spec out_ss = { PA_SAMPLE_FLOAT32NE, 48000, 6 };
+
+static pa_channel_map in_map, out_map;
+
+static pa_resampler *resampler_new(const pa_sample_spec *a, const pa_channel_map *am) {
+    pa_resampler *r;
+
+    r = pa_resampler_new(pool, a, am, &out_ss, &out_map, 0, PA_RESAMPLER_TRIVIAL, 0);
+    fail_unless(r != NULL);
+
+    return r;
+}
+
+/* Returns a copy of the output for the given input */
+static void *run(pa_resampler *r, const int16_t *src, size_t *length) {
+    pa_memchunk in, out;
+    void *d;
+
+    in.memblock = pa_memblock_new_fixed(pool, (void *) src, FRAMES * pa_frame_size(&in_ss), true);
+    in.index = 0;
+    in.length = pa_memblock_get_length(in.memblock);
+
+    pa_resampler_run(r, &in, &out);
+    pa_memblock_unref_fixed(in.memblock);
+
+    fail_unless(out.memblock != NULL);
+
+    *length = out.length;
+    d = pa_xmemdup((uint8_t *) pa_memblock_acquire(out.memblock) + out.index, out.length);
+    pa_memblock_release(out.memblock);
+    pa_memblock_unref(out.memblock);
+
+    return d;
+}
+
+START_TEST (resampler_setup_shared_test) {
+    pa_sample_spec ss = in_ss;
+    pa_channel_map map;
+    pa_resampler *r1, *r2, *r3, *r4;
+
+    r1 = resampler_new(&in_ss, &in_map);
+
+    /* The rates are not part of the setup */
+    ss.rate = 22050;
+    r2 = resampler_new(&ss, &in_map);
+    fail_unless(r1->setup == r2->setup);
+
+    /* But the channel maps and formats are */
+    pa_channel_map_init_stereo(&map);
+    map.map[0] = PA_CHANNEL_POSITION_REAR_LEFT;
+    map.map[1] = PA_CHANNEL_POSITION_REAR_RIGHT;
+    r3 = resampler_new(&in_ss, &map);
+    fail_unless(r3->setup != r1->setup);
+
+    ss = in_ss;
+    ss.format = PA_SAMPLE_S32NE;
+    r4 = resampler_new(&ss, &in_map);
+    fail_unless(r4->setup != r1->setup);
+    fail_unless(r4->setup != r3->setup);
+
+    pa_resampler_free(r1);
+    pa_resampler_free(r2);
+    pa_resampler_free(r3);
+    pa_resampler_free(r4);
+}
+END_TEST
+
+START_TEST (resampler_setup_output_test) {
+    int16_t *src;
+    pa_resampler *r1, *r2, *r3;
+    void *ref, *out;
+    size_t ref_length, out_length;
+
+    src = pa_xnew(int16_t, FRAMES * in_ss.channels);
+    pa_random(src, FRAMES * pa_frame_size(&in_ss));
+
+    /* A resampler with a setup of its own */
+    r1 = resampler_new(&in_ss, &in_map);
+    ref = run(r1, src, &ref_length);
+    pa_resampler_free(r1);
+
+    /* One that shares its setup, and keeps using it once the resampler
+     * that created it is gone */
+    r2 = resampler_new(&in_ss, &in_map);
+    r3 = resampler_new(&in_ss, &in_map);
+    fail_unless(r2->setup == r3->setup);
+    pa_resampler_free(r2);
+
+    out = run(r3, src, &out_length);
+    pa_resampler_free(r3);
+
+    fail_unless(ref_length == out_length);
+    fail_unless(memcmp(ref, out, ref_length) == 0);
+
+    pa_xfree(ref);
+    pa_xfree(out);
+    pa_xfree(src);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(false, 0));
+
+    pa_channel_map_init_stereo(&in_map);
+    pa_channel_map_init_auto(&out_map, out_ss.channels, PA_CHANNEL_MAP_DEFAULT);
+
+    s = suite_create("Resampler setup");
+    tc = tcase_create("resampler-setup");
+    tcase_add_test(tc, resampler_setup_shared_test);
+    tcase_add_test(tc, resampler_setup_output_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    pa_mempool_free(pool);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
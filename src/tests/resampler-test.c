@@ -263,6 +263,7 @@ static void help(const char *argv0) {
              "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
              "      --resample-method=METHOD        Resample method (defaults to auto)\n"
              "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+             "      --benchmark                     Compare the speed of the speex and sinc resamplers\n"
              "\n"
              "If the formats are not specified, the test performs all formats combinations,\n"
              "back and forth.\n"
@@ -284,7 +285,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
 static void dump_resample_methods(void) {
@@ -296,11 +298,66 @@ static void dump_resample_methods(void) {
 
 }
 
+/* Resample seconds of silence in blocks of 20 ms with each of the
+ * methods and print how much faster than realtime that was */
+static void benchmark(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b, int seconds) {
+    static const pa_resample_method_t methods[] = {
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 3,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 5,
+        PA_RESAMPLER_SPEEX_FLOAT_BASE + 10,
+        PA_RESAMPLER_SINC_LOW,
+        PA_RESAMPLER_SINC_MEDIUM,
+        PA_RESAMPLER_SINC_HIGH
+    };
+    unsigned m, n, n_blocks;
+    pa_memchunk i, j;
+
+    i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(20 * PA_USEC_PER_MSEC, a));
+    i.length = pa_memblock_get_length(i.memblock);
+    i.index = 0;
+    pa_silence_memchunk(&i, a);
+
+    n_blocks = (unsigned) seconds * 50;
+
+    printf("%d Hz %d ch (%s) -> %d Hz %d ch (%s)\n",
+           a->rate, a->channels, pa_sample_format_to_string(a->format),
+           b->rate, b->channels, pa_sample_format_to_string(b->format));
+
+    for (m = 0; m < PA_ELEMENTSOF(methods); m++) {
+        pa_resampler *resampler;
+        pa_usec_t ts;
+
+        if (!pa_resample_method_supported(methods[m]))
+            continue;
+
+        if (!(resampler = pa_resampler_new(pool, a, NULL, b, NULL, 0, methods[m], 0))) {
+            printf("%-16s failed to initialize\n", pa_resample_method_to_string(methods[m]));
+            continue;
+        }
+
+        ts = pa_rtclock_now();
+        for (n = 0; n < n_blocks; n++) {
+            pa_resampler_run(resampler, &i, &j);
+            if (j.memblock)
+                pa_memblock_unref(j.memblock);
+        }
+        ts = pa_rtclock_now() - ts;
+
+        printf("%-16s %8.1f x realtime\n", pa_resample_method_to_string(pa_resampler_get_method(resampler)),
+               (double) seconds * PA_USEC_PER_SEC / (double) PA_MAX(ts, 1));
+
+        pa_resampler_free(resampler);
+    }
+
+    pa_memblock_unref(i.memblock);
+}
+
 int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, run_benchmark = false;
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +375,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             0, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -398,6 +456,10 @@ int main(int argc, char *argv[]) {
                 method = pa_parse_resample_method(optarg);
                 break;
 
+            case ARG_BENCHMARK:
+                run_benchmark = true;
+                break;
+
             default:
                 goto quit;
         }
@@ -406,6 +468,11 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(false, 0));
 
+    if (run_benchmark) {
+        benchmark(pool, &a, &b, seconds);
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -0,0 +1,191 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+#include <sys/socket.h>
+
+#ifdef HAVE_OPUS
+#include <opus.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/memblock.h>
+
+#include <modules/rtp/rtp.h>
+
+/* Frames per packet, 10 ms at 48 kHz */
+#define FRAMES 480
+
+START_TEST (rtp_timestamp_delta_test) {
+    fail_unless(pa_rtp_timestamp_delta(1000, 1000) == 0);
+    fail_unless(pa_rtp_timestamp_delta(1000, 1480) == 480);
+    fail_unless(pa_rtp_timestamp_delta(1480, 1000) == -480);
+
+    /* Across the wraparound, in both directions */
+    fail_unless(pa_rtp_timestamp_delta(0xffffff00U, 0x100) == 0x200);
+    fail_unless(pa_rtp_timestamp_delta(0x100, 0xffffff00U) == -0x200);
+}
+END_TEST
+
+START_TEST (rtp_timestamp_restarted_test) {
+    /* In sequence, after a gap, or partly overlapping what we have */
+    fail_if(pa_rtp_timestamp_restarted(0, FRAMES));
+    fail_if(pa_rtp_timestamp_restarted(10 * FRAMES, FRAMES));
+    fail_if(pa_rtp_timestamp_restarted(-FRAMES / 2, FRAMES));
+
+    /* Overtaken by a few later packets */
+    fail_if(pa_rtp_timestamp_restarted(-FRAMES, FRAMES));
+    fail_if(pa_rtp_timestamp_restarted(-3 * FRAMES, FRAMES));
+    fail_if(pa_rtp_timestamp_restarted(-100 * FRAMES, FRAMES));
+
+    /* The sender started over with the same SSRC */
+    fail_unless(pa_rtp_timestamp_restarted(-101 * FRAMES, FRAMES));
+    fail_unless(pa_rtp_timestamp_restarted(pa_rtp_timestamp_delta(123456789, 42), FRAMES));
+    fail_unless(pa_rtp_timestamp_restarted(pa_rtp_timestamp_delta(0x10000, 0xfff00000U), FRAMES));
+}
+END_TEST
+
+#ifdef HAVE_OPUS
+#define OPUS_CHANNELS 2
+#define OPUS_PACKETS 6
+/* Not sent, as when the encoder fails on a frame */
+#define OPUS_SKIPPED 2
+#define OPUS_SSRC 0x12345678U
+#define MAX_OPUS_PACKET 1275
+
+/* Encodes a tone in Opus frames of FRAMES samples, sends them the way
+ * module-rtp-send does over a socket pair and decodes what arrives */
+START_TEST (rtp_opus_loopback_test) {
+    pa_mempool *pool;
+    pa_rtp_context sender, receiver;
+    OpusEncoder *encoder;
+    OpusDecoder *decoder;
+    pa_memchunk packets[OPUS_PACKETS];
+    int16_t pcm[FRAMES * OPUS_CHANNELS];
+    int fds[2], error, one = 1;
+    unsigned i, j, sent = 0;
+    uint16_t sequence;
+
+    pa_assert_se(pool = pa_mempool_new(false, 0));
+    fail_unless(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+    setsockopt(fds[1], SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one));
+
+    fail_unless((encoder = opus_encoder_create(PA_RTP_OPUS_RATE, OPUS_CHANNELS, OPUS_APPLICATION_AUDIO, &error)) != NULL);
+    fail_unless((decoder = opus_decoder_create(PA_RTP_OPUS_RATE, OPUS_CHANNELS, &error)) != NULL);
+
+    for (i = 0; i < OPUS_PACKETS; i++) {
+        opus_int32 r;
+
+        for (j = 0; j < FRAMES; j++)
+            pcm[j * OPUS_CHANNELS] = pcm[j * OPUS_CHANNELS + 1] =
+                (int16_t) (16384 * sin(2 * M_PI * 1000 * (i * FRAMES + j) / PA_RTP_OPUS_RATE));
+
+        packets[i].memblock = pa_memblock_new(pool, MAX_OPUS_PACKET);
+        packets[i].index = 0;
+        r = opus_encode(encoder, pcm, FRAMES, pa_memblock_acquire(packets[i].memblock), MAX_OPUS_PACKET);
+        pa_memblock_release(packets[i].memblock);
+
+        fail_unless(r > 0);
+        packets[i].length = i == OPUS_SKIPPED ? 0 : (size_t) r;
+    }
+
+    pa_rtp_context_init_send(&sender, fds[0], OPUS_SSRC, PA_RTP_PAYLOAD_OPUS, OPUS_CHANNELS * sizeof(int16_t));
+    pa_rtp_context_init_recv(&receiver, fds[1], 1);
+    pa_rtp_context_set_max_packet_size(&receiver, MAX_OPUS_PACKET);
+    sequence = sender.sequence;
+
+    /* The timestamp runs at 48 kHz and covers the frame that wasn't sent */
+    fail_unless(pa_rtp_send_packets(&sender, packets, OPUS_PACKETS, FRAMES) == 0);
+    fail_unless(sender.timestamp == OPUS_PACKETS * FRAMES);
+
+    for (i = 0; i < OPUS_PACKETS; i++) {
+        pa_memchunk chunk;
+        struct timeval tv;
+        const uint8_t *a, *b;
+        int r;
+
+        if (i == OPUS_SKIPPED)
+            continue;
+
+        fail_unless(pa_rtp_recv(&receiver, &chunk, pool, &tv) == 0);
+
+        /* Each packet is one Opus packet as it came from the encoder,
+         * with the sequence numbers counting only what was sent */
+        fail_unless(receiver.payload == PA_RTP_PAYLOAD_OPUS);
+        fail_unless(receiver.ssrc == OPUS_SSRC);
+        fail_unless(receiver.sequence == (uint16_t) (sequence + sent));
+        fail_unless(receiver.timestamp == i * FRAMES);
+        fail_unless(chunk.length == packets[i].length);
+
+        a = pa_memblock_acquire_chunk(&chunk);
+        b = pa_memblock_acquire_chunk(&packets[i]);
+        fail_unless(memcmp(a, b, chunk.length) == 0);
+        pa_memblock_release(packets[i].memblock);
+
+        fail_unless(opus_packet_get_nb_samples(a, (opus_int32) chunk.length, PA_RTP_OPUS_RATE) == FRAMES);
+        r = opus_decode(decoder, a, (opus_int32) chunk.length, pcm, FRAMES, 0);
+        pa_memblock_release(chunk.memblock);
+
+        fail_unless(r == FRAMES);
+        pa_memblock_unref(chunk.memblock);
+        sent++;
+    }
+
+    fail_unless(pa_rtp_recv_pending(&receiver) == 0);
+
+    for (i = 0; i < OPUS_PACKETS; i++)
+        pa_memblock_unref(packets[i].memblock);
+
+    opus_decoder_destroy(decoder);
+    opus_encoder_destroy(encoder);
+    pa_rtp_context_destroy(&receiver);
+    pa_rtp_context_destroy(&sender);
+    pa_mempool_free(pool);
+}
+END_TEST
+#endif
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("RTP");
+    tc = tcase_create("rtp");
+    tcase_add_test(tc, rtp_timestamp_delta_test);
+    tcase_add_test(tc, rtp_timestamp_restarted_test);
+#ifdef HAVE_OPUS
+    tcase_add_test(tc, rtp_opus_loopback_test);
+#endif
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
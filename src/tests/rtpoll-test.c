@@ -21,9 +21,15 @@
 
 #include <check.h>
 #include <signal.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-rtclock.h>
 #include <pulsecore/rtpoll.h>
 
 static int before(pa_rtpoll_item *i) {
@@ -40,12 +46,15 @@ static int worker(pa_rtpoll_item *w) {
     return 0;
 }
 
-START_TEST (rtpoll_test) {
+static void run_rtpoll_test(pa_rtpoll_backend_t b) {
     pa_rtpoll *p;
     pa_rtpoll_item *i, *w;
     struct pollfd *pollfd;
 
-    p = pa_rtpoll_new();
+    pa_log_debug("Checking %s backend", pa_rtpoll_backend_to_string(b));
+
+    p = pa_rtpoll_new_with_backend(b);
+    fail_unless(pa_rtpoll_get_backend(p) == b);
 
     i = pa_rtpoll_item_new(p, PA_RTPOLL_EARLY, 1);
     pa_rtpoll_item_set_before_callback(i, before);
@@ -80,6 +89,104 @@ START_TEST (rtpoll_test) {
 
     pa_rtpoll_free(p);
 }
+
+START_TEST (rtpoll_test) {
+    run_rtpoll_test(PA_RTPOLL_BACKEND_POLL);
+
+    if (pa_rtpoll_backend_supported(PA_RTPOLL_BACKEND_EPOLL))
+        run_rtpoll_test(PA_RTPOLL_BACKEND_EPOLL);
+}
+END_TEST
+
+static void run_events_test(pa_rtpoll_backend_t b) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *i, *j;
+    struct pollfd *pollfd, *pollfd2;
+    int fds[2], fds2[2];
+    pa_usec_t start;
+    char c = 'x';
+
+    pa_log_debug("Checking events with %s backend", pa_rtpoll_backend_to_string(b));
+
+    fail_unless(pipe(fds) == 0);
+    fail_unless(pipe(fds2) == 0);
+
+    p = pa_rtpoll_new_with_backend(b);
+
+    i = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd->fd = fds[0];
+    pollfd->events = POLLIN;
+
+    /* Nothing to read, so only the timer wakes us up */
+    start = pa_rtclock_now();
+    pa_rtpoll_set_timer_relative(p, 20 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtclock_now() - start >= 20 * PA_USEC_PER_MSEC);
+    fail_unless(pollfd->revents == 0);
+
+    /* Now the fd wakes us up long before the timer */
+    fail_unless(pa_write(fds[1], &c, 1, NULL) == 1);
+    start = pa_rtclock_now();
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtclock_now() - start < 5 * PA_USEC_PER_SEC);
+    fail_unless(pollfd->revents & POLLIN);
+
+    /* Changing the events of an existing item takes effect */
+    pollfd->events = POLLOUT;
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pollfd->revents == 0);
+    pollfd->events = POLLIN;
+
+    /* Two items may wait on the same fd */
+    j = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 2);
+    pollfd2 = pa_rtpoll_item_get_pollfd(j, NULL);
+    pollfd2[0].fd = fds[0];
+    pollfd2[0].events = POLLIN;
+    pollfd2[1].fd = fds2[0];
+    pollfd2[1].events = POLLIN;
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    fail_unless(pollfd->revents & POLLIN);
+    fail_unless(pollfd2[0].revents & POLLIN);
+    fail_unless(pollfd2[1].revents == 0);
+
+    /* Draining the pipe and freeing the first item leaves only the
+     * second pipe */
+    fail_unless(pa_read(fds[0], &c, 1, NULL) == 1);
+    pa_rtpoll_item_free(i);
+    fail_unless(pa_write(fds2[1], &c, 1, NULL) == 1);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    pollfd2 = pa_rtpoll_item_get_pollfd(j, NULL);
+    fail_unless(pollfd2[0].revents == 0);
+    fail_unless(pollfd2[1].revents & POLLIN);
+
+    /* A closed writer end shows up as a hangup */
+    pa_close(fds2[1]);
+    fail_unless(pa_read(fds2[0], &c, 1, NULL) == 1);
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pollfd2[1].revents & POLLHUP);
+
+    pa_rtpoll_item_free(j);
+    pa_rtpoll_free(p);
+
+    pa_close_pipe(fds);
+    pa_close(fds2[0]);
+}
+
+START_TEST (rtpoll_events_test) {
+    run_events_test(PA_RTPOLL_BACKEND_POLL);
+
+    if (pa_rtpoll_backend_supported(PA_RTPOLL_BACKEND_EPOLL))
+        run_events_test(PA_RTPOLL_BACKEND_EPOLL);
+}
 END_TEST
 
 int main(int argc, char *argv[]) {
@@ -88,9 +195,13 @@ int main(int argc, char *argv[]) {
     TCase *tc;
     SRunner *sr;
 
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_events_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
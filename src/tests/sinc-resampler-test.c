@@ -0,0 +1,367 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/resampler/sinc.h>
+#include <pulsecore/cpu-x86.h>
+
+#define FRAMES 20000
+#define CHANNELS 2
+#define FREQ 1000.0
+
+/* More than half the longest filter, in input frames */
+#define SKIP 1024
+
+static pa_mempool *pool;
+
+/* Feeds the input in chunks of varying size, and returns the
+ * concatenated output */
+static void *run(pa_resampler *r, const void *src, size_t length, size_t *out_length) {
+    size_t fz = pa_frame_size(pa_resampler_input_sample_spec(r)), done, i;
+    uint8_t *out = NULL;
+
+    *out_length = 0;
+
+    for (done = 0, i = 1; done < length; i = i * 7 % 1031) {
+        pa_memchunk in, o;
+        size_t n = PA_MIN(i * fz, length - done);
+
+        in.memblock = pa_memblock_new_fixed(pool, (uint8_t *) src + done, n, true);
+        in.index = 0;
+        in.length = n;
+
+        pa_resampler_run(r, &in, &o);
+        pa_memblock_unref(in.memblock);
+        done += n;
+
+        if (!o.memblock)
+            continue;
+
+        out = pa_xrealloc(out, *out_length + o.length);
+        memcpy(out + *out_length, (uint8_t *) pa_memblock_acquire(o.memblock) + o.index, o.length);
+        pa_memblock_release(o.memblock);
+        pa_memblock_unref(o.memblock);
+        *out_length += o.length;
+    }
+
+    return out;
+}
+
+static void *make_sine(pa_sample_format_t format, unsigned rate) {
+    void *d;
+    unsigned i, c;
+
+    d = pa_xmalloc(FRAMES * CHANNELS * pa_sample_size_of_format(format));
+
+    for (i = 0; i < FRAMES; i++)
+        for (c = 0; c < CHANNELS; c++) {
+            double v = 0.5 * sin(2.0 * M_PI * FREQ * i / rate + c);
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                ((float *) d)[i * CHANNELS + c] = (float) v;
+            else
+                ((int16_t *) d)[i * CHANNELS + c] = (int16_t) lrint(v * 0x8000);
+        }
+
+    return d;
+}
+
+static double get_sample(const void *d, pa_sample_format_t format, unsigned i) {
+    if (format == PA_SAMPLE_FLOAT32NE)
+        return ((const float *) d)[i];
+    else
+        return ((const int16_t *) d)[i] / (double) 0x8000;
+}
+
+/* Resample a sine, and compare with the sine at the output rate. Output
+ * frame n is centered on input frame n * in_rate / out_rate. */
+static void run_sine_test(pa_resample_method_t method, pa_sample_format_t format, unsigned in_rate, unsigned out_rate, double tolerance) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    void *src, *out;
+    size_t out_length;
+    unsigned n, n_frames, c;
+    double max_err = 0.0;
+
+    a.format = b.format = format;
+    a.channels = b.channels = CHANNELS;
+    a.rate = in_rate;
+    b.rate = out_rate;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, PA_RESAMPLER_VARIABLE_RATE));
+    fail_unless(pa_resampler_get_method(r) == method);
+
+    src = make_sine(format, in_rate);
+    out = run(r, src, FRAMES * pa_frame_size(&a), &out_length);
+    n_frames = out_length / pa_frame_size(&b);
+
+    /* Nothing is lost but the end of the input */
+    fail_unless(n_frames + SKIP * out_rate / in_rate >= (uint64_t) FRAMES * out_rate / in_rate);
+
+    /* Skip the beginning, where the filter still sees the silence
+     * before the input */
+    for (n = SKIP * out_rate / in_rate; n < n_frames; n++)
+        for (c = 0; c < CHANNELS; c++) {
+            double expected = 0.5 * sin(2.0 * M_PI * FREQ * n / out_rate + c);
+
+            max_err = PA_MAX(max_err, fabs(get_sample(out, format, n * CHANNELS + c) - expected));
+        }
+
+    pa_log_debug("%s, %s, %u -> %u Hz: max error %g", pa_resample_method_to_string(method),
+                 pa_sample_format_to_string(format), in_rate, out_rate, max_err);
+    fail_unless(max_err < tolerance);
+
+    pa_xfree(src);
+    pa_xfree(out);
+    pa_resampler_free(r);
+}
+
+START_TEST (sinc_sine_test) {
+    static const unsigned rates[][2] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 8000, 44100 },
+        { 96000, 22050 },
+        /* These need interpolated tables */
+        { 44100, 48017 },
+        { 48017, 44100 },
+    };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(rates); i++) {
+        run_sine_test(PA_RESAMPLER_SINC_LOW, PA_SAMPLE_FLOAT32NE, rates[i][0], rates[i][1], 5e-3);
+        run_sine_test(PA_RESAMPLER_SINC_MEDIUM, PA_SAMPLE_FLOAT32NE, rates[i][0], rates[i][1], 5e-4);
+        run_sine_test(PA_RESAMPLER_SINC_HIGH, PA_SAMPLE_FLOAT32NE, rates[i][0], rates[i][1], 5e-5);
+        run_sine_test(PA_RESAMPLER_SINC_LOW, PA_SAMPLE_S16NE, rates[i][0], rates[i][1], 5e-3);
+        run_sine_test(PA_RESAMPLER_SINC_MEDIUM, PA_SAMPLE_S16NE, rates[i][0], rates[i][1], 6e-4);
+        run_sine_test(PA_RESAMPLER_SINC_HIGH, PA_SAMPLE_S16NE, rates[i][0], rates[i][1], 1e-4);
+    }
+}
+END_TEST
+
+/* Change the input rate halfway through, and check that the output
+ * continues where it left off at the new rate */
+START_TEST (sinc_variable_rate_test) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    void *src, *out1, *out2;
+    size_t length, out1_length, out2_length;
+    unsigned n, n1, n2, c;
+    double max_err = 0.0;
+
+    a.format = b.format = PA_SAMPLE_FLOAT32NE;
+    a.channels = b.channels = CHANNELS;
+    a.rate = 44100;
+    b.rate = 48000;
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, PA_RESAMPLER_SINC_MEDIUM, PA_RESAMPLER_VARIABLE_RATE));
+
+    src = make_sine(PA_SAMPLE_FLOAT32NE, 44100);
+    length = FRAMES / 2 * pa_frame_size(&a);
+
+    out1 = run(r, src, length, &out1_length);
+    pa_resampler_set_input_rate(r, 44150);
+    out2 = run(r, (uint8_t *) src + length, length, &out2_length);
+
+    n1 = out1_length / pa_frame_size(&b);
+    n2 = out2_length / pa_frame_size(&b);
+
+    for (n = 0; n < n2 - 32; n++)
+        for (c = 0; c < CHANNELS; c++) {
+            double t = n1 * 44100.0 / 48000.0 + n * 44150.0 / 48000.0;
+            double expected = 0.5 * sin(2.0 * M_PI * FREQ * t / 44100 + c);
+
+            max_err = PA_MAX(max_err, fabs(((float *) out2)[n * CHANNELS + c] - expected));
+        }
+
+    pa_log_debug("Variable rate: max error %g", max_err);
+    fail_unless(max_err < 5e-4);
+
+    pa_xfree(src);
+    pa_xfree(out1);
+    pa_xfree(out2);
+    pa_resampler_free(r);
+}
+END_TEST
+
+/* Rewinding and passing in the same input again must give exactly the
+ * same output as not rewinding at all */
+static void run_rewind_test(pa_resample_method_t method, pa_sample_format_t format, unsigned in_rate, unsigned out_rate) {
+    pa_sample_spec a, b;
+    pa_resampler *r;
+    uint8_t *src, *ref, *out = NULL;
+    size_t ref_length, out_length = 0, in_fz, out_fz, done = 0, max_done = 0;
+    unsigned i, n_chunks = 0, n_rewinds = 0;
+
+    a.format = b.format = format;
+    a.channels = b.channels = CHANNELS;
+    a.rate = in_rate;
+    b.rate = out_rate;
+
+    in_fz = pa_frame_size(&a);
+    out_fz = pa_frame_size(&b);
+
+    src = pa_xmalloc(FRAMES * in_fz);
+    pa_random(src, FRAMES * in_fz);
+    if (format == PA_SAMPLE_FLOAT32NE)
+        for (i = 0; i < FRAMES * CHANNELS; i++)
+            ((float *) src)[i] = (float) (((uint16_t *) src)[2 * i] / 32768.0 - 1.0);
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+    ref = run(r, src, FRAMES * in_fz, &ref_length);
+    pa_resampler_free(r);
+
+    pa_assert_se(r = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+    pa_resampler_set_max_rewind(r, 3000 * in_fz);
+
+    for (i = 1; done < FRAMES * in_fz; i = i * 5 % 997) {
+        size_t n = PA_MIN(i * 3 * in_fz, FRAMES * in_fz - done), o_length, rewind;
+        uint8_t *o;
+
+        o = run(r, src + done, n, &o_length);
+        if (o_length > 0) {
+            out = pa_xrealloc(out, out_length + o_length);
+            memcpy(out + out_length, o, o_length);
+            out_length += o_length;
+            pa_xfree(o);
+        }
+        done += n;
+        max_done = PA_MAX(max_done, done);
+
+        /* Go back every now and then, but never to more than 3000 frames
+         * before the furthest point reached, and not to the very
+         * beginning, which would just reset the resampler */
+        rewind = (i * 11 % 3001) * in_fz;
+        if (++n_chunks % 3 == 0 && rewind > 0 && rewind + SKIP * in_fz <= done &&
+            max_done - done + rewind <= 3000 * in_fz) {
+            size_t discard = pa_resampler_rewind(r, rewind);
+
+            fail_unless(discard <= out_length);
+            fail_unless(discard % out_fz == 0);
+            out_length -= discard;
+            done -= rewind;
+            n_rewinds++;
+        }
+    }
+
+    pa_log_debug("%s, %s, %u -> %u Hz: %u rewinds", pa_resample_method_to_string(method),
+                 pa_sample_format_to_string(format), in_rate, out_rate, n_rewinds);
+
+    fail_unless(out_length == ref_length);
+    fail_unless(memcmp(out, ref, ref_length) == 0);
+
+    pa_xfree(src);
+    pa_xfree(ref);
+    pa_xfree(out);
+    pa_resampler_free(r);
+}
+
+START_TEST (sinc_rewind_test) {
+    run_rewind_test(PA_RESAMPLER_SINC_LOW, PA_SAMPLE_S16NE, 44100, 48000);
+    run_rewind_test(PA_RESAMPLER_SINC_MEDIUM, PA_SAMPLE_FLOAT32NE, 48000, 44100);
+    run_rewind_test(PA_RESAMPLER_SINC_HIGH, PA_SAMPLE_FLOAT32NE, 44100, 48017);
+    run_rewind_test(PA_RESAMPLER_SINC_MEDIUM, PA_SAMPLE_S16NE, 48017, 22050);
+}
+END_TEST
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (sinc_avx2_test) {
+#ifdef HAVE_AVX2
+    pa_sinc_dot_float_func_t float_c, float_avx2;
+    pa_sinc_dot_s16_func_t s16_c, s16_avx2;
+    pa_cpu_x86_flag_t flags = 0;
+    float x[256], h[256];
+    int16_t xi[256], hi[256];
+    unsigned i, n;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_AVX2)) {
+        pa_log_info("AVX2 not supported. Skipping");
+        return;
+    }
+
+    float_c = pa_get_sinc_dot_float_func();
+    s16_c = pa_get_sinc_dot_s16_func();
+    pa_sinc_func_init_avx2(flags);
+    float_avx2 = pa_get_sinc_dot_float_func();
+    s16_avx2 = pa_get_sinc_dot_s16_func();
+    pa_set_sinc_dot_float_func(float_c);
+    pa_set_sinc_dot_s16_func(s16_c);
+
+    pa_random(xi, sizeof(xi));
+    pa_random(hi, sizeof(hi));
+    for (i = 0; i < 256; i++) {
+        x[i] = xi[i] / 32768.0f;
+        h[i] = hi[i] / 32768.0f / 64;
+        /* Keep the s16 sums in range */
+        hi[i] /= 8;
+    }
+
+    for (n = 16; n <= 256; n += 16) {
+        fail_unless(fabsf(float_c(x, h, n) - float_avx2(x, h, n)) < 1e-5f);
+        fail_unless(s16_c(xi, hi, n) == s16_avx2(xi, hi, n));
+    }
+#endif /* HAVE_AVX2 */
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pool = pa_mempool_new(false, 0);
+
+    s = suite_create("Sinc resampler");
+    tc = tcase_create("sinc");
+    tcase_add_test(tc, sinc_sine_test);
+    tcase_add_test(tc, sinc_variable_rate_test);
+    tcase_add_test(tc, sinc_rewind_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, sinc_avx2_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    pa_mempool_free(pool);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,275 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+/* Renders a sink with several inputs, once serially and once on a
+ * render pool, and checks that both give the same result */
+
+#define N_INPUTS 6
+#define BLOCK_BYTES 4096
+#define N_BLOCKS 32
+
+enum {
+    SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX
+};
+
+struct test_sink {
+    pa_sink *sink;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+    pa_thread *thread;
+};
+
+struct test_input {
+    pa_sink_input *input;
+    unsigned freq;
+    size_t pos;
+};
+
+static pa_mainloop *mainloop = NULL;
+static pa_core *core = NULL;
+
+static void thread_func(void *userdata) {
+    struct test_sink *t = userdata;
+
+    pa_thread_mq_install(&t->thread_mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(t->rtpoll)) < 0)
+            fail();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+/* Called from IO thread context */
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    if (code == SINK_MESSAGE_RENDER) {
+        pa_sink_render_full(s, (size_t) offset, data);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+/* Called from IO thread context */
+static int input_pop(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct test_input *ti = i->userdata;
+    int16_t *d;
+    size_t n, k;
+
+    n = nbytes / sizeof(int16_t);
+
+    chunk->memblock = pa_memblock_new(core->mempool, n * sizeof(int16_t));
+    chunk->index = 0;
+    chunk->length = n * sizeof(int16_t);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (k = 0; k < n; k++, ti->pos++)
+        d[k] = (int16_t) (8000.0 * sin(2.0 * M_PI * ti->freq * ti->pos / i->sample_spec.rate));
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+static void input_process_rewind(pa_sink_input *i, size_t nbytes) {
+}
+
+static void input_kill(pa_sink_input *i) {
+}
+
+static void test_sink_init(struct test_sink *t, unsigned render_threads) {
+    pa_sink_new_data data;
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, 48000, 2 };
+
+    t->rtpoll = pa_rtpoll_new();
+    pa_thread_mq_init(&t->thread_mq, pa_mainloop_get_api(mainloop), t->rtpoll);
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, render_threads ? "parallel" : "serial");
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+    pa_proplist_setf(data.proplist, PA_SINK_PROP_RENDER_THREADS, "%u", render_threads);
+
+    t->sink = pa_sink_new(core, &data, 0);
+    pa_sink_new_data_done(&data);
+    fail_unless(t->sink != NULL);
+
+    t->sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(t->sink, t->thread_mq.inq);
+    pa_sink_set_rtpoll(t->sink, t->rtpoll);
+
+    fail_unless((t->thread = pa_thread_new("test-sink", thread_func, t)) != NULL);
+
+    pa_sink_put(t->sink);
+}
+
+static void test_sink_done(struct test_sink *t) {
+    pa_sink_unlink(t->sink);
+
+    pa_asyncmsgq_send(t->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(t->thread);
+
+    pa_sink_unref(t->sink);
+    pa_thread_mq_done(&t->thread_mq);
+    pa_rtpoll_free(t->rtpoll);
+}
+
+static void add_input(struct test_sink *t, struct test_input *ti, unsigned n) {
+    /* Different rates and volumes, so that each input is resampled,
+     * remapped and scaled on its own */
+    static const uint32_t rates[] = { 44100, 48000, 22050, 32000 };
+    pa_sink_input_new_data data;
+    pa_sample_spec ss;
+    pa_cvolume v;
+
+    ss.format = PA_SAMPLE_S16NE;
+    ss.rate = rates[n % PA_ELEMENTSOF(rates)];
+    ss.channels = 1;
+
+    pa_cvolume_set(&v, 1, PA_VOLUME_NORM / (n + 1));
+
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, t->sink, false);
+    pa_sink_input_new_data_set_sample_spec(&data, &ss);
+    pa_sink_input_new_data_set_volume(&data, &v);
+
+    pa_sink_input_new(&ti->input, core, &data);
+    pa_sink_input_new_data_done(&data);
+    fail_unless(ti->input != NULL);
+
+    ti->freq = 220 * (n + 1);
+    ti->pos = 0;
+
+    ti->input->pop = input_pop;
+    ti->input->process_rewind = input_process_rewind;
+    ti->input->kill = input_kill;
+    ti->input->userdata = ti;
+
+    pa_sink_input_put(ti->input);
+}
+
+/* Returns N_BLOCKS blocks rendered from N_INPUTS inputs */
+static uint8_t *render(unsigned render_threads) {
+    struct test_sink t;
+    struct test_input inputs[N_INPUTS];
+    uint8_t *out;
+    unsigned k;
+
+    test_sink_init(&t, render_threads);
+
+    for (k = 0; k < N_INPUTS; k++)
+        add_input(&t, &inputs[k], k);
+
+    out = pa_xmalloc(N_BLOCKS * BLOCK_BYTES);
+
+    for (k = 0; k < N_BLOCKS; k++) {
+        pa_memchunk chunk;
+        void *d;
+
+        pa_asyncmsgq_send(t.sink->asyncmsgq, PA_MSGOBJECT(t.sink), SINK_MESSAGE_RENDER, &chunk, BLOCK_BYTES, NULL);
+        fail_unless(chunk.length == BLOCK_BYTES);
+
+        d = pa_memblock_acquire_chunk(&chunk);
+        memcpy(out + k * BLOCK_BYTES, d, BLOCK_BYTES);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    for (k = 0; k < N_INPUTS; k++) {
+        pa_sink_input_unlink(inputs[k].input);
+        pa_sink_input_unref(inputs[k].input);
+    }
+
+    test_sink_done(&t);
+
+    return out;
+}
+
+START_TEST (sink_render_pool_test) {
+    uint8_t *serial, *parallel;
+    unsigned silent = 0, k;
+
+    serial = render(0);
+    parallel = render(3);
+
+    /* Make sure there is something to compare */
+    for (k = 0; k < N_BLOCKS * BLOCK_BYTES; k++)
+        if (serial[k] == 0)
+            silent++;
+    fail_unless(silent < N_BLOCKS * BLOCK_BYTES / 2);
+
+    fail_unless(memcmp(serial, parallel, N_BLOCKS * BLOCK_BYTES) == 0);
+
+    pa_xfree(serial);
+    pa_xfree(parallel);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    mainloop = pa_mainloop_new();
+    core = pa_core_new(pa_mainloop_get_api(mainloop), false, 0);
+
+    s = suite_create("Sink render");
+    tc = tcase_create("sink-render");
+    tcase_add_test(tc, sink_render_pool_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    pa_core_unref(core);
+    pa_mainloop_free(mainloop);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
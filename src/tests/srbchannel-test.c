@@ -29,6 +29,7 @@
 #include <pulsecore/pstream.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/macro.h>
 
 static unsigned packets_received;
 static unsigned packets_checksum;
@@ -105,7 +106,7 @@ START_TEST (srbchannel_test) {
 
     pa_log_debug("And now the same thing with srbchannel...");
 
-    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp);
+    sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, (size_t) -1);
     pa_srbchannel_export(sr1, &srt);
     pa_pstream_set_srbchannel(p1, sr1);
     sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
@@ -121,6 +122,50 @@ START_TEST (srbchannel_test) {
 }
 END_TEST
 
+START_TEST (srbchannel_size_test) {
+    static const size_t sizes[] = { PA_SRBCHANNEL_SIZE_MIN, 16*1024, 256*1024 };
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(sizes); i++) {
+        int pipefd[4];
+
+        pa_mainloop *ml = pa_mainloop_new();
+        pa_mempool *mp = pa_mempool_new(true, 0);
+        pa_iochannel *io1, *io2;
+        pa_pstream *p1, *p2;
+        pa_srbchannel *sr1, *sr2;
+        pa_srbchannel_template srt;
+
+        fail_unless(pipe(pipefd) == 0);
+        fail_unless(pipe(&pipefd[2]) == 0);
+        io1 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[2], pipefd[1]);
+        io2 = pa_iochannel_new(pa_mainloop_get_api(ml), pipefd[0], pipefd[3]);
+        p1 = pa_pstream_new(pa_mainloop_get_api(ml), io1, mp);
+        p2 = pa_pstream_new(pa_mainloop_get_api(ml), io2, mp);
+
+        sr1 = pa_srbchannel_new(pa_mainloop_get_api(ml), mp, sizes[i]);
+        fail_unless(sr1 != NULL);
+        fail_unless(pa_srbchannel_get_capacity(sr1) > sizes[i] / 2 - 256);
+        fail_unless(pa_srbchannel_get_capacity(sr1) <= sizes[i] / 2);
+
+        pa_srbchannel_export(sr1, &srt);
+        pa_pstream_set_srbchannel(p1, sr1);
+        sr2 = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+        fail_unless(sr2 != NULL);
+        fail_unless(pa_srbchannel_get_capacity(sr2) == pa_srbchannel_get_capacity(sr1));
+        pa_pstream_set_srbchannel(p2, sr2);
+
+        pa_log_debug("Ringbuffer block of %zu bytes", sizes[i]);
+        packet_test(250, 5, ml, p1, p2);
+        packet_test(10, 12345, ml, p1, p2);
+
+        pa_pstream_unref(p1);
+        pa_pstream_unref(p2);
+        pa_mempool_free(mp);
+        pa_mainloop_free(ml);
+    }
+}
+END_TEST
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -134,6 +179,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("srbchannel");
     tc = tcase_create("srbchannel");
     tcase_add_test(tc, srbchannel_test);
+    tcase_add_test(tc, srbchannel_size_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
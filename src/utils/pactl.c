@@ -61,7 +61,8 @@ static char
 static uint32_t
     sink_input_idx = PA_INVALID_INDEX,
     source_output_idx = PA_INVALID_INDEX,
-    sink_idx = PA_INVALID_INDEX;
+    sink_idx = PA_INVALID_INDEX,
+    timing_idx = PA_INVALID_INDEX;
 
 static bool short_list_format = false;
 static uint32_t module_index;
@@ -132,6 +133,10 @@ static enum {
     SET_PORT_LATENCY_OFFSET,
     SET_SINK_LATENCY_OFFSET,
     SET_SOURCE_LATENCY_OFFSET,
+    GET_SINK_TIMING,
+    GET_SOURCE_TIMING,
+    GET_SINK_INPUT_TIMING,
+    GET_SOURCE_OUTPUT_TIMING,
     SUBSCRIBE
 } action = NONE;
 
@@ -180,6 +185,45 @@ static void stat_callback(pa_context *c, const pa_stat_info *i, void *userdata)
     complete_action();
 }
 
+static void get_timing_stats_callback(pa_context *c, const pa_timing_stats_info *i, void *userdata) {
+    uint32_t j, k;
+
+    if (!i) {
+        pa_log(_("Failed to get timing statistics: %s"), pa_strerror(pa_context_errno(c)));
+        quit(1);
+        return;
+    }
+
+    for (j = 0; j < i->n_histograms; j++) {
+        const pa_timing_histogram *h = &i->histograms[j];
+
+        if (h->count == 0) {
+            printf(_("%s: no data\n"), h->name);
+            continue;
+        }
+
+        printf(_("%s: %llu calls, average %llu usec, maximum %llu usec\n"),
+               h->name,
+               (unsigned long long) h->count,
+               (unsigned long long) (h->total / h->count),
+               (unsigned long long) h->max);
+
+        for (k = 0; k < h->n_buckets; k++) {
+            if (h->buckets[k] == 0)
+                continue;
+
+            if (k == 0)
+                printf("\t        < 1 usec: %u\n", h->buckets[k]);
+            else if (k == h->n_buckets - 1)
+                printf("\t>= %8llu usec: %u\n", 1ULL << (k - 1), h->buckets[k]);
+            else
+                printf("\t < %8llu usec: %u\n", 1ULL << k, h->buckets[k]);
+        }
+    }
+
+    complete_action();
+}
+
 static void get_server_info_callback(pa_context *c, const pa_server_info *i, void *useerdata) {
     char ss[PA_SAMPLE_SPEC_SNPRINT_MAX], cm[PA_CHANNEL_MAP_SNPRINT_MAX];
 
@@ -1414,6 +1458,22 @@ static void context_state_callback(pa_context *c, void *userdata) {
                     o = pa_context_set_source_latency_offset(c, source_name, latency_offset, simple_callback, NULL);
                     break;
 
+                case GET_SINK_TIMING:
+                    o = pa_context_get_sink_timing_stats(c, timing_idx, get_timing_stats_callback, NULL);
+                    break;
+
+                case GET_SOURCE_TIMING:
+                    o = pa_context_get_source_timing_stats(c, timing_idx, get_timing_stats_callback, NULL);
+                    break;
+
+                case GET_SINK_INPUT_TIMING:
+                    o = pa_context_get_sink_input_timing_stats(c, timing_idx, get_timing_stats_callback, NULL);
+                    break;
+
+                case GET_SOURCE_OUTPUT_TIMING:
+                    o = pa_context_get_source_output_timing_stats(c, timing_idx, get_timing_stats_callback, NULL);
+                    break;
+
                 case SUBSCRIBE:
                     pa_context_set_subscribe_callback(c, context_subscribe_callback, NULL);
 
@@ -1591,6 +1651,7 @@ static void help(const char *argv0) {
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-sink-formats", _("#N FORMATS"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-port-latency-offset", _("CARD-NAME|CARD-#N PORT OFFSET"));
     printf("%s %s %s %s\n", argv0, _("[options]"), "set-(sink|source)-latency-offset", _("NAME|#N OFFSET"));
+    printf("%s %s %s %s\n", argv0, _("[options]"), "get-(sink|source|sink-input|source-output)-timing", _("#N"));
     printf("%s %s %s\n",    argv0, _("[options]"), "subscribe");
     printf(_("\nThe special names @DEFAULT_SINK@, @DEFAULT_SOURCE@ and @DEFAULT_MONITOR@\n"
              "can be used to specify the default sink, source and monitor.\n"));
@@ -2085,6 +2146,30 @@ int main(int argc, char *argv[]) {
                 goto quit;
             }
 
+        } else if (pa_streq(argv[optind], "get-sink-timing") ||
+                   pa_streq(argv[optind], "get-source-timing") ||
+                   pa_streq(argv[optind], "get-sink-input-timing") ||
+                   pa_streq(argv[optind], "get-source-output-timing")) {
+
+            if (pa_streq(argv[optind], "get-sink-timing"))
+                action = GET_SINK_TIMING;
+            else if (pa_streq(argv[optind], "get-source-timing"))
+                action = GET_SOURCE_TIMING;
+            else if (pa_streq(argv[optind], "get-sink-input-timing"))
+                action = GET_SINK_INPUT_TIMING;
+            else
+                action = GET_SOURCE_OUTPUT_TIMING;
+
+            if (argc != optind+2) {
+                pa_log(_("You have to specify an index"));
+                goto quit;
+            }
+
+            if (pa_atou(argv[optind+1], &timing_idx) < 0) {
+                pa_log(_("Invalid index specification"));
+                goto quit;
+            }
+
         } else if (pa_streq(argv[optind], "help")) {
             help(bn);
             ret = 0;